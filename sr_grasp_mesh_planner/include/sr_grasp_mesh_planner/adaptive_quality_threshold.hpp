@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   adaptive_quality_threshold.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A minimum grasp quality adjusted while planning, to find the grasps of a goal in time.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
+
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * The qualities of the evaluated samples of a goal are kept in a histogram. From the rate
+ * of the samples, the threshold is the quality that the right share of the samples still
+ * to come would pass to get the missing grasps by the end of the budget: it goes up when
+ * good grasps are easy to find, and down to the floor when they are not.
+ *
+ * Until enough samples have been seen, only grasps of the maximum quality are accepted.
+ * The threshold never goes below the floor. The workers of a goal share one threshold,
+ * so all its methods can be called from any thread.
+ **/
+class AdaptiveQualityThreshold
+{
+public:
+  /*! Qualities are binned in [0, max_quality], the ones above are in the last bin. */
+  explicit AdaptiveQualityThreshold(float floor,
+                                    float max_quality = 1.0f,
+                                    int num_bins = 200,
+                                    int min_samples = 20);
+
+  /*! Start a goal that needs num_grasps grasps in budget seconds. */
+  void start(int num_grasps, double budget);
+
+  /*! The minimum quality a sample needs to be accepted now. */
+  float getThreshold() const;
+
+  /*! Seconds left in the budget (never negative). */
+  double getRemainingTime() const;
+
+  /*! A sample was evaluated (its hand closed with enough contacts). */
+  void addSample(float quality);
+
+  /*! A grasp was accepted. */
+  void addAccepted();
+
+private:
+  void update_();
+
+  const float floor_;
+  const float max_quality_;
+  const int min_samples_;
+
+  mutable boost::mutex mutex_;
+  ros::WallTime start_;
+  double budget_;
+  int num_grasps_;
+  int num_accepted_;
+  int num_samples_;
+  std::vector<int> histogram_;
+  float threshold_;
+};
+
+typedef boost::shared_ptr<AdaptiveQualityThreshold> AdaptiveQualityThresholdPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
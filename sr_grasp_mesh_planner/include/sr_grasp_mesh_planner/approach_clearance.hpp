@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   approach_clearance.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Check that the open hand can reach a grasp in a straight line along its approach direction.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/mesh_bvh.hpp"
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Grasping/Grasp.h>
+#include <VirtualRobot/SceneObject.h>
+
+#include <Eigen/Geometry>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * A grasp planned by GraspSampleJob, with the straight approach that was checked for it.
+ **/
+class ApproachGrasp : public VirtualRobot::Grasp
+{
+public:
+  /*!
+   * approach_direction is the direction the hand moves to reach the grasp, in the frame of the TCP.
+   * The hand can be moved back along it by clear_distance (mm) without touching the object,
+   * and min_distance (mm) is the least that was required.
+   */
+  ApproachGrasp(const std::string &name,
+                const std::string &robot_type,
+                const std::string &eef,
+                const Eigen::Matrix4f &pose_in_tcp,
+                const std::string &creation,
+                float quality,
+                const Eigen::Vector3f &approach_direction,
+                float min_distance,
+                float clear_distance);
+
+  const Eigen::Vector3f &getApproachDirection() const;
+  float getMinDistance() const;
+  float getClearDistance() const;
+
+  /*!
+   * The mean and variance of the quality of the grasp under perturbations of the pose of the
+   * object (see RobustnessJob), and the number of perturbations it was evaluated on (zero if not evaluated).
+   */
+  void setRobustness(float score, float variance, int num_samples);
+  float getRobustness() const;
+  float getRobustnessVariance() const;
+  int getNumRobustnessSamples() const;
+
+private:
+  Eigen::Vector3f approach_direction_;
+  float min_distance_;
+  float clear_distance_;
+  float robustness_;
+  float robustness_variance_;
+  int num_robustness_samples_;
+};
+
+typedef boost::shared_ptr<ApproachGrasp> ApproachGraspPtr;
+
+/**
+ * The open hand is moved back from its grasp pose, opposite to the approach direction,
+ * one step at a time. At each step, the boxes of the links (in the frame of the object)
+ * are first tested against the BVH of the object, and Simox only checks the hand when
+ * one of them touches a triangle.
+ *
+ * It moves the robot of the end-effector, so each worker needs its own (see SampleContext).
+ **/
+class ApproachClearance
+{
+public:
+  /*! step is the distance (mm) between two checked poses. */
+  explicit ApproachClearance(VirtualRobot::EndEffectorPtr eef, float step = 5.0f);
+
+  /*!
+   * How far (mm, at most max_distance) the hand, as it is now, can be moved back opposite to
+   * approach_direction (global, towards the object) without touching the object. bvh may be null.
+   * The hand is left where it was.
+   */
+  float compute(VirtualRobot::SceneObjectPtr object,
+                MeshBvhPtr bvh,
+                const Eigen::Vector3f &approach_direction,
+                float max_distance);
+
+private:
+  /*! True if a link of the hand moved by offset (global) may touch the object. */
+  bool mayCollide_(const Eigen::Matrix4f &object_from_global,
+                   const Eigen::Vector3f &offset,
+                   MeshBvhPtr bvh) const;
+
+  VirtualRobot::EndEffectorPtr eef_;
+  VirtualRobot::RobotPtr robot_;
+  float step_;
+
+  std::vector<VirtualRobot::CollisionModelPtr> col_models_;
+  std::vector<Eigen::Vector3f> local_min_;
+  std::vector<Eigen::Vector3f> local_max_;
+};
+
+typedef boost::shared_ptr<ApproachClearance> ApproachClearancePtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   approach_prior.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Where the grasps planned so far approached objects of the same shape from.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include <Eigen/Core>
+#include <boost/cstdint.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * The principal axes of the vertices of a mesh (longest first, right handed, oriented
+ * towards the heavier side), and the class of its shape from the ratios of its extents.
+ **/
+struct ShapeFrame
+{
+  enum ShapeClass
+  {
+    compact = 0,
+    elongated = 1,
+    flat = 2,
+    elongated_flat = 3,
+    num_shape_classes = 4
+  };
+
+  ShapeFrame();
+
+  static ShapeFrame compute(VirtualRobot::TriMeshModelPtr model);
+
+  Eigen::Vector3f center;
+  //! The axes are the columns.
+  Eigen::Matrix3f axes;
+  //! Half of the extent of the vertices along each axis (mm).
+  Eigen::Vector3f half_extents;
+  int shape_class;
+};
+
+class ApproachPrior;
+typedef boost::shared_ptr<ApproachPrior> ApproachPriorPtr;
+
+/**
+ * A histogram, for each shape class, of the accepted grasps over the position on the surface
+ * along the longest axis of the object and its approach direction in the frame of the object.
+ * The approach movement generators draw candidates from it: a candidate is kept with a
+ * probability that grows with the grasps already found in its cell, and never goes below
+ * an exploration share, so the cells without grasps are still sampled.
+ *
+ * The workers of all the goals share one prior, so all its methods can be called from any thread.
+ **/
+class ApproachPrior
+{
+public:
+  ApproachPrior();
+
+  //! How many candidates a generator draws at most for one approach pose.
+  static const int max_draws;
+
+  /*! An empty prior if the file does not exist, null if it is not an approach prior. */
+  static ApproachPriorPtr load(const std::string &filename);
+  bool save(const std::string &filename) const;
+
+  /*! A copy of the counts as they are now, that the grasps added later do not change. */
+  ApproachPriorPtr clone() const;
+
+  /*!
+   * An accepted grasp: the point on the surface of the object and the approach direction it was
+   * drawn at, in the frame of the object, as given to keep() (not where the hand ended up).
+   */
+  void addGrasp(const ShapeFrame &frame, const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction);
+
+  /*! The probability to keep a candidate, in (0, 1]. */
+  float getWeight(const ShapeFrame &frame, const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction) const;
+
+  /*! True with the probability getWeight(), drawn from the generator of the approach movement. */
+  bool keep(const ShapeFrame &frame,
+            const Eigen::Vector3f &position,
+            const Eigen::Vector3f &approach_direction,
+            boost::mt19937 &random) const;
+
+  /*! The number of grasps in the prior. */
+  unsigned int getNumGrasps() const;
+
+private:
+  int cell_(const ShapeFrame &frame, const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction) const;
+
+  static const int num_position_bins_;
+  static const int num_polar_bins_;
+  static const int num_azimuth_bins_;
+  static const float exploration_;
+
+  mutable boost::mutex mutex_;
+  // [shape class][position][polar][azimuth]
+  std::vector<boost::uint32_t> counts_;
+  // The largest count of each shape class.
+  std::vector<boost::uint32_t> max_counts_;
+  unsigned int num_grasps_;
+};
+
+/*! A point drawn uniformly in the triangle abc, as VirtualRobot::MathTools::randomPointInTriangle but without rand(). */
+Eigen::Vector3f randomPointInTriangle(const Eigen::Vector3f &a,
+                                      const Eigen::Vector3f &b,
+                                      const Eigen::Vector3f &c,
+                                      boost::mt19937 &random);
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   batch_forward_kinematics.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Forward kinematics of the links of the hand for many joint configurations at once.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Nodes/RobotNode.h>
+
+#include <Eigen/Geometry>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * The kinematic chains from the root of the robot to the links (the nodes with a
+ * collision model) of an actor, or of the whole end-effector, are copied from Simox
+ * once, at construction. compute() then only reads this copy: it takes no lock and
+ * does not touch the robot, so any number of threads can call it at the same time.
+ *
+ * Configurations and poses are stored component by component (structure of arrays),
+ * so the inner loops run over the configurations and can be vectorized.
+ **/
+class BatchForwardKinematics
+{
+public:
+  /*! An empty actor_name means all the actors and the static part of the end-effector. */
+  explicit BatchForwardKinematics(VirtualRobot::EndEffectorPtr eef,
+                                  const std::string &actor_name = "");
+
+  /*! The joints, in the order of the joint values. */
+  const std::vector<std::string> &getJointNames() const;
+  /*! The links, in the order of the poses. */
+  const std::vector<std::string> &getLinkNames() const;
+
+  int getNumJoints() const;
+  int getNumLinks() const;
+
+  /*!
+   * joint_values[j * num_configurations + c] is the value of joint j in configuration c.
+   * poses[(l * 12 + e) * num_configurations + c] is element e of the pose of link l in
+   * configuration c, a row-major 3x4 matrix (rotation, then translation in mm) in the
+   * frame of the robot (see VirtualRobot::Robot::getGlobalPose).
+   */
+  void compute(const std::vector<float> &joint_values,
+               int num_configurations,
+               std::vector<float> &poses) const;
+
+  /*! The pose of link l in configuration c, as computed by compute(). */
+  static Eigen::Matrix4f getPose(const std::vector<float> &poses,
+                                 int num_configurations,
+                                 int link,
+                                 int configuration);
+
+private:
+  struct Frame
+  {
+    // Index of the parent frame, -1 for the frame of the robot.
+    int parent;
+    // Transformation from the parent frame (row-major 3x4, mm).
+    float local[12];
+    // Index of the joint value, -1 for a fixed node.
+    int joint;
+    // Rotation axis and offset of the joint.
+    float axis[3];
+    float offset;
+  };
+
+  int addFrame_(VirtualRobot::RobotNodePtr node);
+
+  std::vector<Frame> frames_;
+  std::vector<VirtualRobot::RobotNodePtr> frame_nodes_;
+
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> link_names_;
+  std::vector<int> link_frames_;
+};
+
+typedef boost::shared_ptr<BatchForwardKinematics> BatchForwardKinematicsPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   dynamic_aabb_tree.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A tree of axis aligned boxes that are moved often (the links of the hand).
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <Eigen/Core>
+
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Each leaf keeps its exact box and a box enlarged by a margin. The tree is built on
+ * the enlarged boxes, so a leaf that moves a little stays in its enlarged box and the
+ * tree is not touched. When it leaves it, only the boxes of its ancestors are refit,
+ * up to the first one that already contains the new box.
+ *
+ * All boxes are in the same frame (mm for the hand).
+ **/
+class DynamicAabbTree
+{
+public:
+  explicit DynamicAabbTree(float margin = 2.0f);
+
+  /*! Add a leaf, returns its index (leaves are numbered from zero, in order). */
+  int addLeaf(const Eigen::Vector3f &min, const Eigen::Vector3f &max);
+
+  /*! Move a leaf. Returns true if the tree had to be refit. */
+  bool updateLeaf(int leaf, const Eigen::Vector3f &min, const Eigen::Vector3f &max);
+
+  int getNumLeaves() const;
+  const Eigen::Vector3f &getMin(int leaf) const;
+  const Eigen::Vector3f &getMax(int leaf) const;
+
+  /*! True if the exact boxes of both leaves overlap. */
+  bool overlaps(int leaf_a, int leaf_b) const;
+
+  /*! The leaves whose exact box overlaps the box (appended to leaves). */
+  void query(const Eigen::Vector3f &min, const Eigen::Vector3f &max, std::vector<int> &leaves) const;
+
+private:
+  struct Node
+  {
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+    int parent;
+    // Children of an inner node, -1 for a leaf.
+    int left;
+    int right;
+    // Index of the leaf, -1 for an inner node.
+    int leaf;
+  };
+
+  /*! Insert the node of a leaf under the sibling that grows the least. */
+  void insert_(int node);
+  /*! Refit the boxes of the ancestors of the node, until one does not change. */
+  void refit_(int node);
+
+  static float area_(const Eigen::Vector3f &min, const Eigen::Vector3f &max);
+  static bool overlaps_(const Eigen::Vector3f &min_a, const Eigen::Vector3f &max_a,
+                        const Eigen::Vector3f &min_b, const Eigen::Vector3f &max_b);
+
+  float margin_;
+  int root_;
+  std::vector<Node> nodes_;
+
+  // Exact box and node of each leaf.
+  std::vector<Eigen::Vector3f> leaf_min_;
+  std::vector<Eigen::Vector3f> leaf_max_;
+  std::vector<int> leaf_nodes_;
+
+  // Scratch space for the traversals.
+  mutable std::vector<int> stack_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   flight_recorder.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Keep the trace of the last goals in memory, and save the slow or failed ones.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+#include "sr_robot_msgs/PlanGraspAction.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <ros/time.h>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * The last goals are kept in a ring of records, allocated once: the goal message (shared,
+ * not copied), the configuration and random seed it was planned with, and the spans of
+ * its stages (queued, prepared, planned...). Recording a span is a lock and a few stores,
+ * and nothing is written while goals are fast and succeed.
+ *
+ * A goal that takes more than the latency threshold, or fails, is saved as a bundle, a
+ * directory that is enough to replay it (see replay_flight.cpp):
+ * - goal.bin: the goal, serialized as a ROS message,
+ * - config.yaml: the dynamic reconfigure settings (rosrun dynamic_reconfigure dynparam load),
+ * - approach_prior.bin: the approach prior when the goal started planning, if there was one,
+ * - trace.json: the spans, in the Chrome trace format (chrome://tracing),
+ * - summary.txt: the outcome, seed and spans, and the latencies of the other recorded goals.
+ *
+ * All the methods can be called from any thread.
+ **/
+class FlightRecorder
+{
+public:
+  /*! Spans after the first max_spans of a goal are counted, but not kept. */
+  static const int max_spans = 64;
+
+  FlightRecorder(int num_goals,
+                 double latency_threshold,
+                 const std::string &directory);
+
+  /*!
+   * Start recording a goal, in place of the oldest one. The id of its record is given to
+   * the other methods: they do nothing once the record has been reused.
+   */
+  unsigned int begin(const std::string &goal_id,
+                     const sr_robot_msgs::PlanGraspGoalConstPtr &goal,
+                     unsigned int seed,
+                     const std::string &config);
+
+  /*!
+   * The approach prior the goal is planned with, as a snapshot taken by the caller before
+   * planning (see ApproachPrior::clone): the prior keeps learning from the grasps of later goals.
+   */
+  void setApproachPrior(unsigned int record, const ApproachPriorPtr &snapshot);
+
+  /*! name must be a literal (it is not copied). */
+  void addSpan(unsigned int record,
+               const char *name,
+               const ros::WallTime &start,
+               const ros::WallTime &end);
+
+  /*!
+   * The goal is done. It is saved if it failed or took more than the threshold since begin.
+   * Returns the directory of the bundle, empty if it was not saved.
+   */
+  std::string end(unsigned int record,
+                  bool succeeded,
+                  const std::string &outcome,
+                  int num_grasps);
+
+  /*! A span from its construction to its destruction. */
+  class ScopedSpan
+  {
+  public:
+    ScopedSpan(FlightRecorder *recorder, unsigned int record, const char *name);
+    ~ScopedSpan();
+
+  private:
+    FlightRecorder *recorder_;
+    unsigned int record_;
+    const char *name_;
+    ros::WallTime start_;
+  };
+
+private:
+  struct Span
+  {
+    const char *name;
+    ros::WallTime start;
+    ros::WallTime end;
+    boost::thread::id thread;
+  };
+
+  struct Record
+  {
+    // 0 for an empty slot.
+    unsigned int id;
+    std::string goal_id;
+    sr_robot_msgs::PlanGraspGoalConstPtr goal;
+    unsigned int seed;
+    std::string config;
+    ApproachPriorPtr approach_prior;
+    ros::WallTime start;
+    // Zero while the goal is running.
+    double latency;
+    std::string outcome;
+    int num_grasps;
+    Span spans[max_spans];
+    int num_spans;
+    int dropped_spans;
+  };
+
+  Record *find_(unsigned int record);
+
+  bool save_(const Record &record, const std::string &directory) const;
+
+  const double latency_threshold_;
+  const std::string directory_;
+
+  boost::mutex mutex_;
+  std::vector<Record> records_;
+  unsigned int next_id_;
+};
+
+typedef boost::shared_ptr<FlightRecorder> FlightRecorderPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
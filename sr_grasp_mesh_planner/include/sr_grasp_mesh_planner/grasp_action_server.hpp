@@ -16,14 +16,28 @@
 
 //-------------------------------------------------------------------------------
 
-#include "sr_grasp_mesh_planner/grasp_planner_window.hpp"
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
+#include "sr_grasp_mesh_planner/grasp_cache.hpp"
+#include "sr_grasp_mesh_planner/flight_recorder.hpp"
+#include "sr_grasp_mesh_planner/model_registry.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/speculative_planner.hpp"
 #include "sr_grasp_mesh_planner/PlannerConfig.h"
 #include "sr_robot_msgs/PlanGraspAction.h"
+#include <std_msgs/Float32.h>
 
 #include <ros/ros.h>
-#include <actionlib/server/simple_action_server.h>
+#include <actionlib/server/action_server.h>
 #include <dynamic_reconfigure/server.h>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstddef>
+#include <deque>
+
 #include <VirtualRobot/Visualization/TriMeshModel.h>
 
 //-------------------------------------------------------------------------------
@@ -33,28 +47,80 @@ namespace sr_grasp_mesh_planner
 
 using namespace VirtualRobot;
 
+/**
+ * Goals are queued and served in order by two stages, each running on its own thread:
+ * - the preparation stage builds the object of the next goals (see MeshGraspPlanner::prepareObject),
+ * - the planning stage plans grasps on the prepared objects, one goal at a time.
+ * The preparation of the next goals therefore overlaps with the planning of the current one.
+ **/
 class GraspActionServer
 {
 protected:
+  typedef actionlib::ActionServer<sr_robot_msgs::PlanGraspAction> PlanGraspActionServer;
+  typedef PlanGraspActionServer::GoalHandle GoalHandle;
+
+  struct QueuedGoal
+  {
+    GoalHandle goal_handle;
+    std::size_t mesh_key;
+    //! The key of the grasps of the goal in the cache (see MeshGraspPlanner::getGraspKey).
+    std::size_t grasp_key;
+    //! The registered model of a goal without a mesh, null for a goal with a mesh.
+    ModelRegistry::ModelConstPtr model;
+    //! At the pose of the goal. Null when no preparation was needed (the object is loaded or all grasps are cached).
+    PreparedObjectPtr prepared;
+    //! The configuration when the goal was accepted, used by all the stages of the goal.
+    sr_grasp_mesh_planner::PlannerConfig config;
+    //! The record of the goal in the flight recorder, and when it entered each stage.
+    unsigned int record;
+    //! The seed of the random draws of the goal (see GraspSampleJob), the one of the configuration if set.
+    unsigned int seed;
+    ros::WallTime accepted;
+    ros::WallTime prepared_at;
+  };
+
   ros::NodeHandle nh_;
   // NodeHandle instance must be created before this line. Otherwise strange error may occur.
 
   // Auto start the action server?
   static const bool auto_start_;
 
+  // The maximum number of goals prepared ahead of the one being planned.
+  static const std::size_t max_prepared_goals_;
+
   std::string action_name_;
 
-  actionlib::SimpleActionServer<sr_robot_msgs::PlanGraspAction> as_mesh_;
-  boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh_;
-  boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh_;
+  PlanGraspActionServer as_mesh_;
+
+  MeshGraspPlannerPtr grasp_planner_;
+
+  // Written by the dynamic_reconfigure callback, and copied by each goal when it is accepted.
+  mutable boost::mutex config_mutex_;
+  sr_grasp_mesh_planner::PlannerConfig config_;
+
+  // The minimum quality used for the last planned grasp (see AdaptiveQualityThreshold).
+  ros::Publisher effective_quality_pub_;
+
+  // The last goals, saved when they are slow or fail (see FlightRecorder). Null when disabled.
+  FlightRecorderPtr flight_recorder_;
+  unsigned int num_goals_;
+
+  boost::shared_ptr<GraspCache> grasp_cache_;
+  // The known objects, for the goals that only give a type key (~model_registry). Null if not given.
+  ModelRegistryPtr model_registry_;
+  boost::scoped_ptr<SpeculativePlanner> speculative_planner_;
 
-  boost::shared_ptr<GraspPlannerWindow> grasp_win_;
+  // Protects the queues below.
+  boost::mutex queue_mutex_;
+  boost::condition_variable queue_cond_;
+  // Goals waiting for the preparation stage.
+  std::deque<QueuedGoal> pending_goals_;
+  // Goals waiting for the planning stage.
+  std::deque<QueuedGoal> prepared_goals_;
+  bool shutdown_;
 
-  float timeout_one_grasp_;
-  bool force_closure_;
-  float min_quality_;
-  int max_grasps_;
-  int approach_movement_;
+  boost::scoped_ptr<boost::thread> prepare_thread_;
+  boost::scoped_ptr<boost::thread> plan_thread_;
 
   dynamic_reconfigure::Server<sr_grasp_mesh_planner::PlannerConfig> config_server_;
 
@@ -62,12 +128,40 @@ public:
   // This constructor uses actionlib!
   // Note that node_name is used as the action name.
   GraspActionServer(std::string node_name,
-                    boost::shared_ptr<GraspPlannerWindow> grasp_win);
+                    MeshGraspPlannerPtr grasp_planner);
 
   virtual ~GraspActionServer();
 
 private:
-  void goal_cb_(const sr_robot_msgs::PlanGraspGoalConstPtr &goal);
+  void goal_cb_(GoalHandle goal_handle);
+  void cancel_cb_(GoalHandle goal_handle);
+
+  void prepare_loop_();
+  void plan_loop_();
+
+  void plan_goal_(QueuedGoal &queued);
+
+  /*!
+   * A copy of a prepared object at the pose of the object of a goal. The copies share the object,
+   * the BVH and the contexts built so far, so goals on the same mesh only differ by their pose.
+   */
+  static PreparedObjectPtr place_object_(PreparedObjectPtr prepared,
+                                         const object_recognition_msgs::RecognizedObject &object);
+
+  /*!
+   * The object of the model of a goal, prepared once for all its goals and at the pose of the goal.
+   * Prepared again for this goal only if use_cache is false.
+   */
+  PreparedObjectPtr prepare_model_(const ModelRegistry::ModelConstPtr &model,
+                                   const object_recognition_msgs::RecognizedObject &object,
+                                   int approach_movement,
+                                   bool use_cache = true);
+
+  static bool is_canceled_(GoalHandle &goal_handle);
+
+  sr_grasp_mesh_planner::PlannerConfig get_config_() const;
+  /*! The configuration of a goal as dynparam dump gives it, with the seed of the goal. */
+  static std::string config_yaml_(const sr_grasp_mesh_planner::PlannerConfig &config, unsigned int seed);
 
   void config_cb_(sr_grasp_mesh_planner::PlannerConfig &config, uint32_t level);
 };
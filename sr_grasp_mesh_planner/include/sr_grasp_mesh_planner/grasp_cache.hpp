@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_cache.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A thread safe cache of the grasps planned for object meshes.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <moveit_msgs/Grasp.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Grasps are stored per mesh key (see MeshObstacle::hash_mesh), so that grasps
+ * planned ahead of time (e.g., speculatively) can be returned to a goal without
+ * running the planner again.
+ **/
+class GraspCache
+{
+public:
+  explicit GraspCache(std::size_t max_objects = 32);
+
+  /**
+   * Add grasps planned for the mesh with the given key.
+   * force_closure tells whether the grasps were planned with the force closure constraint.
+   */
+  void insert(std::size_t mesh_key,
+              bool force_closure,
+              const std::vector<moveit_msgs::Grasp> &grasps);
+
+  /**
+   * Number of cached grasps for the mesh that satisfy the given requirements.
+   */
+  std::size_t count(std::size_t mesh_key,
+                    bool force_closure,
+                    float min_quality) const;
+
+  /**
+   * Append at most max_grasps cached grasps satisfying the given requirements to grasps.
+   * Returns the number of grasps appended.
+   */
+  std::size_t lookup(std::size_t mesh_key,
+                     bool force_closure,
+                     float min_quality,
+                     std::size_t max_grasps,
+                     std::vector<moveit_msgs::Grasp> &grasps) const;
+
+  void clear();
+
+private:
+  struct CachedGrasp
+  {
+    moveit_msgs::Grasp grasp;
+    bool force_closure;
+  };
+  typedef std::vector<CachedGrasp> CachedGrasps;
+
+  static bool satisfies_(const CachedGrasp &cached, bool force_closure, float min_quality);
+
+  mutable boost::mutex mutex_;
+
+  std::size_t max_objects_;
+
+  std::map<std::size_t, CachedGrasps> grasps_;
+
+  // Mesh keys in insertion order, the oldest is evicted first.
+  std::deque<std::size_t> keys_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
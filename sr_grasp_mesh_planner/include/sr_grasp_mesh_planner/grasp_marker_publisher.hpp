@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_marker_publisher.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The scene of the planner as RViz markers.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+
+#include <ros/ros.h>
+#include <visualization_msgs/Marker.h>
+
+#include <Eigen/Core>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Publishes the object, the approach poses sampled by the workers, the accepted grasps
+ * and the friction cones of the last grasp as visualization_msgs/MarkerArray. Changes
+ * are only recorded by the planner; at most rate times per second, the markers that
+ * changed since the last message are sent. All markers are sent again to a new subscriber.
+ * Nothing is built while nobody subscribes.
+ *
+ * The markers are in the frame of the recognized object, at its pose (or at the origin of
+ * marker_frame if it is unknown). Everything is given in the frame of the object (mm).
+ * All methods can be called from any thread.
+ **/
+class GraspMarkerPublisher
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /*! Publishes ~grasp_markers on nh. */
+  GraspMarkerPublisher(ros::NodeHandle &nh, double rate, const std::string &marker_frame);
+
+  /*! Delete the markers of the previous object and show this one. */
+  void setObject(PreparedObjectPtr prepared);
+
+  /*! A sampled approach pose: the position of the TCP and the approach direction. */
+  void addApproachPose(const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction);
+
+  /*!
+   * An accepted grasp: the pose of the TCP and the approach direction in the frame of the TCP,
+   * colored from red to green by its quality (0 to 1).
+   */
+  void addGrasp(const Eigen::Matrix4f &tcp_pose, const Eigen::Vector3f &approach_direction, float quality);
+
+  /*! Delete the grasps and the approach poses. */
+  void clearGrasps();
+
+  /*! The friction cones at the contacts (height and radius in mm, as drawn by the window). */
+  void setContacts(const VirtualRobot::EndEffector::ContactInfoVector &contacts, float height, float radius);
+
+private:
+  typedef std::pair<std::string, int> MarkerId;
+
+  void connect_(const ros::SingleSubscriberPublisher &publisher);
+  void publish_(const ros::WallTimerEvent &event);
+
+  /*! A marker at the pose of the object, to be sent at the next publish_. */
+  visualization_msgs::Marker &marker_(const std::string &ns, int id, int type);
+  /*! Delete all the markers of the namespace. */
+  void delete_(const std::string &ns);
+
+  static const std::size_t max_approach_poses_;
+
+  ros::Publisher publisher_;
+  ros::WallTimer timer_;
+  std::string marker_frame_;
+
+  // Protects everything below.
+  boost::mutex mutex_;
+  bool subscribed_;
+  bool resend_;
+
+  std::string frame_id_;
+  Eigen::Matrix4f object_pose_;
+
+  // The current markers, and the ones to send (added, changed or deleted).
+  std::map<MarkerId, visualization_msgs::Marker> markers_;
+  std::set<MarkerId> changed_;
+
+  std::size_t num_approach_poses_;
+  int num_grasps_;
+};
+
+typedef boost::shared_ptr<GraspMarkerPublisher> GraspMarkerPublisherPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -17,35 +17,12 @@
 //-------------------------------------------------------------------------------
 
 #include "sr_grasp_mesh_planner/coin_viewer.hpp"
-#include <sr_robot_msgs/PlanGraspAction.h>
-#include <shape_msgs/Mesh.h>
-
-#include <VirtualRobot/Robot.h>
-#include <VirtualRobot/Obstacle.h>
-#include <VirtualRobot/ManipulationObject.h>
-#include <VirtualRobot/EndEffector/EndEffector.h>
-#include <VirtualRobot/Grasping/Grasp.h>
-#include <VirtualRobot/Grasping/GraspSet.h>
-#include <VirtualRobot/CollisionDetection/CDManager.h>
-#include <VirtualRobot/VirtualRobot.h>
-#include <VirtualRobot/VirtualRobotException.h>
-#include <VirtualRobot/Nodes/RobotNode.h>
-#include <VirtualRobot/XML/SceneIO.h>
-#include <VirtualRobot/XML/ObjectIO.h>
-#include <VirtualRobot/XML/RobotIO.h>
-#include <VirtualRobot/Visualization/TriMeshModel.h>
-#include <VirtualRobot/Visualization/VisualizationFactory.h>
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
+
 #include <VirtualRobot/Visualization/CoinVisualization/CoinVisualization.h>
 #include <VirtualRobot/Visualization/CoinVisualization/CoinVisualizationFactory.h>
 
-#include <GraspPlanning/GraspStudio.h>
-#include <GraspPlanning/ContactConeGenerator.h>
-#include <GraspPlanning/GraspQuality/GraspQualityMeasureWrenchSpace.h>
-#include <GraspPlanning/GraspPlanner/GenericGraspPlanner.h>
-#include <GraspPlanning/ApproachMovementSurfaceNormal.h>
-#include <GraspPlanning/Visualization/CoinVisualization/CoinConvexHullVisualization.h>
-
-#include <string>
+#include <vector>
 #include <QtCore/QtGlobal>
 #include <QtGui/QtGui>
 #include <QtCore/QtCore>
@@ -63,21 +40,28 @@
 namespace sr_grasp_mesh_planner
 {
 
-class GraspPlannerWindow : public QMainWindow
+/**
+ * Draws the loaded object of a MeshGraspPlanner, the grasps planned on it and the hand at the
+ * last of them. Only created when the planner is not headless.
+ **/
+class GraspPlannerWindow : public QMainWindow, public MeshGraspPlanner::Listener
 {
   Q_OBJECT
 
   public:
-  GraspPlannerWindow(std::string &robotFile,
-                     std::string &eefName,
-                     std::string &preshape,
-                     VirtualRobot::TriMeshModelPtr triMeshModel,
+  GraspPlannerWindow(MeshGraspPlannerPtr planner,
                      Qt::WFlags flags = 0);
   ~GraspPlannerWindow();
 
   /*!< Executes the SoQt mainLoop. You need to call this in order to execute the application. */
   int main();
 
+  // See MeshGraspPlanner::Listener.
+  void objectChanged();
+  void graspsCleared();
+  void graspsPlanned(const std::vector<Eigen::Matrix4f> &tcp_poses);
+  void handChanged();
+
 public slots:
   /*! Closes the window and exits SoQt runloop. */
   void quit();
@@ -85,37 +69,22 @@ public slots:
   /*!< Overriding the close event, so we know when the window was closed by the user. */
   void closeEvent(QCloseEvent *event);
 
-  void resetSceneryAll();
-
   void closeEEF();
   void openEEF();
   void colModel();
   void frictionConeVisu();
   void showGrasps();
+  void fullHands();
 
   void buildVisu();
 
-  void plan(bool force_closure,
-            float timeout,
-            float min_quality,
-            boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh,
-            boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh);
-  void plan(bool force_closure,
-            float timeout,
-            float min_quality);
   void save();
 
-  void loadRobot();
-  void loadObject(const object_recognition_msgs::RecognizedObject &object,
-                  int approach_movement);
-  void loadObject(VirtualRobot::TriMeshModelPtr triMeshModel,
-                  int approach_movement);
-
   void setupUI();
 
-  static double diffclock(clock_t clock1, clock_t clock2);
-
 protected:
+  MeshGraspPlannerPtr planner_;
+
   Ui::GraspPlanner UI_;
   CoinViewer *viewer_; /*!< Viewer to display the 3D model of the robot and the environment. */
 
@@ -127,34 +96,21 @@ protected:
 
   SoSeparator *sphereSep_;
 
-  VirtualRobot::RobotPtr robot_;
-  VirtualRobot::RobotPtr eefCloned_;
-  VirtualRobot::ObstaclePtr object_;
-  VirtualRobot::EndEffectorPtr eef_;
-
-  VirtualRobot::GraspSetPtr grasps_;
-
-  VirtualRobot::EndEffector::ContactInfoVector contacts_;
-
-  std::string robotFile_;
-  std::string eefName_;
-  std::string preshape_;
-
   SoSeparator *eefVisu_;
 
-  GraspStudio::GraspQualityMeasureWrenchSpacePtr qualityMeasure_;
-  GraspStudio::ApproachMovementSurfaceNormalPtr approach_;
-  GraspStudio::GenericGraspPlannerPtr planner_;
+  /*!
+   * The node drawn for every grasp under its transform, shared by all of them: a TCP frame,
+   * or with "Full hands" the hand within grasp_lod_distance_ of the camera and the frame beyond.
+   */
+  void buildGraspVisu_();
+  SoSeparator *graspVisu_;
+  SoSeparator *graspProxy_;
+  // Closer than this (m), grasps are drawn as the full hand (~grasp_lod_distance).
+  float grasp_lod_distance_;
+  // At most this many grasps are drawn (~max_displayed_grasps), all of them are kept by the planner.
+  int max_displayed_grasps_;
 
   boost::shared_ptr<VirtualRobot::CoinVisualization> visualizationRobot_;
-
-  // Not used.
-  // boost::shared_ptr<VirtualRobot::CoinVisualization> visualizationObject_;
-
-  boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh_;
-  boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh_;
-
-  unsigned short grasp_counter_;
 };
 
 } // end of namespace sr_grasp_mesh_planner
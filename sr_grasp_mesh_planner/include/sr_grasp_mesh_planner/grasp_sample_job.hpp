@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_sample_job.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Grasp planning on a prepared object, one grasp hypothesis per sample.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/adaptive_quality_threshold.hpp"
+#include "sr_grasp_mesh_planner/approach_clearance.hpp"
+#include "sr_grasp_mesh_planner/grasp_marker_publisher.hpp"
+#include "sr_grasp_mesh_planner/hand_closing.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/reachability_map.hpp"
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Grasping/Grasp.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * What a worker needs to evaluate samples on a prepared object: its own
+ * approach movement generator (with its own end-effector clone), the closing of
+ * that end-effector and the check of its approach, and its own grasp quality measure. The object itself is shared,
+ * it is never moved.
+ **/
+struct SampleContext
+{
+  GraspStudio::GraspQualityMeasureWrenchSpacePtr quality_measure;
+  GraspStudio::ApproachMovementSurfaceNormalPtr approach;
+  //! The retraction engine of approach (null if it has none).
+  RetractionEngine *retraction;
+  //! The generator of the random poses of approach (null if it has none), seeded by each job.
+  boost::mt19937 *random;
+  HandClosingPtr closing;
+  ApproachClearancePtr clearance;
+};
+
+/**
+ * Each sample is one grasp hypothesis, as in GraspStudio::GenericGraspPlanner::planGrasp:
+ * a random approach pose, closing the hand, and evaluating the contacts.
+ * The open hand must then be able to reach the grasp in a straight line along its
+ * approach direction for at least min_approach_distance (see ApproachClearance).
+ *
+ * With a reachability map (in the frame of the recognized object), approach poses the arm
+ * cannot reach are rejected before closing the hand, and another one is drawn (up to
+ * max_reachability_attempts_ times per sample), so the samples go to reachable directions.
+ * The job is done when enough grasps have been accepted, on timeout, or when canceled.
+ **/
+class GraspSampleJob : public SampleJob
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /*!
+   * timeout is in seconds, no limit if zero. approach_distance and min_approach_distance
+   * are in m, the approach is not checked if approach_distance is zero. With a threshold,
+   * its threshold replaces min_quality, and it is told about each sample and grasp.
+   * With markers, each approach pose that is closed is shown. The random approach poses of
+   * each worker are drawn from a generator seeded with seed and the id of the worker, so with
+   * one worker a seed draws the same poses.
+   */
+  GraspSampleJob(PreparedObjectPtr prepared,
+                 VirtualRobot::EndEffectorPtr eef,
+                 int hand,
+                 int num_workers,
+                 int num_grasps,
+                 bool force_closure,
+                 float min_quality,
+                 float timeout,
+                 unsigned int seed,
+                 float approach_distance = 0.0f,
+                 float min_approach_distance = 0.0f,
+                 ReachabilityMapPtr reachability = ReachabilityMapPtr(),
+                 AdaptiveQualityThresholdPtr threshold = AdaptiveQualityThresholdPtr(),
+                 GraspMarkerPublisherPtr markers = GraspMarkerPublisherPtr());
+
+  virtual ~GraspSampleJob();
+
+  virtual void run_sample(int worker_id);
+
+  virtual bool done() const;
+
+  void cancel();
+
+  /*! Block until the job is done, and return the accepted grasps. */
+  std::vector<VirtualRobot::GraspPtr> wait();
+
+  int getNumSamples() const;
+  /*! The number of grasps dropped because their approach was blocked. */
+  int getNumBlocked() const;
+  /*! The number of approach poses rejected by the reachability map. */
+  int getNumUnreachable() const;
+  /*! The number of times the hand was moved out of the object, and the collision checks it took. */
+  int getNumRetractions() const;
+  int getNumRetractionChecks() const;
+  /*! The time (s) from the creation of the job to its first grasp (negative if none), and the grasps from seeds. */
+  double getTimeToFirstGrasp() const;
+  int getNumSeedGrasps() const;
+
+  /*! Make room for the contexts of the workers for a hand on a prepared object, before any job runs on it. */
+  static void reserveContexts(PreparedObjectPtr prepared, int hand, int num_workers);
+
+  /*!
+   * The context of a worker for a hand on a prepared object, built on first use. Only the
+   * worker worker_id may call it, from its own thread (see WorkStealingScheduler).
+   */
+  static SampleContext &getContext(PreparedObjectPtr prepared,
+                                   int hand,
+                                   VirtualRobot::EndEffectorPtr eef,
+                                   int worker_id);
+
+private:
+  SampleContext &context_(int worker_id);
+
+  bool done_() const;
+
+  /*!
+   * Set the hand of the context to a new approach pose (reachable if there is a map): the next
+   * seed of the object for this hand if any is left (seeded is then true), else a random one.
+   * position and approach_direction are where the pose was drawn on the surface of the object,
+   * the key of the approach prior (sampled is false if the generator does not tell).
+   */
+  bool drawApproachPose_(SampleContext &context,
+                         bool &seeded,
+                         bool &sampled,
+                         Eigen::Vector3f &position,
+                         Eigen::Vector3f &approach_direction);
+
+  /*! The index of the next seed of the object for this hand, negative once all were tried. */
+  int takeSeed_();
+
+  /*! True if the arm can reach the current approach pose of the hand of the context. */
+  bool isReachable_(SampleContext &context) const;
+
+  static const int max_reachability_attempts_;
+
+  // Cloning Coin visualizations is not thread safe.
+  static boost::mutex context_mutex_;
+
+  PreparedObjectPtr prepared_;
+  VirtualRobot::EndEffectorPtr eef_;
+  // The index of the hand of eef_ in the contexts of the prepared object.
+  const int hand_;
+  std::string robot_type_;
+
+  const int num_grasps_;
+  const bool force_closure_;
+  const float min_quality_;
+  // Null if min_quality_ is used.
+  AdaptiveQualityThresholdPtr threshold_;
+  // In mm.
+  const float approach_distance_;
+  const float min_approach_distance_;
+
+  // Null if the approach poses are not shown.
+  GraspMarkerPublisherPtr markers_;
+
+  // Null if the reachability of the poses is not checked.
+  ReachabilityMapPtr reachability_;
+  // The pose of the object in the frame of the reachability map (mm).
+  Eigen::Matrix4f object_pose_;
+
+  bool has_deadline_;
+  boost::posix_time::ptime start_;
+  boost::posix_time::ptime deadline_;
+
+  const unsigned int seed_;
+  // Whether each worker has seeded the generator of its context for this job (only touched by that worker).
+  std::vector<char> seeded_;
+
+  // Protects the members below.
+  mutable boost::mutex mutex_;
+  boost::condition_variable cond_;
+  std::vector<VirtualRobot::GraspPtr> grasps_;
+  double time_to_first_grasp_;
+  int num_seed_grasps_;
+  int num_samples_;
+  int num_blocked_;
+  int num_unreachable_;
+  int num_retractions_;
+  int num_retraction_checks_;
+  bool canceled_;
+};
+
+typedef boost::shared_ptr<GraspSampleJob> GraspSampleJobPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
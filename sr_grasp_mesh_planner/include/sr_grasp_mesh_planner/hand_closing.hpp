@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_closing.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Close the actors of the hand on an object before Simox takes the last steps.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/CollisionDetection/CollisionModel.h>
+#include <VirtualRobot/CollisionDetection/CollisionChecker.h>
+#include <VirtualRobot/Nodes/RobotNode.h>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+#include "sr_grasp_mesh_planner/dynamic_aabb_tree.hpp"
+#include "sr_grasp_mesh_planner/mesh_bvh.hpp"
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * The actors are first moved on their own, step by step, until they would touch the
+ * object (or another actor). Simox then closes the hand from there, which only takes
+ * the last steps and gives the contacts.
+ *
+ * The boxes of the links are kept in a DynamicAabbTree, refit only for the actor that
+ * moved. At each step, only the links of that actor whose box overlaps the object (the
+ * root of its BVH, then its triangles) or the box of another link are checked by Simox.
+ *
+ * Every step of VirtualRobot::EndEffector::closeActors updates the poses of the robot
+ * nodes through the generic node graph of Simox. When the planner is built with the
+ * forward kinematics generated by urdf_to_simox_xml (see README.md), the steps compute
+ * only the poses of the collision models of the actor instead, and the pairs of links
+ * that the converter found can never collide are not checked. Coupled joints (e.g., J1
+ * of the fingers of the Shadow hand) are not moved by the actors but follow their joint,
+ * as PropagateJointValue does in Simox.
+ *
+ * Without the generated forward kinematics, or if it was generated for another hand,
+ * the steps move the joints of the actor on the robot nodes of Simox.
+ **/
+class HandClosing
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > PoseVector;
+
+  /*! angle is the step of the joints, as in VirtualRobot::EndEffector::closeActors. */
+  explicit HandClosing(VirtualRobot::EndEffectorPtr eef, float angle = 0.02f);
+
+  /*! True if the generated forward kinematics is used. */
+  bool isGenerated() const;
+
+  /*! Same as eef->closeActors(object). bvh, if given, is the BVH of the mesh of the object. */
+  VirtualRobot::EndEffector::ContactInfoVector closeActors(VirtualRobot::SceneObjectPtr object,
+                                                           MeshBvhPtr bvh = MeshBvhPtr());
+
+  /*! The joints of the generated forward kinematics (of the actors without it), in the order of the joint values. */
+  const std::vector<std::string> &getJointNames() const;
+  /*! The links of the generated forward kinematics (none without it), in the order of the poses. */
+  const std::vector<std::string> &getLinkNames() const;
+
+  /*! Global poses of all links (in mm) for the joint values, with the generated forward kinematics. */
+  void computeLinkPoses(const std::vector<double> &joint_values,
+                        PoseVector &poses) const;
+
+private:
+  struct ActorJoint
+  {
+    VirtualRobot::RobotNodePtr node;
+    int index;
+    float direction;
+  };
+
+  // A joint that follows one of the joints of the actor (J1 and J2 of the Shadow hand).
+  struct CoupledJoint
+  {
+    VirtualRobot::RobotNodePtr node;
+    int index;
+    int leader;
+    float factor;
+  };
+
+  struct ActorLink
+  {
+    VirtualRobot::CollisionModelPtr col_model;
+    int index;
+    // The leaf of the link in the tree, and the box of its collision model in its own frame.
+    int leaf;
+    Eigen::Vector3f local_min;
+    Eigen::Vector3f local_max;
+    // Check collisions with the object (considerCollisions is not None).
+    bool check_object;
+    // Check collisions with the links of the other actors.
+    bool check_actors;
+    // The links of the other actors it can collide with (see the collision filter of urdf_to_simox_xml).
+    std::vector<VirtualRobot::CollisionModelPtr> actor_col_models;
+    std::vector<int> actor_leaves;
+  };
+
+  struct Actor
+  {
+    // The function of the generated forward kinematics, -1 for all links.
+    int function;
+    std::vector<ActorJoint> joints;
+    std::vector<CoupledJoint> coupled_joints;
+    std::vector<ActorLink> links;
+    // The nodes of the joints, and scratch space for their values (without the generated forward kinematics).
+    std::vector<VirtualRobot::RobotNodePtr> nodes;
+    std::vector<float> values;
+  };
+
+  /*! Find the joints and links of the actors. Returns false if the generated forward kinematics does not fit. */
+  bool initActors_(bool generated);
+
+  /*! False if the pair of links can never collide. */
+  bool canCollide_(const ActorLink &link, const ActorLink &other) const;
+
+  /*! Move the actor (and the joints coupled to it) one step. Returns false when none of its joints could move. */
+  bool step_(const Actor &actor, std::vector<double> &joint_values) const;
+
+  /*! Move the collision models (and the boxes) of the actor to the joint values. */
+  void updateCollisionModels_(Actor &actor, const std::vector<double> &joint_values);
+
+  bool isColliding_(size_t actor_index, VirtualRobot::CollisionModelPtr object);
+
+  /*! The axis aligned box of a box of the frame moved by the pose. */
+  static void transformBox_(const Eigen::Matrix4f &pose,
+                            const Eigen::Vector3f &min, const Eigen::Vector3f &max,
+                            Eigen::Vector3f &out_min, Eigen::Vector3f &out_max);
+
+  VirtualRobot::EndEffectorPtr eef_;
+  VirtualRobot::RobotPtr robot_;
+  VirtualRobot::CollisionCheckerPtr col_checker_;
+  float angle_;
+
+  bool generated_;
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> link_names_;
+  std::vector<VirtualRobot::RobotNodePtr> joint_nodes_;
+  std::vector<Actor> actors_;
+
+  // Scratch space for the poses computed by the generated forward kinematics.
+  std::vector<double> poses_;
+
+  DynamicAabbTree links_tree_;
+
+  // The object being closed on: its box in the frame of the robot, its BVH (may be null)
+  // and the pose of the frame of the robot in its frame.
+  Eigen::Vector3f object_min_;
+  Eigen::Vector3f object_max_;
+  MeshBvhPtr object_bvh_;
+  Eigen::Matrix4f object_from_global_;
+
+  // Scratch space for the links near the object.
+  std::vector<int> near_leaves_;
+  std::vector<char> near_object_;
+};
+
+typedef boost::shared_ptr<HandClosing> HandClosingPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
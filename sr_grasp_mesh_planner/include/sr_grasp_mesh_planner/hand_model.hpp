@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_model.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The hands (robot file, end-effector and preshape) a planner can plan grasps for.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/EndEffector/EndEffector.h>
+
+#include <ros/node_handle.h>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * A hand is loaded once, when the planner starts, and kept. The workers plan with their
+ * own clones of its end-effector (see SampleContext), so it is never moved while planning.
+ **/
+struct HandModel
+{
+  //! The name goals and the configuration refer to the hand with.
+  std::string name;
+  std::string robot_file;
+  std::string eef_name;
+  std::string preshape;
+
+  VirtualRobot::RobotPtr robot;
+  VirtualRobot::EndEffectorPtr eef;
+  //! The frame the grasps of the hand are given in (see getHandFrame).
+  std::string frame_id;
+};
+
+typedef boost::shared_ptr<HandModel> HandModelPtr;
+
+/*!
+ * True if the robot is a URDF: the robot_description parameter, or a file ending in .urdf.
+ * It is then converted by urdf_to_simox_xml when loaded, instead of read from a Simox XML file.
+ */
+bool isUrdfRobot(const std::string &robot_file);
+
+/*!
+ * Load a robot from a Simox XML file, or from a URDF (see isUrdfRobot). A URDF is converted
+ * with the same defaults as urdf_to_simox_xml (gsc::ConversionOptions), to a directory of
+ * ~model_cache_dir (~/.ros/sr_grasp_mesh_planner_models by default) named after a hash of the
+ * URDF, of its meshes and of the options. The robot is loaded from that directory, without
+ * converting it again, as long as none of them changes. Null on error.
+ */
+VirtualRobot::RobotPtr loadRobotModel(const std::string &robot_file);
+
+/*!
+ * The node of the robot that is a frame of the hand outside of Simox: the base link of the URDF.
+ * urdf_to_simox_xml adds a root node (<hand>_hand_base) with the base link, the TCP and the GCP
+ * as its children, none of which but the base link is a link of the URDF. The root node if the
+ * robot was not converted.
+ */
+std::string getHandFrame(VirtualRobot::RobotPtr robot);
+
+/*! Load the robot of a hand and set its preshape (if not empty). Null on error. */
+HandModelPtr loadHandModel(const std::string &name,
+                           const std::string &robot_file,
+                           const std::string &eef_name,
+                           const std::string &preshape);
+
+/*!
+ * Load the hands listed in the parameter, a list of dictionaries with a robot (Simox XML
+ * file or URDF, see loadRobotModel), an endeffector, and optionally a name (the end-effector
+ * by default) and a preshape:
+ *   hands:
+ *     - {name: dms, robot: /path/to/dms.xml, endeffector: DMS, preshape: Grasp Preshape}
+ * The hands that cannot be loaded are skipped.
+ */
+std::vector<HandModelPtr> loadHandModels(const ros::NodeHandle &node_handle, const std::string &param);
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   mesh_bvh.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A flattened bounding volume hierarchy over the triangles of an object mesh.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include <Eigen/Core>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+class MeshBvh;
+typedef boost::shared_ptr<MeshBvh> MeshBvhPtr;
+
+/**
+ * The tree is built once per mesh with the surface area heuristic (binned), and
+ * stored depth first in one array: the left child of an inner node is the next
+ * node, the right child is at its offset. The triangles are reordered so that the
+ * triangles of a leaf are contiguous. Everything is in the frame of the mesh (mm).
+ *
+ * A built tree is read only, so it can be shared by all workers, and it can be
+ * saved to a file so that the same mesh does not have to be built again.
+ **/
+class MeshBvh
+{
+public:
+  struct Node
+  {
+    float min[3];
+    float max[3];
+    // Inner node: index of the right child. Leaf: index of the first triangle.
+    boost::uint32_t offset;
+    // Number of triangles, zero for an inner node.
+    boost::uint32_t count;
+  };
+
+  /*! Build the tree over the faces of the mesh, with at most max_leaf_size triangles per leaf. */
+  static MeshBvhPtr build(VirtualRobot::TriMeshModelPtr model, int max_leaf_size = 4);
+
+  /*! Null if the file cannot be read or is not a tree. */
+  static MeshBvhPtr load(const std::string &filename);
+  bool save(const std::string &filename) const;
+
+  std::size_t getNumNodes() const;
+  std::size_t getNumTriangles() const;
+
+  /*! The bounds of the whole mesh (the root node). */
+  Eigen::Vector3f getMin() const;
+  Eigen::Vector3f getMax() const;
+
+  /*! True if the bounds of the whole mesh overlap the box. */
+  bool overlapsBounds(const Eigen::Vector3f &min, const Eigen::Vector3f &max) const;
+
+  /*! True if a triangle of the mesh intersects the box. */
+  bool intersectsBox(const Eigen::Vector3f &min, const Eigen::Vector3f &max) const;
+
+  /*!
+   * Distance along the (unit) direction from the origin to the first triangle,
+   * or max_distance if no triangle is hit before.
+   */
+  float raycast(const Eigen::Vector3f &origin,
+                const Eigen::Vector3f &direction,
+                float max_distance) const;
+
+private:
+  MeshBvh();
+
+  struct BuildTriangle
+  {
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+    Eigen::Vector3f centroid;
+    boost::uint32_t index;
+  };
+
+  void build_(std::vector<BuildTriangle> &triangles,
+              std::size_t begin,
+              std::size_t end,
+              int max_leaf_size,
+              int depth);
+
+  void triangle_(std::size_t t, Eigen::Vector3f &a, Eigen::Vector3f &b, Eigen::Vector3f &c) const;
+
+  std::vector<Node> nodes_;
+  // x, y, z of each vertex.
+  std::vector<float> vertices_;
+  // Three vertex indices per triangle, in the order of the leaves.
+  std::vector<boost::uint32_t> triangles_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   mesh_grasp_planner.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The Simox-based grasp planner, without any window.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/adaptive_quality_threshold.hpp"
+#include "sr_grasp_mesh_planner/grasp_marker_publisher.hpp"
+#include "sr_grasp_mesh_planner/hand_model.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/reachability_map.hpp"
+#include "sr_grasp_mesh_planner/robustness_job.hpp"
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+#include <sr_robot_msgs/PlanGraspAction.h>
+#include <moveit_msgs/Grasp.h>
+#include <object_recognition_msgs/RecognizedObject.h>
+#include <shape_msgs/Mesh.h>
+
+#include <VirtualRobot/VirtualRobot.h>
+#include <VirtualRobot/VirtualRobotException.h>
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/Obstacle.h>
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Grasping/Grasp.h>
+#include <VirtualRobot/Grasping/GraspSet.h>
+#include <VirtualRobot/Nodes/RobotNode.h>
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include <GraspPlanning/GraspStudio.h>
+#include <GraspPlanning/GraspQuality/GraspQualityMeasureWrenchSpace.h>
+#include <GraspPlanning/ApproachMovementSurfaceNormal.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Loads the hands, prepares the objects and plans grasps on them with the workers of the
+ * scheduler. It renders nothing and needs no display: the scene is published as RViz markers
+ * (~grasp_markers), and a GraspPlannerWindow can draw it when the planner is not headless.
+ *
+ * The loaded object (the one of the goal being planned), the grasps planned on it and the
+ * clone of the hand drawn at the last of them are protected by one mutex. The listener is
+ * called without it, from the thread that changed them.
+ **/
+class MeshGraspPlanner
+{
+public:
+  /*! Told when the loaded object, its grasps or the drawn hand change (see GraspPlannerWindow). */
+  class Listener
+  {
+  public:
+    virtual ~Listener()
+    {
+    }
+
+    virtual void objectChanged() = 0;
+    virtual void graspsCleared() = 0;
+    /*! The grasps added to getGraspSet(), with the pose of their TCP on the loaded object. */
+    virtual void graspsPlanned(const std::vector<Eigen::Matrix4f> &tcp_poses) = 0;
+    virtual void handChanged() = 0;
+  };
+
+  MeshGraspPlanner(const std::string &robotFile,
+                   const std::string &eefName,
+                   const std::string &preshape,
+                   VirtualRobot::TriMeshModelPtr triMeshModel,
+                   WorkStealingSchedulerPtr scheduler);
+
+  /*! Set before planning, null for none. */
+  void setListener(Listener *listener);
+
+  /*!
+   * Plan one grasp on the loaded object, add its message to result_mesh and return it (none if
+   * the object changed meanwhile). Its robustness is not scored: see scoreGrasps.
+   */
+  std::vector<VirtualRobot::GraspPtr> plan(bool force_closure,
+                                           float timeout,
+                                           float min_quality,
+                                           unsigned int seed,
+                                           boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh,
+                                           boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh,
+                                           AdaptiveQualityThresholdPtr threshold = AdaptiveQualityThresholdPtr());
+  std::vector<VirtualRobot::GraspPtr> plan(bool force_closure,
+                                           float timeout,
+                                           float min_quality,
+                                           unsigned int seed,
+                                           AdaptiveQualityThresholdPtr threshold = AdaptiveQualityThresholdPtr());
+
+  /*!
+   * Score the grasps plan() returned for a goal, of all the hands, in one RobustnessJob: on the
+   * same perturbations of the loaded object, drawn from seed, within one budget (see setRobustness).
+   * The scores replace the grasp_quality of their messages, msgs pointing to the one of the first
+   * grasp and the others following in the same order. Not done if robustness is off.
+   */
+  void scoreGrasps(const std::vector<VirtualRobot::GraspPtr> &grasps,
+                   bool force_closure,
+                   unsigned int seed,
+                   std::vector<moveit_msgs::Grasp>::iterator msgs);
+
+  /*!
+   * Plan up to nrGrasps grasps on a prepared object, on the workers of the scheduler.
+   * With several hands, each hand plans up to nrGrasps grasps at the same time, and the
+   * best nrGrasps of all the hands are returned, best first. With robustness (see setRobustness),
+   * all of them are scored in one RobustnessJob first, and ranked by their scores.
+   * Does not touch the loaded object, so it can be called from any thread.
+   * weight is the share of the workers given to this request (see WorkStealingScheduler),
+   * zero to only use idle workers. timeout is in seconds, for all the grasps.
+   * With a threshold, its threshold replaces min_quality (see AdaptiveQualityThreshold).
+   * The random draws of the jobs of each hand are seeded from seed (see GraspSampleJob).
+   */
+  std::vector<VirtualRobot::GraspPtr> planGrasps(PreparedObjectPtr prepared,
+                                                 int nrGrasps,
+                                                 bool force_closure,
+                                                 float timeout,
+                                                 float min_quality,
+                                                 unsigned int seed,
+                                                 double weight = 1.0,
+                                                 AdaptiveQualityThresholdPtr threshold = AdaptiveQualityThresholdPtr());
+
+  /*! Convert a grasp planned with planGrasps to a message. */
+  moveit_msgs::Grasp createGraspMsg(VirtualRobot::GraspPtr grasp);
+
+  /*!
+   * Save the approach prior (~approach_prior), with the grasps planned so far, speculative ones
+   * included. Writes a file: called once a goal is done, not while planning.
+   */
+  void saveApproachPrior();
+
+  /*!
+   * Prepare the objects with the approach prior read from filename from now on, in place of
+   * ~approach_prior, to replay a goal saved by the flight recorder. The grasps planned with it
+   * are added to it only, and it is never saved. Back to ~approach_prior if filename is empty.
+   */
+  void setReplayApproachPrior(const std::string &filename);
+
+  /*!
+   * The straight approach (in m) the open hand must have to the grasps planned from now on
+   * (see GraspSampleJob). The approach is not checked if approach_distance is zero.
+   */
+  void setApproachDistances(float approach_distance, float min_approach_distance);
+
+  /*!
+   * The hands to plan grasps with from now on, by name, separated by commas (all the loaded
+   * hands if empty). The first hand is the one given to the constructor, the others are
+   * listed in the ~hands parameter (see loadHandModels).
+   */
+  void setHands(const std::string &names);
+
+  /*!
+   * Score the grasps planned from now on under perturbations of the pose of the object, and
+   * return them best score first, with the score as their quality (see RobustnessJob).
+   * Not done if settings.num_samples is zero.
+   */
+  void setRobustness(const RobustnessJob::Settings &settings);
+
+  void loadObject(const object_recognition_msgs::RecognizedObject &object,
+                  int approach_movement);
+  void loadObject(VirtualRobot::TriMeshModelPtr triMeshModel,
+                  int approach_movement);
+
+  /*!
+   * Build everything needed to plan grasps on an object, without changing the loaded object.
+   * Safe to call from another thread while plan() is running.
+   */
+  PreparedObjectPtr prepareObject(const object_recognition_msgs::RecognizedObject &object,
+                                  int approach_movement);
+  PreparedObjectPtr prepareObject(VirtualRobot::TriMeshModelPtr triMeshModel,
+                                  int approach_movement,
+                                  std::size_t key = 0);
+
+  /*! Make a prepared object the one grasps are planned on. */
+  void setObject(PreparedObjectPtr prepared);
+
+  /*! The key of the mesh of the loaded object (see MeshObstacle::hash_mesh), zero if unknown. */
+  std::size_t getObjectKey() const;
+
+  /*! The loaded object, null if none. */
+  PreparedObjectPtr getObject() const;
+
+  /*!
+   * The key the grasps planned for a mesh at a pose are cached under (see GraspCache): the key of
+   * the mesh, combined with the pose when the reachability of the grasps is checked, as the grasps
+   * then depend on it (see ReachabilityMap::hashPose).
+   */
+  std::size_t getGraspKey(std::size_t mesh_key, const geometry_msgs::PoseWithCovarianceStamped &pose) const;
+
+  /*! The first hand, the one given to the constructor. */
+  VirtualRobot::EndEffectorPtr getEEF() const;
+
+  /*! The grasps of the first hand planned on the loaded object since the last goal. */
+  VirtualRobot::GraspSetPtr getGraspSet() const;
+
+  /*!
+   * The clone of the first hand, set to the last grasp planned on the loaded object, and its
+   * contacts with the object when it is closed (see openHand and closeHand).
+   */
+  VirtualRobot::RobotPtr getHandClone() const;
+  VirtualRobot::EndEffector::ContactInfoVector getContacts() const;
+
+  /*! The quality of the grasp of the clone of the hand, false if it is not closed. */
+  bool getHandQuality(float &quality, bool &force_closure) const;
+
+  void openHand();
+  void closeHand();
+
+  static double diffclock(clock_t clock1, clock_t clock2);
+
+private:
+  void loadRobot_();
+
+  /*! The grasps of all the enabled hands, best quality first, not scored nor truncated (see planGrasps). */
+  std::vector<VirtualRobot::GraspPtr> sampleGrasps_(PreparedObjectPtr prepared,
+                                                    int nrGrasps,
+                                                    bool force_closure,
+                                                    float timeout,
+                                                    float min_quality,
+                                                    unsigned int seed,
+                                                    double weight,
+                                                    AdaptiveQualityThresholdPtr threshold);
+
+  /*! Score grasps of any of the hands in one RobustnessJob. */
+  void scoreGrasps_(PreparedObjectPtr prepared,
+                    const std::vector<VirtualRobot::GraspPtr> &grasps,
+                    bool force_closure,
+                    const RobustnessJob::Settings &settings,
+                    unsigned int seed,
+                    double weight);
+
+  // Called with object_mutex_ locked.
+  void openHand_();
+  void closeHand_();
+
+  Listener *listener_;
+
+  VirtualRobot::RobotPtr robot_;
+  VirtualRobot::EndEffectorPtr eef_;
+
+  std::string robotFile_;
+  std::string eefName_;
+  std::string preshape_;
+
+  // Protects the loaded object and what goes with it, below.
+  mutable boost::mutex object_mutex_;
+  VirtualRobot::RobotPtr eefCloned_;
+  VirtualRobot::ObstaclePtr object_;
+  VirtualRobot::GraspSetPtr grasps_;
+  VirtualRobot::EndEffector::ContactInfoVector contacts_;
+  bool hand_closed_;
+  float hand_quality_;
+  bool hand_force_closure_;
+  GraspStudio::GraspQualityMeasureWrenchSpacePtr qualityMeasure_;
+  GraspStudio::ApproachMovementSurfaceNormalPtr approach_;
+  PreparedObjectPtr prepared_;
+  std::size_t object_key_;
+
+  WorkStealingSchedulerPtr scheduler_;
+
+  boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh_;
+  boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh_;
+
+  unsigned short grasp_counter_;
+  boost::mutex grasp_counter_mutex_;
+
+  // Protects the settings below.
+  boost::mutex settings_mutex_;
+  // See setApproachDistances (m).
+  float approach_distance_;
+  float min_approach_distance_;
+  // Indices of the hands to plan with (see setHands).
+  std::vector<int> enabled_hands_;
+  // See setRobustness.
+  RobustnessJob::Settings robustness_;
+
+  // The loaded hands, the first one is robot_ and eef_. Never changed after construction.
+  std::vector<HandModelPtr> hands_;
+
+  /*! The hand that planned the grasp, null if none. */
+  HandModelPtr getHand_(VirtualRobot::GraspPtr grasp) const;
+
+  // Only one object is prepared at a time.
+  boost::mutex prepare_mutex_;
+
+  /*!
+   * The BVH of the mesh with the given key (mm): from memory, from the object library
+   * or built (and saved to the library). Called with prepare_mutex_ locked.
+   */
+  MeshBvhPtr getMeshBvh_(std::size_t key, VirtualRobot::TriMeshModelPtr triMeshModel);
+
+  // BVHs of the last meshes, by key (see MeshObstacle::hash_mesh), the oldest is evicted first.
+  std::map<std::size_t, MeshBvhPtr> bvh_cache_;
+  std::deque<std::size_t> bvh_keys_;
+  static const std::size_t max_cached_bvhs_;
+
+  // Directory where the BVHs are saved, to be reused across runs (~object_library, none if empty).
+  std::string object_library_;
+
+  // The poses the arm can reach (~reachability_map), null if not given.
+  ReachabilityMapPtr reachability_;
+
+  // The scene as RViz markers (~grasp_markers), for the loaded object only.
+  GraspMarkerPublisherPtr markers_;
+
+  // Where the grasps found so far approached objects from, saved to ~approach_prior after each goal.
+  // Null if not given: the approach poses are then drawn uniformly.
+  ApproachPriorPtr approach_prior_;
+  std::string approach_prior_file_;
+  // Used in place of approach_prior_ while a goal is replayed (see setReplayApproachPrior).
+  ApproachPriorPtr replay_prior_;
+  std::string replay_prior_file_;
+
+  // How each generator moves the hand out of the object (~retraction and ~retraction_step,
+  // overridden in ~bounding_box and ~surface_normal).
+  RetractionEngine::Settings bounding_box_retraction_;
+  RetractionEngine::Settings surface_normal_retraction_;
+
+  // Try the analytic approach poses of each object before the random ones (~seed_grasps, see SeedApproach).
+  bool seed_grasps_;
+};
+
+typedef boost::shared_ptr<MeshGraspPlanner> MeshGraspPlannerPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
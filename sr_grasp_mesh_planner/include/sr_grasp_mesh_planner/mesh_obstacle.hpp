@@ -59,6 +59,12 @@ public:
   static TriMeshModelPtr create_tri_mesh_skybox(void);
   static TriMeshModelPtr create_tri_mesh(const shape_msgs::Mesh &mesh_msg);
 
+  /**
+   * A key identifying a mesh by its vertices and triangles.
+   * Used to recognize an object that has been seen before.
+   */
+  static std::size_t hash_mesh(const shape_msgs::Mesh &mesh_msg);
+
   /**
    * Debug function to write a tri mesh to an OFF file.
    * http://segeval.cs.princeton.edu/public/off_format.html
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   model_registry.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The meshes of known objects, by recognition key, loaded once from disk.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+
+#include <shape_msgs/Mesh.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * A goal whose object has no bounding mesh is served from the model registered under the
+ * key of its type (object_recognition_msgs/ObjectType), so known objects can be sent as a
+ * key and a pose. Each .ply file of the registry directory is a model (in m, as in a goal),
+ * registered under its file name without the extension.
+ *
+ * The meshes are read and hashed once, when the registry is loaded, and the object prepared
+ * for each model is kept, so a goal on a registered model neither sends, hashes nor converts
+ * a mesh. The key of a model's mesh is the key of the same mesh sent in a goal, so both share
+ * the grasp cache and the object library.
+ *
+ * All the methods can be called from any thread.
+ **/
+class ModelRegistry
+{
+public:
+  struct Model
+  {
+    //! The recognition key (ObjectType.key).
+    std::string key;
+    std::string filename;
+    shape_msgs::Mesh mesh;
+    //! See MeshObstacle::hash_mesh.
+    std::size_t mesh_key;
+  };
+
+  typedef boost::shared_ptr<const Model> ModelConstPtr;
+
+  /*! Register the .ply files of a directory. Returns the number of models registered. */
+  int load(const std::string &directory);
+
+  /*! The model registered under the key, null if none. */
+  ModelConstPtr find(const std::string &key) const;
+
+  std::vector<std::string> getKeys() const;
+
+  /*! The object prepared for the model with approach_movement, null if none yet. */
+  PreparedObjectPtr getPrepared(const std::string &key, int approach_movement) const;
+  void setPrepared(const std::string &key, PreparedObjectPtr prepared);
+
+private:
+  // Protects the members below.
+  mutable boost::mutex mutex_;
+  std::map<std::string, ModelConstPtr> models_;
+  std::map<std::string, PreparedObjectPtr> prepared_;
+};
+
+typedef boost::shared_ptr<ModelRegistry> ModelRegistryPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   prepared_object.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Everything the grasp planner needs for an object, built before planning starts.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/Obstacle.h>
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+#include "sr_grasp_mesh_planner/mesh_bvh.hpp"
+#include "sr_grasp_mesh_planner/retraction_engine.hpp"
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+
+#include <GraspPlanning/GraspQuality/GraspQualityMeasureWrenchSpace.h>
+#include <GraspPlanning/ApproachMovementSurfaceNormal.h>
+
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+struct SampleContext;
+
+/**
+ * The result of MeshGraspPlanner::prepareObject: the mesh obstacle, its grasp
+ * quality measure and the approach movement generator (which owns its own clone
+ * of the end-effector). Building it does not touch the state of the planner, so
+ * it can be done on another thread while the planner is busy with another object.
+ **/
+struct PreparedObject
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  PreparedObject()
+    : key(0),
+      approach_movement(0),
+      pose(Eigen::Matrix4f::Identity())
+  {
+  }
+
+  //! The key of the mesh (see MeshObstacle::hash_mesh), zero if unknown.
+  std::size_t key;
+  int approach_movement;
+
+  //! The pose of the object (mm) in frame_id, as recognized. frame_id is empty if unknown.
+  std::string frame_id;
+  Eigen::Matrix4f pose;
+
+  VirtualRobot::ObstaclePtr object;
+  //! The triangles of the object, in the frame of the object (mm). Shared by all the goals on the same mesh.
+  MeshBvhPtr bvh;
+  //! The principal axes and shape class of the object, and the prior the generators draw from (null if none).
+  ShapeFrame shape_frame;
+  ApproachPriorPtr approach_prior;
+  //! How the generators move the hand out of the object.
+  RetractionEngine::Settings retraction;
+  //! The analytic approach poses tried before the random ones (none if empty), and per hand the next one to try.
+  SeedApproaches seeds;
+  std::vector<int> next_seed;
+  GraspStudio::GraspQualityMeasureWrenchSpacePtr quality_measure;
+  GraspStudio::ApproachMovementSurfaceNormalPtr approach;
+
+  //! One per hand of the planner and worker of the scheduler, built on first use by the worker (see GraspSampleJob).
+  std::vector< std::vector< boost::shared_ptr<SampleContext> > > contexts;
+};
+
+typedef boost::shared_ptr<PreparedObject> PreparedObjectPtr;
+
+/**
+ * Create the approach movement generator selected by approach_movement (see cfg/Planner.cfg).
+ * The generator owns its own clone of the end-effector, and draws its positions from the prior if any.
+ */
+GraspStudio::ApproachMovementSurfaceNormalPtr createApproachMovement(int approach_movement,
+                                                                     VirtualRobot::SceneObjectPtr object,
+                                                                     VirtualRobot::EndEffectorPtr eef,
+                                                                     ApproachPriorPtr prior = ApproachPriorPtr(),
+                                                                     const ShapeFrame &shape_frame = ShapeFrame(),
+                                                                     const RetractionEngine::Settings &retraction =
+                                                                       RetractionEngine::Settings());
+
+/*! The pose (mm) of a recognized object (m). */
+Eigen::Matrix4f getRecognizedPose(const geometry_msgs::PoseWithCovarianceStamped &pose);
+
+/*! Set the pose and frame of a prepared object from the pose of the recognized object (m). */
+void setRecognizedPose(PreparedObject &prepared, const geometry_msgs::PoseWithCovarianceStamped &pose);
+
+/*! The retraction engine of a generator made by createApproachMovement (null for another generator). */
+RetractionEngine *getRetractionEngine(GraspStudio::ApproachMovementSurfaceNormalPtr approach);
+
+/*! The generator of the random poses of a generator made by createApproachMovement (null for another generator). */
+boost::mt19937 *getRandomGenerator(GraspStudio::ApproachMovementSurfaceNormalPtr approach);
+
+/*!
+ * The point on the surface of the object and the approach direction (against the normal) of the last
+ * random pose of a generator made by createApproachMovement, as its prior saw them (false for another generator).
+ */
+bool getSampledPosition(GraspStudio::ApproachMovementSurfaceNormalPtr approach,
+                        Eigen::Vector3f &position,
+                        Eigen::Vector3f &approach_direction);
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
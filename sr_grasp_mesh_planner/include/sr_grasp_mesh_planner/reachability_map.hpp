@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   reachability_map.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A precomputed map of the hand poses the arm can reach, read from a file.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <Eigen/Core>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <string>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+class ReachabilityMap;
+typedef boost::shared_ptr<ReachabilityMap> ReachabilityMapPtr;
+
+/**
+ * The positions of the TCP are binned in a grid of voxels, and its approach directions
+ * in azimuth and polar angle bins. A cell is non zero if the arm can reach the TCP at
+ * that position with that approach direction. The map is computed offline (with the IK
+ * of the arm) in one frame, usually the base of the arm.
+ *
+ * The file is memory mapped, so a large map is only read where it is used, and is shared
+ * by all the planners of the machine. Its layout (little endian):
+ *   - "SRREACH1"
+ *   - the frame of the map, 64 chars padded with zeros
+ *   - float32 origin[3]: the corner of the grid (m)
+ *   - float32 voxel_size (m)
+ *   - uint32 size[3]: the number of voxels along x, y and z
+ *   - uint32 num_azimuth, num_polar: the number of direction bins
+ *   - uint8 cells, one per voxel and direction, with x slowest, then y, z, polar and azimuth
+ * The azimuth is in [-pi, pi), the polar angle (from z) in [0, pi].
+ **/
+class ReachabilityMap : private boost::noncopyable
+{
+public:
+  /*! Null if the file cannot be mapped or is not a reachability map. */
+  static ReachabilityMapPtr load(const std::string &filename);
+
+  ~ReachabilityMap();
+
+  const std::string &getFrameId() const;
+
+  /*!
+   * True if the arm can reach the TCP at position (mm) with the approach direction,
+   * both in the frame of the map. False outside of the grid.
+   */
+  bool isReachable(const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction) const;
+
+  /*!
+   * A key of the pose of an object (mm) in frame_id, at the resolution of the map: the voxel of
+   * its position and its orientation in steps of the azimuth bins. The grasps planned for an
+   * object can be reused at another pose with the same key.
+   */
+  std::size_t hashPose(const std::string &frame_id, const Eigen::Matrix4f &pose) const;
+
+private:
+  ReachabilityMap();
+
+  void *data_;
+  std::size_t size_;
+
+  std::string frame_id_;
+  // In mm.
+  Eigen::Vector3f origin_;
+  float voxel_size_;
+  boost::uint32_t grid_size_[3];
+  boost::uint32_t num_azimuth_;
+  boost::uint32_t num_polar_;
+  const boost::uint8_t *cells_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
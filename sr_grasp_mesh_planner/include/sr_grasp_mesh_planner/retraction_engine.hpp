@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   retraction_engine.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Move the hand of an approach movement generator back until it is out of the object.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <GraspPlanning/ApproachMovementGenerator.h>
+#include <VirtualRobot/SceneObjectSet.h>
+
+#include <Eigen/Core>
+#include <boost/function.hpp>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * GraspStudio moves the hand away from the object by fixed steps, with a collision check
+ * at each step (moveEEFAway), so a deep start costs many checks. In adaptive mode, the
+ * number of steps is doubled until the hand is free, then bisected back between the last
+ * colliding and the first free doubling: a few checks whatever the depth. Both modes stop
+ * on the same grid of steps, so the adaptive distance is the one of moveEEFAway whenever
+ * the hand leaves the object once along the way. The distance at which the bounding boxes
+ * of the hand and of the object no longer overlap along the direction is free for sure, so
+ * the doubling jumps there without a check when it would go further.
+ *
+ * A free gap that the doubling and the bisection both step over (e.g., the object between
+ * two fingers) is missed: the distance is then farther than the one of moveEEFAway, but free.
+ *
+ * An engine belongs to one generator, and is not shared between threads.
+ **/
+class RetractionEngine
+{
+public:
+  enum Mode
+  {
+    //! Steps of step mm, as moveEEFAway.
+    fixed_steps,
+    //! Doubling the steps, then bisection back to the first free step.
+    adaptive
+  };
+
+  struct Settings
+  {
+    Settings()
+      : mode(adaptive),
+        step(3.0f),
+        max_distance(3000.0f)
+    {
+    }
+
+    Mode mode;
+    // In mm.
+    float step;
+    float max_distance;
+  };
+
+  struct Stats
+  {
+    Stats()
+      : retractions(0),
+        checks(0),
+        failures(0),
+        distance(0.0)
+    {
+    }
+
+    int retractions;
+    //! Collision checks, for all the retractions.
+    int checks;
+    //! Retractions still in collision at max_distance.
+    int failures;
+    //! Sum of the distances moved (mm).
+    double distance;
+  };
+
+  //! True if the hand collides when moved back by the distance (mm).
+  typedef boost::function<bool (float)> CollisionQuery;
+
+  explicit RetractionEngine(const Settings &settings = Settings());
+
+  void setSettings(const Settings &settings);
+  const Settings &getSettings() const;
+
+  const Stats &getStats() const;
+
+  /*!
+   * Move the end-effector of the generator along the (global) direction, away from the object,
+   * until it does not collide with the object. False if it still does at max_distance.
+   */
+  bool retract(GraspStudio::ApproachMovementGenerator &generator,
+               const Eigen::Vector3f &direction);
+
+  /*!
+   * The distance to move back (a multiple of step), given the query, and a distance known to
+   * be free, as are all the farther ones (negative if none). Negative if the hand still
+   * collides at max_distance.
+   */
+  float search(const CollisionQuery &collides, float free_distance = -1.0f);
+
+  /*!
+   * The distance along the unit direction that separates the box of the hand from the box
+   * of the object (zero if they are already separated along it).
+   */
+  static float separatingDistance(const Eigen::Vector3f &direction,
+                                  const Eigen::Vector3f &hand_min,
+                                  const Eigen::Vector3f &hand_max,
+                                  const Eigen::Vector3f &object_min,
+                                  const Eigen::Vector3f &object_max);
+
+private:
+  bool collides_(GraspStudio::ApproachMovementGenerator *generator,
+                 VirtualRobot::SceneObjectSetPtr hand,
+                 const Eigen::Matrix4f &start_pose,
+                 const Eigen::Vector3f &direction,
+                 float distance);
+
+  Settings settings_;
+  Stats stats_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   robustness_job.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Score accepted grasps by their quality under perturbations of the pose of the object.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/grasp_sample_job.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/Grasping/Grasp.h>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Each sample closes the hand of one grasp on the object moved by one perturbation
+ * (a translation and a rotation about the center of the object, drawn from normal
+ * distributions), and evaluates the quality of the contacts. Moving the object is the same
+ * as moving the hand the other way, so the object stays where it is and the samples share
+ * its BVH. A perturbation where the hand gets fewer than two contacts (or no force closure
+ * when it is required) counts as a quality of zero.
+ *
+ * All the grasps are evaluated on the same perturbations, so their scores are compared on
+ * the same errors, and the samples go perturbation after perturbation, so all the grasps
+ * have about as many samples when the budget runs out. The grasps can be of several hands:
+ * each sample runs on the context of the worker for the hand of its grasp (see GraspSampleJob).
+ **/
+class RobustnessJob : public SampleJob
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  struct Settings
+  {
+    Settings()
+      : num_samples(0),
+        position_noise(0.005f),
+        rotation_noise(0.05f),
+        budget(1.0f)
+    {
+    }
+
+    //! Perturbations per grasp, not evaluated if zero.
+    int num_samples;
+    //! The standard deviations of the translation (m) and of the angle of the rotation (rad).
+    float position_noise;
+    float rotation_noise;
+    //! In seconds, for all the grasps of the job. No limit if zero.
+    float budget;
+  };
+
+  /*!
+   * hands gives the hand of each grasp, an index in eefs, the end-effectors of all the hands.
+   * The perturbations are drawn from a generator seeded with seed, so they follow the seed of the goal.
+   */
+  RobustnessJob(PreparedObjectPtr prepared,
+                const std::vector<VirtualRobot::EndEffectorPtr> &eefs,
+                const std::vector<int> &hands,
+                int num_workers,
+                const std::vector<VirtualRobot::GraspPtr> &grasps,
+                bool force_closure,
+                const Settings &settings,
+                unsigned int seed);
+
+  virtual ~RobustnessJob();
+
+  virtual void run_sample(int worker_id);
+
+  virtual bool done() const;
+
+  /*!
+   * Block until all the samples are evaluated or the budget is spent, then set the robustness
+   * of each grasp (see ApproachGrasp::setRobustness) from the samples evaluated so far.
+   * Returns the number of samples evaluated.
+   */
+  int wait();
+
+private:
+  bool done_() const;
+
+  /*! The quality of a grasp, with the object moved by a perturbation (zero if the grasp fails). */
+  float evaluate_(SampleContext &context,
+                  const VirtualRobot::GraspPtr &grasp,
+                  const Eigen::Matrix4f &perturbation) const;
+
+  PreparedObjectPtr prepared_;
+  std::vector<VirtualRobot::EndEffectorPtr> eefs_;
+  std::vector<int> hands_;
+  const bool force_closure_;
+
+  std::vector<VirtualRobot::GraspPtr> grasps_;
+  // The poses of the object (mm), in its frame.
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > perturbations_;
+  const int num_total_;
+
+  bool has_deadline_;
+  boost::posix_time::ptime deadline_;
+
+  // Protects the members below.
+  mutable boost::mutex mutex_;
+  boost::condition_variable cond_;
+  // The next sample to hand out: perturbation next_ / grasps, grasp next_ % grasps.
+  int next_;
+  int num_finished_;
+  // Per grasp, the sums of the qualities and of their squares.
+  std::vector<int> counts_;
+  std::vector<double> sums_;
+  std::vector<double> squares_;
+  bool finished_;
+};
+
+typedef boost::shared_ptr<RobustnessJob> RobustnessJobPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
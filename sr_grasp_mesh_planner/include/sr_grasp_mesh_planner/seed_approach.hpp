@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   seed_approach.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Analytic approach poses from the principal axes of an object, tried before the random ones.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+#include "sr_grasp_mesh_planner/retraction_engine.hpp"
+
+#include <GraspPlanning/ApproachMovementSurfaceNormal.h>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * An approach pose of the hand, in the frame of the object (mm): the grasp center point on
+ * the box of the principal axes, the approach direction (from the object outward, as in
+ * GraspStudio), and the x axis of the grasp center point, which sets the roll of the hand.
+ **/
+struct SeedApproach
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Eigen::Vector3f position;
+  Eigen::Vector3f direction;
+  Eigen::Vector3f x_axis;
+};
+
+typedef std::vector<SeedApproach, Eigen::aligned_allocator<SeedApproach> > SeedApproaches;
+
+/*!
+ * The analytic approach poses of an object, in the order they are tried:
+ * - enclosing grasps, from the sides, perpendicular to the longest axis (along the shortest axis first),
+ * - pinches from the ends of the longest axis, across the thinnest dimension.
+ * Each is given with two rolls, 90 degrees apart, since which way the fingers close depends on the hand.
+ */
+SeedApproaches computeSeedApproaches(const ShapeFrame &frame);
+
+/*!
+ * Open the hand of the generator, put its grasp center point at the seed, and move it back
+ * along the approach direction until it does not collide with the object.
+ */
+void setEEFToSeedApproach(GraspStudio::ApproachMovementSurfaceNormal &approach,
+                          RetractionEngine &retraction,
+                          const SeedApproach &seed);
+
+/*!
+ * Put the grasp center point of the hand of the generator at position (mm, in the frame of the
+ * object), approaching along direction, with its x axis as close to x_axis as possible.
+ */
+void setEEFPoseWithRoll(GraspStudio::ApproachMovementSurfaceNormal &approach,
+                        const Eigen::Vector3f &position,
+                        const Eigen::Vector3f &direction,
+                        const Eigen::Vector3f &x_axis);
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   speculative_planner.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Plan grasps for recognized objects before they are requested.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
+#include "sr_grasp_mesh_planner/grasp_cache.hpp"
+
+#include <object_recognition_msgs/RecognizedObject.h>
+#include <object_recognition_msgs/RecognizedObjectArray.h>
+#include <ros/ros.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstddef>
+#include <deque>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * Subscribes to the objects published by perception and plans grasps for the ones
+ * that have not been seen before, while no goal is being served. The grasps are
+ * stored in a GraspCache, from which GraspActionServer serves later goals.
+ *
+ * Each object is prepared on its own (see MeshGraspPlanner::prepareObject), at the
+ * lowest thread priority, and its grasps are planned with a weight of zero, so that
+ * the workers of the scheduler only run its samples when no goal needs them.
+ * No new object is started between pause() and resume().
+ **/
+class SpeculativePlanner
+{
+public:
+  SpeculativePlanner(ros::NodeHandle &nh,
+                     MeshGraspPlannerPtr grasp_planner,
+                     boost::shared_ptr<GraspCache> grasp_cache);
+
+  virtual ~SpeculativePlanner();
+
+  void set_config(bool enabled,
+                  int max_grasps,
+                  float timeout_one_grasp,
+                  float min_quality,
+                  bool force_closure,
+                  int approach_movement);
+
+  /*! Called before a goal takes the planner. */
+  void pause();
+  /*! Called once a goal is done with the planner. */
+  void resume();
+
+private:
+  struct PendingObject
+  {
+    //! The key of the grasps of the object in the cache (see MeshGraspPlanner::getGraspKey).
+    std::size_t key;
+    object_recognition_msgs::RecognizedObject object;
+  };
+
+  void objects_cb_(const object_recognition_msgs::RecognizedObjectArrayConstPtr &msg);
+
+  void run_();
+
+  /*! Plan the missing grasps of the object. */
+  void speculate_(const PendingObject &pending);
+
+  bool is_pending_(std::size_t key) const;
+
+  // The maximum number of objects waiting for speculation.
+  static const std::size_t max_pending_;
+
+  ros::Subscriber objects_sub_;
+
+  MeshGraspPlannerPtr grasp_planner_;
+  boost::shared_ptr<GraspCache> grasp_cache_;
+
+  // Protects everything below.
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+
+  std::deque<PendingObject> pending_;
+
+  bool enabled_;
+  int paused_;
+  bool shutdown_;
+
+  int max_grasps_;
+  float timeout_one_grasp_;
+  float min_quality_;
+  bool force_closure_;
+  int approach_movement_;
+
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -16,6 +16,11 @@
 
 #include <GraspPlanning/ApproachMovementSurfaceNormal.h>
 
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+#include "sr_grasp_mesh_planner/retraction_engine.hpp"
+
+#include <boost/random/mersenne_twister.hpp>
+
 //-------------------------------------------------------------------------------
 
 namespace sr_grasp_mesh_planner
@@ -39,6 +44,30 @@ public:
   //! Returns a position with normal on the surface of the object
   bool getPositionOnObjectWithFocalPoint(Eigen::Vector3f &storePos,
                                          Eigen::Vector3f &storeApproachDir);
+
+  //! Draw the positions from the prior of the shape of the object (null to draw them uniformly).
+  void setPrior(ApproachPriorPtr prior, const ShapeFrame &shape_frame);
+
+  //! How the hand is moved out of the object (adaptive by default), and its counts.
+  RetractionEngine &getRetraction();
+
+  //! The generator of the random approach poses, to seed (see GraspSampleJob).
+  boost::mt19937 &getRandom();
+
+  //! The point on the surface of the object and the approach direction the last random pose was drawn at.
+  const Eigen::Vector3f &getSampledPosition() const;
+  const Eigen::Vector3f &getSampledApproachDir() const;
+
+private:
+  ApproachPriorPtr prior_;
+  ShapeFrame shape_frame_;
+  // What the prior was asked about for the last random pose.
+  Eigen::Vector3f sampled_position_;
+  Eigen::Vector3f sampled_approach_dir_;
+
+  RetractionEngine retraction_;
+
+  boost::mt19937 random_;
 };
 
 } // end of namespace sr_grasp_mesh_planner
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   work_stealing_scheduler.hpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A pool of worker threads evaluating grasp samples of several jobs.
+ **/
+
+#pragma once
+
+//-------------------------------------------------------------------------------
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+/**
+ * A job is an unbounded source of independent samples (e.g., grasp hypotheses),
+ * evaluated one at a time by the workers until the job is done.
+ **/
+class SampleJob
+{
+public:
+  virtual ~SampleJob() {}
+
+  /*! Evaluate one sample. worker_id is in [0, WorkStealingScheduler::num_workers()). */
+  virtual void run_sample(int worker_id) = 0;
+
+  /*! True once no more samples are needed. Must be thread safe. */
+  virtual bool done() const = 0;
+};
+
+typedef boost::shared_ptr<SampleJob> SampleJobPtr;
+
+//-------------------------------------------------------------------------------
+
+/**
+ * Samples are handed out to the workers in small chunks, in proportion to the
+ * weights of the jobs (stride scheduling). A worker runs the samples of its own
+ * deque, newest first. Once it runs out of work, it steals the oldest samples of
+ * the other workers, and only asks the jobs for a new chunk when there is nothing
+ * to steal. The cost of a sample varies a lot (from a rejected approach pose to a
+ * full closing simulation and wrench space computation), so this keeps all workers
+ * busy whatever the mix.
+ *
+ * Jobs with a weight of zero (or less) only get samples when no weighted job can.
+ **/
+class WorkStealingScheduler
+{
+public:
+  /*! num_workers <= 0 uses one worker per hardware thread. */
+  explicit WorkStealingScheduler(int num_workers = 0);
+  ~WorkStealingScheduler();
+
+  int num_workers() const;
+
+  /*! Evaluate the samples of job until it is done. */
+  void add_job(SampleJobPtr job, double weight = 1.0);
+
+private:
+  struct Worker
+  {
+    boost::mutex mutex;
+    std::deque<SampleJobPtr> samples;
+  };
+
+  struct JobEntry
+  {
+    SampleJobPtr job;
+    double weight;
+    // Virtual time of the job, advanced by 1/weight per sample handed out.
+    double pass;
+  };
+
+  void worker_loop_(int worker_id);
+
+  bool pop_local_(int worker_id, SampleJobPtr &job);
+  bool refill_(int worker_id, SampleJobPtr &job);
+  bool steal_(int worker_id, SampleJobPtr &job);
+
+  // Samples handed out at once to a worker for a weighted job.
+  static const std::size_t chunk_size_;
+
+  std::vector< boost::shared_ptr<Worker> > workers_;
+
+  // Protects the members below.
+  boost::mutex jobs_mutex_;
+  boost::condition_variable jobs_cond_;
+  std::list<JobEntry> jobs_;
+  double global_pass_;
+  bool shutdown_;
+
+  boost::thread_group threads_;
+};
+
+typedef boost::shared_ptr<WorkStealingScheduler> WorkStealingSchedulerPtr;
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   adaptive_quality_threshold.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A minimum grasp quality adjusted while planning, to find the grasps of a goal in time.
+ **/
+
+#include "sr_grasp_mesh_planner/adaptive_quality_threshold.hpp"
+
+#include <algorithm>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+AdaptiveQualityThreshold::AdaptiveQualityThreshold(float floor,
+                                                   float max_quality,
+                                                   int num_bins,
+                                                   int min_samples)
+  : floor_(floor),
+    max_quality_(max_quality),
+    min_samples_(min_samples),
+    budget_(0.0),
+    num_grasps_(0),
+    num_accepted_(0),
+    num_samples_(0),
+    histogram_(std::max(num_bins, 1), 0),
+    threshold_(std::max(floor, max_quality))
+{
+}
+
+//-------------------------------------------------------------------------------
+
+void AdaptiveQualityThreshold::start(int num_grasps, double budget)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  start_ = ros::WallTime::now();
+  budget_ = budget;
+  num_grasps_ = num_grasps;
+  num_accepted_ = 0;
+  num_samples_ = 0;
+  std::fill(histogram_.begin(), histogram_.end(), 0);
+  threshold_ = std::max(floor_, max_quality_);
+}
+
+//-------------------------------------------------------------------------------
+
+float AdaptiveQualityThreshold::getThreshold() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return threshold_;
+}
+
+//-------------------------------------------------------------------------------
+
+double AdaptiveQualityThreshold::getRemainingTime() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return std::max(0.0, budget_ - (ros::WallTime::now() - start_).toSec());
+}
+
+//-------------------------------------------------------------------------------
+
+void AdaptiveQualityThreshold::addSample(float quality)
+{
+  const int num_bins = static_cast<int>(histogram_.size());
+  int bin = static_cast<int>(quality / max_quality_ * num_bins);
+  bin = std::max(0, std::min(num_bins - 1, bin));
+
+  boost::mutex::scoped_lock lock(mutex_);
+  histogram_[bin]++;
+  num_samples_++;
+  this->update_();
+}
+
+//-------------------------------------------------------------------------------
+
+void AdaptiveQualityThreshold::addAccepted()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  num_accepted_++;
+  this->update_();
+}
+
+//-------------------------------------------------------------------------------
+
+void AdaptiveQualityThreshold::update_()
+{
+  if (num_samples_ < min_samples_)
+    return;
+
+  const int missing = num_grasps_ - num_accepted_;
+  if (missing <= 0)
+    return;
+
+  const double elapsed = (ros::WallTime::now() - start_).toSec();
+  const double remaining_time = budget_ - elapsed;
+  if (elapsed <= 0.0 || remaining_time <= 0.0)
+  {
+    threshold_ = floor_;
+    return;
+  }
+
+  // The share of the samples still to come that must pass.
+  const double expected_samples = num_samples_ / elapsed * remaining_time;
+  const double share = missing / expected_samples;
+  if (share >= 1.0)
+  {
+    threshold_ = floor_;
+    return;
+  }
+
+  // The quality above which that share of the samples seen so far are.
+  const int num_bins = static_cast<int>(histogram_.size());
+  const double wanted = share * num_samples_;
+  int above = 0;
+  int bin = num_bins - 1;
+  for (; bin > 0; bin--)
+  {
+    above += histogram_[bin];
+    if (above >= wanted)
+      break;
+  }
+  threshold_ = std::max(floor_, bin * max_quality_ / num_bins);
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   approach_clearance.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Check that the open hand can reach a grasp in a straight line along its approach direction.
+ **/
+
+#include "sr_grasp_mesh_planner/approach_clearance.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/SceneObjectSet.h>
+#include <VirtualRobot/CollisionDetection/CollisionChecker.h>
+#include <VirtualRobot/CollisionDetection/CollisionModel.h>
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include <algorithm>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+ApproachGrasp::ApproachGrasp(const std::string &name,
+                             const std::string &robot_type,
+                             const std::string &eef,
+                             const Eigen::Matrix4f &pose_in_tcp,
+                             const std::string &creation,
+                             float quality,
+                             const Eigen::Vector3f &approach_direction,
+                             float min_distance,
+                             float clear_distance)
+  : Grasp(name, robot_type, eef, pose_in_tcp, creation, quality),
+    approach_direction_(approach_direction),
+    min_distance_(min_distance),
+    clear_distance_(clear_distance),
+    robustness_(0.0f),
+    robustness_variance_(0.0f),
+    num_robustness_samples_(0)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &ApproachGrasp::getApproachDirection() const
+{
+  return approach_direction_;
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachGrasp::getMinDistance() const
+{
+  return min_distance_;
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachGrasp::getClearDistance() const
+{
+  return clear_distance_;
+}
+
+//-------------------------------------------------------------------------------
+
+void ApproachGrasp::setRobustness(float score, float variance, int num_samples)
+{
+  robustness_ = score;
+  robustness_variance_ = variance;
+  num_robustness_samples_ = num_samples;
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachGrasp::getRobustness() const
+{
+  return robustness_;
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachGrasp::getRobustnessVariance() const
+{
+  return robustness_variance_;
+}
+
+//-------------------------------------------------------------------------------
+
+int ApproachGrasp::getNumRobustnessSamples() const
+{
+  return num_robustness_samples_;
+}
+
+//-------------------------------------------------------------------------------
+
+ApproachClearance::ApproachClearance(EndEffectorPtr eef, float step)
+  : eef_(eef),
+    robot_(eef->getRobot()),
+    step_(step)
+{
+  col_models_ = eef_->getCollisionModels();
+  for (size_t i = 0; i < col_models_.size(); i++)
+  {
+    Eigen::Vector3f min, max;
+    col_models_[i]->getTriMeshModel()->getSize(min, max);
+    local_min_.push_back(min);
+    local_max_.push_back(max);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachClearance::compute(SceneObjectPtr object,
+                                 MeshBvhPtr bvh,
+                                 const Eigen::Vector3f &approach_direction,
+                                 float max_distance)
+{
+  if (!object || !object->getCollisionModel() || max_distance <= 0.0f)
+    return 0.0f;
+
+  const Eigen::Vector3f back = -approach_direction.normalized();
+  const Eigen::Matrix4f object_from_global = object->getCollisionModel()->getGlobalPose().inverse();
+  const Eigen::Matrix4f robot_pose = robot_->getGlobalPose();
+  const bool use_bvh = bvh && bvh->getNumNodes() > 0;
+
+  float clear = 0.0f;
+  bool moved = false;
+  while (clear < max_distance)
+  {
+    const float distance = std::min(clear + step_, max_distance);
+    const Eigen::Vector3f offset = back * distance;
+
+    if (!use_bvh || this->mayCollide_(object_from_global, offset, bvh))
+    {
+      Eigen::Matrix4f pose = robot_pose;
+      pose.block<3, 1>(0, 3) += offset;
+      robot_->setGlobalPose(pose);
+      moved = true;
+      if (robot_->getCollisionChecker()->checkCollision(object->getCollisionModel(), eef_->createSceneObjectSet()))
+        break;
+    }
+    clear = distance;
+  }
+
+  if (moved)
+    robot_->setGlobalPose(robot_pose);
+  return clear;
+}
+
+//-------------------------------------------------------------------------------
+
+bool ApproachClearance::mayCollide_(const Eigen::Matrix4f &object_from_global,
+                                    const Eigen::Vector3f &offset,
+                                    MeshBvhPtr bvh) const
+{
+  for (size_t i = 0; i < col_models_.size(); i++)
+  {
+    Eigen::Matrix4f pose = col_models_[i]->getGlobalPose();
+    pose.block<3, 1>(0, 3) += offset;
+    pose = object_from_global * pose;
+
+    const Eigen::Vector3f center = pose.block<3, 3>(0, 0) * ((local_min_[i] + local_max_[i]) / 2.0f) +
+      pose.block<3, 1>(0, 3);
+    const Eigen::Vector3f half_size = pose.block<3, 3>(0, 0).cwiseAbs() * ((local_max_[i] - local_min_[i]) / 2.0f);
+    if (bvh->intersectsBox(center - half_size, center + half_size))
+      return true;
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
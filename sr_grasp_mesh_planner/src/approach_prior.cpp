@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   approach_prior.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Where the grasps planned so far approached objects of the same shape from.
+ **/
+
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+
+#include <Eigen/Eigenvalues>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+const char file_magic[8] = { 'S', 'R', 'P', 'R', 'I', 'O', 'R', '1' };
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+ShapeFrame::ShapeFrame()
+  : center(Eigen::Vector3f::Zero()),
+    axes(Eigen::Matrix3f::Identity()),
+    half_extents(Eigen::Vector3f::Ones()),
+    shape_class(compact)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+ShapeFrame ShapeFrame::compute(VirtualRobot::TriMeshModelPtr model)
+{
+  ShapeFrame frame;
+  const std::vector<Eigen::Vector3f> &vertices = model->vertices;
+  if (vertices.size() < 3)
+    return frame;
+
+  for (size_t i = 0; i < vertices.size(); i++)
+    frame.center += vertices[i];
+  frame.center /= static_cast<float>(vertices.size());
+
+  Eigen::Matrix3f covariance = Eigen::Matrix3f::Zero();
+  for (size_t i = 0; i < vertices.size(); i++)
+  {
+    const Eigen::Vector3f d = vertices[i] - frame.center;
+    covariance += d * d.transpose();
+  }
+
+  // The eigenvalues are in increasing order: the longest axis first.
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
+  for (int i = 0; i < 3; i++)
+    frame.axes.col(i) = solver.eigenvectors().col(2 - i);
+
+  // Orient the axes towards the heavier side, so that the same shape gets the same frame.
+  Eigen::Vector3f skewness = Eigen::Vector3f::Zero();
+  Eigen::Vector3f max_distance = Eigen::Vector3f::Zero();
+  for (size_t i = 0; i < vertices.size(); i++)
+  {
+    const Eigen::Vector3f p = frame.axes.transpose() * (vertices[i] - frame.center);
+    skewness += p.cwiseProduct(p).cwiseProduct(p);
+    max_distance = max_distance.cwiseMax(p.cwiseAbs());
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    if (skewness(i) < 0.0f)
+      frame.axes.col(i) = -frame.axes.col(i);
+  }
+  frame.axes.col(2) = frame.axes.col(0).cross(frame.axes.col(1));
+  frame.half_extents = max_distance.cwiseMax(Eigen::Vector3f::Constant(1.0e-3f));
+
+  const bool is_elongated = frame.half_extents(0) > 2.0f * frame.half_extents(1);
+  const bool is_flat = frame.half_extents(1) > 2.0f * frame.half_extents(2);
+  frame.shape_class = (is_elongated ? elongated : compact) + (is_flat ? flat : compact);
+  return frame;
+}
+
+//-------------------------------------------------------------------------------
+
+const int ApproachPrior::max_draws = 20;
+const int ApproachPrior::num_position_bins_ = 4;
+const int ApproachPrior::num_polar_bins_ = 4;
+const int ApproachPrior::num_azimuth_bins_ = 8;
+const float ApproachPrior::exploration_ = 0.2f;
+
+//-------------------------------------------------------------------------------
+
+ApproachPrior::ApproachPrior()
+  : counts_(ShapeFrame::num_shape_classes * num_position_bins_ * num_polar_bins_ * num_azimuth_bins_, 0),
+    max_counts_(ShapeFrame::num_shape_classes, 0),
+    num_grasps_(0)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+ApproachPriorPtr ApproachPrior::load(const std::string &filename)
+{
+  ApproachPriorPtr prior(new ApproachPrior);
+
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (!in)
+    return prior;
+
+  char magic[sizeof(file_magic)];
+  boost::uint32_t size = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&size), sizeof(size));
+  if (!in || std::memcmp(magic, file_magic, sizeof(file_magic)) != 0 || size != prior->counts_.size())
+  {
+    ROS_WARN_STREAM(filename << " is not an approach prior.");
+    return ApproachPriorPtr();
+  }
+
+  in.read(reinterpret_cast<char*>(&prior->counts_[0]), size * sizeof(boost::uint32_t));
+  if (!in)
+  {
+    ROS_WARN_STREAM(filename << " is truncated.");
+    return ApproachPriorPtr();
+  }
+
+  const size_t class_size = prior->counts_.size() / ShapeFrame::num_shape_classes;
+  for (size_t i = 0; i < prior->counts_.size(); i++)
+  {
+    boost::uint32_t &max_count = prior->max_counts_[i / class_size];
+    max_count = std::max(max_count, prior->counts_[i]);
+    prior->num_grasps_ += prior->counts_[i];
+  }
+
+  ROS_INFO_STREAM("Loaded the approach prior " << filename << " (" << prior->num_grasps_ << " grasps).");
+  return prior;
+}
+
+//-------------------------------------------------------------------------------
+
+bool ApproachPrior::save(const std::string &filename) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // Written next to the file then renamed, so a reader never sees half a file.
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+    const boost::uint32_t size = counts_.size();
+    out.write(file_magic, sizeof(file_magic));
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(&counts_[0]), size * sizeof(boost::uint32_t));
+    if (!out)
+      return false;
+  }
+  return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+//-------------------------------------------------------------------------------
+
+ApproachPriorPtr ApproachPrior::clone() const
+{
+  ApproachPriorPtr copy(new ApproachPrior);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  copy->counts_ = counts_;
+  copy->max_counts_ = max_counts_;
+  copy->num_grasps_ = num_grasps_;
+  return copy;
+}
+
+//-------------------------------------------------------------------------------
+
+int ApproachPrior::cell_(const ShapeFrame &frame,
+                         const Eigen::Vector3f &position,
+                         const Eigen::Vector3f &approach_direction) const
+{
+  const float t = frame.axes.col(0).dot(position - frame.center) / frame.half_extents(0);
+  int position_bin = static_cast<int>(std::floor((t + 1.0f) / 2.0f * num_position_bins_));
+  position_bin = std::max(0, std::min(num_position_bins_ - 1, position_bin));
+
+  Eigen::Vector3f d = frame.axes.transpose() * approach_direction;
+  const float norm = d.norm();
+  if (norm > 0.0f)
+    d /= norm;
+  const float polar = std::acos(std::max(-1.0f, std::min(1.0f, d.z())));
+  const float azimuth = std::atan2(d.y(), d.x());
+  int polar_bin = static_cast<int>(polar / M_PI * num_polar_bins_);
+  int azimuth_bin = static_cast<int>((azimuth + M_PI) / (2.0 * M_PI) * num_azimuth_bins_);
+  polar_bin = std::max(0, std::min(num_polar_bins_ - 1, polar_bin));
+  azimuth_bin = std::max(0, std::min(num_azimuth_bins_ - 1, azimuth_bin));
+
+  const int shape_class = std::max(0, std::min(ShapeFrame::num_shape_classes - 1, frame.shape_class));
+  return ((shape_class * num_position_bins_ + position_bin) * num_polar_bins_ + polar_bin) * num_azimuth_bins_ +
+    azimuth_bin;
+}
+
+//-------------------------------------------------------------------------------
+
+void ApproachPrior::addGrasp(const ShapeFrame &frame,
+                             const Eigen::Vector3f &position,
+                             const Eigen::Vector3f &approach_direction)
+{
+  const int cell = this->cell_(frame, position, approach_direction);
+  const int shape_class = cell / (num_position_bins_ * num_polar_bins_ * num_azimuth_bins_);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  counts_[cell]++;
+  max_counts_[shape_class] = std::max(max_counts_[shape_class], counts_[cell]);
+  num_grasps_++;
+}
+
+//-------------------------------------------------------------------------------
+
+float ApproachPrior::getWeight(const ShapeFrame &frame,
+                               const Eigen::Vector3f &position,
+                               const Eigen::Vector3f &approach_direction) const
+{
+  const int cell = this->cell_(frame, position, approach_direction);
+  const int shape_class = cell / (num_position_bins_ * num_polar_bins_ * num_azimuth_bins_);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  const float share = (counts_[cell] + 1.0f) / (max_counts_[shape_class] + 1.0f);
+  return exploration_ + (1.0f - exploration_) * share;
+}
+
+//-------------------------------------------------------------------------------
+
+bool ApproachPrior::keep(const ShapeFrame &frame,
+                         const Eigen::Vector3f &position,
+                         const Eigen::Vector3f &approach_direction,
+                         boost::mt19937 &random) const
+{
+  const float weight = this->getWeight(frame, position, approach_direction);
+  boost::variate_generator<boost::mt19937&, boost::uniform_real<float> >
+    uniform(random, boost::uniform_real<float>(0.0f, 1.0f));
+  return uniform() < weight;
+}
+
+//-------------------------------------------------------------------------------
+
+unsigned int ApproachPrior::getNumGrasps() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_grasps_;
+}
+
+//-------------------------------------------------------------------------------
+
+Eigen::Vector3f sr_grasp_mesh_planner::randomPointInTriangle(const Eigen::Vector3f &a,
+                                                             const Eigen::Vector3f &b,
+                                                             const Eigen::Vector3f &c,
+                                                             boost::mt19937 &random)
+{
+  boost::variate_generator<boost::mt19937&, boost::uniform_real<float> >
+    uniform(random, boost::uniform_real<float>(0.0f, 1.0f));
+  float u = uniform();
+  float v = uniform();
+  // Fold the points of the other half of the parallelogram back into the triangle.
+  if (u + v > 1.0f)
+  {
+    u = 1.0f - u;
+    v = 1.0f - v;
+  }
+  return a + u * (b - a) + v * (c - a);
+}
+
+//-------------------------------------------------------------------------------
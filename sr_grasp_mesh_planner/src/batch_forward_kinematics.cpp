@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   batch_forward_kinematics.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Forward kinematics of the links of the hand for many joint configurations at once.
+ **/
+
+#include "sr_grasp_mesh_planner/batch_forward_kinematics.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/EndEffector/EndEffectorActor.h>
+#include <VirtualRobot/Nodes/RobotNodeRevolute.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+BatchForwardKinematics::BatchForwardKinematics(EndEffectorPtr eef, const std::string &actor_name)
+{
+  std::vector<RobotNodePtr> nodes;
+  if (actor_name.empty())
+  {
+    eef->getStatics(nodes);
+    std::vector<EndEffectorActorPtr> actors;
+    eef->getActors(actors);
+    for (size_t i = 0; i < actors.size(); i++)
+    {
+      std::vector<RobotNodePtr> actor_nodes = actors[i]->getRobotNodes();
+      nodes.insert(nodes.end(), actor_nodes.begin(), actor_nodes.end());
+    }
+  }
+  else
+  {
+    EndEffectorActorPtr actor = eef->getActor(actor_name);
+    if (!actor)
+      ROS_ERROR_STREAM("No actor " << actor_name << " in " << eef->getName() << ".");
+    else
+      nodes = actor->getRobotNodes();
+  }
+
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    if (!nodes[i]->getCollisionModel())
+      continue;
+    if (std::find(link_names_.begin(), link_names_.end(), nodes[i]->getName()) != link_names_.end())
+      continue;
+    link_frames_.push_back(this->addFrame_(nodes[i]));
+    link_names_.push_back(nodes[i]->getName());
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+int BatchForwardKinematics::addFrame_(RobotNodePtr node)
+{
+  for (size_t i = 0; i < frame_nodes_.size(); i++)
+  {
+    if (frame_nodes_[i] == node)
+      return static_cast<int>(i);
+  }
+
+  // The parents come first, so that frames can be computed in order.
+  Frame frame;
+  RobotNodePtr parent = boost::dynamic_pointer_cast<RobotNode>(node->getParent());
+  frame.parent = parent ? this->addFrame_(parent) : -1;
+
+  const Eigen::Matrix4f local = node->getLocalTransformation();
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 4; c++)
+      frame.local[4 * r + c] = local(r, c);
+
+  frame.joint = -1;
+  frame.axis[0] = frame.axis[1] = frame.axis[2] = 0.0f;
+  frame.offset = 0.0f;
+  RobotNodeRevolutePtr revolute = boost::dynamic_pointer_cast<RobotNodeRevolute>(node);
+  if (revolute)
+  {
+    const Eigen::Vector3f axis = revolute->getJointRotationAxisInJointCoordSystem().normalized();
+    for (int i = 0; i < 3; i++)
+      frame.axis[i] = axis(i);
+    frame.offset = node->getJointValueOffset();
+    frame.joint = static_cast<int>(joint_names_.size());
+    joint_names_.push_back(node->getName());
+  }
+  else if (node->isTranslationalJoint())
+  {
+    ROS_WARN_STREAM("Prismatic joint " << node->getName() << " is not supported, it is kept at its current value.");
+  }
+
+  frames_.push_back(frame);
+  frame_nodes_.push_back(node);
+  return static_cast<int>(frames_.size()) - 1;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::vector<std::string> &BatchForwardKinematics::getJointNames() const
+{
+  return joint_names_;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::vector<std::string> &BatchForwardKinematics::getLinkNames() const
+{
+  return link_names_;
+}
+
+//-------------------------------------------------------------------------------
+
+int BatchForwardKinematics::getNumJoints() const
+{
+  return static_cast<int>(joint_names_.size());
+}
+
+//-------------------------------------------------------------------------------
+
+int BatchForwardKinematics::getNumLinks() const
+{
+  return static_cast<int>(link_names_.size());
+}
+
+//-------------------------------------------------------------------------------
+
+void BatchForwardKinematics::compute(const std::vector<float> &joint_values,
+                                     int num_configurations,
+                                     std::vector<float> &poses) const
+{
+  poses.clear();
+  const int n = num_configurations;
+  if (n <= 0)
+    return;
+  if (joint_values.size() != joint_names_.size() * n)
+  {
+    ROS_ERROR_STREAM("Expected " << joint_names_.size() * n << " joint values for " << n <<
+                     " configurations, got " << joint_values.size() << ".");
+    return;
+  }
+
+  std::vector<float> frames(frames_.size() * 12 * n);
+  std::vector<float> sines(n);
+  std::vector<float> cosines(n);
+
+  for (size_t f = 0; f < frames_.size(); f++)
+  {
+    const Frame &frame = frames_[f];
+    const float *l = frame.local;
+    float *out = &frames[f * 12 * n];
+
+    // Transformation from the parent frame.
+    if (frame.parent < 0)
+    {
+      for (int e = 0; e < 12; e++)
+        std::fill(out + e * n, out + (e + 1) * n, l[e]);
+    }
+    else
+    {
+      const float *p = &frames[frame.parent * 12 * n];
+      for (int r = 0; r < 3; r++)
+      {
+        const float *p0 = p + (4 * r) * n;
+        const float *p1 = p + (4 * r + 1) * n;
+        const float *p2 = p + (4 * r + 2) * n;
+        const float *p3 = p + (4 * r + 3) * n;
+        for (int col = 0; col < 4; col++)
+        {
+          float *o = out + (4 * r + col) * n;
+          const float l0 = l[col];
+          const float l1 = l[4 + col];
+          const float l2 = l[8 + col];
+          const float l3 = (col == 3) ? 1.0f : 0.0f;
+          for (int c = 0; c < n; c++)
+            o[c] = p0[c] * l0 + p1[c] * l1 + p2[c] * l2 + p3[c] * l3;
+        }
+      }
+    }
+
+    if (frame.joint < 0)
+      continue;
+
+    // Rotation of the joint (Rodrigues), applied on the right.
+    const float *q = &joint_values[frame.joint * n];
+    for (int c = 0; c < n; c++)
+    {
+      sines[c] = std::sin(q[c] + frame.offset);
+      cosines[c] = std::cos(q[c] + frame.offset);
+    }
+
+    const float x = frame.axis[0];
+    const float y = frame.axis[1];
+    const float z = frame.axis[2];
+    for (int r = 0; r < 3; r++)
+    {
+      float *o0 = out + (4 * r) * n;
+      float *o1 = out + (4 * r + 1) * n;
+      float *o2 = out + (4 * r + 2) * n;
+      for (int c = 0; c < n; c++)
+      {
+        const float s = sines[c];
+        const float co = cosines[c];
+        const float t = 1.0f - co;
+        const float a0 = o0[c];
+        const float a1 = o1[c];
+        const float a2 = o2[c];
+        o0[c] = a0 * (t * x * x + co) + a1 * (t * x * y + s * z) + a2 * (t * x * z - s * y);
+        o1[c] = a0 * (t * x * y - s * z) + a1 * (t * y * y + co) + a2 * (t * y * z + s * x);
+        o2[c] = a0 * (t * x * z + s * y) + a1 * (t * y * z - s * x) + a2 * (t * z * z + co);
+      }
+    }
+  }
+
+  poses.resize(link_frames_.size() * 12 * n);
+  for (size_t l = 0; l < link_frames_.size(); l++)
+  {
+    const float *frame = &frames[link_frames_[l] * 12 * n];
+    std::copy(frame, frame + 12 * n, poses.begin() + l * 12 * n);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+Eigen::Matrix4f BatchForwardKinematics::getPose(const std::vector<float> &poses,
+                                                int num_configurations,
+                                                int link,
+                                                int configuration)
+{
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 4; c++)
+      pose(r, c) = poses[(link * 12 + 4 * r + c) * num_configurations + configuration];
+  return pose;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   dynamic_aabb_tree.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A tree of axis aligned boxes that are moved often (the links of the hand).
+ **/
+
+#include "sr_grasp_mesh_planner/dynamic_aabb_tree.hpp"
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+  : margin_(margin),
+    root_(-1)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+int DynamicAabbTree::addLeaf(const Eigen::Vector3f &min, const Eigen::Vector3f &max)
+{
+  const int leaf = static_cast<int>(leaf_nodes_.size());
+
+  Node node;
+  node.min = min - Eigen::Vector3f::Constant(margin_);
+  node.max = max + Eigen::Vector3f::Constant(margin_);
+  node.parent = -1;
+  node.left = -1;
+  node.right = -1;
+  node.leaf = leaf;
+  nodes_.push_back(node);
+
+  leaf_min_.push_back(min);
+  leaf_max_.push_back(max);
+  leaf_nodes_.push_back(static_cast<int>(nodes_.size()) - 1);
+
+  this->insert_(leaf_nodes_.back());
+  return leaf;
+}
+
+//-------------------------------------------------------------------------------
+
+void DynamicAabbTree::insert_(int node)
+{
+  if (root_ < 0)
+  {
+    root_ = node;
+    return;
+  }
+
+  const Eigen::Vector3f min = nodes_[node].min;
+  const Eigen::Vector3f max = nodes_[node].max;
+
+  // Go down to the child whose box grows the least.
+  int sibling = root_;
+  while (nodes_[sibling].leaf < 0)
+  {
+    const Node &inner = nodes_[sibling];
+    const Node &left = nodes_[inner.left];
+    const Node &right = nodes_[inner.right];
+    const float left_cost = area_(left.min.cwiseMin(min), left.max.cwiseMax(max)) - area_(left.min, left.max);
+    const float right_cost = area_(right.min.cwiseMin(min), right.max.cwiseMax(max)) - area_(right.min, right.max);
+    sibling = (left_cost <= right_cost) ? inner.left : inner.right;
+  }
+
+  // Replace the sibling by a new inner node with both.
+  Node inner;
+  inner.min = nodes_[sibling].min.cwiseMin(min);
+  inner.max = nodes_[sibling].max.cwiseMax(max);
+  inner.parent = nodes_[sibling].parent;
+  inner.left = sibling;
+  inner.right = node;
+  inner.leaf = -1;
+  nodes_.push_back(inner);
+  const int inner_index = static_cast<int>(nodes_.size()) - 1;
+
+  if (inner.parent < 0)
+    root_ = inner_index;
+  else if (nodes_[inner.parent].left == sibling)
+    nodes_[inner.parent].left = inner_index;
+  else
+    nodes_[inner.parent].right = inner_index;
+  nodes_[sibling].parent = inner_index;
+  nodes_[node].parent = inner_index;
+
+  this->refit_(inner.parent);
+}
+
+//-------------------------------------------------------------------------------
+
+bool DynamicAabbTree::updateLeaf(int leaf, const Eigen::Vector3f &min, const Eigen::Vector3f &max)
+{
+  leaf_min_[leaf] = min;
+  leaf_max_[leaf] = max;
+
+  Node &node = nodes_[leaf_nodes_[leaf]];
+  if ((node.min.array() <= min.array()).all() && (node.max.array() >= max.array()).all())
+    return false;
+
+  node.min = min - Eigen::Vector3f::Constant(margin_);
+  node.max = max + Eigen::Vector3f::Constant(margin_);
+  this->refit_(node.parent);
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+void DynamicAabbTree::refit_(int node)
+{
+  while (node >= 0)
+  {
+    Node &inner = nodes_[node];
+    const Eigen::Vector3f min = nodes_[inner.left].min.cwiseMin(nodes_[inner.right].min);
+    const Eigen::Vector3f max = nodes_[inner.left].max.cwiseMax(nodes_[inner.right].max);
+    if (min == inner.min && max == inner.max)
+      return;
+    inner.min = min;
+    inner.max = max;
+    node = inner.parent;
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+int DynamicAabbTree::getNumLeaves() const
+{
+  return static_cast<int>(leaf_nodes_.size());
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &DynamicAabbTree::getMin(int leaf) const
+{
+  return leaf_min_[leaf];
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &DynamicAabbTree::getMax(int leaf) const
+{
+  return leaf_max_[leaf];
+}
+
+//-------------------------------------------------------------------------------
+
+bool DynamicAabbTree::overlaps(int leaf_a, int leaf_b) const
+{
+  return overlaps_(leaf_min_[leaf_a], leaf_max_[leaf_a], leaf_min_[leaf_b], leaf_max_[leaf_b]);
+}
+
+//-------------------------------------------------------------------------------
+
+void DynamicAabbTree::query(const Eigen::Vector3f &min,
+                            const Eigen::Vector3f &max,
+                            std::vector<int> &leaves) const
+{
+  if (root_ < 0)
+    return;
+
+  stack_.clear();
+  stack_.push_back(root_);
+  while (!stack_.empty())
+  {
+    const Node &node = nodes_[stack_.back()];
+    stack_.pop_back();
+    if (!overlaps_(node.min, node.max, min, max))
+      continue;
+
+    if (node.leaf < 0)
+    {
+      stack_.push_back(node.left);
+      stack_.push_back(node.right);
+    }
+    else if (overlaps_(leaf_min_[node.leaf], leaf_max_[node.leaf], min, max))
+    {
+      leaves.push_back(node.leaf);
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+float DynamicAabbTree::area_(const Eigen::Vector3f &min, const Eigen::Vector3f &max)
+{
+  const Eigen::Vector3f d = max - min;
+  return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+//-------------------------------------------------------------------------------
+
+bool DynamicAabbTree::overlaps_(const Eigen::Vector3f &min_a, const Eigen::Vector3f &max_a,
+                                const Eigen::Vector3f &min_b, const Eigen::Vector3f &max_b)
+{
+  return (min_a.array() <= max_b.array()).all() && (min_b.array() <= max_a.array()).all();
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   flight_recorder.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Keep the trace of the last goals in memory, and save the slow or failed ones.
+ **/
+
+#include "sr_grasp_mesh_planner/flight_recorder.hpp"
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+FlightRecorder::FlightRecorder(int num_goals,
+                               double latency_threshold,
+                               const std::string &directory)
+  : latency_threshold_(latency_threshold),
+    directory_(directory),
+    records_(std::max(num_goals, 1)),
+    next_id_(1)
+{
+  for (size_t i = 0; i < records_.size(); i++)
+    records_[i].id = 0;
+}
+
+//-------------------------------------------------------------------------------
+
+unsigned int FlightRecorder::begin(const std::string &goal_id,
+                                   const sr_robot_msgs::PlanGraspGoalConstPtr &goal,
+                                   unsigned int seed,
+                                   const std::string &config)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const unsigned int id = next_id_++;
+  if (next_id_ == 0)
+    next_id_ = 1;
+
+  Record &record = records_[id % records_.size()];
+  record.id = id;
+  record.goal_id = goal_id;
+  record.goal = goal;
+  record.seed = seed;
+  record.config = config;
+  record.approach_prior.reset();
+  record.start = ros::WallTime::now();
+  record.latency = 0.0;
+  record.outcome.clear();
+  record.num_grasps = 0;
+  record.num_spans = 0;
+  record.dropped_spans = 0;
+  return id;
+}
+
+//-------------------------------------------------------------------------------
+
+FlightRecorder::Record *FlightRecorder::find_(unsigned int record)
+{
+  Record &slot = records_[record % records_.size()];
+  return (record != 0 && slot.id == record) ? &slot : NULL;
+}
+
+//-------------------------------------------------------------------------------
+
+void FlightRecorder::setApproachPrior(unsigned int record, const ApproachPriorPtr &snapshot)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Record *slot = this->find_(record);
+  if (slot)
+    slot->approach_prior = snapshot;
+}
+
+//-------------------------------------------------------------------------------
+
+void FlightRecorder::addSpan(unsigned int record,
+                             const char *name,
+                             const ros::WallTime &start,
+                             const ros::WallTime &end)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Record *slot = this->find_(record);
+  if (!slot)
+    return;
+  if (slot->num_spans >= max_spans)
+  {
+    slot->dropped_spans++;
+    return;
+  }
+
+  Span &span = slot->spans[slot->num_spans++];
+  span.name = name;
+  span.start = start;
+  span.end = end;
+  span.thread = boost::this_thread::get_id();
+}
+
+//-------------------------------------------------------------------------------
+
+std::string FlightRecorder::end(unsigned int record,
+                                bool succeeded,
+                                const std::string &outcome,
+                                int num_grasps)
+{
+  Record saved;
+  std::ostringstream others;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    Record *slot = this->find_(record);
+    if (!slot)
+      return "";
+    slot->latency = std::max((ros::WallTime::now() - slot->start).toSec(), 1.0e-9);
+    slot->outcome = outcome;
+    slot->num_grasps = num_grasps;
+    if (succeeded && slot->latency <= latency_threshold_)
+      return "";
+
+    // Only the slow or failed goals pay for a copy.
+    saved = *slot;
+    for (size_t i = 0; i < records_.size(); i++)
+    {
+      const Record &other = records_[i];
+      if (other.id == 0 || other.id == record)
+        continue;
+      others << "  " << other.goal_id << ": ";
+      if (other.latency > 0.0)
+        others << other.latency * 1000.0 << " ms, " << other.outcome;
+      else
+        others << "running for " << (saved.start - other.start).toSec() * 1000.0 << " ms at its start";
+      others << std::endl;
+    }
+  }
+
+  std::ostringstream name;
+  name << directory_ << "/" << std::fixed << std::setprecision(0) << saved.start.toSec() * 1000.0 << "_" << saved.id;
+  const std::string directory = name.str();
+  if (!this->save_(saved, directory))
+    return "";
+
+  std::ofstream summary((directory + "/summary.txt").c_str(), std::ios::app);
+  summary << std::endl << "Other recorded goals:" << std::endl << others.str();
+
+  ROS_WARN_STREAM("Goal " << saved.goal_id << " " << saved.outcome << " in " << saved.latency * 1000.0 <<
+                  " ms, saved to " << directory << ".");
+  return directory;
+}
+
+//-------------------------------------------------------------------------------
+
+bool FlightRecorder::save_(const Record &record, const std::string &directory) const
+{
+  boost::system::error_code error;
+  boost::filesystem::create_directories(directory, error);
+  if (error)
+  {
+    ROS_ERROR_STREAM("Could not create " << directory << ": " << error.message() << ".");
+    return false;
+  }
+
+  // The goal, as sent by the client.
+  if (record.goal)
+  {
+    const uint32_t size = ros::serialization::serializationLength(*record.goal);
+    std::vector<uint8_t> buffer(size);
+    ros::serialization::OStream stream(buffer.empty() ? NULL : &buffer[0], size);
+    ros::serialization::serialize(stream, *record.goal);
+    std::ofstream goal_file((directory + "/goal.bin").c_str(), std::ios::binary);
+    goal_file.write(reinterpret_cast<const char *>(buffer.empty() ? NULL : &buffer[0]), size);
+  }
+
+  std::ofstream config_file((directory + "/config.yaml").c_str());
+  config_file << record.config;
+
+  // Given to the planner by replay_flight, in place of its own prior.
+  if (record.approach_prior && !record.approach_prior->save(directory + "/approach_prior.bin"))
+    ROS_WARN_STREAM("Could not save the approach prior to " << directory << ".");
+
+  // Threads are numbered in the order of their first span.
+  std::map<boost::thread::id, int> threads;
+  std::ofstream trace((directory + "/trace.json").c_str());
+  trace << "{\"traceEvents\": [" << std::endl;
+  for (int i = 0; i < record.num_spans; i++)
+  {
+    const Span &span = record.spans[i];
+    if (!threads.count(span.thread))
+    {
+      const int n = static_cast<int>(threads.size());
+      threads[span.thread] = n;
+    }
+    trace << "  {\"name\": \"" << span.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << threads[span.thread] <<
+             ", \"ts\": " << std::fixed << std::setprecision(0) << (span.start - record.start).toSec() * 1.0e6 <<
+             ", \"dur\": " << (span.end - span.start).toSec() * 1.0e6 << "}" <<
+             (i + 1 < record.num_spans ? "," : "") << std::endl;
+  }
+  trace << "]}" << std::endl;
+
+  std::ofstream summary((directory + "/summary.txt").c_str());
+  summary << "Goal: " << record.goal_id << std::endl;
+  summary << "Outcome: " << record.outcome << ", " << record.num_grasps << " grasp(s)" << std::endl;
+  summary << "Latency: " << record.latency * 1000.0 << " ms (threshold " << latency_threshold_ * 1000.0 <<
+             " ms)" << std::endl;
+  summary << "Seed: " << record.seed << std::endl;
+  if (record.approach_prior)
+    summary << "Approach prior: " << record.approach_prior->getNumGrasps() << " grasp(s)" << std::endl;
+  if (record.goal)
+    summary << "Mesh: " << record.goal->object.bounding_mesh.vertices.size() << " vertices, " <<
+               record.goal->object.bounding_mesh.triangles.size() << " triangles" << std::endl;
+  summary << std::endl << "Spans (ms from the start of the goal):" << std::endl;
+  for (int i = 0; i < record.num_spans; i++)
+  {
+    const Span &span = record.spans[i];
+    summary << "  " << std::setw(24) << std::left << span.name << std::right << std::fixed << std::setprecision(3) <<
+               std::setw(12) << (span.start - record.start).toSec() * 1000.0 <<
+               std::setw(12) << (span.end - span.start).toSec() * 1000.0 << std::endl;
+  }
+  if (record.dropped_spans > 0)
+    summary << "  (" << record.dropped_spans << " more spans not kept)" << std::endl;
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+FlightRecorder::ScopedSpan::ScopedSpan(FlightRecorder *recorder, unsigned int record, const char *name)
+  : recorder_(recorder),
+    record_(record),
+    name_(name),
+    start_(ros::WallTime::now())
+{
+}
+
+//-------------------------------------------------------------------------------
+
+FlightRecorder::ScopedSpan::~ScopedSpan()
+{
+  if (recorder_)
+    recorder_->addSpan(record_, name_, start_, ros::WallTime::now());
+}
+
+//-------------------------------------------------------------------------------
@@ -13,10 +13,14 @@
  **/
 
 #include "sr_grasp_mesh_planner/grasp_action_server.hpp"
-#include "sr_grasp_mesh_planner/grasp_planner_window.hpp"
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <iostream>
+#include <sstream>
 #include <boost/assign/list_of.hpp>
 #include <VirtualRobot/VirtualRobot.h>
 #include <VirtualRobot/RuntimeEnvironment.h>
@@ -27,30 +31,80 @@ using namespace sr_grasp_mesh_planner;
 
 //-------------------------------------------------------------------------------
 
+namespace
+{
+
+// Best first.
+bool compareGraspMsgQuality(const moveit_msgs::Grasp &a, const moveit_msgs::Grasp &b)
+{
+  return a.grasp_quality > b.grasp_quality;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
 const bool GraspActionServer::auto_start_ = true;
+const std::size_t GraspActionServer::max_prepared_goals_ = 2;
 
 //-------------------------------------------------------------------------------
 
 /*
  * This constructor uses actionlib!
  * Note that node_name is used as the action name.
- * Parameters max_grasps_ etc will be set in GraspActionServer::config_cb_.
+ * Parameters max_grasps etc will be set in GraspActionServer::config_cb_.
  */
 GraspActionServer::GraspActionServer(std::string node_name,
-                                     boost::shared_ptr<GraspPlannerWindow> grasp_win)
+                                     MeshGraspPlannerPtr grasp_planner)
   : nh_("~"),
     action_name_(node_name),
     as_mesh_(nh_,
              action_name_,
              boost::bind(&GraspActionServer::goal_cb_, this, _1),
+             boost::bind(&GraspActionServer::cancel_cb_, this, _1),
              !GraspActionServer::auto_start_),
-    grasp_win_(grasp_win)
+    grasp_planner_(grasp_planner),
+    num_goals_(0),
+    grasp_cache_(new GraspCache()),
+    shutdown_(false)
 {
+  // Keep the last goals in memory, and save the ones that are slow or fail.
+  int flight_recorder_goals = 16;
+  double flight_recorder_threshold = 10.0;
+  const char *home = std::getenv("HOME");
+  std::string flight_recorder_dir = std::string(home ? home : "/tmp") + "/.ros/sr_grasp_mesh_planner_flights";
+  nh_.param("flight_recorder_goals", flight_recorder_goals, flight_recorder_goals);
+  nh_.param("flight_recorder_threshold", flight_recorder_threshold, flight_recorder_threshold);
+  nh_.param("flight_recorder_dir", flight_recorder_dir, flight_recorder_dir);
+  if (flight_recorder_goals > 0)
+    flight_recorder_.reset(new FlightRecorder(flight_recorder_goals, flight_recorder_threshold, flight_recorder_dir));
+
+  speculative_planner_.reset(new SpeculativePlanner(nh_, grasp_planner_, grasp_cache_));
+
+  effective_quality_pub_ = nh_.advertise<std_msgs::Float32>("effective_min_quality", 1, true);
+
   // Set up dynamic_reconfigure.
   config_server_.setCallback( boost::bind(&GraspActionServer::config_cb_, this, _1, _2) );
 
-  feedback_mesh_.reset(new sr_robot_msgs::PlanGraspFeedback);
-  result_mesh_.reset(new sr_robot_msgs::PlanGraspResult);
+  // Prepare the known objects now, so that their goals do not wait for it.
+  std::string model_registry;
+  nh_.param<std::string>("model_registry", model_registry, "");
+  if (!model_registry.empty())
+  {
+    model_registry_.reset(new ModelRegistry);
+    model_registry_->load(model_registry);
+    const std::vector<std::string> keys = model_registry_->getKeys();
+    const int approach_movement = this->get_config_().approach_movement;
+    const ros::WallTime start = ros::WallTime::now();
+    for (size_t i = 0; i < keys.size(); i++)
+      this->prepare_model_(model_registry_->find(keys[i]), object_recognition_msgs::RecognizedObject(),
+                           approach_movement);
+    ROS_INFO_STREAM("Action " << action_name_ << ": " << keys.size() << " registered model(s) prepared in " <<
+                    (ros::WallTime::now() - start).toSec() * 1000.0 << " ms.");
+  }
+
+  prepare_thread_.reset(new boost::thread(boost::bind(&GraspActionServer::prepare_loop_, this)));
+  plan_thread_.reset(new boost::thread(boost::bind(&GraspActionServer::plan_loop_, this)));
 
   as_mesh_.start();
   ROS_INFO_STREAM("Action server " << action_name_ << " just started.");
@@ -60,6 +114,13 @@ GraspActionServer::GraspActionServer(std::string node_name,
 
 GraspActionServer::~GraspActionServer()
 {
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    shutdown_ = true;
+  }
+  queue_cond_.notify_all();
+  prepare_thread_->join();
+  plan_thread_->join();
 }
 
 //-------------------------------------------------------------------------------
@@ -67,70 +128,455 @@ GraspActionServer::~GraspActionServer()
 void GraspActionServer::config_cb_(sr_grasp_mesh_planner::PlannerConfig &config,
                                   uint32_t level)
 {
-  max_grasps_        = config.max_grasps;
-  timeout_one_grasp_ = config.timeout_one_grasp;
-  min_quality_       = config.min_quality;
-  force_closure_     = config.force_closure;
-  approach_movement_ = config.approach_movement;
+  // The goals already accepted keep the configuration they were accepted with.
+  {
+    boost::mutex::scoped_lock lock(config_mutex_);
+    config_ = config;
+  }
+
+  grasp_planner_->setApproachDistances(config.approach_distance, config.min_approach_distance);
+  grasp_planner_->setHands(config.hands);
+  grasp_planner_->setReplayApproachPrior(config.replay_approach_prior);
+
+  RobustnessJob::Settings robustness;
+  robustness.num_samples = config.robustness_samples;
+  robustness.position_noise = config.robustness_position_noise;
+  robustness.rotation_noise = config.robustness_rotation_noise;
+  robustness.budget = config.robustness_budget;
+  grasp_planner_->setRobustness(robustness);
+
+  speculative_planner_->set_config(config.speculative_planning,
+                                   config.max_grasps,
+                                   config.speculation_timeout,
+                                   config.min_quality,
+                                   config.force_closure,
+                                   config.approach_movement);
 }
 
 //-------------------------------------------------------------------------------
 
-void GraspActionServer::goal_cb_(const sr_robot_msgs::PlanGraspGoalConstPtr &goal)
+void GraspActionServer::goal_cb_(GoalHandle goal_handle)
 {
-  bool success = true;
+  goal_handle.setAccepted();
+
+  // A goal without a mesh is served from the model registered for its type.
+  QueuedGoal queued;
+  const object_recognition_msgs::RecognizedObject &object = goal_handle.getGoal()->object;
+  if (object.bounding_mesh.triangles.empty())
+  {
+    if (model_registry_)
+      queued.model = model_registry_->find(object.type.key);
+    if (!queued.model)
+    {
+      ROS_ERROR_STREAM("Action " << action_name_ << ": The goal has no mesh, and no model is registered for \"" <<
+                       object.type.key << "\".");
+      goal_handle.setAborted(sr_robot_msgs::PlanGraspResult(), "No mesh, and no registered model for the type key.");
+      if (flight_recorder_)
+      {
+        const sr_grasp_mesh_planner::PlannerConfig config = this->get_config_();
+        const unsigned int record = flight_recorder_->begin(goal_handle.getGoalID().id,
+                                                            goal_handle.getGoal(),
+                                                            config.seed,
+                                                            config_yaml_(config, config.seed));
+        flight_recorder_->end(record, false, "aborted: no mesh and no registered model", 0);
+      }
+      return;
+    }
+  }
+
+  // Speculative planning must not start a new object while goals are waiting.
+  speculative_planner_->pause();
+
+  queued.goal_handle = goal_handle;
+  queued.mesh_key = queued.model ? queued.model->mesh_key : MeshObstacle::hash_mesh(object.bounding_mesh);
+  queued.grasp_key = grasp_planner_->getGraspKey(queued.mesh_key, object.pose);
+  queued.config = this->get_config_();
+  queued.accepted = ros::WallTime::now();
+  // Kept positive, so that it can be set back with dynparam load for a replay.
+  queued.seed = (queued.config.seed != 0) ? static_cast<unsigned int>(queued.config.seed)
+    : ((static_cast<unsigned int>(queued.accepted.toNSec()) + num_goals_++) & 0x7fffffffu);
+  queued.record = 0;
+  if (flight_recorder_)
+    queued.record = flight_recorder_->begin(goal_handle.getGoalID().id,
+                                            goal_handle.getGoal(),
+                                            queued.seed,
+                                            config_yaml_(queued.config, queued.seed));
+
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    pending_goals_.push_back(queued);
+    ROS_INFO_STREAM("Action " << action_name_ << ": Goal queued, " <<
+                    pending_goals_.size() + prepared_goals_.size() << " goal(s) waiting.");
+  }
+  queue_cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspActionServer::cancel_cb_(GoalHandle goal_handle)
+{
+  // The goal is canceled by the stage it is in (see is_canceled_).
+  ROS_INFO("%s: Cancel requested", action_name_.c_str());
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspActionServer::is_canceled_(GoalHandle &goal_handle)
+{
+  const uint8_t status = goal_handle.getGoalStatus().status;
+  return (status == actionlib_msgs::GoalStatus::PREEMPTING ||
+          status == actionlib_msgs::GoalStatus::RECALLING);
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspActionServer::prepare_loop_()
+{
+  boost::mutex::scoped_lock lock(queue_mutex_);
+  while (!shutdown_)
+  {
+    // Do not prepare too far ahead, prepared objects are not small.
+    while (!shutdown_ && (pending_goals_.empty() || prepared_goals_.size() >= max_prepared_goals_))
+      queue_cond_.wait(lock);
+    if (shutdown_)
+      break;
+
+    QueuedGoal queued = pending_goals_.front();
+    pending_goals_.pop_front();
+    if (flight_recorder_)
+      flight_recorder_->addSpan(queued.record, "queued", queued.accepted, ros::WallTime::now());
+
+    // Share the object prepared for an earlier goal on the same mesh, at the pose of this goal.
+    const bool use_cache = queued.config.use_cache;
+    for (size_t i = 0; use_cache && i < prepared_goals_.size() && !queued.prepared; i++)
+    {
+      if (prepared_goals_[i].mesh_key == queued.mesh_key && prepared_goals_[i].prepared)
+        queued.prepared = place_object_(prepared_goals_[i].prepared, queued.goal_handle.getGoal()->object);
+    }
+
+    const int approach_movement = queued.config.approach_movement;
+    std::size_t num_cached = 0;
+    if (use_cache)
+      num_cached = grasp_cache_->count(queued.grasp_key, queued.config.force_closure, queued.config.min_quality);
+    const bool needs_object = (num_cached < static_cast<std::size_t>(queued.config.max_grasps) &&
+                               (!use_cache || grasp_planner_->getObjectKey() != queued.mesh_key));
+
+    lock.unlock();
+
+    if (!queued.prepared && needs_object && !is_canceled_(queued.goal_handle))
+    {
+      ros::WallTime start = ros::WallTime::now();
+      if (queued.model)
+        queued.prepared = this->prepare_model_(queued.model, queued.goal_handle.getGoal()->object, approach_movement,
+                                               use_cache);
+      else
+        queued.prepared = grasp_planner_->prepareObject(queued.goal_handle.getGoal()->object, approach_movement);
+      const ros::WallTime end = ros::WallTime::now();
+      ROS_INFO_STREAM("Action " << action_name_ << ": Object prepared in " <<
+                      (end - start).toSec() * 1000.0 << " ms.");
+      if (flight_recorder_)
+        flight_recorder_->addSpan(queued.record, "prepare object", start, end);
+    }
+
+    lock.lock();
+    queued.prepared_at = ros::WallTime::now();
+    prepared_goals_.push_back(queued);
+    queue_cond_.notify_all();
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspActionServer::plan_loop_()
+{
+  boost::mutex::scoped_lock lock(queue_mutex_);
+  while (!shutdown_)
+  {
+    while (!shutdown_ && prepared_goals_.empty())
+      queue_cond_.wait(lock);
+    if (shutdown_)
+      break;
+
+    QueuedGoal queued = prepared_goals_.front();
+    prepared_goals_.pop_front();
+    // The preparation stage may move on to the next goal.
+    queue_cond_.notify_all();
 
-  // Construct an object from the given triangle mesh model (for the grasp planner).
-  grasp_win_->loadObject(goal->object, approach_movement_);
-  grasp_win_->buildVisu();
+    lock.unlock();
+    if (flight_recorder_)
+      flight_recorder_->addSpan(queued.record, "wait for planner", queued.prepared_at, ros::WallTime::now());
+    this->plan_goal_(queued);
+    speculative_planner_->resume();
+    lock.lock();
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspActionServer::plan_goal_(QueuedGoal &queued)
+{
+  GoalHandle &goal_handle = queued.goal_handle;
+  sr_robot_msgs::PlanGraspGoalConstPtr goal = goal_handle.getGoal();
+  const sr_grasp_mesh_planner::PlannerConfig &config = queued.config;
+
+  boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh(new sr_robot_msgs::PlanGraspFeedback);
+  boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh(new sr_robot_msgs::PlanGraspResult);
 
   // Init the actionlib feedback and result data.
-  feedback_mesh_->number_of_synthesized_grasps = 0;
-  result_mesh_->grasps.clear();
+  feedback_mesh->number_of_synthesized_grasps = 0;
+  result_mesh->grasps.clear();
+
+  if (is_canceled_(goal_handle) || !ros::ok())
+  {
+    goal_handle.setCanceled(*result_mesh);
+    ROS_INFO("%s: Canceled before planning", action_name_.c_str());
+    if (flight_recorder_)
+      flight_recorder_->end(queued.record, false, "canceled before planning", 0);
+    return;
+  }
 
   // publish info to the console for the user
-  ROS_INFO_STREAM("Action " << action_name_ << ": Executing GraspActionServer::goal_cb_");
+  ROS_INFO_STREAM("Action " << action_name_ << ": Executing GraspActionServer::plan_goal_");
+
+  bool success = true;
+
+  // Serve as many grasps as possible from the ones planned ahead of time, for this mesh at this pose.
+  const std::size_t mesh_key = queued.mesh_key;
+  const ros::WallTime lookup_start = ros::WallTime::now();
+  std::size_t num_cached = 0;
+  if (config.use_cache)
+    num_cached = grasp_cache_->lookup(queued.grasp_key,
+                                      config.force_closure,
+                                      config.min_quality,
+                                      config.max_grasps,
+                                      result_mesh->grasps);
+  if (flight_recorder_)
+    flight_recorder_->addSpan(queued.record, "cache lookup", lookup_start, ros::WallTime::now());
+  if (num_cached > 0)
+  {
+    const ros::Time now = ros::Time::now();
+    for (size_t i = 0; i < result_mesh->grasps.size(); i++)
+    {
+      result_mesh->grasps[i].grasp_pose.header.stamp = now;
+      result_mesh->grasps[i].pre_grasp_posture.header.stamp = now;
+      result_mesh->grasps[i].grasp_posture.header.stamp = now;
+    }
+    feedback_mesh->number_of_synthesized_grasps = num_cached;
+    goal_handle.publishFeedback(*feedback_mesh);
+    ROS_INFO_STREAM("Action " << action_name_ << ": " << num_cached << " grasp(s) served from the cache.");
+  }
 
   // *** start executing the action ***
 
-  /*
-   * GraspPlannerWindow::plan can generate multiple grasps.
-   * However, we always generate a single grasp in the method.
-   * Therefore the number grasp sets is equal to the number of grasps.
-   */
-  const int num_of_desired_grasp_sets = max_grasps_;
-  for (size_t i = 0; i < num_of_desired_grasp_sets; i++)
+  if (num_cached < static_cast<std::size_t>(config.max_grasps))
   {
-    // Synthesize grasps.
-    grasp_win_->plan(force_closure_,
-                     timeout_one_grasp_,
-                     min_quality_,
-                     feedback_mesh_,
-                     result_mesh_);
-
-    // check that preempt has not been requested by the client
-    if (as_mesh_.isPreemptRequested() || !ros::ok())
+    // Use the object built by the preparation stage. The object may also have been
+    // loaded already by an earlier goal, it is then moved to the pose of this goal.
     {
-      ROS_INFO("%s: Preempted", action_name_.c_str());
-      // set the action state to preempted
-      as_mesh_.setPreempted();
-      success = false;
-      ROS_INFO("%s: Preempted", action_name_.c_str());
-      break;
+      FlightRecorder::ScopedSpan span(flight_recorder_.get(), queued.record, "load object");
+      PreparedObjectPtr loaded = grasp_planner_->getObject();
+      if (queued.prepared)
+        grasp_planner_->setObject(queued.prepared);
+      else if (config.use_cache && loaded && loaded->key == mesh_key &&
+               loaded->approach_movement == config.approach_movement)
+        grasp_planner_->setObject(place_object_(loaded, goal->object));
+      else if (queued.model)
+        grasp_planner_->setObject(this->prepare_model_(queued.model, goal->object, config.approach_movement,
+                                                       config.use_cache));
+      else
+        grasp_planner_->loadObject(goal->object, config.approach_movement);
+    }
+
+    // The prior keeps learning from later goals: a replay needs it as it is now. A copy of a
+    // few kilobytes, kept by the recorder only if the goal is saved.
+    const ApproachPriorPtr approach_prior = grasp_planner_->getObject()->approach_prior;
+    if (flight_recorder_ && approach_prior)
+      flight_recorder_->setApproachPrior(queued.record, approach_prior->clone());
+
+    /*
+     * MeshGraspPlanner::plan can generate multiple grasps.
+     * However, we always generate a single grasp in the method.
+     * Therefore the number grasp sets is equal to the number of grasps.
+     */
+    const int num_of_desired_grasp_sets = config.max_grasps - num_cached;
+
+    // In adaptive mode, all the grasps share the latency budget.
+    AdaptiveQualityThresholdPtr threshold;
+    if (config.adaptive_quality)
+    {
+      threshold.reset(new AdaptiveQualityThreshold(config.min_quality_floor));
+      threshold->start(num_of_desired_grasp_sets, config.latency_budget);
+    }
+
+    // The new grasps, in the order of their messages in the result.
+    std::vector<VirtualRobot::GraspPtr> new_grasps;
+    for (size_t i = 0; i < num_of_desired_grasp_sets; i++)
+    {
+      float timeout = config.timeout_one_grasp;
+      float min_quality = config.min_quality;
+      if (threshold)
+      {
+        timeout = threshold->getRemainingTime();
+        if (timeout <= 0.0f)
+        {
+          ROS_INFO_STREAM("Action " << action_name_ << ": Latency budget spent.");
+          break;
+        }
+        min_quality = threshold->getThreshold();
+      }
+
+      // Synthesize grasps.
+      {
+        FlightRecorder::ScopedSpan span(flight_recorder_.get(), queued.record, "plan grasp");
+        // The seed is saved with the goal by the flight recorder. With one worker (~num_threads),
+        // a replay draws the same approach poses.
+        std::vector<VirtualRobot::GraspPtr> grasps = grasp_planner_->plan(config.force_closure,
+                                                                          timeout,
+                                                                          min_quality,
+                                                                          queued.seed + static_cast<unsigned int>(i),
+                                                                          feedback_mesh,
+                                                                          result_mesh,
+                                                                          threshold);
+        new_grasps.insert(new_grasps.end(), grasps.begin(), grasps.end());
+      }
+
+      // Report the minimum quality the grasp had to pass.
+      std_msgs::Float32 effective_quality;
+      effective_quality.data = threshold ? threshold->getThreshold() : config.min_quality;
+      effective_quality_pub_.publish(effective_quality);
+      if (threshold)
+        ROS_INFO_STREAM("Action " << action_name_ << ": Effective minimum quality " << effective_quality.data << ".");
+
+      // check that preempt has not been requested by the client
+      if (is_canceled_(goal_handle) || !ros::ok())
+      {
+        ROS_INFO("%s: Preempted", action_name_.c_str());
+        // set the action state to preempted
+        goal_handle.setCanceled(*result_mesh);
+        success = false;
+        break;
+      }
+
+      // publish the feedback
+      goal_handle.publishFeedback(*feedback_mesh);
+      ROS_INFO_STREAM("feedback_mesh->number_of_synthesized_grasps = " <<
+                      feedback_mesh->number_of_synthesized_grasps);
     }
 
-    // publish the feedback
-    as_mesh_.publishFeedback(*feedback_mesh_);
-    ROS_INFO_STREAM("feedback_mesh_->number_of_synthesized_grasps = " <<
-                    feedback_mesh_->number_of_synthesized_grasps);
+    // Each grasp was planned on its own: score the new ones together, then rank them by their scores.
+    if (config.robustness_samples > 0 && success)
+    {
+      {
+        FlightRecorder::ScopedSpan span(flight_recorder_.get(), queued.record, "robustness");
+        grasp_planner_->scoreGrasps(new_grasps, config.force_closure, queued.seed,
+                                    result_mesh->grasps.begin() + num_cached);
+      }
+      std::stable_sort(result_mesh->grasps.begin() + num_cached, result_mesh->grasps.end(), compareGraspMsgQuality);
+    }
+
+    // Keep the new grasps for later goals on the same object, unless they could not be scored
+    // or the goal is replayed.
+    if (config.use_cache && (config.robustness_samples == 0 || success))
+    {
+      std::vector<moveit_msgs::Grasp> planned(result_mesh->grasps.begin() + num_cached,
+                                              result_mesh->grasps.end());
+      grasp_cache_->insert(queued.grasp_key, config.force_closure, planned);
+    }
   }
 
   if (success)
   {
     // set the action state to succeeded
-    as_mesh_.setSucceeded(*result_mesh_);
+    goal_handle.setSucceeded(*result_mesh);
     ROS_INFO_STREAM("Action " << action_name_ << ": Succeeded");
   }
+
+  // Saved once the result is sent, and once per goal rather than per grasp.
+  if (num_cached < static_cast<std::size_t>(config.max_grasps))
+    grasp_planner_->saveApproachPrior();
+
+  // Recorded once the result is sent, so that saving a slow goal does not delay it more.
+  if (flight_recorder_)
+  {
+    const int num_grasps = static_cast<int>(result_mesh->grasps.size());
+    std::ostringstream outcome;
+    if (!success)
+      outcome << "canceled";
+    else if (num_grasps < config.max_grasps)
+      outcome << "succeeded with " << num_grasps << " of " << config.max_grasps << " grasps";
+    else
+      outcome << "succeeded";
+    flight_recorder_->end(queued.record, success && num_grasps >= config.max_grasps, outcome.str(), num_grasps);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr GraspActionServer::prepare_model_(const ModelRegistry::ModelConstPtr &model,
+                                                    const object_recognition_msgs::RecognizedObject &object,
+                                                    int approach_movement,
+                                                    bool use_cache)
+{
+  PreparedObjectPtr prepared;
+  if (use_cache)
+    prepared = model_registry_->getPrepared(model->key, approach_movement);
+  if (!prepared)
+  {
+    prepared = grasp_planner_->prepareObject(MeshObstacle::create_tri_mesh(model->mesh),
+                                             approach_movement,
+                                             model->mesh_key);
+    if (use_cache)
+      model_registry_->setPrepared(model->key, prepared);
+  }
+
+  return place_object_(prepared, object);
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr GraspActionServer::place_object_(PreparedObjectPtr prepared,
+                                                   const object_recognition_msgs::RecognizedObject &object)
+{
+  PreparedObjectPtr placed(new PreparedObject(*prepared));
+  setRecognizedPose(*placed, object.pose);
+  return placed;
+}
+
+//-------------------------------------------------------------------------------
+
+sr_grasp_mesh_planner::PlannerConfig GraspActionServer::get_config_() const
+{
+  boost::mutex::scoped_lock lock(config_mutex_);
+  return config_;
+}
+
+//-------------------------------------------------------------------------------
+
+std::string GraspActionServer::config_yaml_(const sr_grasp_mesh_planner::PlannerConfig &config, unsigned int seed)
+{
+  // The format of dynparam dump, for dynparam load.
+  std::ostringstream yaml;
+  yaml << "max_grasps: " << config.max_grasps << std::endl;
+  yaml << "timeout_one_grasp: " << config.timeout_one_grasp << std::endl;
+  yaml << "min_quality: " << config.min_quality << std::endl;
+  yaml << "adaptive_quality: " << (config.adaptive_quality ? "true" : "false") << std::endl;
+  yaml << "latency_budget: " << config.latency_budget << std::endl;
+  yaml << "min_quality_floor: " << config.min_quality_floor << std::endl;
+  yaml << "force_closure: " << (config.force_closure ? "true" : "false") << std::endl;
+  yaml << "approach_movement: " << config.approach_movement << std::endl;
+  yaml << "approach_distance: " << config.approach_distance << std::endl;
+  yaml << "min_approach_distance: " << config.min_approach_distance << std::endl;
+  yaml << "robustness_samples: " << config.robustness_samples << std::endl;
+  yaml << "robustness_position_noise: " << config.robustness_position_noise << std::endl;
+  yaml << "robustness_rotation_noise: " << config.robustness_rotation_noise << std::endl;
+  yaml << "robustness_budget: " << config.robustness_budget << std::endl;
+  yaml << "hands: '" << config.hands << "'" << std::endl;
+  yaml << "speculative_planning: " << (config.speculative_planning ? "true" : "false") << std::endl;
+  yaml << "speculation_timeout: " << config.speculation_timeout << std::endl;
+  yaml << "seed: " << seed << std::endl;
+  yaml << "use_cache: " << (config.use_cache ? "true" : "false") << std::endl;
+  yaml << "replay_approach_prior: '" << config.replay_approach_prior << "'" << std::endl;
+  return yaml.str();
 }
 
 //-------------------------------------------------------------------------------
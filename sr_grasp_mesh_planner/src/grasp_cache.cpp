@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_cache.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A thread safe cache of the grasps planned for object meshes.
+ **/
+
+#include "sr_grasp_mesh_planner/grasp_cache.hpp"
+
+#include <algorithm>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+GraspCache::GraspCache(std::size_t max_objects)
+  : max_objects_(std::max<std::size_t>(max_objects, 1))
+{
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspCache::insert(std::size_t mesh_key,
+                        bool force_closure,
+                        const std::vector<moveit_msgs::Grasp> &grasps)
+{
+  if (grasps.empty())
+    return;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::map<std::size_t, CachedGrasps>::iterator it = grasps_.find(mesh_key);
+  if (it == grasps_.end())
+  {
+    // Evict the oldest object.
+    if (keys_.size() >= max_objects_)
+    {
+      grasps_.erase(keys_.front());
+      keys_.pop_front();
+    }
+    keys_.push_back(mesh_key);
+    it = grasps_.insert(std::make_pair(mesh_key, CachedGrasps())).first;
+  }
+
+  for (size_t i = 0; i < grasps.size(); i++)
+  {
+    CachedGrasp cached;
+    cached.grasp = grasps[i];
+    cached.force_closure = force_closure;
+    it->second.push_back(cached);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t GraspCache::count(std::size_t mesh_key,
+                              bool force_closure,
+                              float min_quality) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::map<std::size_t, CachedGrasps>::const_iterator it = grasps_.find(mesh_key);
+  if (it == grasps_.end())
+    return 0;
+
+  std::size_t n = 0;
+  for (size_t i = 0; i < it->second.size(); i++)
+  {
+    if (satisfies_(it->second[i], force_closure, min_quality))
+      n++;
+  }
+  return n;
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t GraspCache::lookup(std::size_t mesh_key,
+                               bool force_closure,
+                               float min_quality,
+                               std::size_t max_grasps,
+                               std::vector<moveit_msgs::Grasp> &grasps) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::map<std::size_t, CachedGrasps>::const_iterator it = grasps_.find(mesh_key);
+  if (it == grasps_.end())
+    return 0;
+
+  std::size_t n = 0;
+  for (size_t i = 0; i < it->second.size() && n < max_grasps; i++)
+  {
+    if (satisfies_(it->second[i], force_closure, min_quality))
+    {
+      grasps.push_back(it->second[i].grasp);
+      n++;
+    }
+  }
+  return n;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspCache::clear()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  grasps_.clear();
+  keys_.clear();
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspCache::satisfies_(const CachedGrasp &cached, bool force_closure, float min_quality)
+{
+  // Grasps planned with the force closure constraint also satisfy goals without it.
+  if (force_closure && !cached.force_closure)
+    return false;
+  return cached.grasp.grasp_quality >= min_quality;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_marker_publisher.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The scene of the planner as RViz markers.
+ **/
+
+#include "sr_grasp_mesh_planner/grasp_marker_publisher.hpp"
+
+#include <VirtualRobot/CollisionDetection/CollisionModel.h>
+#include <VirtualRobot/Visualization/TriMeshModel.h>
+
+#include <visualization_msgs/MarkerArray.h>
+
+#include <Eigen/Geometry>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+geometry_msgs::Point toPoint(const Eigen::Vector3f &p)
+{
+  geometry_msgs::Point point;
+  point.x = p.x() / 1000.0; // MM to M
+  point.y = p.y() / 1000.0; // MM to M
+  point.z = p.z() / 1000.0; // MM to M
+  return point;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+const std::size_t GraspMarkerPublisher::max_approach_poses_ = 500;
+
+//-------------------------------------------------------------------------------
+
+GraspMarkerPublisher::GraspMarkerPublisher(ros::NodeHandle &nh, double rate, const std::string &marker_frame)
+  : marker_frame_(marker_frame),
+    resend_(false),
+    frame_id_(marker_frame),
+    object_pose_(Eigen::Matrix4f::Identity()),
+    num_approach_poses_(0),
+    num_grasps_(0)
+{
+  publisher_ = nh.advertise<visualization_msgs::MarkerArray>("grasp_markers", 10,
+                                                             boost::bind(&GraspMarkerPublisher::connect_, this, _1));
+  timer_ = nh.createWallTimer(ros::WallDuration(1.0 / std::max(rate, 0.1)),
+                              &GraspMarkerPublisher::publish_, this);
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::setObject(PreparedObjectPtr prepared)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  for (std::map<MarkerId, visualization_msgs::Marker>::const_iterator it = markers_.begin(); it != markers_.end(); ++it)
+    changed_.insert(it->first);
+  markers_.clear();
+  num_approach_poses_ = 0;
+  num_grasps_ = 0;
+
+  frame_id_ = prepared->frame_id.empty() ? marker_frame_ : prepared->frame_id;
+  object_pose_ = prepared->frame_id.empty() ? Eigen::Matrix4f::Identity() : prepared->pose;
+
+  VirtualRobot::TriMeshModelPtr model = prepared->object->getCollisionModel()->getTriMeshModel();
+  visualization_msgs::Marker &marker = this->marker_("object", 0, visualization_msgs::Marker::TRIANGLE_LIST);
+  marker.color.r = marker.color.g = marker.color.b = 0.7f;
+  marker.points.reserve(3 * model->faces.size());
+  for (size_t i = 0; i < model->faces.size(); i++)
+  {
+    marker.points.push_back(toPoint(model->vertices[model->faces[i].id1]));
+    marker.points.push_back(toPoint(model->vertices[model->faces[i].id2]));
+    marker.points.push_back(toPoint(model->vertices[model->faces[i].id3]));
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::addApproachPose(const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction)
+{
+  if (publisher_.getNumSubscribers() == 0)
+    return;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // The last poses only, the oldest ones are replaced.
+  visualization_msgs::Marker &marker = this->marker_("approaches", 0, visualization_msgs::Marker::LINE_LIST);
+  marker.scale.x = 0.001;
+  marker.color.r = marker.color.g = 0.3f;
+  marker.color.b = 1.0f;
+  marker.color.a = 0.5f;
+
+  const std::size_t index = 2 * (num_approach_poses_ % max_approach_poses_);
+  if (marker.points.size() < index + 2)
+    marker.points.resize(index + 2);
+  marker.points[index] = toPoint(position - 20.0f * approach_direction.normalized());
+  marker.points[index + 1] = toPoint(position);
+  num_approach_poses_++;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::addGrasp(const Eigen::Matrix4f &tcp_pose,
+                                    const Eigen::Vector3f &approach_direction,
+                                    float quality)
+{
+  if (publisher_.getNumSubscribers() == 0)
+    return;
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  const Eigen::Vector3f position = tcp_pose.block<3, 1>(0, 3);
+  const Eigen::Vector3f direction = (tcp_pose.block<3, 3>(0, 0) * approach_direction).normalized();
+
+  visualization_msgs::Marker &marker = this->marker_("grasps", num_grasps_++, visualization_msgs::Marker::ARROW);
+  marker.points.push_back(toPoint(position - 50.0f * direction));
+  marker.points.push_back(toPoint(position));
+  marker.scale.x = 0.003;
+  marker.scale.y = 0.006;
+  marker.scale.z = 0.01;
+  const float q = std::max(0.0f, std::min(1.0f, quality));
+  marker.color.r = 1.0f - q;
+  marker.color.g = q;
+  marker.color.b = 0.0f;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::clearGrasps()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  this->delete_("approaches");
+  this->delete_("grasps");
+  this->delete_("cones");
+  num_approach_poses_ = 0;
+  num_grasps_ = 0;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::setContacts(const VirtualRobot::EndEffector::ContactInfoVector &contacts,
+                                       float height,
+                                       float radius)
+{
+  if (publisher_.getNumSubscribers() == 0)
+    return;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  this->delete_("cones");
+
+  // One cone per contact, from the contact point and away from the object.
+  const int num_segments = 12;
+  const float scaling = 30.0f;
+  for (size_t i = 0; i < contacts.size(); i++)
+  {
+    const Eigen::Vector3f apex = contacts[i].contactPointObjectGlobal;
+    const Eigen::Vector3f axis = -contacts[i].approachDirectionGlobal.normalized();
+    const Eigen::Vector3f u = axis.unitOrthogonal();
+    const Eigen::Vector3f v = axis.cross(u);
+    const Eigen::Vector3f center = apex + axis * height * scaling;
+
+    visualization_msgs::Marker &marker = this->marker_("cones", static_cast<int>(i),
+                                                       visualization_msgs::Marker::TRIANGLE_LIST);
+    marker.color.r = 1.0f;
+    marker.color.g = 0.6f;
+    marker.color.b = 0.0f;
+    marker.color.a = 0.6f;
+    for (int s = 0; s < num_segments; s++)
+    {
+      const float a0 = 2.0f * M_PI * s / num_segments;
+      const float a1 = 2.0f * M_PI * (s + 1) / num_segments;
+      marker.points.push_back(toPoint(apex));
+      marker.points.push_back(toPoint(center + radius * scaling * (std::cos(a0) * u + std::sin(a0) * v)));
+      marker.points.push_back(toPoint(center + radius * scaling * (std::cos(a1) * u + std::sin(a1) * v)));
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::connect_(const ros::SingleSubscriberPublisher &publisher)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  resend_ = true;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::publish_(const ros::WallTimerEvent &event)
+{
+  visualization_msgs::MarkerArray msg;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (resend_)
+    {
+      for (std::map<MarkerId, visualization_msgs::Marker>::const_iterator it = markers_.begin(); it != markers_.end(); ++it)
+        changed_.insert(it->first);
+      resend_ = false;
+    }
+    if (changed_.empty() || publisher_.getNumSubscribers() == 0)
+      return;
+
+    const ros::Time now = ros::Time::now();
+    for (std::set<MarkerId>::const_iterator it = changed_.begin(); it != changed_.end(); ++it)
+    {
+      std::map<MarkerId, visualization_msgs::Marker>::const_iterator marker = markers_.find(*it);
+      if (marker != markers_.end())
+      {
+        msg.markers.push_back(marker->second);
+      }
+      else
+      {
+        visualization_msgs::Marker deleted;
+        deleted.header.frame_id = frame_id_;
+        deleted.ns = it->first;
+        deleted.id = it->second;
+        deleted.action = visualization_msgs::Marker::DELETE;
+        msg.markers.push_back(deleted);
+      }
+      msg.markers.back().header.stamp = now;
+    }
+    changed_.clear();
+  }
+  publisher_.publish(msg);
+}
+
+//-------------------------------------------------------------------------------
+
+visualization_msgs::Marker &GraspMarkerPublisher::marker_(const std::string &ns, int id, int type)
+{
+  const MarkerId marker_id(ns, id);
+  changed_.insert(marker_id);
+
+  std::map<MarkerId, visualization_msgs::Marker>::iterator it = markers_.find(marker_id);
+  if (it != markers_.end())
+    return it->second;
+
+  visualization_msgs::Marker &marker = markers_[marker_id];
+  marker.header.frame_id = frame_id_;
+  marker.ns = ns;
+  marker.id = id;
+  marker.type = type;
+  marker.action = visualization_msgs::Marker::ADD;
+
+  const Eigen::Quaternionf orientation(object_pose_.block<3, 3>(0, 0));
+  marker.pose.position = toPoint(object_pose_.block<3, 1>(0, 3));
+  marker.pose.orientation.x = orientation.x();
+  marker.pose.orientation.y = orientation.y();
+  marker.pose.orientation.z = orientation.z();
+  marker.pose.orientation.w = orientation.w();
+
+  marker.scale.x = marker.scale.y = marker.scale.z = 1.0;
+  marker.color.a = 1.0f;
+  return marker;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspMarkerPublisher::delete_(const std::string &ns)
+{
+  std::map<MarkerId, visualization_msgs::Marker>::iterator it = markers_.lower_bound(MarkerId(ns, INT_MIN));
+  while (it != markers_.end() && it->first.first == ns)
+  {
+    changed_.insert(it->first);
+    markers_.erase(it++);
+  }
+}
+
+//-------------------------------------------------------------------------------
@@ -1,3 +1,4 @@
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
 #include "sr_grasp_mesh_planner/grasp_planner_window.hpp"
 #include "sr_grasp_mesh_planner/grasp_action_server.hpp"
 #include "sr_grasp_mesh_planner/sr_approach_movement_surface_normal.hpp"
@@ -6,6 +7,8 @@
 #include <ros/ros.h>
 #include <ros/package.h>
 
+#include <Inventor/SoDB.h>
+
 //-------------------------------------------------------------------------------
 
 using namespace sr_grasp_mesh_planner;
@@ -23,12 +26,20 @@ int main(int argc, char** argv)
 {
   ros::init(argc, argv, "sr_grasp_mesh_planner");
 
-  SoDB::init();
-  SoQt::init(argc, argv, "sr_grasp_mesh_planner");
+  // Headless, there is no window: Qt is not started and no display is needed.
+  bool headless = false;
+  ros::NodeHandle("~").param("headless", headless, false);
+
+  // Simox keeps the models it loads as Coin nodes, which only needs the database of Coin.
+  if (headless)
+    SoDB::init();
+  else
+    SoQt::init(argc, argv, "sr_grasp_mesh_planner");
   ROS_INFO_STREAM(" --- START --- ");
 
   // You can choose a different robot / endeffector / preshape with command-line arguments:
   // --robot robots/iCub/iCub.xml --endeffector "Left Hand" --preshape "Grasp Preshape"
+  // The robot can also be a URDF file or robot_description, converted when loaded (see loadRobotModel).
   std::string robot = ros::package::getPath("sr_grasp_description");
   robot.append("/simox/shadowhand.xml");
   std::string eef("SHADOWHAND");
@@ -47,7 +58,8 @@ int main(int argc, char** argv)
   VirtualRobot::RuntimeEnvironment::print();
 
   std::string robFile = VirtualRobot::RuntimeEnvironment::getValue("robot");
-  if (!robFile.empty() && VirtualRobot::RuntimeEnvironment::getDataFileAbsolute(robFile))
+  if (robFile == "robot_description" ||
+      (!robFile.empty() && VirtualRobot::RuntimeEnvironment::getDataFileAbsolute(robFile)))
     robot = robFile;
 
   std::string eefname = VirtualRobot::RuntimeEnvironment::getValue("endeffector");
@@ -66,13 +78,30 @@ int main(int argc, char** argv)
 
   TriMeshModelPtr skybox = MeshObstacle::create_tri_mesh_skybox();
 
-  boost::shared_ptr<GraspPlannerWindow> grasp_win(new GraspPlannerWindow(robot, eef, preshape, skybox));
+  // The grasp samples are evaluated by a pool of workers, one per hardware thread by default.
+  int num_threads = 0;
+  ros::NodeHandle("~").param("num_threads", num_threads, 0);
+  WorkStealingSchedulerPtr scheduler(new WorkStealingScheduler(num_threads));
+
+  MeshGraspPlannerPtr grasp_planner(new MeshGraspPlanner(robot, eef, preshape, skybox, scheduler));
+
+  // Headless, nothing is rendered: see the ~grasp_markers in RViz instead.
+  boost::shared_ptr<GraspPlannerWindow> grasp_win;
+  if (!headless)
+    grasp_win.reset(new GraspPlannerWindow(grasp_planner));
 
-  GraspActionServer grasp_as_("plan_grasp", grasp_win);
+  GraspActionServer grasp_as_("plan_grasp", grasp_planner);
   boost::thread spin_thread(&ros_spin);
 
-  // Start Qt!
-  grasp_win->main();
+  if (headless)
+  {
+    ros::waitForShutdown();
+  }
+  else
+  {
+    // Start Qt!
+    grasp_win->main();
+  }
 
   // Shutdown the node and join the thread back before exiting.
   ros::shutdown();
@@ -13,24 +13,22 @@
  **/
 
 #include "sr_grasp_mesh_planner/grasp_planner_window.hpp"
-#include "sr_grasp_mesh_planner/sr_approach_movement_bounding_box.hpp"
-#include "sr_grasp_mesh_planner/sr_approach_movement_surface_normal.hpp"
-#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
-#include "sr_grasp_mesh_planner/PlannerConfig.h"
-
-#include <cmath>
-#include <ctime>
-#include <iostream>
+
+#include <iomanip>
 #include <sstream>
 #include <vector>
 
-#include <boost/lexical_cast.hpp>
-#include <Eigen/Geometry>
 #include <QFileDialog>
 
+#include <VirtualRobot/ManipulationObject.h>
+#include <VirtualRobot/XML/ObjectIO.h>
+#include <GraspPlanning/ContactConeGenerator.h>
+
 #include <Inventor/actions/SoLineHighlightRenderAction.h>
 #include <Inventor/nodes/SoShapeHints.h>
 #include <Inventor/nodes/SoLightModel.h>
+#include <Inventor/nodes/SoLOD.h>
+#include <Inventor/nodes/SoMaterial.h>
 #include <Inventor/sensors/SoTimerSensor.h>
 #include <Inventor/nodes/SoEventCallback.h>
 #include <Inventor/nodes/SoMatrixTransform.h>
@@ -51,13 +49,12 @@ using namespace sr_grasp_mesh_planner;
 
 //-------------------------------------------------------------------------------
 
-GraspPlannerWindow::GraspPlannerWindow(string &robFile,
-                                       string &eefName,
-                                       string &preshape,
-                                       VirtualRobot::TriMeshModelPtr triMeshModel,
+GraspPlannerWindow::GraspPlannerWindow(MeshGraspPlannerPtr planner,
                                        Qt::WFlags flags)
   : QMainWindow(NULL),
 
+  planner_(planner),
+
   viewer_(NULL), /*!< Viewer to display the 3D model of the robot and the environment. */
 
   sceneSep_(new SoSeparator),
@@ -67,20 +64,21 @@ GraspPlannerWindow::GraspPlannerWindow(string &robFile,
   graspsSep_(new SoSeparator),
   sphereSep_(new SoSeparator),
 
-  robotFile_(robFile),
-  eefName_(eefName),
-  preshape_(preshape),
   eefVisu_(NULL),
-
-  grasp_counter_(0)
+  graspVisu_(new SoSeparator),
+  graspProxy_(new SoSeparator),
+  grasp_lod_distance_(0.3f),
+  max_displayed_grasps_(100)
 {
   VR_INFO << " Start GraspPlannerWindow " << endl;
 
-  // init the random number generator
-  srand(time(NULL));
+  ros::NodeHandle("~").param<float>("grasp_lod_distance", grasp_lod_distance_, grasp_lod_distance_);
+  ros::NodeHandle("~").param<int>("max_displayed_grasps", max_displayed_grasps_, max_displayed_grasps_);
 
   sceneSep_->ref();
   graspsSep_->ref();
+  graspVisu_->ref();
+  graspProxy_->ref();
 
   sceneSep_->addChild(robotSep_);
   sceneSep_->addChild(objectSep_);
@@ -89,11 +87,14 @@ GraspPlannerWindow::GraspPlannerWindow(string &robFile,
 
   setupUI();
 
-  loadRobot();
+  if (planner_->getEEF())
+  {
+    eefVisu_ = CoinVisualizationFactory::CreateEndEffectorVisualization(planner_->getEEF());
+    eefVisu_->ref();
+  }
+  buildGraspVisu_();
 
-  // Load a temporary object.
-  int approach_movement = 0;
-  loadObject(triMeshModel, approach_movement);
+  planner_->setListener(this);
 
   buildVisu();
 
@@ -104,8 +105,12 @@ GraspPlannerWindow::GraspPlannerWindow(string &robFile,
 
 GraspPlannerWindow::~GraspPlannerWindow()
 {
+  planner_->setListener(NULL);
+
   sceneSep_->unref();
   graspsSep_->unref();
+  graspVisu_->unref();
+  graspProxy_->unref();
   if (eefVisu_)
     eefVisu_->unref();
 }
@@ -130,14 +135,68 @@ void GraspPlannerWindow::setupUI()
   connect(UI_.checkBoxColModel, SIGNAL(clicked()), this, SLOT(colModel()));
   connect(UI_.checkBoxCones, SIGNAL(clicked()), this, SLOT(frictionConeVisu()));
   connect(UI_.checkBoxGrasps, SIGNAL(clicked()), this, SLOT(showGrasps()));
+  connect(UI_.checkBoxFullHands, SIGNAL(clicked()), this, SLOT(fullHands()));
 }
 
 //-------------------------------------------------------------------------------
 
-void GraspPlannerWindow::resetSceneryAll()
+void GraspPlannerWindow::objectChanged()
 {
-  grasps_->removeAllGrasps();
+  this->buildVisu();
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspPlannerWindow::graspsCleared()
+{
+  viewer_->lock();
   graspsSep_->removeAllChildren();
+  viewer_->scheduleRedraw();
+  viewer_->unlock();
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspPlannerWindow::graspsPlanned(const std::vector<Eigen::Matrix4f> &tcp_poses)
+{
+  viewer_->lock();
+
+  for (size_t i = 0; i < tcp_poses.size() && graspsSep_->getNumChildren() < max_displayed_grasps_; i++)
+  {
+    SoMatrixTransform *mt = CoinVisualizationFactory::getMatrixTransformScaleMM2M(tcp_poses[i]);
+    SoSeparator *grasp_sep = new SoSeparator();
+    grasp_sep->addChild(mt);
+    grasp_sep->addChild(graspVisu_);
+    graspsSep_->addChild(grasp_sep);
+  }
+
+  viewer_->scheduleRedraw();
+  viewer_->unlock();
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspPlannerWindow::handChanged()
+{
+  float quality;
+  bool force_closure;
+  if (planner_->getHandQuality(quality, force_closure))
+  {
+    VirtualRobot::GraspSetPtr grasps = planner_->getGraspSet();
+
+    stringstream ss;
+    ss << setprecision(3);
+    ss << "Grasp Nr " << (grasps ? grasps->getSize() : 0);
+    ss << "\nQuality (wrench space): ";
+    ss << "\n  " << quality;
+    ss << "\nForce closure: ";
+    if (force_closure)
+      ss << "yes";
+    else
+      ss << "no";
+    UI_.labelInfo->setText(QString (ss.str().c_str()));
+  }
+  this->buildVisu();
 }
 
 //-------------------------------------------------------------------------------
@@ -152,14 +211,18 @@ void GraspPlannerWindow::closeEvent(QCloseEvent *event)
 
 void GraspPlannerWindow::buildVisu()
 {
+  VirtualRobot::RobotPtr eefCloned = planner_->getHandClone();
+  PreparedObjectPtr prepared = planner_->getObject();
+  EndEffector::ContactInfoVector contacts = planner_->getContacts();
+
   viewer_->lock();
 
   robotSep_->removeAllChildren();
   SceneObject::VisualizationType colModel = (UI_.checkBoxColModel->isChecked() ?
                                              SceneObject::Collision : SceneObject::Full);
-  if (eefCloned_)
+  if (eefCloned)
   {
-    visualizationRobot_ = eefCloned_->getVisualization<CoinVisualization>(colModel);
+    visualizationRobot_ = eefCloned->getVisualization<CoinVisualization>(colModel);
     SoNode* visualisationNode = visualizationRobot_->getCoinVisualization();
     if (visualisationNode)
     {
@@ -170,11 +233,11 @@ void GraspPlannerWindow::buildVisu()
 
 
   objectSep_->removeAllChildren();
-  if (object_)
+  if (prepared && prepared->object)
   {
     SceneObject::VisualizationType colModel2 = (UI_.checkBoxColModel->isChecked() ?
                                                 SceneObject::CollisionData : SceneObject::Full);
-    SoNode* visualisationNode = CoinVisualizationFactory::getCoinVisualization(object_, colModel2);
+    SoNode* visualisationNode = CoinVisualizationFactory::getCoinVisualization(prepared->object, colModel2);
     if (visualisationNode)
     {
       objectSep_->addChild(visualisationNode);
@@ -183,13 +246,13 @@ void GraspPlannerWindow::buildVisu()
 
   frictionConeSep_->removeAllChildren();
   bool fc = (UI_.checkBoxCones->isChecked());
-  if (fc && contacts_.size()>0 && qualityMeasure_)
+  if (fc && contacts.size()>0 && prepared && prepared->quality_measure)
   {
-    ContactConeGeneratorPtr cg = qualityMeasure_->getConeGenerator();
+    ContactConeGeneratorPtr cg = prepared->quality_measure->getConeGenerator();
     float radius = cg->getConeRadius();
     float height = cg->getConeHeight();
     float scaling = 30.0f;
-    SoNode* visualisationNode = CoinVisualizationFactory::getCoinVisualization(contacts_,
+    SoNode* visualisationNode = CoinVisualizationFactory::getCoinVisualization(contacts,
                                                                                height*scaling,
                                                                                radius*scaling,
                                                                                true);
@@ -197,15 +260,15 @@ void GraspPlannerWindow::buildVisu()
       frictionConeSep_->addChild(visualisationNode);
 
     // add approach dir visu
-    for (size_t i=0;i<contacts_.size();i++)
+    for (size_t i=0;i<contacts.size();i++)
     {
       SoSeparator *s = new SoSeparator;
       Eigen::Matrix4f ma;
       ma.setIdentity();
-      ma.block(0,3,3,1) = contacts_[i].contactPointFingerGlobal;
+      ma.block(0,3,3,1) = contacts[i].contactPointFingerGlobal;
       SoMatrixTransform *m = CoinVisualizationFactory::getMatrixTransformScaleMM2M(ma);
       s->addChild(m);
-      s->addChild(CoinVisualizationFactory::CreateArrow(contacts_[i].approachDirectionGlobal,10.0f,1.0f));
+      s->addChild(CoinVisualizationFactory::CreateArrow(contacts[i].approachDirectionGlobal,10.0f,1.0f));
       frictionConeSep_->addChild(s);
     }
   }
@@ -240,269 +303,40 @@ void GraspPlannerWindow::quit()
 
 //-------------------------------------------------------------------------------
 
-void GraspPlannerWindow::loadObject(const object_recognition_msgs::RecognizedObject &object,
-                                    int approach_movement)
-{
-  const shape_msgs::Mesh& obj_mesh = object.bounding_mesh;
-  TriMeshModelPtr triMeshModel = MeshObstacle::create_tri_mesh(obj_mesh);
-  this->loadObject(triMeshModel, approach_movement);
-}
-
-//-------------------------------------------------------------------------------
-
-void GraspPlannerWindow::loadObject(VirtualRobot::TriMeshModelPtr triMeshModel,
-                                    int approach_movement)
-{
-  viewer_->lock();
-
-  // Simox uses MM while ROS uses M. So convert from M to MM.
-  for (unsigned int i = 0; i < triMeshModel->vertices.size(); i++)
-  {
-    float x_MM = triMeshModel->vertices[i].x() * 1000.0; // M to MM
-    float y_MM = triMeshModel->vertices[i].y() * 1000.0; // M to MM
-    float z_MM = triMeshModel->vertices[i].z() * 1000.0; // M to MM
-    triMeshModel->vertices[i] << x_MM, y_MM, z_MM;
-  }
-
-  const bool show_normals = true;
-  object_ = MeshObstacle::create_mesh_obstacle(triMeshModel, !show_normals);
-
-  Eigen::Vector3f minS, maxS;
-  object_->getCollisionModel()->getTriMeshModel()->getSize(minS, maxS);
-  ROS_INFO_STREAM("TriMeshModel minS: [" << minS[0] << ", " << minS[1] << ", " << minS[2] << "]");
-  ROS_INFO_STREAM("TriMeshModel MaxS: [" << maxS[0] << ", " << maxS[1] << ", " << maxS[2] << "]");
-
-  qualityMeasure_.reset(new GraspStudio::GraspQualityMeasureWrenchSpace(object_));
-  // qualityMeasure_->setVerbose(true);
-  qualityMeasure_->calculateObjectProperties();
-
-  /*
-   * Set approach movement generator.
-   * Planner_bounding_box : Bounding box based approach movement generator.
-   * Planner_surface_normal : Object surface normal based approach movement generator.
-   * See cfg/Planner.cfg.
-   */
-  if (approach_movement == Planner_bounding_box)
-  {
-    approach_.reset(new SrApproachMovementBoundingBox(object_, eef_));
-    ROS_INFO_STREAM("Choose the Bounding box based approach movement generator.");
-  }
-  else if (approach_movement == Planner_surface_normal)
-  {
-    approach_.reset(new SrApproachMovementSurfaceNormal(object_, eef_));
-    ROS_INFO_STREAM("Choose the Object surface normal based approach movement generator.");
-  }
-
-  eefCloned_ = approach_->getEEFRobotClone();
-  if (robot_ && eef_)
-  {
-    string name = "Grasp Planner - ";
-    name += eef_->getName();
-    grasps_.reset(new GraspSet(name, robot_->getType(), eefName_));
-  }
-
-  planner_.reset(new GraspStudio::GenericGraspPlanner(grasps_, qualityMeasure_, approach_));
-  planner_->setVerbose(true);
-
-  viewer_->unlock();
-}
-
-//-------------------------------------------------------------------------------
-
-void GraspPlannerWindow::loadRobot()
-{
-  robot_.reset();
-  robot_ = RobotIO::loadRobot(robotFile_);
-  if (!robot_)
-  {
-    VR_ERROR << " no robot at " << robotFile_ << endl;
-    return;
-  }
-  eef_ = robot_->getEndEffector(eefName_);
-  if (!preshape_.empty())
-  {
-    eef_->setPreshape(preshape_);
-  }
-
-  eefVisu_ = CoinVisualizationFactory::CreateEndEffectorVisualization(eef_);
-  eefVisu_->ref();
-}
-
-//-------------------------------------------------------------------------------
-
-void GraspPlannerWindow::plan(bool force_closure,
-                              float timeout,
-                              float min_quality,
-                              boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh,
-                              boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh)
-{
-  feedback_mesh_ = feedback_mesh;
-  result_mesh_ = result_mesh;
-  this->resetSceneryAll();
-  this->plan(force_closure, timeout, min_quality);
-}
-
-//-------------------------------------------------------------------------------
-
-void GraspPlannerWindow::plan(bool force_closure,
-                              float timeout,
-                              float min_quality)
+void GraspPlannerWindow::buildGraspVisu_()
 {
   viewer_->lock();
 
-  // Start!
-  clock_t begin = clock();
-
-  /*
-   * Parameter num_of_desired_grasp_sets is set in class GraspActionServer.
-   * For every set, we generate ONE grasp.
-   */
-  const int nrDesiredGrasps = 1;
-  const float timeout_ms =  timeout * 1000.0f; // second -> millisecond.
-
-  planner_.reset(new GraspStudio::GenericGraspPlanner(grasps_,
-                                                      qualityMeasure_,
-                                                      approach_,
-                                                      min_quality,
-                                                      force_closure));
-
-  int nrComputedGrasps = planner_->plan(nrDesiredGrasps, timeout_ms);
-  grasps_->setPreshape(preshape_);
-  for (size_t i=0; i < grasps_->getSize(); i++)
+  // The TCP frame: x red, y green, z blue (mm, under the MM to M transform of each grasp).
+  if (graspProxy_->getNumChildren() == 0)
   {
-    // m is the pose of the grasp applied to the global object pose,
-    // resulting in the global TCP pose which is related to the grasp.
-    Eigen::Matrix4f m = grasps_->getGrasp(i)->getTcpPoseGlobal(object_->getGlobalPose());
-    SoMatrixTransform *mt = CoinVisualizationFactory::getMatrixTransformScaleMM2M(m);
-    SoSeparator *grasp_sep = new SoSeparator();
-    grasp_sep->addChild(mt);
-    grasp_sep->addChild(eefVisu_);
-    graspsSep_->addChild(grasp_sep);
-  }
-
-  //--------------------------------------------------------
-
-  for (size_t i=0; i < grasps_->getSize(); i++)
-  {
-    // m is the pose of the grasp applied to the global object pose,
-    // resulting in the global TCP pose which is related to the grasp.
-    Eigen::Matrix4f m = grasps_->getGrasp(i)->getTcpPoseGlobal(object_->getGlobalPose());
-
-    moveit_msgs::Grasp grasp_msg;
-
-    // nrComputedGrasps should be one.
-    feedback_mesh_->number_of_synthesized_grasps += nrComputedGrasps;
-
-    // A name for this grasp.
-    grasp_msg.id = string("grasp_") + boost::lexical_cast<string>(grasp_counter_);
-    grasp_counter_++;
-
-    // The position of the end-effector for the grasp.
-    grasp_msg.grasp_pose.header.stamp = ros::Time::now();
-
-    // The internal posture of the hand before the grasp.
-    // positions and efforts (not set here) are used.
-    if (eef_->hasPreshape("Grasp Preshape"))
+    for (int i = 0; i < 3; i++)
     {
-      trajectory_msgs::JointTrajectory pre_grasp_posture;
-      pre_grasp_posture.header.stamp = grasp_msg.grasp_pose.header.stamp;
-      // Get the configuration of the grasp.
-      trajectory_msgs::JointTrajectoryPoint pre_grasp_point;
-
-      map<string, float> robotNodeJointValueMap = eef_->getPreshape("Grasp Preshape")->getRobotNodeJointValueMap();
-      for (map<string, float>::const_iterator it = robotNodeJointValueMap.begin();
-           it != robotNodeJointValueMap.end();
-           ++it)
-      {
-        // Set joint name.
-        pre_grasp_posture.joint_names.push_back(it->first);
-        // Set position (i.e., angle).
-        pre_grasp_point.positions.push_back(it->second); // Unit is radian
-      }
-      if (!pre_grasp_posture.joint_names.empty())
-        pre_grasp_posture.points.push_back(pre_grasp_point);
-      // Set the pre-grasp posture.
-      grasp_msg.pre_grasp_posture = pre_grasp_posture;
+      SoSeparator *axis = new SoSeparator;
+      SoMaterial *material = new SoMaterial;
+      material->diffuseColor.setValue(i == 0 ? 1.0f : 0.0f, i == 1 ? 1.0f : 0.0f, i == 2 ? 1.0f : 0.0f);
+      axis->addChild(material);
+      axis->addChild(CoinVisualizationFactory::CreateArrow(Eigen::Vector3f::Unit(i), 30.0f, 1.0f));
+      graspProxy_->addChild(axis);
     }
-
-    // The internal posture of the hand for the grasp.
-    // positions and efforts (not set here) are used.
-    trajectory_msgs::JointTrajectory grasp_posture;
-    grasp_posture.header.stamp = grasp_msg.grasp_pose.header.stamp;
-    // Get the configuration of the grasp.
-    trajectory_msgs::JointTrajectoryPoint grasp_point;
-
-    map<string, float> configuration = grasps_->getGrasp(i)->getConfiguration();
-    for (map<string, float>::const_iterator it = configuration.begin();
-         it != configuration.end();
-         ++it)
-    {
-      // Set joint name.
-      grasp_posture.joint_names.push_back(it->first);
-      // Set position (i.e., angle).
-      grasp_point.positions.push_back(it->second); // Unit is radian
-    }
-    if (!grasp_posture.joint_names.empty())
-      grasp_posture.points.push_back(grasp_point);
-    // Set the grasp posture.
-    grasp_msg.grasp_posture = grasp_posture;
-
-    // Get the transformation of this grasp.
-    // The transformation is given in the coordinate system of the tcp,
-    // whereas the tcp belongs to the eef.
-    // This transformation specifies the tcp to object relation.
-    Eigen::Matrix4f poseTcp = grasps_->getGrasp(i)->getTransformation();
-
-    // Now the eef can be set to a position so that it's TCP is at m.
-    // m is the pose of the grasp applied to the global object pose,
-    // resulting in the global TCP pose which is related to the grasp.
-    eefCloned_->setGlobalPoseForRobotNode(eefCloned_->getEndEffector(eefName_)->getTcp(), m);
-    Eigen::Matrix4f poseGlobal = eefCloned_->getGlobalPose();
-
-    // We obtain the translation from the root to the TCP, to be able to get the grasp pose in the root (forearm) frame
-    // We do it this way because the TCP we have defined doesn't match any of the robot links' frames
-    Eigen::Matrix4f globalPoseTcp = eef_->getTcp()->getGlobalPose();
-
-    // Here we choose between poseTcp and poseGlobal to save.
-    Eigen::Matrix4f poseToSave = poseTcp;
-    // Set pose.position.
-    grasp_msg.grasp_pose.header.frame_id = "forearm";
-    grasp_msg.grasp_pose.pose.position.x = (poseToSave(0,3) + globalPoseTcp(0,3)) / 1000.0; // /1000 as ros msg is in meters instead of mm
-    grasp_msg.grasp_pose.pose.position.y = (poseToSave(1,3) + globalPoseTcp(1,3)) / 1000.0;
-    grasp_msg.grasp_pose.pose.position.z = (poseToSave(2,3) + globalPoseTcp(2,3)) / 1000.0;
-    // Set pose.orientation.
-    MathTools::Quaternion q = MathTools::eigen4f2quat(poseToSave);
-    grasp_msg.grasp_pose.pose.orientation.x = q.x;
-    grasp_msg.grasp_pose.pose.orientation.y = q.y;
-    grasp_msg.grasp_pose.pose.orientation.z = q.z;
-    grasp_msg.grasp_pose.pose.orientation.w = q.w;
-
-    // The estimated probability of success for this grasp.
-    grasp_msg.grasp_quality = grasps_->getGrasp(i)->getQuality();
-
-    // Save the current moveit_msgs::Grasp.
-    result_mesh_->grasps.push_back(grasp_msg);
   }
 
-  //--------------------------------------------------------
-
-  // Set to the last valid grasp.
-  if (grasps_->getSize()>0 && eefCloned_ && eefCloned_->getEndEffector(eefName_))
+  // Changing this node changes all the grasps drawn.
+  graspVisu_->removeAllChildren();
+  if (UI_.checkBoxFullHands->isChecked() && eefVisu_)
   {
-    int last_idx = grasps_->getSize() - 1;
-    // last_m is the pose of the grasp applied to the global object pose,
-    // resulting in the global TCP pose which is related to the grasp.
-    Eigen::Matrix4f last_m = grasps_->getGrasp(last_idx)->getTcpPoseGlobal(object_->getGlobalPose());
-    // Now the eef can be set to a position so that it's TCP is at last_m.
-    eefCloned_->setGlobalPoseForRobotNode(eefCloned_->getEndEffector(eefName_)->getTcp(), last_m);
-
-    this->openEEF();
-    this->closeEEF();
+    SoLOD *lod = new SoLOD;
+    lod->range.setValue(grasp_lod_distance_);
+    lod->addChild(eefVisu_);
+    lod->addChild(graspProxy_);
+    graspVisu_->addChild(lod);
+  }
+  else
+  {
+    graspVisu_->addChild(graspProxy_);
   }
 
-  clock_t end = clock();
-  ROS_INFO_STREAM("Grasp planning took " << static_cast<double>(diffclock(end, begin)) << " ms.");
-
+  viewer_->scheduleRedraw();
   viewer_->unlock();
 }
 
@@ -510,40 +344,14 @@ void GraspPlannerWindow::plan(bool force_closure,
 
 void GraspPlannerWindow::openEEF()
 {
-  contacts_.clear();
-  if (eefCloned_ && eefCloned_->getEndEffector(eefName_))
-  {
-    eefCloned_->getEndEffector(eefName_)->openActors();
-  }
-  this->buildVisu();
+  planner_->openHand();
 }
 
 //-------------------------------------------------------------------------------
 
 void GraspPlannerWindow::closeEEF()
 {
-  contacts_.clear();
-  if (eefCloned_ && eefCloned_->getEndEffector(eefName_))
-  {
-    contacts_ = eefCloned_->getEndEffector(eefName_)->closeActors(object_);
-
-    // The last computed quality is retrieved with
-    float qual = qualityMeasure_->getGraspQuality();
-    bool isFC = qualityMeasure_->isGraspForceClosure();
-
-    stringstream ss;
-    ss << setprecision(3);
-    ss << "Grasp Nr " << grasps_->getSize();
-    ss << "\nQuality (wrench space): ";
-    ss << "\n  " << qual;
-    ss << "\nForce closure: ";
-    if (isFC)
-      ss << "yes";
-    else
-      ss << "no";
-    UI_.labelInfo->setText(QString (ss.str().c_str()));
-  }
-  this->buildVisu();
+  planner_->closeHand();
 }
 
 //-------------------------------------------------------------------------------
@@ -569,15 +377,24 @@ void GraspPlannerWindow::showGrasps()
 
 //-------------------------------------------------------------------------------
 
+void GraspPlannerWindow::fullHands()
+{
+  this->buildGraspVisu_();
+}
+
+//-------------------------------------------------------------------------------
+
 void GraspPlannerWindow::save()
 {
-  if (!object_)
+  PreparedObjectPtr prepared = planner_->getObject();
+  if (!prepared || !prepared->object)
     return;
 
-  ManipulationObjectPtr objectM(new ManipulationObject(object_->getName(),
-                                                       object_->getVisualization()->clone(),
-                                                       object_->getCollisionModel()->clone()));
-  objectM->addGraspSet(grasps_);
+  ObstaclePtr object = prepared->object;
+  ManipulationObjectPtr objectM(new ManipulationObject(object->getName(),
+                                                       object->getVisualization()->clone(),
+                                                       object->getCollisionModel()->clone()));
+  objectM->addGraspSet(planner_->getGraspSet());
   QString fi = QFileDialog::getSaveFileName(this,
                                             tr("Save ManipulationObject"),
                                             QString(),
@@ -603,12 +420,3 @@ void GraspPlannerWindow::save()
 }
 
 //-------------------------------------------------------------------------------
-
-double GraspPlannerWindow::diffclock(clock_t clock1, clock_t clock2)
-{
-  double diffticks=clock1-clock2;
-  double diffms=(diffticks*1000)/CLOCKS_PER_SEC;
-  return diffms;
-}
-
-//-------------------------------------------------------------------------------
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   grasp_sample_job.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Grasp planning on a prepared object, one grasp hypothesis per sample.
+ **/
+
+#include "sr_grasp_mesh_planner/grasp_sample_job.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/RobotConfig.h>
+#include <VirtualRobot/Nodes/RobotNode.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/functional/hash.hpp>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+boost::mutex GraspSampleJob::context_mutex_;
+
+const int GraspSampleJob::max_reachability_attempts_ = 10;
+
+//-------------------------------------------------------------------------------
+
+GraspSampleJob::GraspSampleJob(PreparedObjectPtr prepared,
+                               VirtualRobot::EndEffectorPtr eef,
+                               int hand,
+                               int num_workers,
+                               int num_grasps,
+                               bool force_closure,
+                               float min_quality,
+                               float timeout,
+                               unsigned int seed,
+                               float approach_distance,
+                               float min_approach_distance,
+                               ReachabilityMapPtr reachability,
+                               AdaptiveQualityThresholdPtr threshold,
+                               GraspMarkerPublisherPtr markers)
+  : prepared_(prepared),
+    eef_(eef),
+    hand_(hand),
+    robot_type_(eef->getRobot()->getType()),
+    num_grasps_(num_grasps),
+    force_closure_(force_closure),
+    min_quality_(min_quality),
+    threshold_(threshold),
+    approach_distance_(approach_distance * 1000.0f), // M to MM
+    min_approach_distance_(std::min(min_approach_distance, approach_distance) * 1000.0f), // M to MM
+    markers_(markers),
+    object_pose_(prepared->pose),
+    has_deadline_(timeout > 0.0f),
+    seed_(seed),
+    seeded_(std::max(num_workers, 0), 0),
+    time_to_first_grasp_(-1.0),
+    num_seed_grasps_(0),
+    num_samples_(0),
+    num_blocked_(0),
+    num_unreachable_(0),
+    num_retractions_(0),
+    num_retraction_checks_(0),
+    canceled_(false)
+{
+  start_ = boost::posix_time::microsec_clock::universal_time();
+
+  if (reachability && prepared_->frame_id.empty())
+    ROS_WARN_STREAM_ONCE("The pose of the object is unknown, the reachability of the grasps is not checked.");
+  else if (reachability && prepared_->frame_id != reachability->getFrameId())
+    ROS_WARN_STREAM_ONCE("The object is in " << prepared_->frame_id << " but the reachability map is in " <<
+                         reachability->getFrameId() << ", the reachability of the grasps is not checked.");
+  else
+    reachability_ = reachability;
+
+  if (has_deadline_)
+    deadline_ = start_ + boost::posix_time::microseconds(static_cast<long>(timeout * 1.0e6f));
+
+  GraspSampleJob::reserveContexts(prepared_, hand_, num_workers);
+}
+
+//-------------------------------------------------------------------------------
+
+GraspSampleJob::~GraspSampleJob()
+{
+}
+
+//-------------------------------------------------------------------------------
+
+SampleContext &GraspSampleJob::context_(int worker_id)
+{
+  return GraspSampleJob::getContext(prepared_, hand_, eef_, worker_id);
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspSampleJob::reserveContexts(PreparedObjectPtr prepared, int hand, int num_workers)
+{
+  boost::mutex::scoped_lock lock(context_mutex_);
+  if (prepared->contexts.size() <= static_cast<size_t>(hand))
+    prepared->contexts.resize(hand + 1);
+  if (prepared->contexts[hand].size() < static_cast<size_t>(num_workers))
+    prepared->contexts[hand].resize(num_workers);
+  if (prepared->next_seed.size() <= static_cast<size_t>(hand))
+    prepared->next_seed.resize(hand + 1, 0);
+}
+
+//-------------------------------------------------------------------------------
+
+SampleContext &GraspSampleJob::getContext(PreparedObjectPtr prepared,
+                                          int hand,
+                                          VirtualRobot::EndEffectorPtr eef,
+                                          int worker_id)
+{
+  // Only this worker ever touches its slot.
+  boost::shared_ptr<SampleContext> &context = prepared->contexts[hand][worker_id];
+  if (!context)
+  {
+    boost::mutex::scoped_lock lock(context_mutex_);
+    context.reset(new SampleContext);
+    context->quality_measure.reset(new GraspStudio::GraspQualityMeasureWrenchSpace(prepared->object));
+    context->quality_measure->calculateObjectProperties();
+    context->approach = createApproachMovement(prepared->approach_movement, prepared->object, eef,
+                                               prepared->approach_prior, prepared->shape_frame,
+                                               prepared->retraction);
+    context->retraction = getRetractionEngine(context->approach);
+    context->random = getRandomGenerator(context->approach);
+    context->closing.reset(new HandClosing(context->approach->getEEF()));
+    context->clearance.reset(new ApproachClearance(context->approach->getEEF()));
+  }
+  return *context;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspSampleJob::run_sample(int worker_id)
+{
+  SampleContext &context = this->context_(worker_id);
+  if (context.random && !seeded_[worker_id])
+  {
+    std::size_t seed = seed_;
+    boost::hash_combine(seed, worker_id);
+    context.random->seed(static_cast<boost::uint32_t>(seed));
+    seeded_[worker_id] = 1;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    num_samples_++;
+  }
+
+  VirtualRobot::EndEffectorPtr eef = context.approach->getEEF();
+  VirtualRobot::SceneObjectPtr object = prepared_->object;
+
+  // Count the retractions of the approach poses drawn for this sample.
+  const RetractionEngine::Stats before = context.retraction ? context.retraction->getStats()
+                                                            : RetractionEngine::Stats();
+  bool seeded = false;
+  bool sampled = false;
+  Eigen::Vector3f sampled_position;
+  Eigen::Vector3f sampled_approach_dir;
+  const bool drawn = this->drawApproachPose_(context, seeded, sampled, sampled_position, sampled_approach_dir);
+  if (context.retraction)
+  {
+    const RetractionEngine::Stats &after = context.retraction->getStats();
+    boost::mutex::scoped_lock lock(mutex_);
+    num_retractions_ += after.retractions - before.retractions;
+    num_retraction_checks_ += after.checks - before.checks;
+  }
+  if (!drawn)
+    return;
+
+  if (markers_)
+    markers_->addApproachPose(eef->getTcp()->getGlobalPose().block<3, 1>(0, 3),
+                              context.approach->getApproachDirGlobal());
+
+  VirtualRobot::EndEffector::ContactInfoVector contacts = context.closing->closeActors(object, prepared_->bvh);
+  eef->addStaticPartContacts(object, contacts, context.approach->getApproachDirGlobal());
+
+  // Ignore grasp hypotheses with a low number of contacts.
+  if (contacts.size() < 2)
+    return;
+
+  context.quality_measure->setContactPoints(contacts);
+  const float score = context.quality_measure->getGraspQuality();
+  const float min_quality = threshold_ ? threshold_->getThreshold() : min_quality_;
+  if (threshold_)
+    threshold_->addSample(score);
+  if (score < min_quality)
+    return;
+  if (force_closure_ && !context.quality_measure->isGraspForceClosure())
+    return;
+
+  // The pose of the object in the TCP coordinate system, and the joint values of the hand.
+  Eigen::Matrix4f pose_local = eef->getTcp()->toLocalCoordinateSystem(object->getGlobalPose());
+  std::map<std::string, float> configuration = eef->getConfiguration()->getRobotNodeJointValueMap();
+
+  // The open hand must reach the grasp in a straight line.
+  const Eigen::Vector3f approach_dir = context.approach->getApproachDirGlobal().normalized();
+  const Eigen::Vector3f approach_dir_tcp = eef->getTcp()->getGlobalPose().block<3, 3>(0, 0).transpose() * approach_dir;
+  float clear_distance = 0.0f;
+  if (approach_distance_ > 0.0f)
+  {
+    context.approach->openHand();
+    clear_distance = context.clearance->compute(object, prepared_->bvh, approach_dir, approach_distance_);
+    if (clear_distance < min_approach_distance_)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      num_blocked_++;
+      return;
+    }
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if (this->done_())
+    return;
+
+  std::stringstream ss;
+  ss << "Grasp " << (grasps_.size() + 1);
+  std::string planner_name("Simox - GraspStudio - ");
+  planner_name += context.quality_measure->getName();
+
+  VirtualRobot::GraspPtr grasp(new ApproachGrasp(ss.str(),
+                                                 robot_type_,
+                                                 eef_->getName(),
+                                                 pose_local,
+                                                 planner_name,
+                                                 score,
+                                                 approach_dir_tcp,
+                                                 min_approach_distance_,
+                                                 clear_distance));
+  grasp->setConfiguration(configuration);
+  grasps_.push_back(grasp);
+  if (grasps_.size() == 1)
+  {
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start_;
+    time_to_first_grasp_ = elapsed.total_microseconds() * 1.0e-6;
+  }
+  if (seeded)
+    num_seed_grasps_++;
+  if (threshold_)
+    threshold_->addAccepted();
+  // Binned where the generator asked the prior, not where the hand ended up.
+  if (prepared_->approach_prior && sampled)
+    prepared_->approach_prior->addGrasp(prepared_->shape_frame, sampled_position, sampled_approach_dir);
+
+  if (this->done_())
+    cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspSampleJob::done() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return this->done_();
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspSampleJob::done_() const
+{
+  if (canceled_ || grasps_.size() >= static_cast<size_t>(num_grasps_))
+    return true;
+  return has_deadline_ && boost::posix_time::microsec_clock::universal_time() >= deadline_;
+}
+
+//-------------------------------------------------------------------------------
+
+void GraspSampleJob::cancel()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  canceled_ = true;
+  cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+std::vector<VirtualRobot::GraspPtr> GraspSampleJob::wait()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while (!this->done_())
+  {
+    if (has_deadline_)
+      cond_.timed_wait(lock, deadline_);
+    else
+      cond_.wait(lock);
+  }
+  return grasps_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumSamples() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_samples_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumBlocked() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_blocked_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumUnreachable() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_unreachable_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumRetractions() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_retractions_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumRetractionChecks() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_retraction_checks_;
+}
+
+//-------------------------------------------------------------------------------
+
+double GraspSampleJob::getTimeToFirstGrasp() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return time_to_first_grasp_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::getNumSeedGrasps() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_seed_grasps_;
+}
+
+//-------------------------------------------------------------------------------
+
+int GraspSampleJob::takeSeed_()
+{
+  // Shared by the jobs of the hand on the object, so each seed is only tried once.
+  boost::mutex::scoped_lock lock(context_mutex_);
+  int &next = prepared_->next_seed[hand_];
+  if (next >= static_cast<int>(prepared_->seeds.size()))
+    return -1;
+  return next++;
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspSampleJob::drawApproachPose_(SampleContext &context,
+                                       bool &seeded,
+                                       bool &sampled,
+                                       Eigen::Vector3f &position,
+                                       Eigen::Vector3f &approach_direction)
+{
+  seeded = false;
+  sampled = false;
+  const int seed = context.retraction ? this->takeSeed_() : -1;
+  if (seed >= 0)
+  {
+    const SeedApproach &seed_approach = prepared_->seeds[seed];
+    setEEFToSeedApproach(*context.approach, *context.retraction, seed_approach);
+    if (!reachability_ || this->isReachable_(context))
+    {
+      seeded = true;
+      sampled = true;
+      position = seed_approach.position;
+      approach_direction = -seed_approach.direction.normalized();
+      return true;
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    num_unreachable_++;
+  }
+
+  if (!context.approach->setEEFToRandomApproachPose())
+    return false;
+  if (!reachability_)
+  {
+    sampled = getSampledPosition(context.approach, position, approach_direction);
+    return true;
+  }
+
+  int rejected = 0;
+  bool reachable = this->isReachable_(context);
+  while (!reachable && ++rejected < max_reachability_attempts_ && context.approach->setEEFToRandomApproachPose())
+    reachable = this->isReachable_(context);
+
+  if (rejected > 0)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    num_unreachable_ += rejected;
+  }
+  if (reachable)
+    sampled = getSampledPosition(context.approach, position, approach_direction);
+  return reachable;
+}
+
+//-------------------------------------------------------------------------------
+
+bool GraspSampleJob::isReachable_(SampleContext &context) const
+{
+  // The object is at the origin of Simox, so global poses are in the frame of the object.
+  const Eigen::Matrix4f tcp_pose = object_pose_ * context.approach->getEEF()->getTcp()->getGlobalPose();
+  const Eigen::Vector3f approach_dir = object_pose_.block<3, 3>(0, 0) * context.approach->getApproachDirGlobal();
+  return reachability_->isReachable(tcp_pose.block<3, 1>(0, 3), approach_dir);
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_closing.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Close the actors of the hand on an object before Simox takes the last steps.
+ **/
+
+#include "sr_grasp_mesh_planner/hand_closing.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/EndEffector/EndEffectorActor.h>
+
+#include <algorithm>
+#include <map>
+#include <ros/ros.h>
+
+// Set by CMake when the planner is built with the generated forward kinematics.
+#ifdef SR_GRASP_GENERATED_HAND_FK
+#include SR_GRASP_GENERATED_HAND_FK
+#endif
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+HandClosing::HandClosing(EndEffectorPtr eef, float angle)
+  : eef_(eef),
+    robot_(eef->getRobot()),
+    col_checker_(eef->getRobot()->getCollisionChecker()),
+    angle_(angle),
+    generated_(false)
+{
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  generated_ = this->initActors_(true);
+#endif
+  if (!generated_)
+    this->initActors_(false);
+
+  for (size_t i = 0; i < actors_.size(); i++)
+  {
+    for (size_t l = 0; l < actors_[i].links.size(); l++)
+    {
+      ActorLink &link = actors_[i].links[l];
+      Eigen::Vector3f min, max;
+      transformBox_(link.col_model->getGlobalPose(), link.local_min, link.local_max, min, max);
+      link.leaf = links_tree_.addLeaf(min, max);
+    }
+  }
+  near_object_.resize(links_tree_.getNumLeaves());
+
+  // The links of the other actors each link has to be checked against.
+  for (size_t i = 0; i < actors_.size(); i++)
+  {
+    for (size_t l = 0; l < actors_[i].links.size(); l++)
+    {
+      ActorLink &link = actors_[i].links[l];
+      if (!link.check_actors)
+        continue;
+      for (size_t k = 0; k < actors_.size(); k++)
+      {
+        if (k == i)
+          continue;
+        for (size_t m = 0; m < actors_[k].links.size(); m++)
+        {
+          const ActorLink &other = actors_[k].links[m];
+          if (other.check_actors && this->canCollide_(link, other))
+          {
+            link.actor_col_models.push_back(other.col_model);
+            link.actor_leaves.push_back(other.leaf);
+          }
+        }
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+/*
+ * With the generated forward kinematics, the joints and links are those of the generated
+ * header, and false is returned if the hand does not match it. Otherwise, the joints are
+ * those of the actors, moved on the robot nodes, which Simox couples (PropagateJointValue).
+ */
+bool HandClosing::initActors_(bool generated)
+{
+  joint_names_.clear();
+  joint_nodes_.clear();
+  link_names_.clear();
+  actors_.clear();
+
+  std::map<std::string, int> joint_index;
+  std::map<std::string, int> link_index;
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  if (generated)
+  {
+    if (robot_->getType() != generated_hand_fk::hand_type)
+    {
+      ROS_WARN_STREAM_ONCE("The generated forward kinematics is for " << generated_hand_fk::hand_type <<
+                           ", not for " << robot_->getType() << ". It is not used.");
+      return false;
+    }
+
+    for (int i = 0; i < generated_hand_fk::num_joints; i++)
+    {
+      const std::string name(generated_hand_fk::joint_names[i]);
+      if (!robot_->hasRobotNode(name))
+      {
+        ROS_WARN_STREAM_ONCE("Joint " << name << " of the generated forward kinematics is not in the hand. " <<
+                             "It is not used.");
+        return false;
+      }
+      joint_index[name] = i;
+      joint_names_.push_back(name);
+      joint_nodes_.push_back(robot_->getRobotNode(name));
+    }
+
+    for (int i = 0; i < generated_hand_fk::num_links; i++)
+    {
+      link_index[generated_hand_fk::link_names[i]] = i;
+      link_names_.push_back(generated_hand_fk::link_names[i]);
+    }
+  }
+#endif
+
+  std::vector<EndEffectorActorPtr> actors;
+  eef_->getActors(actors);
+  for (size_t i = 0; i < actors.size(); i++)
+  {
+    Actor actor;
+    actor.function = -1;
+#ifdef SR_GRASP_GENERATED_HAND_FK
+    for (int k = 0; generated && k < generated_hand_fk::num_actors; k++)
+    {
+      if (actors[i]->getName() == std::string(1, generated_hand_fk::actor_names[k]))
+        actor.function = k;
+    }
+#endif
+
+    std::vector<EndEffectorActor::ActorDefinition> definition = actors[i]->getDefinition();
+    for (size_t j = 0; j < definition.size(); j++)
+    {
+      RobotNodePtr node = definition[j].robotNode;
+
+      if (node->isRotationalJoint() && definition[j].directionAndSpeed != 0.0f)
+      {
+        if (!generated && joint_index.find(node->getName()) == joint_index.end())
+        {
+          joint_index[node->getName()] = joint_nodes_.size();
+          joint_names_.push_back(node->getName());
+          joint_nodes_.push_back(node);
+        }
+        if (joint_index.find(node->getName()) == joint_index.end())
+        {
+          ROS_WARN_STREAM_ONCE("Joint " << node->getName() << " is not in the generated forward kinematics. " <<
+                               "It is not used.");
+          return false;
+        }
+        ActorJoint joint;
+        joint.node = node;
+        joint.index = joint_index[node->getName()];
+        joint.direction = definition[j].directionAndSpeed;
+        actor.joints.push_back(joint);
+        actor.nodes.push_back(node);
+      }
+
+      if (node->getCollisionModel())
+      {
+        if (generated && link_index.find(node->getName()) == link_index.end())
+        {
+          ROS_WARN_STREAM_ONCE("Link " << node->getName() << " is not in the generated forward kinematics. " <<
+                               "It is not used.");
+          return false;
+        }
+        ActorLink link;
+        link.col_model = node->getCollisionModel();
+        link.index = generated ? link_index[node->getName()] : -1;
+        link.leaf = -1;
+        link.col_model->getTriMeshModel()->getSize(link.local_min, link.local_max);
+        link.check_object = definition[j].colMode != EndEffectorActor::eNone;
+        link.check_actors = (definition[j].colMode & EndEffectorActor::eActors) != 0;
+        actor.links.push_back(link);
+      }
+    }
+
+#ifdef SR_GRASP_GENERATED_HAND_FK
+    for (int k = 0; generated && k < generated_hand_fk::num_couplings; k++)
+    {
+      const generated_hand_fk::Coupling &coupling = generated_hand_fk::couplings[k];
+      for (size_t j = 0; j < actor.joints.size(); j++)
+      {
+        if (actor.joints[j].index != coupling.leader)
+          continue;
+        CoupledJoint coupled;
+        coupled.node = joint_nodes_[coupling.joint];
+        coupled.index = coupling.joint;
+        coupled.leader = coupling.leader;
+        coupled.factor = static_cast<float>(coupling.factor);
+        actor.coupled_joints.push_back(coupled);
+      }
+    }
+#endif
+
+    actor.values.resize(actor.nodes.size());
+    actors_.push_back(actor);
+  }
+
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  if (generated)
+    poses_.resize(generated_hand_fk::num_links * 12);
+#endif
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+// The collision filter of urdf_to_simox_xml, with the generated forward kinematics.
+bool HandClosing::canCollide_(const ActorLink &link, const ActorLink &other) const
+{
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  if (generated_)
+    return generated_hand_fk::can_collide[link.index][other.index];
+#endif
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+bool HandClosing::isGenerated() const
+{
+  return generated_;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::vector<std::string> &HandClosing::getJointNames() const
+{
+  return joint_names_;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::vector<std::string> &HandClosing::getLinkNames() const
+{
+  return link_names_;
+}
+
+//-------------------------------------------------------------------------------
+
+EndEffector::ContactInfoVector HandClosing::closeActors(SceneObjectPtr object, MeshBvhPtr bvh)
+{
+  if (actors_.empty() || !object || !object->getCollisionModel())
+    return eef_->closeActors(object, angle_);
+
+  CollisionModelPtr object_col_model = object->getCollisionModel();
+
+  // The box of the object does not move while closing.
+  const Eigen::Matrix4f object_pose = object_col_model->getGlobalPose();
+  object_from_global_ = object_pose.inverse();
+  object_bvh_ = (bvh && bvh->getNumNodes() > 0) ? bvh : MeshBvhPtr();
+  Eigen::Vector3f min, max;
+  if (object_bvh_)
+  {
+    min = object_bvh_->getMin();
+    max = object_bvh_->getMax();
+  }
+  else
+  {
+    object_col_model->getTriMeshModel()->getSize(min, max);
+  }
+  transformBox_(object_pose, min, max, object_min_, object_max_);
+
+  std::vector<double> joint_values(joint_nodes_.size());
+  for (size_t i = 0; i < joint_nodes_.size(); i++)
+    joint_values[i] = joint_nodes_[i]->getJointValue();
+
+  for (size_t i = 0; i < actors_.size(); i++)
+    this->updateCollisionModels_(actors_[i], joint_values);
+
+  // An actor touching the object from the start is left to Simox.
+  std::vector<bool> moving(actors_.size());
+  for (size_t i = 0; i < actors_.size(); i++)
+    moving[i] = !this->isColliding_(i, object_col_model);
+
+  /*
+   * The actors move one step at a time, in turn, as in Simox, and stop one step before
+   * touching the object or another actor. The links are checked as Simox does (see
+   * considerCollisions), so an actor never goes past a configuration where Simox would
+   * have stopped it.
+   */
+  bool any_moving = true;
+  while (any_moving)
+  {
+    any_moving = false;
+    for (size_t i = 0; i < actors_.size(); i++)
+    {
+      if (!moving[i])
+        continue;
+
+      std::vector<double> next_values(joint_values);
+      if (!this->step_(actors_[i], next_values))
+      {
+        moving[i] = false;
+        continue;
+      }
+
+      this->updateCollisionModels_(actors_[i], next_values);
+      if (this->isColliding_(i, object_col_model))
+      {
+        moving[i] = false;
+        this->updateCollisionModels_(actors_[i], joint_values);
+        continue;
+      }
+
+      joint_values = next_values;
+      any_moving = true;
+    }
+  }
+
+  object_bvh_.reset();
+
+  // Update the robot nodes (and their collision models), and let Simox do the last steps.
+  if (generated_)
+  {
+    std::vector<float> values(joint_values.begin(), joint_values.end());
+    robot_->setJointValues(joint_nodes_, values);
+  }
+
+  return eef_->closeActors(object, angle_);
+}
+
+//-------------------------------------------------------------------------------
+
+bool HandClosing::step_(const Actor &actor, std::vector<double> &joint_values) const
+{
+  bool moved = false;
+  for (size_t j = 0; j < actor.joints.size(); j++)
+  {
+    const ActorJoint &joint = actor.joints[j];
+    const double value = joint_values[joint.index] + angle_ * joint.direction;
+    if (value <= joint.node->getJointLimitHi() && value >= joint.node->getJointLimitLo())
+    {
+      joint_values[joint.index] = value;
+      moved = true;
+    }
+  }
+
+  for (size_t j = 0; j < actor.coupled_joints.size(); j++)
+  {
+    const CoupledJoint &joint = actor.coupled_joints[j];
+    const double value = joint_values[joint.leader] * joint.factor;
+    joint_values[joint.index] = std::max<double>(joint.node->getJointLimitLo(),
+                                                 std::min<double>(joint.node->getJointLimitHi(), value));
+  }
+  return moved;
+}
+
+//-------------------------------------------------------------------------------
+
+void HandClosing::updateCollisionModels_(Actor &actor, const std::vector<double> &joint_values)
+{
+  if (!generated_)
+  {
+    // Simox moves the nodes of the actor, the joints coupled to them and their collision models.
+    for (size_t j = 0; j < actor.joints.size(); j++)
+      actor.values[j] = static_cast<float>(joint_values[actor.joints[j].index]);
+    robot_->setJointValues(actor.nodes, actor.values);
+
+    for (size_t l = 0; l < actor.links.size(); l++)
+    {
+      const ActorLink &link = actor.links[l];
+      Eigen::Vector3f min, max;
+      transformBox_(link.col_model->getGlobalPose(), link.local_min, link.local_max, min, max);
+      links_tree_.updateLeaf(link.leaf, min, max);
+    }
+    return;
+  }
+
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  double (*poses)[12] = reinterpret_cast<double (*)[12]>(&poses_[0]);
+  if (actor.function >= 0)
+    generated_hand_fk::actor_functions[actor.function](&joint_values[0], poses);
+  else
+    generated_hand_fk::all_links(&joint_values[0], poses);
+
+  const Eigen::Matrix4f root_pose = robot_->getRootNode()->getGlobalPose();
+  for (size_t l = 0; l < actor.links.size(); l++)
+  {
+    const double *p = poses[actor.links[l].index];
+    Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 4; c++)
+        pose(r, c) = static_cast<float>(p[4 * r + c]);
+    const ActorLink &link = actor.links[l];
+    const Eigen::Matrix4f global_pose = root_pose * pose;
+    link.col_model->setGlobalPose(global_pose);
+
+    Eigen::Vector3f min, max;
+    transformBox_(global_pose, link.local_min, link.local_max, min, max);
+    links_tree_.updateLeaf(link.leaf, min, max);
+  }
+#endif
+}
+
+//-------------------------------------------------------------------------------
+
+bool HandClosing::isColliding_(size_t actor_index, CollisionModelPtr object)
+{
+  const Actor &actor = actors_[actor_index];
+
+  // Broad phase: the links whose box overlaps the box of the object.
+  near_leaves_.clear();
+  links_tree_.query(object_min_, object_max_, near_leaves_);
+  std::fill(near_object_.begin(), near_object_.end(), 0);
+  for (size_t i = 0; i < near_leaves_.size(); i++)
+    near_object_[near_leaves_[i]] = 1;
+
+  for (size_t l = 0; l < actor.links.size(); l++)
+  {
+    const ActorLink &link = actor.links[l];
+    if (!link.check_object || !near_object_[link.leaf])
+      continue;
+
+    // The box of the link in the frame of the object must touch one of its triangles.
+    if (object_bvh_)
+    {
+      Eigen::Vector3f min, max;
+      transformBox_(object_from_global_ * link.col_model->getGlobalPose(), link.local_min, link.local_max, min, max);
+      if (!object_bvh_->intersectsBox(min, max))
+        continue;
+    }
+
+    if (col_checker_->checkCollision(link.col_model, object))
+      return true;
+  }
+
+  for (size_t l = 0; l < actor.links.size(); l++)
+  {
+    const ActorLink &link = actor.links[l];
+    for (size_t m = 0; m < link.actor_col_models.size(); m++)
+    {
+      if (!links_tree_.overlaps(link.leaf, link.actor_leaves[m]))
+        continue;
+      if (col_checker_->checkCollision(link.col_model, link.actor_col_models[m]))
+        return true;
+    }
+  }
+
+  return false;
+}
+
+//-------------------------------------------------------------------------------
+
+void HandClosing::transformBox_(const Eigen::Matrix4f &pose,
+                                const Eigen::Vector3f &min, const Eigen::Vector3f &max,
+                                Eigen::Vector3f &out_min, Eigen::Vector3f &out_max)
+{
+  const Eigen::Vector3f center = pose.block<3, 3>(0, 0) * ((min + max) / 2.0f) + pose.block<3, 1>(0, 3);
+  const Eigen::Vector3f half_size = pose.block<3, 3>(0, 0).cwiseAbs() * ((max - min) / 2.0f);
+  out_min = center - half_size;
+  out_max = center + half_size;
+}
+
+//-------------------------------------------------------------------------------
+
+void HandClosing::computeLinkPoses(const std::vector<double> &joint_values,
+                                   HandClosing::PoseVector &poses) const
+{
+  poses.clear();
+#ifdef SR_GRASP_GENERATED_HAND_FK
+  double link_poses[generated_hand_fk::num_links][12];
+  generated_hand_fk::all_links(&joint_values[0], link_poses);
+
+  const Eigen::Matrix4f root_pose = robot_->getRootNode()->getGlobalPose();
+  for (int i = 0; i < generated_hand_fk::num_links; i++)
+  {
+    Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 4; c++)
+        pose(r, c) = static_cast<float>(link_poses[i][4 * r + c]);
+    poses.push_back(root_pose * pose);
+  }
+#endif
+}
+
+//-------------------------------------------------------------------------------
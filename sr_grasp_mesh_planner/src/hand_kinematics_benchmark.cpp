@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_kinematics_benchmark.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Compare the batched and the generated (by urdf_to_simox_xml) forward kinematics with Simox.
+ **/
+
+#include "sr_grasp_mesh_planner/batch_forward_kinematics.hpp"
+#include "sr_grasp_mesh_planner/hand_closing.hpp"
+#include "sr_grasp_mesh_planner/sr_approach_movement_surface_normal.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/Obstacle.h>
+#include <VirtualRobot/XML/RobotIO.h>
+
+#include <Inventor/SoDB.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "hand_kinematics_benchmark");
+  ros::NodeHandle nh("~");
+
+  SoDB::init();
+
+  std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  std::string eef_name("SHADOWHAND");
+  std::string preshape("Grasp Preshape");
+  int num_configurations;
+  int num_closings;
+  int num_approaches;
+  nh.param<std::string>("robot", robot_file, robot_file);
+  nh.param<std::string>("endeffector", eef_name, eef_name);
+  nh.param("configurations", num_configurations, 10000);
+  nh.param("closings", num_closings, 100);
+  nh.param("approaches", num_approaches, 1000);
+
+  RobotPtr robot = RobotIO::loadRobot(robot_file);
+  if (!robot)
+  {
+    ROS_FATAL_STREAM("No robot at " << robot_file);
+    return EXIT_FAILURE;
+  }
+  EndEffectorPtr eef = robot->getEndEffector(eef_name);
+  if (!eef)
+  {
+    ROS_FATAL_STREAM("No end-effector " << eef_name << " in " << robot_file);
+    return EXIT_FAILURE;
+  }
+
+  //--------------------------------------------------------
+  // Batched forward kinematics of all links.
+
+  BatchForwardKinematics batch(eef);
+  std::vector<RobotNodePtr> batch_joints;
+  for (int j = 0; j < batch.getNumJoints(); j++)
+    batch_joints.push_back(robot->getRobotNode(batch.getJointNames()[j]));
+  std::vector<RobotNodePtr> batch_links;
+  for (int l = 0; l < batch.getNumLinks(); l++)
+    batch_links.push_back(robot->getRobotNode(batch.getLinkNames()[l]));
+
+  // Random configurations within the joint limits, joint by joint.
+  std::vector<float> batch_values(batch_joints.size() * num_configurations);
+  for (size_t j = 0; j < batch_joints.size(); j++)
+  {
+    const float lo = batch_joints[j]->getJointLimitLo();
+    const float hi = batch_joints[j]->getJointLimitHi();
+    for (int c = 0; c < num_configurations; c++)
+      batch_values[j * num_configurations + c] = lo + (hi - lo) * static_cast<float>(rand()) / RAND_MAX;
+  }
+
+  std::vector<float> batch_poses;
+  ros::WallTime start = ros::WallTime::now();
+  batch.compute(batch_values, num_configurations, batch_poses);
+  const double batch_us = (ros::WallTime::now() - start).toSec() * 1.0e6 / num_configurations;
+
+  float batch_error = 0.0f;
+  const Eigen::Matrix4f robot_pose = robot->getGlobalPose();
+  std::vector<float> values(batch_joints.size());
+  start = ros::WallTime::now();
+  for (int c = 0; c < num_configurations; c++)
+  {
+    for (size_t j = 0; j < batch_joints.size(); j++)
+      values[j] = batch_values[j * num_configurations + c];
+    robot->setJointValues(batch_joints, values);
+    for (size_t l = 0; l < batch_links.size(); l++)
+    {
+      const Eigen::Matrix4f pose = robot_pose * BatchForwardKinematics::getPose(batch_poses, num_configurations, l, c);
+      const float error = (batch_links[l]->getGlobalPose().block<3, 1>(0, 3) - pose.block<3, 1>(0, 3)).norm();
+      batch_error = std::max(batch_error, error);
+    }
+  }
+  const double batch_simox_us = (ros::WallTime::now() - start).toSec() * 1.0e6 / num_configurations;
+
+  ROS_INFO_STREAM("Batched forward kinematics of " << batch_links.size() << " links, " << num_configurations <<
+                  " configurations:");
+  ROS_INFO_STREAM("  Simox:   " << batch_simox_us << " us per configuration (with the comparison)");
+  ROS_INFO_STREAM("  Batched: " << batch_us << " us per configuration");
+  ROS_INFO_STREAM("  Largest position difference: " << batch_error << " mm");
+
+  //--------------------------------------------------------
+  // Moving the hand out of a box after the approach poses, by fixed steps and adaptively.
+
+  ObstaclePtr approach_box = Obstacle::createBox(100.0f, 60.0f, 40.0f);
+  const RetractionEngine::Mode modes[] = {RetractionEngine::fixed_steps, RetractionEngine::adaptive};
+  const char *mode_names[] = {"Fixed:   ", "Adaptive:"};
+  ROS_INFO_STREAM("Approach poses on a box, " << num_approaches << " times:");
+  for (int m = 0; m < 2; m++)
+  {
+    // The same approach poses for both.
+    srand(42);
+    SrApproachMovementSurfaceNormal approach(approach_box, eef, preshape);
+    RetractionEngine::Settings settings;
+    settings.mode = modes[m];
+    approach.getRetraction().setSettings(settings);
+
+    start = ros::WallTime::now();
+    for (int a = 0; a < num_approaches; a++)
+      approach.setEEFToRandomApproachPose();
+    const double approach_ms = (ros::WallTime::now() - start).toSec() * 1.0e3;
+
+    const RetractionEngine::Stats &stats = approach.getRetraction().getStats();
+    const int retractions = std::max(stats.retractions, 1);
+    ROS_INFO_STREAM("  " << mode_names[m] << " " << approach_ms / num_approaches << " ms per pose, " <<
+                    static_cast<double>(stats.checks) / retractions << " checks and " <<
+                    stats.distance / retractions << " mm per retraction, " << stats.failures << " failure(s)");
+  }
+
+  // Without the generated forward kinematics, only the closing is compared, which then moves the robot nodes.
+  HandClosing closing(eef);
+  if (!closing.isGenerated())
+  {
+    ROS_WARN("The planner was built without the generated forward kinematics (see GENERATE_HAND_FK in README.md).");
+  }
+  else
+  {
+    std::vector<RobotNodePtr> joints;
+    for (size_t i = 0; i < closing.getJointNames().size(); i++)
+      joints.push_back(robot->getRobotNode(closing.getJointNames()[i]));
+    std::vector<CollisionModelPtr> links;
+    for (size_t i = 0; i < closing.getLinkNames().size(); i++)
+      links.push_back(robot->getRobotNode(closing.getLinkNames()[i])->getCollisionModel());
+
+    // Random configurations within the joint limits.
+    std::vector< std::vector<float> > configurations(num_configurations);
+    for (int c = 0; c < num_configurations; c++)
+    {
+      for (size_t i = 0; i < joints.size(); i++)
+      {
+        const float lo = joints[i]->getJointLimitLo();
+        const float hi = joints[i]->getJointLimitHi();
+        configurations[c].push_back(lo + (hi - lo) * static_cast<float>(rand()) / RAND_MAX);
+      }
+    }
+
+    //--------------------------------------------------------
+    // Forward kinematics of all links.
+
+    float checksum = 0.0f;
+    start = ros::WallTime::now();
+    for (int c = 0; c < num_configurations; c++)
+    {
+      robot->setJointValues(joints, configurations[c]);
+      for (size_t l = 0; l < links.size(); l++)
+      {
+        if (links[l])
+          checksum += links[l]->getGlobalPose()(0, 3);
+      }
+    }
+    const double simox_us = (ros::WallTime::now() - start).toSec() * 1.0e6 / num_configurations;
+
+    HandClosing::PoseVector poses;
+    start = ros::WallTime::now();
+    for (int c = 0; c < num_configurations; c++)
+    {
+      std::vector<double> joint_values(configurations[c].begin(), configurations[c].end());
+      closing.computeLinkPoses(joint_values, poses);
+      checksum += poses[0](0, 3);
+    }
+    const double generated_us = (ros::WallTime::now() - start).toSec() * 1.0e6 / num_configurations;
+
+    // Both must give the same poses.
+    float max_error = 0.0f;
+    for (int c = 0; c < num_configurations; c++)
+    {
+      robot->setJointValues(joints, configurations[c]);
+      std::vector<double> joint_values(configurations[c].begin(), configurations[c].end());
+      closing.computeLinkPoses(joint_values, poses);
+      for (size_t l = 0; l < links.size(); l++)
+      {
+        if (!links[l])
+          continue;
+        const float error = (links[l]->getGlobalPose().block<3, 1>(0, 3) - poses[l].block<3, 1>(0, 3)).norm();
+        max_error = std::max(max_error, error);
+      }
+    }
+
+    ROS_INFO_STREAM("Forward kinematics of " << links.size() << " links, " << num_configurations <<
+                    " configurations (checksum " << checksum << "):");
+    ROS_INFO_STREAM("  Simox:     " << simox_us << " us per configuration");
+    ROS_INFO_STREAM("  Generated: " << generated_us << " us per configuration");
+    ROS_INFO_STREAM("  Largest position difference: " << max_error << " mm");
+  }
+
+  //--------------------------------------------------------
+  // Closing the hand on a box at the grasp center point.
+
+  ObstaclePtr box = Obstacle::createBox(40.0f, 40.0f, 40.0f);
+  box->setGlobalPose(eef->getGCP()->getGlobalPose());
+
+  double simox_ms = 0.0;
+  double closing_ms = 0.0;
+  size_t simox_contacts = 0;
+  size_t closing_contacts = 0;
+  for (int c = 0; c < num_closings; c++)
+  {
+    eef->setPreshape(preshape);
+    start = ros::WallTime::now();
+    simox_contacts += eef->closeActors(box).size();
+    simox_ms += (ros::WallTime::now() - start).toSec() * 1.0e3;
+
+    eef->setPreshape(preshape);
+    start = ros::WallTime::now();
+    closing_contacts += closing.closeActors(box).size();
+    closing_ms += (ros::WallTime::now() - start).toSec() * 1.0e3;
+  }
+
+  ROS_INFO_STREAM("Closing on a box, " << num_closings << " times:");
+  ROS_INFO_STREAM("  Simox:     " << simox_ms / num_closings << " ms, " << simox_contacts << " contacts");
+  ROS_INFO_STREAM("  " << (closing.isGenerated() ? "Generated: " : "Nodes:     ") << closing_ms / num_closings <<
+                  " ms, " << closing_contacts << " contacts");
+
+  return EXIT_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_model.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The hands (robot file, end-effector and preshape) a planner can plan grasps for.
+ **/
+
+#include "sr_grasp_mesh_planner/hand_model.hpp"
+
+#include <VirtualRobot/RuntimeEnvironment.h>
+#include <VirtualRobot/XML/RobotIO.h>
+
+#include <urdf_to_simox_xml/urdf_to_simox_xml.hpp>
+
+#include <ros/package.h>
+#include <ros/ros.h>
+#include <urdf/model.h>
+#include <XmlRpcValue.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+//-------------------------------------------------------------------------------
+
+bool isUrdfRobot(const std::string &robot_file)
+{
+  return robot_file == "robot_description" || boost::algorithm::iends_with(robot_file, ".urdf");
+}
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+// Bump it when the conversion changes, for the hands converted before to be converted again.
+const int model_cache_version = 1;
+
+void hashFile(const std::string &filename, std::size_t &seed)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  boost::hash_combine(seed, filename);
+  boost::hash_combine(seed, contents);
+}
+
+/*
+ * The key of the conversion of a URDF: its contents, the contents of the meshes it refers to
+ * (package:// paths, found as the converter finds them) and the options of the conversion.
+ */
+std::size_t hashConversion(const std::string &urdf_string,
+                           const urdf::Model &urdf_model,
+                           const gsc::ConversionOptions &options)
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, model_cache_version);
+  boost::hash_combine(seed, urdf_string);
+
+  std::vector< boost::shared_ptr<urdf::Link> > links;
+  urdf_model.getLinks(links);
+  for (size_t i = 0; i < links.size(); i++)
+  {
+    if (!links[i]->visual || !links[i]->visual->geometry ||
+        links[i]->visual->geometry->type != urdf::Geometry::MESH)
+      continue;
+    const urdf::Mesh &mesh = static_cast<const urdf::Mesh&>(*links[i]->visual->geometry);
+    const std::string prefix("package://");
+    std::string filename = mesh.filename;
+    if (boost::algorithm::starts_with(filename, prefix))
+    {
+      const std::string path = filename.substr(prefix.size());
+      const std::size_t slash = path.find('/');
+      filename = ros::package::getPath(path.substr(0, slash)) +
+                 (slash == std::string::npos ? "" : path.substr(slash));
+    }
+    hashFile(filename, seed);
+  }
+
+  for (size_t i = 0; i < options.coupled_joints.size(); i++)
+    boost::hash_combine(seed, options.coupled_joints[i]);
+  boost::hash_combine(seed, options.collision_intervals);
+  boost::hash_combine(seed, options.workspace_radius);
+  boost::hash_combine(seed, options.collision_margin);
+  boost::hash_combine(seed, options.binary_models);
+  return seed;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+VirtualRobot::RobotPtr loadRobotModel(const std::string &robot_file)
+{
+  if (!isUrdfRobot(robot_file))
+    return VirtualRobot::RobotIO::loadRobot(robot_file);
+
+  const bool from_param = (robot_file == "robot_description");
+  std::string urdf_string;
+  if (from_param)
+  {
+    ros::param::get("robot_description", urdf_string);
+  }
+  else
+  {
+    std::ifstream file(robot_file.c_str());
+    urdf_string.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  }
+  urdf::Model urdf_model;
+  if (urdf_string.empty() || !urdf_model.initString(urdf_string))
+  {
+    ROS_ERROR_STREAM("Could not parse the URDF of " << robot_file << ".");
+    return VirtualRobot::RobotPtr();
+  }
+  const std::string hand_name = from_param ? urdf_model.getName() :
+                                boost::filesystem::path(robot_file).stem().string();
+
+  // Each conversion in its own directory, named after its key.
+  const gsc::ConversionOptions options;
+  std::string model_cache_dir;
+  const char *home = std::getenv("HOME");
+  ros::NodeHandle("~").param("model_cache_dir", model_cache_dir,
+                             std::string(home ? home : "/tmp") + "/.ros/sr_grasp_mesh_planner_models");
+  std::ostringstream key;
+  key << std::hex << hashConversion(urdf_string, urdf_model, options);
+  const std::string model_dir = model_cache_dir + "/" + hand_name + "_" + key.str();
+  const std::string xml_file = model_dir + "/" + hand_name + ".xml";
+
+  // The Simox XML file is written last: if it is there, the models are too.
+  if (boost::filesystem::exists(xml_file))
+  {
+    const ros::WallTime start = ros::WallTime::now();
+    VirtualRobot::RobotPtr robot = VirtualRobot::RobotIO::loadRobot(xml_file);
+    ROS_INFO_STREAM(robot_file << " was already converted to " << xml_file << ", loaded in " <<
+                    (ros::WallTime::now() - start).toSec() << " s.");
+    return robot;
+  }
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(model_dir, error);
+  if (error)
+  {
+    ROS_ERROR_STREAM("Could not create " << model_dir << ": " << error.message() << ".");
+    return VirtualRobot::RobotPtr();
+  }
+
+  const ros::WallTime start = ros::WallTime::now();
+  std::string xml;
+  try
+  {
+    gsc::UrdfToSimoxXml converter(from_param, from_param ? "" : robot_file, model_dir, 1.0);
+    converter.set_options(options);
+    xml = converter.get_xml(hand_name);
+  }
+  catch (std::exception &e)
+  {
+    ROS_ERROR_STREAM("Could not convert " << robot_file << ": " << e.what());
+    return VirtualRobot::RobotPtr();
+  }
+  const ros::WallTime converted = ros::WallTime::now();
+
+  VirtualRobot::RobotPtr robot = VirtualRobot::RobotIO::createRobotFromString(xml, model_dir);
+  ROS_INFO_STREAM("Converted " << robot_file << " in " << (converted - start).toSec() << " s, loaded in " <<
+                  (ros::WallTime::now() - converted).toSec() << " s.");
+
+  // Renamed once written, so that another planner never reads half of it.
+  if (robot)
+  {
+    const std::string tmp_file = xml_file + ".tmp";
+    std::ofstream out(tmp_file.c_str());
+    out << xml;
+    out.close();
+    if (out)
+      boost::filesystem::rename(tmp_file, xml_file, error);
+    if (!out || error)
+      ROS_WARN_STREAM("Could not write " << xml_file << ", " << robot_file << " will be converted again.");
+  }
+  return robot;
+}
+
+//-------------------------------------------------------------------------------
+
+std::string getHandFrame(VirtualRobot::RobotPtr robot)
+{
+  VirtualRobot::RobotNodePtr root = robot->getRootNode();
+  std::vector<VirtualRobot::SceneObjectPtr> children = root->getChildren();
+  for (size_t i = 0; i < children.size(); i++)
+  {
+    const std::string &name = children[i]->getName();
+    if (!boost::algorithm::ends_with(name, "_hand_tcp") && !boost::algorithm::ends_with(name, "_hand_gcp"))
+      return name;
+  }
+  return root->getName();
+}
+
+//-------------------------------------------------------------------------------
+
+HandModelPtr loadHandModel(const std::string &name,
+                           const std::string &robot_file,
+                           const std::string &eef_name,
+                           const std::string &preshape)
+{
+  std::string filename = robot_file;
+  if (filename != "robot_description" && !VirtualRobot::RuntimeEnvironment::getDataFileAbsolute(filename))
+  {
+    ROS_ERROR_STREAM("Hand " << name << ": " << robot_file << " not found.");
+    return HandModelPtr();
+  }
+
+  HandModelPtr hand(new HandModel);
+  hand->name = name;
+  hand->robot_file = filename;
+  hand->eef_name = eef_name;
+  hand->preshape = preshape;
+
+  hand->robot = loadRobotModel(filename);
+  if (!hand->robot)
+  {
+    ROS_ERROR_STREAM("Hand " << name << ": could not load " << filename << ".");
+    return HandModelPtr();
+  }
+
+  hand->eef = hand->robot->getEndEffector(eef_name);
+  if (!hand->eef)
+  {
+    ROS_ERROR_STREAM("Hand " << name << ": no end-effector " << eef_name << " in " << filename << ".");
+    return HandModelPtr();
+  }
+
+  if (!preshape.empty())
+    hand->eef->setPreshape(preshape);
+  hand->frame_id = getHandFrame(hand->robot);
+
+  return hand;
+}
+
+//-------------------------------------------------------------------------------
+
+std::vector<HandModelPtr> loadHandModels(const ros::NodeHandle &node_handle, const std::string &param)
+{
+  std::vector<HandModelPtr> hands;
+
+  XmlRpc::XmlRpcValue list;
+  if (!node_handle.getParam(param, list))
+    return hands;
+  if (list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+  {
+    ROS_ERROR_STREAM("Parameter " << param << " should be a list of hands.");
+    return hands;
+  }
+
+  for (int i = 0; i < list.size(); i++)
+  {
+    XmlRpc::XmlRpcValue &entry = list[i];
+    if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+        !entry.hasMember("robot") || !entry.hasMember("endeffector"))
+    {
+      ROS_ERROR_STREAM("Hand " << i << " of " << param << " needs a robot and an endeffector.");
+      continue;
+    }
+
+    const std::string robot_file = static_cast<std::string>(entry["robot"]);
+    const std::string eef_name = static_cast<std::string>(entry["endeffector"]);
+    const std::string name = entry.hasMember("name") ? static_cast<std::string>(entry["name"]) : eef_name;
+    const std::string preshape = entry.hasMember("preshape") ? static_cast<std::string>(entry["preshape"]) : "";
+
+    HandModelPtr hand = loadHandModel(name, robot_file, eef_name, preshape);
+    if (hand)
+    {
+      ROS_INFO_STREAM("Loaded hand " << name << " (" << eef_name << " of " << hand->robot_file << ").");
+      hands.push_back(hand);
+    }
+  }
+
+  return hands;
+}
+
+//-------------------------------------------------------------------------------
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
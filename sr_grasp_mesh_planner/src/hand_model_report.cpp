@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   hand_model_report.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Load a hand written by urdf_to_simox_xml and report how expensive its links are to plan with.
+ **/
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/Obstacle.h>
+#include <VirtualRobot/CollisionDetection/CollisionChecker.h>
+#include <VirtualRobot/Visualization/VisualizationNode.h>
+#include <VirtualRobot/Visualization/CoinVisualization/CoinVisualizationFactory.h>
+#include <VirtualRobot/XML/RobotIO.h>
+
+#include <Inventor/SoDB.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <ros/ros.h>
+#include <ros/package.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+struct LinkReport
+{
+  RobotNodePtr node;
+  size_t visual_triangles;
+  size_t collision_triangles;
+  // Size of the bounding box of the collision model (mm).
+  Eigen::Vector3f size;
+  // Time spent in the collision queries of the link, with the other links and with the object (s).
+  double self_collision_time;
+  double object_collision_time;
+};
+
+size_t numTriangles(VisualizationNodePtr visualization)
+{
+  if (!visualization || !visualization->getTriMeshModel())
+    return 0;
+  return visualization->getTriMeshModel()->faces.size();
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "hand_model_report");
+  ros::NodeHandle nh("~");
+
+  SoDB::init();
+
+  std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  std::string eef_name("SHADOWHAND");
+  std::string preshape("Grasp Preshape");
+  std::string report_file;
+  int num_configurations;
+  int num_closings;
+  nh.param<std::string>("robot", robot_file, robot_file);
+  nh.param<std::string>("endeffector", eef_name, eef_name);
+  nh.param<std::string>("preshape", preshape, preshape);
+  nh.param("configurations", num_configurations, 1000);
+  nh.param("closings", num_closings, 100);
+  boost::filesystem::path default_report(robot_file);
+  default_report.replace_extension("");
+  nh.param<std::string>("report", report_file, default_report.string() + "_report.txt");
+
+  ros::WallTime start = ros::WallTime::now();
+  RobotPtr robot = RobotIO::loadRobot(robot_file);
+  const double robot_load_time = (ros::WallTime::now() - start).toSec();
+  if (!robot)
+  {
+    ROS_FATAL_STREAM("No robot at " << robot_file);
+    return EXIT_FAILURE;
+  }
+  EndEffectorPtr eef = robot->getEndEffector(eef_name);
+  if (!eef)
+  {
+    ROS_FATAL_STREAM("No end-effector " << eef_name << " in " << robot_file);
+    return EXIT_FAILURE;
+  }
+
+  //--------------------------------------------------------
+  // Triangles and bounds of the links.
+
+  std::vector<LinkReport> links;
+  std::vector<RobotNodePtr> nodes = robot->getRobotNodes();
+  std::map<std::string, double> file_load_times;
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    VisualizationNodePtr visualization = nodes[i]->getVisualization();
+    CollisionModelPtr col_model = nodes[i]->getCollisionModel();
+    if (!visualization && !col_model)
+      continue;
+
+    LinkReport link;
+    link.node = nodes[i];
+    link.visual_triangles = numTriangles(visualization);
+    link.collision_triangles = col_model ? numTriangles(col_model->getVisualization()) : 0;
+    link.size = Eigen::Vector3f::Zero();
+    if (col_model && col_model->getTriMeshModel())
+    {
+      Eigen::Vector3f min;
+      Eigen::Vector3f max;
+      col_model->getTriMeshModel()->getSize(min, max);
+      link.size = max - min;
+    }
+    link.self_collision_time = 0.0;
+    link.object_collision_time = 0.0;
+    links.push_back(link);
+
+    // Each model file is loaded again on its own, once.
+    std::vector<std::string> filenames;
+    if (visualization)
+      filenames.push_back(visualization->getFilename());
+    if (col_model && col_model->getVisualization())
+      filenames.push_back(col_model->getVisualization()->getFilename());
+    for (size_t f = 0; f < filenames.size(); f++)
+    {
+      if (filenames[f].empty() || file_load_times.count(filenames[f]))
+        continue;
+      start = ros::WallTime::now();
+      CoinVisualizationFactory::getVisualizationFromFile(filenames[f]);
+      file_load_times[filenames[f]] = (ros::WallTime::now() - start).toSec();
+    }
+  }
+
+  //--------------------------------------------------------
+  // Collision queries of each link in random configurations, with the other links and with
+  // an object at the grasp center point. The time of a pair is shared by both links.
+
+  CollisionCheckerPtr col_checker = robot->getCollisionChecker();
+  ObstaclePtr box = Obstacle::createBox(40.0f, 40.0f, 40.0f);
+  box->setGlobalPose(eef->getGCP()->getGlobalPose());
+
+  std::vector<RobotNodePtr> joints;
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    if (nodes[i]->isRotationalJoint() || nodes[i]->isTranslationalJoint())
+      joints.push_back(nodes[i]);
+  }
+
+  size_t self_collisions = 0;
+  size_t object_collisions = 0;
+  double self_collision_time = 0.0;
+  double object_collision_time = 0.0;
+  std::vector<float> values(joints.size());
+  for (int c = 0; c < num_configurations; c++)
+  {
+    for (size_t j = 0; j < joints.size(); j++)
+    {
+      const float lo = joints[j]->getJointLimitLo();
+      const float hi = joints[j]->getJointLimitHi();
+      values[j] = lo + (hi - lo) * static_cast<float>(rand()) / RAND_MAX;
+    }
+    robot->setJointValues(joints, values);
+
+    for (size_t a = 0; a < links.size(); a++)
+    {
+      CollisionModelPtr col_model = links[a].node->getCollisionModel();
+      if (!col_model)
+        continue;
+
+      start = ros::WallTime::now();
+      object_collisions += col_checker->checkCollision(col_model, box->getCollisionModel()) ? 1 : 0;
+      const double object_time = (ros::WallTime::now() - start).toSec();
+      links[a].object_collision_time += object_time;
+      object_collision_time += object_time;
+
+      for (size_t b = a + 1; b < links.size(); b++)
+      {
+        CollisionModelPtr other = links[b].node->getCollisionModel();
+        if (!other)
+          continue;
+        start = ros::WallTime::now();
+        self_collisions += col_checker->checkCollision(col_model, other) ? 1 : 0;
+        const double pair_time = (ros::WallTime::now() - start).toSec();
+        links[a].self_collision_time += 0.5 * pair_time;
+        links[b].self_collision_time += 0.5 * pair_time;
+        self_collision_time += pair_time;
+      }
+    }
+  }
+
+  //--------------------------------------------------------
+  // Closing the hand on the object.
+
+  double closing_time = 0.0;
+  size_t closing_contacts = 0;
+  for (int c = 0; c < num_closings; c++)
+  {
+    eef->setPreshape(preshape);
+    start = ros::WallTime::now();
+    closing_contacts += eef->closeActors(box).size();
+    closing_time += (ros::WallTime::now() - start).toSec();
+  }
+
+  //--------------------------------------------------------
+  // The report. A link dominates when it takes more than twice its share of the query time.
+
+  std::ofstream report(report_file.c_str());
+  if (!report)
+  {
+    ROS_FATAL_STREAM("Cannot write " << report_file);
+    return EXIT_FAILURE;
+  }
+
+  const double query_time = self_collision_time + object_collision_time;
+  const double dominant_share = links.empty() ? 1.0 : 2.0 / links.size();
+  size_t visual_triangles = 0;
+  size_t collision_triangles = 0;
+  std::vector<std::string> dominant_links;
+
+  report << "Hand model report for " << robot_file << " (" << eef_name << ")" << std::endl << std::endl;
+  report << "Robot loaded in " << robot_load_time * 1000.0 << " ms." << std::endl << std::endl;
+  report << std::left << std::setw(32) << "link" << std::right <<
+            std::setw(10) << "visual" << std::setw(10) << "collision" <<
+            std::setw(26) << "bounding box (mm)" << std::setw(14) << "volume (cm3)" <<
+            std::setw(14) << "self (us)" << std::setw(14) << "object (us)" << std::setw(10) << "share" << std::endl;
+  for (size_t i = 0; i < links.size(); i++)
+  {
+    const LinkReport &link = links[i];
+    const double link_time = link.self_collision_time + link.object_collision_time;
+    const double share = query_time > 0.0 ? link_time / query_time : 0.0;
+    const bool dominant = share > dominant_share;
+    if (dominant)
+      dominant_links.push_back(link.node->getName());
+    visual_triangles += link.visual_triangles;
+    collision_triangles += link.collision_triangles;
+
+    std::ostringstream box_size;
+    box_size << std::fixed << std::setprecision(1) << link.size(0) << " x " << link.size(1) << " x " << link.size(2);
+    report << std::left << std::setw(32) << link.node->getName() << std::right <<
+              std::setw(10) << link.visual_triangles << std::setw(10) << link.collision_triangles <<
+              std::setw(26) << box_size.str() <<
+              std::setw(14) << std::fixed << std::setprecision(1) << link.size.prod() / 1000.0 <<
+              std::setw(14) << link.self_collision_time * 1.0e6 / num_configurations <<
+              std::setw(14) << link.object_collision_time * 1.0e6 / num_configurations <<
+              std::setw(9) << share * 100.0 << "%" << (dominant ? " *" : "") << std::endl;
+  }
+  report << std::left << std::setw(32) << "total" << std::right <<
+            std::setw(10) << visual_triangles << std::setw(10) << collision_triangles << std::endl << std::endl;
+
+  report << "Load time per file:" << std::endl;
+  for (std::map<std::string, double>::const_iterator it = file_load_times.begin(); it != file_load_times.end(); ++it)
+    report << "  " << std::setw(10) << std::setprecision(2) << it->second * 1000.0 << " ms  " << it->first << std::endl;
+  report << std::endl;
+
+  report << std::setprecision(1);
+  report << "Self-collision queries: " << self_collision_time * 1.0e6 / num_configurations <<
+            " us per configuration, " << self_collisions << " collisions in " << num_configurations <<
+            " configurations." << std::endl;
+  report << "Object queries: " << object_collision_time * 1.0e6 / num_configurations <<
+            " us per configuration, " << object_collisions << " collisions." << std::endl;
+  report << "Closing on a box at the GCP: " << closing_time * 1000.0 / std::max(num_closings, 1) << " ms, " <<
+            closing_contacts << " contacts in " << num_closings << " closings." << std::endl << std::endl;
+
+  report << "Dominant links (*, more than " << dominant_share * 100.0 << "% of the query time):";
+  for (size_t i = 0; i < dominant_links.size(); i++)
+    report << " " << dominant_links[i];
+  report << std::endl;
+
+  ROS_INFO_STREAM("Loaded " << robot_file << " in " << robot_load_time * 1000.0 << " ms: " <<
+                  visual_triangles << " visual and " << collision_triangles << " collision triangles, " <<
+                  dominant_links.size() << " dominant link(s). Report written to " << report_file << ".");
+
+  return EXIT_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------
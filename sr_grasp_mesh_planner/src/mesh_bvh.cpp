@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   mesh_bvh.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A flattened bounding volume hierarchy over the triangles of an object mesh.
+ **/
+
+#include "sr_grasp_mesh_planner/mesh_bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+const char file_magic[8] = { 'S', 'R', 'B', 'V', 'H', '0', '0', '1' };
+
+// Number of bins of the surface area heuristic.
+const int num_bins = 12;
+
+// Deeper nodes are split in the middle, so that the depth of the tree stays below max_depth.
+const int max_sah_depth = 64;
+const int max_depth = 128;
+
+float half_area(const Eigen::Vector3f &min, const Eigen::Vector3f &max)
+{
+  const Eigen::Vector3f d = (max - min).cwiseMax(Eigen::Vector3f::Zero());
+  return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+bool overlaps(const MeshBvh::Node &node, const Eigen::Vector3f &min, const Eigen::Vector3f &max)
+{
+  return node.min[0] <= max.x() && node.max[0] >= min.x() &&
+         node.min[1] <= max.y() && node.max[1] >= min.y() &&
+         node.min[2] <= max.z() && node.max[2] >= min.z();
+}
+
+// Separating axis test of a triangle against a box centered on the origin.
+bool triangle_box(const Eigen::Vector3f v[3], const Eigen::Vector3f &half_size)
+{
+  for (int k = 0; k < 3; k++)
+  {
+    if (std::min(v[0][k], std::min(v[1][k], v[2][k])) > half_size[k] ||
+        std::max(v[0][k], std::max(v[1][k], v[2][k])) < -half_size[k])
+      return false;
+  }
+
+  const Eigen::Vector3f edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+  const Eigen::Vector3f normal = edges[0].cross(edges[1]);
+  if (std::fabs(normal.dot(v[0])) > half_size.dot(normal.cwiseAbs()))
+    return false;
+
+  for (int e = 0; e < 3; e++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      const Eigen::Vector3f axis = Eigen::Vector3f::Unit(k).cross(edges[e]);
+      const float p0 = axis.dot(v[0]);
+      const float p1 = axis.dot(v[1]);
+      const float p2 = axis.dot(v[2]);
+      const float r = half_size.dot(axis.cwiseAbs());
+      if (std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r)
+        return false;
+    }
+  }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+MeshBvh::MeshBvh()
+{
+}
+
+//-------------------------------------------------------------------------------
+
+MeshBvhPtr MeshBvh::build(VirtualRobot::TriMeshModelPtr model, int max_leaf_size)
+{
+  MeshBvhPtr bvh(new MeshBvh);
+
+  bvh->vertices_.reserve(model->vertices.size() * 3);
+  for (size_t i = 0; i < model->vertices.size(); i++)
+  {
+    for (int k = 0; k < 3; k++)
+      bvh->vertices_.push_back(model->vertices[i][k]);
+  }
+
+  std::vector<BuildTriangle> triangles(model->faces.size());
+  for (size_t t = 0; t < model->faces.size(); t++)
+  {
+    const Eigen::Vector3f &a = model->vertices[model->faces[t].id1];
+    const Eigen::Vector3f &b = model->vertices[model->faces[t].id2];
+    const Eigen::Vector3f &c = model->vertices[model->faces[t].id3];
+    triangles[t].min = a.cwiseMin(b).cwiseMin(c);
+    triangles[t].max = a.cwiseMax(b).cwiseMax(c);
+    triangles[t].centroid = (a + b + c) / 3.0f;
+    triangles[t].index = t;
+  }
+
+  bvh->triangles_.reserve(model->faces.size() * 3);
+  if (!triangles.empty())
+  {
+    bvh->nodes_.reserve(2 * triangles.size() / std::max(1, max_leaf_size) + 1);
+    bvh->build_(triangles, 0, triangles.size(), std::max(1, max_leaf_size), 0);
+  }
+
+  // The vertex indices of the faces, in the order of the leaves.
+  std::vector<boost::uint32_t> leaf_order;
+  leaf_order.swap(bvh->triangles_);
+  for (size_t i = 0; i < leaf_order.size(); i++)
+  {
+    const VirtualRobot::MathTools::TriangleFace &face = model->faces[leaf_order[i]];
+    bvh->triangles_.push_back(face.id1);
+    bvh->triangles_.push_back(face.id2);
+    bvh->triangles_.push_back(face.id3);
+  }
+
+  return bvh;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshBvh::build_(std::vector<BuildTriangle> &triangles,
+                     std::size_t begin,
+                     std::size_t end,
+                     int max_leaf_size,
+                     int depth)
+{
+  const std::size_t node_index = nodes_.size();
+  nodes_.push_back(Node());
+
+  Eigen::Vector3f min = triangles[begin].min;
+  Eigen::Vector3f max = triangles[begin].max;
+  Eigen::Vector3f centroid_min = triangles[begin].centroid;
+  Eigen::Vector3f centroid_max = triangles[begin].centroid;
+  for (std::size_t t = begin + 1; t < end; t++)
+  {
+    min = min.cwiseMin(triangles[t].min);
+    max = max.cwiseMax(triangles[t].max);
+    centroid_min = centroid_min.cwiseMin(triangles[t].centroid);
+    centroid_max = centroid_max.cwiseMax(triangles[t].centroid);
+  }
+  for (int k = 0; k < 3; k++)
+  {
+    nodes_[node_index].min[k] = min[k];
+    nodes_[node_index].max[k] = max[k];
+  }
+
+  const std::size_t count = end - begin;
+  if (count <= static_cast<std::size_t>(max_leaf_size))
+  {
+    // Only the face indices for now, see build.
+    nodes_[node_index].offset = triangles_.size();
+    nodes_[node_index].count = count;
+    for (std::size_t t = begin; t < end; t++)
+      triangles_.push_back(triangles[t].index);
+    return;
+  }
+
+  // Binned surface area heuristic: the split with the lowest cost on any axis.
+  int best_axis = -1;
+  int best_bin = 0;
+  float best_cost = std::numeric_limits<float>::max();
+  for (int axis = 0; axis < 3 && depth < max_sah_depth; axis++)
+  {
+    const float extent = centroid_max[axis] - centroid_min[axis];
+    if (extent <= 0.0f)
+      continue;
+    const float scale = num_bins / extent;
+
+    std::size_t bin_count[num_bins] = { 0 };
+    Eigen::Vector3f bin_min[num_bins];
+    Eigen::Vector3f bin_max[num_bins];
+    for (int b = 0; b < num_bins; b++)
+    {
+      bin_min[b] = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+      bin_max[b] = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    }
+    for (std::size_t t = begin; t < end; t++)
+    {
+      const int b = std::min(num_bins - 1, static_cast<int>((triangles[t].centroid[axis] - centroid_min[axis]) * scale));
+      bin_count[b]++;
+      bin_min[b] = bin_min[b].cwiseMin(triangles[t].min);
+      bin_max[b] = bin_max[b].cwiseMax(triangles[t].max);
+    }
+
+    // Areas of the right side of each split, then sweep from the left.
+    float right_area[num_bins];
+    std::size_t right_count[num_bins];
+    Eigen::Vector3f right_min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f right_max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    std::size_t right_sum = 0;
+    for (int b = num_bins - 1; b > 0; b--)
+    {
+      right_min = right_min.cwiseMin(bin_min[b]);
+      right_max = right_max.cwiseMax(bin_max[b]);
+      right_sum += bin_count[b];
+      right_area[b] = half_area(right_min, right_max);
+      right_count[b] = right_sum;
+    }
+
+    Eigen::Vector3f left_min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f left_max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    std::size_t left_sum = 0;
+    for (int b = 1; b < num_bins; b++)
+    {
+      left_min = left_min.cwiseMin(bin_min[b - 1]);
+      left_max = left_max.cwiseMax(bin_max[b - 1]);
+      left_sum += bin_count[b - 1];
+      if (left_sum == 0 || right_count[b] == 0)
+        continue;
+      const float cost = left_sum * half_area(left_min, left_max) + right_count[b] * right_area[b];
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+      }
+    }
+  }
+
+  std::size_t middle = begin + count / 2;
+  if (best_axis >= 0)
+  {
+    const float scale = num_bins / (centroid_max[best_axis] - centroid_min[best_axis]);
+    std::size_t left = begin;
+    std::size_t right = end;
+    while (left < right)
+    {
+      const int b = std::min(num_bins - 1,
+                             static_cast<int>((triangles[left].centroid[best_axis] - centroid_min[best_axis]) * scale));
+      if (b < best_bin)
+        left++;
+      else
+        std::swap(triangles[left], triangles[--right]);
+    }
+    middle = left;
+    if (middle == begin || middle == end)
+      middle = begin + count / 2;
+  }
+
+  nodes_[node_index].count = 0;
+  this->build_(triangles, begin, middle, max_leaf_size, depth + 1);
+  nodes_[node_index].offset = nodes_.size();
+  this->build_(triangles, middle, end, max_leaf_size, depth + 1);
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t MeshBvh::getNumNodes() const
+{
+  return nodes_.size();
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t MeshBvh::getNumTriangles() const
+{
+  return triangles_.size() / 3;
+}
+
+//-------------------------------------------------------------------------------
+
+Eigen::Vector3f MeshBvh::getMin() const
+{
+  if (nodes_.empty())
+    return Eigen::Vector3f::Zero();
+  return Eigen::Vector3f(nodes_[0].min[0], nodes_[0].min[1], nodes_[0].min[2]);
+}
+
+//-------------------------------------------------------------------------------
+
+Eigen::Vector3f MeshBvh::getMax() const
+{
+  if (nodes_.empty())
+    return Eigen::Vector3f::Zero();
+  return Eigen::Vector3f(nodes_[0].max[0], nodes_[0].max[1], nodes_[0].max[2]);
+}
+
+//-------------------------------------------------------------------------------
+
+bool MeshBvh::overlapsBounds(const Eigen::Vector3f &min, const Eigen::Vector3f &max) const
+{
+  return !nodes_.empty() && overlaps(nodes_[0], min, max);
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshBvh::triangle_(std::size_t t, Eigen::Vector3f &a, Eigen::Vector3f &b, Eigen::Vector3f &c) const
+{
+  const float *va = &vertices_[3 * triangles_[3 * t]];
+  const float *vb = &vertices_[3 * triangles_[3 * t + 1]];
+  const float *vc = &vertices_[3 * triangles_[3 * t + 2]];
+  a = Eigen::Vector3f(va[0], va[1], va[2]);
+  b = Eigen::Vector3f(vb[0], vb[1], vb[2]);
+  c = Eigen::Vector3f(vc[0], vc[1], vc[2]);
+}
+
+//-------------------------------------------------------------------------------
+
+bool MeshBvh::intersectsBox(const Eigen::Vector3f &min, const Eigen::Vector3f &max) const
+{
+  if (nodes_.empty())
+    return false;
+
+  const Eigen::Vector3f center = (min + max) / 2.0f;
+  const Eigen::Vector3f half_size = (max - min) / 2.0f;
+
+  boost::uint32_t stack[max_depth];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0)
+  {
+    const Node &node = nodes_[stack[--stack_size]];
+    if (!overlaps(node, min, max))
+      continue;
+
+    if (node.count == 0)
+    {
+      const boost::uint32_t index = &node - &nodes_[0];
+      stack[stack_size++] = node.offset;
+      stack[stack_size++] = index + 1;
+      continue;
+    }
+
+    for (boost::uint32_t t = node.offset; t < node.offset + node.count; t++)
+    {
+      Eigen::Vector3f v[3];
+      this->triangle_(t, v[0], v[1], v[2]);
+      for (int k = 0; k < 3; k++)
+        v[k] -= center;
+      if (triangle_box(v, half_size))
+        return true;
+    }
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
+
+float MeshBvh::raycast(const Eigen::Vector3f &origin,
+                       const Eigen::Vector3f &direction,
+                       float max_distance) const
+{
+  float best = max_distance;
+  if (nodes_.empty())
+    return best;
+
+  const Eigen::Vector3f inverse(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+
+  boost::uint32_t stack[max_depth];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0)
+  {
+    const Node &node = nodes_[stack[--stack_size]];
+
+    // Slab test, skipping nodes behind a closer hit.
+    float t_min = 0.0f;
+    float t_max = best;
+    for (int k = 0; k < 3; k++)
+    {
+      float t0 = (node.min[k] - origin[k]) * inverse[k];
+      float t1 = (node.max[k] - origin[k]) * inverse[k];
+      if (t0 > t1)
+        std::swap(t0, t1);
+      t_min = std::max(t_min, t0);
+      t_max = std::min(t_max, t1);
+    }
+    if (t_min > t_max)
+      continue;
+
+    if (node.count == 0)
+    {
+      const boost::uint32_t index = &node - &nodes_[0];
+      stack[stack_size++] = node.offset;
+      stack[stack_size++] = index + 1;
+      continue;
+    }
+
+    // Moller-Trumbore.
+    for (boost::uint32_t t = node.offset; t < node.offset + node.count; t++)
+    {
+      Eigen::Vector3f a, b, c;
+      this->triangle_(t, a, b, c);
+      const Eigen::Vector3f e1 = b - a;
+      const Eigen::Vector3f e2 = c - a;
+      const Eigen::Vector3f p = direction.cross(e2);
+      const float det = e1.dot(p);
+      if (std::fabs(det) < 1.0e-9f)
+        continue;
+      const Eigen::Vector3f s = origin - a;
+      const float u = s.dot(p) / det;
+      if (u < 0.0f || u > 1.0f)
+        continue;
+      const Eigen::Vector3f q = s.cross(e1);
+      const float v = direction.dot(q) / det;
+      if (v < 0.0f || u + v > 1.0f)
+        continue;
+      const float distance = e2.dot(q) / det;
+      if (distance >= 0.0f && distance < best)
+        best = distance;
+    }
+  }
+  return best;
+}
+
+//-------------------------------------------------------------------------------
+
+bool MeshBvh::save(const std::string &filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out)
+  {
+    ROS_WARN_STREAM("Failed to open " << filename << " for writing.");
+    return false;
+  }
+
+  const boost::uint32_t sizes[3] = { static_cast<boost::uint32_t>(nodes_.size()),
+                                     static_cast<boost::uint32_t>(vertices_.size()),
+                                     static_cast<boost::uint32_t>(triangles_.size()) };
+  out.write(file_magic, sizeof(file_magic));
+  out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+  if (!nodes_.empty())
+    out.write(reinterpret_cast<const char*>(&nodes_[0]), nodes_.size() * sizeof(Node));
+  if (!vertices_.empty())
+    out.write(reinterpret_cast<const char*>(&vertices_[0]), vertices_.size() * sizeof(float));
+  if (!triangles_.empty())
+    out.write(reinterpret_cast<const char*>(&triangles_[0]), triangles_.size() * sizeof(boost::uint32_t));
+  return static_cast<bool>(out);
+}
+
+//-------------------------------------------------------------------------------
+
+MeshBvhPtr MeshBvh::load(const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (!in)
+    return MeshBvhPtr();
+
+  char magic[sizeof(file_magic)];
+  boost::uint32_t sizes[3];
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+  if (!in || std::memcmp(magic, file_magic, sizeof(file_magic)) != 0 || sizes[2] % 3 != 0)
+  {
+    ROS_WARN_STREAM(filename << " is not a mesh BVH.");
+    return MeshBvhPtr();
+  }
+
+  MeshBvhPtr bvh(new MeshBvh);
+  bvh->nodes_.resize(sizes[0]);
+  bvh->vertices_.resize(sizes[1]);
+  bvh->triangles_.resize(sizes[2]);
+  if (sizes[0] > 0)
+    in.read(reinterpret_cast<char*>(&bvh->nodes_[0]), sizes[0] * sizeof(Node));
+  if (sizes[1] > 0)
+    in.read(reinterpret_cast<char*>(&bvh->vertices_[0]), sizes[1] * sizeof(float));
+  if (sizes[2] > 0)
+    in.read(reinterpret_cast<char*>(&bvh->triangles_[0]), sizes[2] * sizeof(boost::uint32_t));
+  if (!in)
+  {
+    ROS_WARN_STREAM(filename << " is truncated.");
+    return MeshBvhPtr();
+  }
+
+  // Do not trust the indices of a damaged file.
+  for (size_t i = 0; i < bvh->triangles_.size(); i++)
+  {
+    if (3 * static_cast<std::size_t>(bvh->triangles_[i]) + 2 >= bvh->vertices_.size())
+    {
+      ROS_WARN_STREAM(filename << " is not a valid mesh BVH.");
+      return MeshBvhPtr();
+    }
+  }
+  // Children come after their parent, so the depths are known in order.
+  std::vector<int> depths(bvh->nodes_.size(), 0);
+  for (size_t i = 0; i < bvh->nodes_.size(); i++)
+  {
+    const Node &node = bvh->nodes_[i];
+    const bool valid = (node.count == 0) ? (node.offset > i + 1 && node.offset < bvh->nodes_.size() &&
+                                            depths[i] + 1 < max_depth)
+                                         : (node.offset + node.count <= bvh->triangles_.size() / 3);
+    if (!valid)
+    {
+      ROS_WARN_STREAM(filename << " is not a valid mesh BVH.");
+      return MeshBvhPtr();
+    }
+    if (node.count == 0)
+      depths[i + 1] = depths[node.offset] = depths[i] + 1;
+  }
+
+  return bvh;
+}
+
+//-------------------------------------------------------------------------------
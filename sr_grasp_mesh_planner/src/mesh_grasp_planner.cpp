@@ -0,0 +1,1051 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   mesh_grasp_planner.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The Simox-based grasp planner, without any window.
+ **/
+
+#include "sr_grasp_mesh_planner/mesh_grasp_planner.hpp"
+#include "sr_grasp_mesh_planner/grasp_sample_job.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
+#include "sr_grasp_mesh_planner/PlannerConfig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+#include <Eigen/Geometry>
+
+#include <GraspPlanning/ContactConeGenerator.h>
+
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace std;
+using namespace VirtualRobot;
+using namespace GraspStudio;
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+// Best first.
+bool compareGraspQuality(const GraspPtr &a, const GraspPtr &b)
+{
+  return a->getQuality() > b->getQuality();
+}
+
+// The robustness score if the grasp has one, else its quality.
+float graspScore(const GraspPtr &grasp)
+{
+  ApproachGraspPtr approach_grasp = boost::dynamic_pointer_cast<ApproachGrasp>(grasp);
+  if (approach_grasp && approach_grasp->getNumRobustnessSamples() > 0)
+    return approach_grasp->getRobustness();
+  return grasp->getQuality();
+}
+
+// Best first.
+bool compareGraspRobustness(const GraspPtr &a, const GraspPtr &b)
+{
+  return graspScore(a) > graspScore(b);
+}
+
+// The seed of the perturbations of a request, apart from the seeds of its hands.
+unsigned int perturbationSeed(unsigned int seed)
+{
+  std::size_t perturbation_seed = seed;
+  boost::hash_combine(perturbation_seed, std::string("robustness"));
+  return static_cast<unsigned int>(perturbation_seed);
+}
+
+// retraction and retraction_step of the node handle, defaults if not set.
+RetractionEngine::Settings readRetraction(const ros::NodeHandle &nh, const RetractionEngine::Settings &defaults)
+{
+  RetractionEngine::Settings settings = defaults;
+  std::string mode;
+  if (nh.getParam("retraction", mode))
+  {
+    if (mode == "fixed")
+      settings.mode = RetractionEngine::fixed_steps;
+    else if (mode == "adaptive")
+      settings.mode = RetractionEngine::adaptive;
+    else
+      ROS_WARN_STREAM("Unknown retraction " << mode << " in " << nh.getNamespace() << ", " <<
+                      (defaults.mode == RetractionEngine::fixed_steps ? "fixed" : "adaptive") << " is used.");
+  }
+  double step;
+  if (nh.getParam("retraction_step", step))
+    settings.step = static_cast<float>(step);
+  return settings;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+MeshGraspPlanner::MeshGraspPlanner(const string &robFile,
+                                   const string &eefName,
+                                   const string &preshape,
+                                   VirtualRobot::TriMeshModelPtr triMeshModel,
+                                   WorkStealingSchedulerPtr scheduler)
+  : listener_(NULL),
+
+  robotFile_(robFile),
+  eefName_(eefName),
+  preshape_(preshape),
+
+  hand_closed_(false),
+  hand_quality_(0.0f),
+  hand_force_closure_(false),
+  object_key_(0),
+
+  scheduler_(scheduler),
+
+  grasp_counter_(0),
+  approach_distance_(0.0f),
+  min_approach_distance_(0.0f),
+  seed_grasps_(true)
+{
+  ROS_INFO_STREAM(" Start MeshGraspPlanner ");
+
+  ros::NodeHandle("~").param<std::string>("object_library", object_library_, "");
+
+  double marker_rate;
+  std::string marker_frame;
+  ros::NodeHandle private_nh("~");
+  private_nh.param<double>("marker_rate", marker_rate, 5.0);
+  private_nh.param<std::string>("marker_frame", marker_frame, "object");
+  markers_.reset(new GraspMarkerPublisher(private_nh, marker_rate, marker_frame));
+
+  std::string reachability_map;
+  ros::NodeHandle("~").param<std::string>("reachability_map", reachability_map, "");
+  if (!reachability_map.empty())
+    reachability_ = ReachabilityMap::load(reachability_map);
+
+  ros::NodeHandle("~").param<std::string>("approach_prior", approach_prior_file_, "");
+  if (!approach_prior_file_.empty())
+    approach_prior_ = ApproachPrior::load(approach_prior_file_);
+
+  // The settings of all the generators, then of each of them.
+  const RetractionEngine::Settings retraction = readRetraction(ros::NodeHandle("~"), RetractionEngine::Settings());
+  bounding_box_retraction_ = readRetraction(ros::NodeHandle("~bounding_box"), retraction);
+  surface_normal_retraction_ = readRetraction(ros::NodeHandle("~surface_normal"), retraction);
+
+  ros::NodeHandle("~").param("seed_grasps", seed_grasps_, true);
+
+  // init the random number generator
+  srand(time(NULL));
+
+  loadRobot_();
+
+  // The other hands goals can be planned with.
+  std::vector<HandModelPtr> hands = loadHandModels(ros::NodeHandle("~"), "hands");
+  for (size_t i = 0; i < hands.size(); i++)
+  {
+    bool duplicate = false;
+    for (size_t j = 0; j < hands_.size(); j++)
+      duplicate = duplicate || hands_[j]->name == hands[i]->name;
+    if (duplicate)
+      ROS_WARN_STREAM("There is already a hand named " << hands[i]->name << ", it is not loaded again.");
+    else
+      hands_.push_back(hands[i]);
+  }
+  for (size_t i = 0; i < hands_.size(); i++)
+    enabled_hands_.push_back(static_cast<int>(i));
+
+  // Load a temporary object.
+  int approach_movement = 0;
+  loadObject(triMeshModel, approach_movement);
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setListener(Listener *listener)
+{
+  listener_ = listener;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::loadObject(const object_recognition_msgs::RecognizedObject &object,
+                                  int approach_movement)
+{
+  this->setObject(this->prepareObject(object, approach_movement));
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::loadObject(VirtualRobot::TriMeshModelPtr triMeshModel,
+                                  int approach_movement)
+{
+  this->setObject(this->prepareObject(triMeshModel, approach_movement));
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr MeshGraspPlanner::prepareObject(const object_recognition_msgs::RecognizedObject &object,
+                                                  int approach_movement)
+{
+  const shape_msgs::Mesh& obj_mesh = object.bounding_mesh;
+  TriMeshModelPtr triMeshModel = MeshObstacle::create_tri_mesh(obj_mesh);
+  PreparedObjectPtr prepared = this->prepareObject(triMeshModel, approach_movement, MeshObstacle::hash_mesh(obj_mesh));
+  setRecognizedPose(*prepared, object.pose);
+  return prepared;
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr MeshGraspPlanner::prepareObject(VirtualRobot::TriMeshModelPtr triMeshModel,
+                                                  int approach_movement,
+                                                  std::size_t key)
+{
+  boost::mutex::scoped_lock lock(prepare_mutex_);
+
+  PreparedObjectPtr prepared(new PreparedObject);
+  prepared->key = key;
+  prepared->approach_movement = approach_movement;
+
+  // Simox uses MM while ROS uses M. So convert from M to MM.
+  for (unsigned int i = 0; i < triMeshModel->vertices.size(); i++)
+  {
+    float x_MM = triMeshModel->vertices[i].x() * 1000.0; // M to MM
+    float y_MM = triMeshModel->vertices[i].y() * 1000.0; // M to MM
+    float z_MM = triMeshModel->vertices[i].z() * 1000.0; // M to MM
+    triMeshModel->vertices[i] << x_MM, y_MM, z_MM;
+  }
+
+  prepared->bvh = this->getMeshBvh_(key, triMeshModel);
+  prepared->shape_frame = ShapeFrame::compute(triMeshModel);
+  if (seed_grasps_)
+    prepared->seeds = computeSeedApproaches(prepared->shape_frame);
+  prepared->approach_prior = replay_prior_ ? replay_prior_ : approach_prior_;
+  prepared->retraction = (approach_movement == Planner_bounding_box) ? bounding_box_retraction_
+                                                                    : surface_normal_retraction_;
+
+  const bool show_normals = true;
+  prepared->object = MeshObstacle::create_mesh_obstacle(triMeshModel, !show_normals);
+
+  Eigen::Vector3f minS, maxS;
+  prepared->object->getCollisionModel()->getTriMeshModel()->getSize(minS, maxS);
+  ROS_INFO_STREAM("TriMeshModel minS: [" << minS[0] << ", " << minS[1] << ", " << minS[2] << "]");
+  ROS_INFO_STREAM("TriMeshModel MaxS: [" << maxS[0] << ", " << maxS[1] << ", " << maxS[2] << "]");
+
+  prepared->quality_measure.reset(new GraspStudio::GraspQualityMeasureWrenchSpace(prepared->object));
+  // prepared->quality_measure->setVerbose(true);
+  prepared->quality_measure->calculateObjectProperties();
+
+  // Set approach movement generator (see cfg/Planner.cfg).
+  prepared->approach = createApproachMovement(approach_movement, prepared->object, eef_,
+                                              prepared->approach_prior, prepared->shape_frame,
+                                              prepared->retraction);
+  if (approach_movement == Planner_bounding_box)
+    ROS_INFO_STREAM("Choose the Bounding box based approach movement generator.");
+  else if (approach_movement == Planner_surface_normal)
+    ROS_INFO_STREAM("Choose the Object surface normal based approach movement generator.");
+
+  // The contexts of the workers are built on first use (see GraspSampleJob).
+  prepared->contexts.resize(hands_.size(),
+                           std::vector< boost::shared_ptr<SampleContext> >(scheduler_->num_workers()));
+
+  return prepared;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::size_t MeshGraspPlanner::max_cached_bvhs_ = 32;
+
+MeshBvhPtr MeshGraspPlanner::getMeshBvh_(std::size_t key, VirtualRobot::TriMeshModelPtr triMeshModel)
+{
+  // Without a key, the mesh cannot be recognized later: build it for this object only.
+  if (key == 0)
+    return MeshBvh::build(triMeshModel);
+
+  std::map<std::size_t, MeshBvhPtr>::const_iterator cached = bvh_cache_.find(key);
+  if (cached != bvh_cache_.end())
+    return cached->second;
+
+  std::string filename;
+  if (!object_library_.empty())
+  {
+    std::ostringstream name;
+    name << object_library_ << "/" << std::hex << std::setw(2 * sizeof(std::size_t)) << std::setfill('0')
+         << key << ".bvh";
+    filename = name.str();
+  }
+
+  const ros::WallTime start = ros::WallTime::now();
+  MeshBvhPtr bvh;
+  if (!filename.empty())
+    bvh = MeshBvh::load(filename);
+  if (bvh && bvh->getNumTriangles() != triMeshModel->faces.size())
+  {
+    ROS_WARN_STREAM("The BVH in " << filename << " does not match the mesh, it is built again.");
+    bvh.reset();
+  }
+
+  if (bvh)
+  {
+    ROS_INFO_STREAM("Loaded the BVH of the object from " << filename << " in "
+                    << (ros::WallTime::now() - start).toSec() * 1000.0 << "ms.");
+  }
+  else
+  {
+    bvh = MeshBvh::build(triMeshModel);
+    ROS_INFO_STREAM("Built the BVH of the object (" << bvh->getNumTriangles() << " triangles, "
+                    << bvh->getNumNodes() << " nodes) in "
+                    << (ros::WallTime::now() - start).toSec() * 1000.0 << "ms.");
+    if (!filename.empty() && !bvh->save(filename))
+      ROS_WARN_STREAM("Could not save the BVH of the object to " << filename << ".");
+  }
+
+  bvh_cache_[key] = bvh;
+  bvh_keys_.push_back(key);
+  if (bvh_keys_.size() > max_cached_bvhs_)
+  {
+    bvh_cache_.erase(bvh_keys_.front());
+    bvh_keys_.pop_front();
+  }
+  return bvh;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setObject(PreparedObjectPtr prepared)
+{
+  {
+    boost::mutex::scoped_lock lock(object_mutex_);
+
+    object_key_ = prepared->key;
+    object_ = prepared->object;
+    qualityMeasure_ = prepared->quality_measure;
+    approach_ = prepared->approach;
+    prepared_ = prepared;
+    markers_->setObject(prepared);
+
+    eefCloned_ = approach_->getEEFRobotClone();
+    contacts_.clear();
+    hand_closed_ = false;
+    if (robot_ && eef_)
+    {
+      string name = "Grasp Planner - ";
+      name += eef_->getName();
+      grasps_.reset(new GraspSet(name, robot_->getType(), eefName_));
+    }
+  }
+
+  if (listener_)
+    listener_->objectChanged();
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t MeshGraspPlanner::getObjectKey() const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  return object_key_;
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr MeshGraspPlanner::getObject() const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  return prepared_;
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t MeshGraspPlanner::getGraspKey(std::size_t mesh_key,
+                                          const geometry_msgs::PoseWithCovarianceStamped &pose) const
+{
+  // As GraspSampleJob, which only checks the reachability of objects in the frame of the map.
+  if (!reachability_ || pose.header.frame_id != reachability_->getFrameId())
+    return mesh_key;
+
+  std::size_t key = mesh_key;
+  boost::hash_combine(key, reachability_->hashPose(pose.header.frame_id, getRecognizedPose(pose)));
+  return key;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::loadRobot_()
+{
+  robot_.reset();
+  robot_ = loadRobotModel(robotFile_);
+  if (!robot_)
+  {
+    VR_ERROR << " no robot at " << robotFile_ << endl;
+    return;
+  }
+  eef_ = robot_->getEndEffector(eefName_);
+  if (!preshape_.empty())
+  {
+    eef_->setPreshape(preshape_);
+  }
+
+  HandModelPtr hand(new HandModel);
+  hand->name = eefName_;
+  hand->robot_file = robotFile_;
+  hand->eef_name = eefName_;
+  hand->preshape = preshape_;
+  hand->robot = robot_;
+  hand->eef = eef_;
+  hand->frame_id = getHandFrame(robot_);
+  hands_.assign(1, hand);
+}
+
+//-------------------------------------------------------------------------------
+
+vector<GraspPtr> MeshGraspPlanner::plan(bool force_closure,
+                                        float timeout,
+                                        float min_quality,
+                                        unsigned int seed,
+                                        boost::shared_ptr<sr_robot_msgs::PlanGraspFeedback> feedback_mesh,
+                                        boost::shared_ptr<sr_robot_msgs::PlanGraspResult> result_mesh,
+                                        AdaptiveQualityThresholdPtr threshold)
+{
+  {
+    boost::mutex::scoped_lock lock(object_mutex_);
+    feedback_mesh_ = feedback_mesh;
+    result_mesh_ = result_mesh;
+    if (grasps_)
+      grasps_->removeAllGrasps();
+    markers_->clearGrasps();
+  }
+
+  if (listener_)
+    listener_->graspsCleared();
+
+  return this->plan(force_closure, timeout, min_quality, seed, threshold);
+}
+
+//-------------------------------------------------------------------------------
+
+vector<GraspPtr> MeshGraspPlanner::plan(bool force_closure,
+                                        float timeout,
+                                        float min_quality,
+                                        unsigned int seed,
+                                        AdaptiveQualityThresholdPtr threshold)
+{
+  PreparedObjectPtr prepared = this->getObject();
+
+  // Start!
+  clock_t begin = clock();
+
+  /*
+   * Parameter num_of_desired_grasp_sets is set in class GraspActionServer.
+   * For every set, we generate ONE grasp.
+   */
+  const int nrDesiredGrasps = 1;
+
+  // The robustness of the grasps of a goal is scored once they are all planned (see scoreGrasps).
+  vector<GraspPtr> planned = this->sampleGrasps_(prepared,
+                                                 nrDesiredGrasps,
+                                                 force_closure,
+                                                 timeout,
+                                                 min_quality,
+                                                 seed,
+                                                 1.0,
+                                                 threshold);
+  if (planned.size() > static_cast<size_t>(nrDesiredGrasps))
+    planned.resize(nrDesiredGrasps);
+
+  // The TCP poses of the grasps of the first hand, for the listener.
+  std::vector<Eigen::Matrix4f> shown;
+  bool hand_moved = false;
+  {
+    boost::mutex::scoped_lock lock(object_mutex_);
+
+    // The object may have been changed while planning.
+    if (prepared != prepared_)
+      return vector<GraspPtr>();
+
+    for (size_t i=0; i < planned.size(); i++)
+    {
+      // m is the pose of the grasp applied to the global object pose,
+      // resulting in the global TCP pose which is related to the grasp.
+      Eigen::Matrix4f m = planned[i]->getTcpPoseGlobal(object_->getGlobalPose());
+
+      ApproachGraspPtr approach_grasp = boost::dynamic_pointer_cast<ApproachGrasp>(planned[i]);
+      if (approach_grasp)
+        markers_->addGrasp(m, approach_grasp->getApproachDirection(), planned[i]->getQuality());
+
+      // Only the grasps of the first hand are kept in grasps_.
+      if (this->getHand_(planned[i]) != hands_.front())
+        continue;
+
+      grasps_->addGrasp(planned[i]);
+      shown.push_back(m);
+    }
+    grasps_->setPreshape(preshape_);
+
+    //--------------------------------------------------------
+
+    // nrComputedGrasps should be one.
+    feedback_mesh_->number_of_synthesized_grasps += planned.size();
+    for (size_t i=0; i < planned.size(); i++)
+    {
+      // Save the current moveit_msgs::Grasp.
+      result_mesh_->grasps.push_back(this->createGraspMsg(planned[i]));
+    }
+
+    //--------------------------------------------------------
+
+    // Set to the last valid grasp.
+    if (grasps_->getSize()>0 && eefCloned_ && eefCloned_->getEndEffector(eefName_))
+    {
+      int last_idx = grasps_->getSize() - 1;
+      // last_m is the pose of the grasp applied to the global object pose,
+      // resulting in the global TCP pose which is related to the grasp.
+      Eigen::Matrix4f last_m = grasps_->getGrasp(last_idx)->getTcpPoseGlobal(object_->getGlobalPose());
+      // Now the eef can be set to a position so that it's TCP is at last_m.
+      eefCloned_->setGlobalPoseForRobotNode(eefCloned_->getEndEffector(eefName_)->getTcp(), last_m);
+
+      this->openHand_();
+      this->closeHand_();
+      hand_moved = true;
+    }
+  }
+
+  if (listener_)
+  {
+    if (!shown.empty())
+      listener_->graspsPlanned(shown);
+    if (hand_moved)
+      listener_->handChanged();
+  }
+
+  clock_t end = clock();
+  ROS_INFO_STREAM("Grasp planning took " << static_cast<double>(diffclock(end, begin)) << " ms.");
+
+  return planned;
+}
+
+//-------------------------------------------------------------------------------
+
+vector<GraspPtr> MeshGraspPlanner::planGrasps(PreparedObjectPtr prepared,
+                                              int nrGrasps,
+                                              bool force_closure,
+                                              float timeout,
+                                              float min_quality,
+                                              unsigned int seed,
+                                              double weight,
+                                              AdaptiveQualityThresholdPtr threshold)
+{
+  RobustnessJob::Settings robustness;
+  {
+    boost::mutex::scoped_lock lock(settings_mutex_);
+    robustness = robustness_;
+  }
+
+  vector<GraspPtr> planned = this->sampleGrasps_(prepared,
+                                                 nrGrasps,
+                                                 force_closure,
+                                                 timeout,
+                                                 min_quality,
+                                                 seed,
+                                                 weight,
+                                                 threshold);
+
+  // The best grasps of all the hands.
+  if (robustness.num_samples > 0 && !planned.empty())
+  {
+    this->scoreGrasps_(prepared, planned, force_closure, robustness, perturbationSeed(seed), weight);
+    std::stable_sort(planned.begin(), planned.end(), compareGraspRobustness);
+  }
+  if (planned.size() > static_cast<size_t>(nrGrasps))
+    planned.resize(nrGrasps);
+
+  return planned;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::scoreGrasps(const std::vector<VirtualRobot::GraspPtr> &grasps,
+                                   bool force_closure,
+                                   unsigned int seed,
+                                   std::vector<moveit_msgs::Grasp>::iterator msgs)
+{
+  RobustnessJob::Settings robustness;
+  {
+    boost::mutex::scoped_lock lock(settings_mutex_);
+    robustness = robustness_;
+  }
+  if (robustness.num_samples <= 0 || grasps.empty())
+    return;
+
+  this->scoreGrasps_(this->getObject(), grasps, force_closure, robustness, perturbationSeed(seed), 1.0);
+  for (size_t i = 0; i < grasps.size(); i++, ++msgs)
+    msgs->grasp_quality = graspScore(grasps[i]);
+}
+
+//-------------------------------------------------------------------------------
+
+vector<GraspPtr> MeshGraspPlanner::sampleGrasps_(PreparedObjectPtr prepared,
+                                                 int nrGrasps,
+                                                 bool force_closure,
+                                                 float timeout,
+                                                 float min_quality,
+                                                 unsigned int seed,
+                                                 double weight,
+                                                 AdaptiveQualityThresholdPtr threshold)
+{
+  if (!prepared || !prepared->object || nrGrasps <= 0)
+    return vector<GraspPtr>();
+
+  float approach_distance, min_approach_distance;
+  std::vector<int> enabled_hands;
+  {
+    boost::mutex::scoped_lock lock(settings_mutex_);
+    approach_distance = approach_distance_;
+    min_approach_distance = min_approach_distance_;
+    enabled_hands = enabled_hands_;
+  }
+  if (enabled_hands.empty())
+    return vector<GraspPtr>();
+
+  // Only the samples on the loaded object are shown, not the speculative ones.
+  GraspMarkerPublisherPtr markers = (prepared == this->getObject()) ? markers_ : GraspMarkerPublisherPtr();
+
+  // One job per hand, sharing the weight of the request, each with its own seed.
+  std::vector<GraspSampleJobPtr> jobs;
+  for (size_t h = 0; h < enabled_hands.size(); h++)
+  {
+    std::size_t hand_seed = seed;
+    boost::hash_combine(hand_seed, h);
+    GraspSampleJobPtr job(new GraspSampleJob(prepared,
+                                             hands_[enabled_hands[h]]->eef,
+                                             enabled_hands[h],
+                                             scheduler_->num_workers(),
+                                             nrGrasps,
+                                             force_closure,
+                                             min_quality,
+                                             timeout,
+                                             static_cast<unsigned int>(hand_seed),
+                                             approach_distance,
+                                             min_approach_distance,
+                                             reachability_,
+                                             threshold,
+                                             markers));
+    scheduler_->add_job(job, weight / enabled_hands.size());
+    jobs.push_back(job);
+  }
+
+  vector<GraspPtr> planned;
+  for (size_t h = 0; h < jobs.size(); h++)
+  {
+    vector<GraspPtr> grasps = jobs[h]->wait();
+    // Stop the samples still running on timeout.
+    jobs[h]->cancel();
+    planned.insert(planned.end(), grasps.begin(), grasps.end());
+
+    ROS_DEBUG_STREAM("Hand " << hands_[enabled_hands[h]]->name << ": planned " << grasps.size() <<
+                     " grasp(s) out of " << jobs[h]->getNumSamples() << " samples (shape class " <<
+                     prepared->shape_frame.shape_class << "), " <<
+                     jobs[h]->getNumBlocked() << " dropped for a blocked approach.");
+    if (jobs[h]->getTimeToFirstGrasp() >= 0.0)
+      ROS_DEBUG_STREAM("First grasp after " << jobs[h]->getTimeToFirstGrasp() * 1000.0 << " ms, " <<
+                       jobs[h]->getNumSeedGrasps() << " grasp(s) from the seeds.");
+    if (jobs[h]->getNumRetractions() > 0)
+      ROS_DEBUG_STREAM("Moved the hand out of the object " << jobs[h]->getNumRetractions() << " time(s) with " <<
+                       jobs[h]->getNumRetractionChecks() << " collision checks.");
+    if (jobs[h]->getNumUnreachable() > 0)
+      ROS_INFO_STREAM("Rejected " << jobs[h]->getNumUnreachable() <<
+                      " unreachable approach pose(s) before closing the hand.");
+  }
+
+  if (jobs.size() > 1)
+    std::stable_sort(planned.begin(), planned.end(), compareGraspQuality);
+  return planned;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::scoreGrasps_(PreparedObjectPtr prepared,
+                                    const std::vector<VirtualRobot::GraspPtr> &grasps,
+                                    bool force_closure,
+                                    const RobustnessJob::Settings &settings,
+                                    unsigned int seed,
+                                    double weight)
+{
+  if (!prepared || grasps.empty())
+    return;
+
+  std::vector<EndEffectorPtr> eefs;
+  for (size_t i = 0; i < hands_.size(); i++)
+    eefs.push_back(hands_[i]->eef);
+  // The hand of each grasp, the first one if unknown.
+  std::vector<int> hands(grasps.size(), 0);
+  for (size_t g = 0; g < grasps.size(); g++)
+  {
+    const HandModelPtr hand = this->getHand_(grasps[g]);
+    for (size_t i = 0; i < hands_.size(); i++)
+    {
+      if (hands_[i] == hand)
+        hands[g] = static_cast<int>(i);
+    }
+  }
+
+  // All the grasps on the same perturbations of the object, on the workers, within one budget.
+  RobustnessJobPtr job(new RobustnessJob(prepared,
+                                         eefs,
+                                         hands,
+                                         scheduler_->num_workers(),
+                                         grasps,
+                                         force_closure,
+                                         settings,
+                                         seed));
+  scheduler_->add_job(job, weight);
+  const int num_evaluated = job->wait();
+
+  ROS_DEBUG_STREAM("Evaluated " << num_evaluated << " of " << grasps.size() * settings.num_samples <<
+                   " perturbations.");
+  for (size_t i = 0; i < grasps.size(); i++)
+  {
+    ApproachGraspPtr grasp = boost::dynamic_pointer_cast<ApproachGrasp>(grasps[i]);
+    if (grasp && grasp->getNumRobustnessSamples() > 0)
+      ROS_DEBUG_STREAM("  " << grasp->getName() << ": quality " << grasp->getQuality() << ", robustness " <<
+                       grasp->getRobustness() << " (variance " << grasp->getRobustnessVariance() << ", " <<
+                       grasp->getNumRobustnessSamples() << " perturbations)");
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+moveit_msgs::Grasp MeshGraspPlanner::createGraspMsg(GraspPtr grasp)
+{
+  moveit_msgs::Grasp grasp_msg;
+
+  HandModelPtr hand = this->getHand_(grasp);
+  if (!hand)
+    hand = hands_.front();
+  EndEffectorPtr eef = hand->eef;
+
+  // A name for this grasp, prefixed by its hand when there are several.
+  {
+    boost::mutex::scoped_lock lock(grasp_counter_mutex_);
+    grasp_msg.id = string("grasp_") + boost::lexical_cast<string>(grasp_counter_);
+    if (hands_.size() > 1)
+      grasp_msg.id = hand->name + "/" + grasp_msg.id;
+    grasp_counter_++;
+  }
+
+  // The position of the end-effector for the grasp.
+  grasp_msg.grasp_pose.header.stamp = ros::Time::now();
+
+  // The internal posture of the hand before the grasp.
+  // positions and efforts (not set here) are used.
+  if (eef->hasPreshape("Grasp Preshape"))
+  {
+    trajectory_msgs::JointTrajectory pre_grasp_posture;
+    pre_grasp_posture.header.stamp = grasp_msg.grasp_pose.header.stamp;
+    // Get the configuration of the grasp.
+    trajectory_msgs::JointTrajectoryPoint pre_grasp_point;
+
+    map<string, float> robotNodeJointValueMap = eef->getPreshape("Grasp Preshape")->getRobotNodeJointValueMap();
+    for (map<string, float>::const_iterator it = robotNodeJointValueMap.begin();
+         it != robotNodeJointValueMap.end();
+         ++it)
+    {
+      // Set joint name.
+      pre_grasp_posture.joint_names.push_back(it->first);
+      // Set position (i.e., angle).
+      pre_grasp_point.positions.push_back(it->second); // Unit is radian
+    }
+    if (!pre_grasp_posture.joint_names.empty())
+      pre_grasp_posture.points.push_back(pre_grasp_point);
+    // Set the pre-grasp posture.
+    grasp_msg.pre_grasp_posture = pre_grasp_posture;
+  }
+
+  // The internal posture of the hand for the grasp.
+  // positions and efforts (not set here) are used.
+  trajectory_msgs::JointTrajectory grasp_posture;
+  grasp_posture.header.stamp = grasp_msg.grasp_pose.header.stamp;
+  // Get the configuration of the grasp.
+  trajectory_msgs::JointTrajectoryPoint grasp_point;
+
+  map<string, float> configuration = grasp->getConfiguration();
+  for (map<string, float>::const_iterator it = configuration.begin();
+       it != configuration.end();
+       ++it)
+  {
+    // Set joint name.
+    grasp_posture.joint_names.push_back(it->first);
+    // Set position (i.e., angle).
+    grasp_point.positions.push_back(it->second); // Unit is radian
+  }
+  if (!grasp_posture.joint_names.empty())
+    grasp_posture.points.push_back(grasp_point);
+  // Set the grasp posture.
+  grasp_msg.grasp_posture = grasp_posture;
+
+  // Get the transformation of this grasp.
+  // The transformation is given in the coordinate system of the tcp,
+  // whereas the tcp belongs to the eef.
+  // This transformation specifies the tcp to object relation.
+  Eigen::Matrix4f poseTcp = grasp->getTransformation();
+
+  // We obtain the translation from the base link to the TCP, to be able to get the grasp pose in the frame of the hand
+  // We do it this way because the TCP we have defined doesn't match any of the robot links' frames
+  RobotNodePtr frame = hand->robot->getRobotNode(hand->frame_id);
+  Eigen::Matrix4f framePoseTcp = frame->toLocalCoordinateSystem(eef->getTcp()->getGlobalPose());
+
+  Eigen::Matrix4f poseToSave = poseTcp;
+  // Set pose.position.
+  grasp_msg.grasp_pose.header.frame_id = hand->frame_id;
+  grasp_msg.grasp_pose.pose.position.x = (poseToSave(0,3) + framePoseTcp(0,3)) / 1000.0; // /1000 as ros msg is in meters instead of mm
+  grasp_msg.grasp_pose.pose.position.y = (poseToSave(1,3) + framePoseTcp(1,3)) / 1000.0;
+  grasp_msg.grasp_pose.pose.position.z = (poseToSave(2,3) + framePoseTcp(2,3)) / 1000.0;
+  // Set pose.orientation.
+  MathTools::Quaternion q = MathTools::eigen4f2quat(poseToSave);
+  grasp_msg.grasp_pose.pose.orientation.x = q.x;
+  grasp_msg.grasp_pose.pose.orientation.y = q.y;
+  grasp_msg.grasp_pose.pose.orientation.z = q.z;
+  grasp_msg.grasp_pose.pose.orientation.w = q.w;
+
+  // The estimated probability of success for this grasp: its robustness score when it was evaluated.
+  grasp_msg.grasp_quality = graspScore(grasp);
+
+  // The straight approach checked by the planner (see ApproachClearance), from the frame of the TCP, which is
+  // not a frame of the robot, to the frame of the grasp pose. The hand retreats the way it came.
+  ApproachGraspPtr approach_grasp = boost::dynamic_pointer_cast<ApproachGrasp>(grasp);
+  if (approach_grasp && approach_grasp->getClearDistance() > 0.0f)
+  {
+    const Eigen::Vector3f direction = framePoseTcp.block<3, 3>(0, 0) * approach_grasp->getApproachDirection();
+
+    grasp_msg.pre_grasp_approach.direction.header.stamp = grasp_msg.grasp_pose.header.stamp;
+    grasp_msg.pre_grasp_approach.direction.header.frame_id = grasp_msg.grasp_pose.header.frame_id;
+    grasp_msg.pre_grasp_approach.direction.vector.x = direction.x();
+    grasp_msg.pre_grasp_approach.direction.vector.y = direction.y();
+    grasp_msg.pre_grasp_approach.direction.vector.z = direction.z();
+    grasp_msg.pre_grasp_approach.desired_distance = approach_grasp->getClearDistance() / 1000.0; // MM to M
+    grasp_msg.pre_grasp_approach.min_distance = approach_grasp->getMinDistance() / 1000.0; // MM to M
+
+    grasp_msg.post_grasp_retreat = grasp_msg.pre_grasp_approach;
+    grasp_msg.post_grasp_retreat.direction.vector.x = -direction.x();
+    grasp_msg.post_grasp_retreat.direction.vector.y = -direction.y();
+    grasp_msg.post_grasp_retreat.direction.vector.z = -direction.z();
+  }
+
+  return grasp_msg;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::saveApproachPrior()
+{
+  if (approach_prior_ && !approach_prior_->save(approach_prior_file_))
+    ROS_WARN_STREAM("Could not save the approach prior to " << approach_prior_file_ << ".");
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setReplayApproachPrior(const std::string &filename)
+{
+  boost::mutex::scoped_lock lock(prepare_mutex_);
+  if (filename == replay_prior_file_)
+    return;
+
+  replay_prior_file_ = filename;
+  replay_prior_.reset();
+  if (filename.empty())
+    return;
+
+  replay_prior_ = ApproachPrior::load(filename);
+  if (replay_prior_)
+    ROS_INFO_STREAM("Replaying with the approach prior of " << filename << " (" << replay_prior_->getNumGrasps() <<
+                    " grasps).");
+  else
+    ROS_WARN_STREAM("Could not read the approach prior of " << filename << ", ~approach_prior is used.");
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setApproachDistances(float approach_distance, float min_approach_distance)
+{
+  boost::mutex::scoped_lock lock(settings_mutex_);
+  approach_distance_ = approach_distance;
+  min_approach_distance_ = min_approach_distance;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setRobustness(const RobustnessJob::Settings &settings)
+{
+  boost::mutex::scoped_lock lock(settings_mutex_);
+  robustness_ = settings;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::setHands(const std::string &names)
+{
+  std::vector<int> enabled_hands;
+  std::stringstream ss(names);
+  std::string name;
+  while (std::getline(ss, name, ','))
+  {
+    name.erase(0, name.find_first_not_of(" "));
+    name.erase(name.find_last_not_of(" ") + 1);
+    if (name.empty())
+      continue;
+
+    bool found = false;
+    for (size_t i = 0; i < hands_.size(); i++)
+    {
+      if (hands_[i]->name != name)
+        continue;
+      found = true;
+      if (std::find(enabled_hands.begin(), enabled_hands.end(), static_cast<int>(i)) == enabled_hands.end())
+        enabled_hands.push_back(static_cast<int>(i));
+    }
+    if (!found)
+      ROS_WARN_STREAM("No hand named " << name << ", it is ignored.");
+  }
+
+  // All the hands by default.
+  if (enabled_hands.empty())
+  {
+    for (size_t i = 0; i < hands_.size(); i++)
+      enabled_hands.push_back(static_cast<int>(i));
+  }
+
+  boost::mutex::scoped_lock lock(settings_mutex_);
+  enabled_hands_ = enabled_hands;
+}
+
+//-------------------------------------------------------------------------------
+
+HandModelPtr MeshGraspPlanner::getHand_(GraspPtr grasp) const
+{
+  for (size_t i = 0; i < hands_.size(); i++)
+  {
+    if (grasp->getEefName() == hands_[i]->eef->getName() &&
+        grasp->getRobotType() == hands_[i]->robot->getType())
+      return hands_[i];
+  }
+  return HandModelPtr();
+}
+
+//-------------------------------------------------------------------------------
+
+VirtualRobot::EndEffectorPtr MeshGraspPlanner::getEEF() const
+{
+  return eef_;
+}
+
+//-------------------------------------------------------------------------------
+
+VirtualRobot::GraspSetPtr MeshGraspPlanner::getGraspSet() const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  return grasps_;
+}
+
+//-------------------------------------------------------------------------------
+
+VirtualRobot::RobotPtr MeshGraspPlanner::getHandClone() const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  return eefCloned_;
+}
+
+//-------------------------------------------------------------------------------
+
+EndEffector::ContactInfoVector MeshGraspPlanner::getContacts() const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  return contacts_;
+}
+
+//-------------------------------------------------------------------------------
+
+bool MeshGraspPlanner::getHandQuality(float &quality, bool &force_closure) const
+{
+  boost::mutex::scoped_lock lock(object_mutex_);
+  quality = hand_quality_;
+  force_closure = hand_force_closure_;
+  return hand_closed_;
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::openHand()
+{
+  {
+    boost::mutex::scoped_lock lock(object_mutex_);
+    this->openHand_();
+  }
+  if (listener_)
+    listener_->handChanged();
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::closeHand()
+{
+  {
+    boost::mutex::scoped_lock lock(object_mutex_);
+    this->closeHand_();
+  }
+  if (listener_)
+    listener_->handChanged();
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::openHand_()
+{
+  contacts_.clear();
+  hand_closed_ = false;
+  if (eefCloned_ && eefCloned_->getEndEffector(eefName_))
+  {
+    eefCloned_->getEndEffector(eefName_)->openActors();
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void MeshGraspPlanner::closeHand_()
+{
+  contacts_.clear();
+  if (eefCloned_ && eefCloned_->getEndEffector(eefName_))
+  {
+    contacts_ = eefCloned_->getEndEffector(eefName_)->closeActors(object_);
+    ContactConeGeneratorPtr cg = qualityMeasure_->getConeGenerator();
+    markers_->setContacts(contacts_, cg->getConeHeight(), cg->getConeRadius());
+
+    // The last computed quality is retrieved with
+    hand_quality_ = qualityMeasure_->getGraspQuality();
+    hand_force_closure_ = qualityMeasure_->isGraspForceClosure();
+    hand_closed_ = true;
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+double MeshGraspPlanner::diffclock(clock_t clock1, clock_t clock2)
+{
+  double diffticks=clock1-clock2;
+  double diffms=(diffticks*1000)/CLOCKS_PER_SEC;
+  return diffms;
+}
+
+//-------------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 #include <string>
 #include <iostream>
 #include <boost/assign/list_of.hpp>
+#include <boost/functional/hash.hpp>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <ros/ros.h>
@@ -166,6 +167,33 @@ TriMeshModelPtr MeshObstacle::create_tri_mesh(const shape_msgs::Mesh &mesh_msg)
 
 //-------------------------------------------------------------------------------
 
+std::size_t MeshObstacle::hash_mesh(const shape_msgs::Mesh &mesh_msg)
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, mesh_msg.vertices.size());
+  boost::hash_combine(seed, mesh_msg.triangles.size());
+
+  for (size_t i = 0; i < mesh_msg.vertices.size(); i++)
+  {
+    const geometry_msgs::Point &p = mesh_msg.vertices[i];
+    boost::hash_combine(seed, p.x);
+    boost::hash_combine(seed, p.y);
+    boost::hash_combine(seed, p.z);
+  }
+
+  for (size_t i = 0; i < mesh_msg.triangles.size(); i++)
+  {
+    const shape_msgs::MeshTriangle &triangle = mesh_msg.triangles[i];
+    boost::hash_combine(seed, triangle.vertex_indices[0]);
+    boost::hash_combine(seed, triangle.vertex_indices[1]);
+    boost::hash_combine(seed, triangle.vertex_indices[2]);
+  }
+
+  return seed;
+}
+
+//-------------------------------------------------------------------------------
+
 void MeshObstacle::write_tri_mesh(TriMeshModelPtr model, std::string filename)
 {
   std::ofstream outf(filename.c_str());
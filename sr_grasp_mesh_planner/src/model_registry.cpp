@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   model_registry.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  The meshes of known objects, by recognition key, loaded once from disk.
+ **/
+
+#include "sr_grasp_mesh_planner/model_registry.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
+#include "sr_grasp_mesh_planner/read_ply.hpp"
+
+#include <ros/ros.h>
+
+#include <boost/filesystem.hpp>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+int ModelRegistry::load(const std::string &directory)
+{
+  boost::system::error_code error;
+  boost::filesystem::directory_iterator it(directory, error);
+  if (error)
+  {
+    ROS_ERROR_STREAM("Could not read the model registry " << directory << ": " << error.message() << ".");
+    return 0;
+  }
+
+  int num_loaded = 0;
+  for (; it != boost::filesystem::directory_iterator(); ++it)
+  {
+    const boost::filesystem::path &path = it->path();
+    if (path.extension() != ".ply")
+      continue;
+
+    ReadPLY reader;
+    if (reader.load(path.string().c_str()) != 0)
+    {
+      ROS_WARN_STREAM("Could not read the model " << path.string() << ", it is not registered.");
+      continue;
+    }
+
+    boost::shared_ptr<Model> model(new Model);
+    model->key = path.stem().string();
+    model->filename = path.string();
+    model->mesh.triangles.resize(reader.total_triangles_);
+    for (int i = 0; i < reader.total_triangles_; i++)
+    {
+      model->mesh.triangles[i].vertex_indices[0] = reader.triangles_[i].n1;
+      model->mesh.triangles[i].vertex_indices[1] = reader.triangles_[i].n2;
+      model->mesh.triangles[i].vertex_indices[2] = reader.triangles_[i].n3;
+    }
+    model->mesh.vertices.resize(reader.total_vertices_);
+    for (int i = 0; i < reader.total_vertices_; i++)
+    {
+      model->mesh.vertices[i].x = reader.vertices_[i].x;
+      model->mesh.vertices[i].y = reader.vertices_[i].y;
+      model->mesh.vertices[i].z = reader.vertices_[i].z;
+    }
+    model->mesh_key = MeshObstacle::hash_mesh(model->mesh);
+
+    boost::mutex::scoped_lock lock(mutex_);
+    models_[model->key] = model;
+    prepared_.erase(model->key);
+    num_loaded++;
+    ROS_INFO_STREAM("Registered the model " << model->key << " (" << reader.total_triangles_ << " triangles).");
+  }
+  return num_loaded;
+}
+
+//-------------------------------------------------------------------------------
+
+ModelRegistry::ModelConstPtr ModelRegistry::find(const std::string &key) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::map<std::string, ModelConstPtr>::const_iterator it = models_.find(key);
+  return (it != models_.end()) ? it->second : ModelConstPtr();
+}
+
+//-------------------------------------------------------------------------------
+
+std::vector<std::string> ModelRegistry::getKeys() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::vector<std::string> keys;
+  for (std::map<std::string, ModelConstPtr>::const_iterator it = models_.begin(); it != models_.end(); ++it)
+    keys.push_back(it->first);
+  return keys;
+}
+
+//-------------------------------------------------------------------------------
+
+PreparedObjectPtr ModelRegistry::getPrepared(const std::string &key, int approach_movement) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::map<std::string, PreparedObjectPtr>::const_iterator it = prepared_.find(key);
+  if (it == prepared_.end() || it->second->approach_movement != approach_movement)
+    return PreparedObjectPtr();
+  return it->second;
+}
+
+//-------------------------------------------------------------------------------
+
+void ModelRegistry::setPrepared(const std::string &key, PreparedObjectPtr prepared)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  prepared_[key] = prepared;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   prepared_object.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Everything the grasp planner needs for an object, built before planning starts.
+ **/
+
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/sr_approach_movement_bounding_box.hpp"
+#include "sr_grasp_mesh_planner/sr_approach_movement_surface_normal.hpp"
+#include "sr_grasp_mesh_planner/PlannerConfig.h"
+
+#include <Eigen/Geometry>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+//-------------------------------------------------------------------------------
+
+GraspStudio::ApproachMovementSurfaceNormalPtr createApproachMovement(int approach_movement,
+                                                                     VirtualRobot::SceneObjectPtr object,
+                                                                     VirtualRobot::EndEffectorPtr eef,
+                                                                     ApproachPriorPtr prior,
+                                                                     const ShapeFrame &shape_frame,
+                                                                     const RetractionEngine::Settings &retraction)
+{
+  GraspStudio::ApproachMovementSurfaceNormalPtr approach;
+
+  /*
+   * Planner_bounding_box : Bounding box based approach movement generator.
+   * Planner_surface_normal : Object surface normal based approach movement generator.
+   */
+  if (approach_movement == Planner_bounding_box)
+  {
+    boost::shared_ptr<SrApproachMovementBoundingBox> bounding_box(new SrApproachMovementBoundingBox(object, eef));
+    bounding_box->setPrior(prior, shape_frame);
+    bounding_box->getRetraction().setSettings(retraction);
+    approach = bounding_box;
+  }
+  else if (approach_movement == Planner_surface_normal)
+  {
+    boost::shared_ptr<SrApproachMovementSurfaceNormal> surface_normal(new SrApproachMovementSurfaceNormal(object, eef));
+    surface_normal->setPrior(prior, shape_frame);
+    surface_normal->getRetraction().setSettings(retraction);
+    approach = surface_normal;
+  }
+  else
+    ROS_ERROR_STREAM("Unknown approach movement generator " << approach_movement << ".");
+
+  return approach;
+}
+
+//-------------------------------------------------------------------------------
+
+Eigen::Matrix4f getRecognizedPose(const geometry_msgs::PoseWithCovarianceStamped &pose)
+{
+  const geometry_msgs::Pose &p = pose.pose.pose;
+  Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+  m.block<3, 3>(0, 0) = Eigen::Quaternionf(p.orientation.w,
+                                           p.orientation.x,
+                                           p.orientation.y,
+                                           p.orientation.z).normalized().toRotationMatrix();
+  m.block<3, 1>(0, 3) = Eigen::Vector3f(p.position.x, p.position.y, p.position.z) * 1000.0f; // M to MM
+  return m;
+}
+
+//-------------------------------------------------------------------------------
+
+void setRecognizedPose(PreparedObject &prepared, const geometry_msgs::PoseWithCovarianceStamped &pose)
+{
+  prepared.frame_id = pose.header.frame_id;
+  prepared.pose = getRecognizedPose(pose);
+}
+
+//-------------------------------------------------------------------------------
+
+RetractionEngine *getRetractionEngine(GraspStudio::ApproachMovementSurfaceNormalPtr approach)
+{
+  boost::shared_ptr<SrApproachMovementBoundingBox> bounding_box =
+    boost::dynamic_pointer_cast<SrApproachMovementBoundingBox>(approach);
+  if (bounding_box)
+    return &bounding_box->getRetraction();
+  boost::shared_ptr<SrApproachMovementSurfaceNormal> surface_normal =
+    boost::dynamic_pointer_cast<SrApproachMovementSurfaceNormal>(approach);
+  if (surface_normal)
+    return &surface_normal->getRetraction();
+  return NULL;
+}
+
+//-------------------------------------------------------------------------------
+
+boost::mt19937 *getRandomGenerator(GraspStudio::ApproachMovementSurfaceNormalPtr approach)
+{
+  boost::shared_ptr<SrApproachMovementBoundingBox> bounding_box =
+    boost::dynamic_pointer_cast<SrApproachMovementBoundingBox>(approach);
+  if (bounding_box)
+    return &bounding_box->getRandom();
+  boost::shared_ptr<SrApproachMovementSurfaceNormal> surface_normal =
+    boost::dynamic_pointer_cast<SrApproachMovementSurfaceNormal>(approach);
+  if (surface_normal)
+    return &surface_normal->getRandom();
+  return NULL;
+}
+
+//-------------------------------------------------------------------------------
+
+bool getSampledPosition(GraspStudio::ApproachMovementSurfaceNormalPtr approach,
+                        Eigen::Vector3f &position,
+                        Eigen::Vector3f &approach_direction)
+{
+  boost::shared_ptr<SrApproachMovementBoundingBox> bounding_box =
+    boost::dynamic_pointer_cast<SrApproachMovementBoundingBox>(approach);
+  if (bounding_box)
+  {
+    position = bounding_box->getSampledPosition();
+    approach_direction = bounding_box->getSampledApproachDir();
+    return true;
+  }
+  boost::shared_ptr<SrApproachMovementSurfaceNormal> surface_normal =
+    boost::dynamic_pointer_cast<SrApproachMovementSurfaceNormal>(approach);
+  if (surface_normal)
+  {
+    position = surface_normal->getSampledPosition();
+    approach_direction = surface_normal->getSampledApproachDir();
+    return true;
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   reachability_map.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A precomputed map of the hand poses the arm can reach, read from a file.
+ **/
+
+#include "sr_grasp_mesh_planner/reachability_map.hpp"
+
+#include <Eigen/Geometry>
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+const char file_magic[8] = { 'S', 'R', 'R', 'E', 'A', 'C', 'H', '1' };
+const std::size_t frame_id_size = 64;
+
+struct FileHeader
+{
+  char magic[8];
+  char frame_id[frame_id_size];
+  float origin[3];
+  float voxel_size;
+  boost::uint32_t size[3];
+  boost::uint32_t num_azimuth;
+  boost::uint32_t num_polar;
+};
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+ReachabilityMap::ReachabilityMap()
+  : data_(MAP_FAILED),
+    size_(0),
+    voxel_size_(0.0f),
+    num_azimuth_(0),
+    num_polar_(0),
+    cells_(NULL)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+ReachabilityMap::~ReachabilityMap()
+{
+  if (data_ != MAP_FAILED)
+    munmap(data_, size_);
+}
+
+//-------------------------------------------------------------------------------
+
+ReachabilityMapPtr ReachabilityMap::load(const std::string &filename)
+{
+  ReachabilityMapPtr map;
+
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    ROS_WARN_STREAM("Could not open the reachability map " << filename << ".");
+    return map;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(FileHeader))
+  {
+    ROS_WARN_STREAM(filename << " is not a reachability map.");
+    close(fd);
+    return map;
+  }
+
+  map.reset(new ReachabilityMap);
+  map->size_ = static_cast<std::size_t>(status.st_size);
+  map->data_ = mmap(NULL, map->size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid once the file is closed.
+  close(fd);
+  if (map->data_ == MAP_FAILED)
+  {
+    ROS_WARN_STREAM("Could not map the reachability map " << filename << ".");
+    return ReachabilityMapPtr();
+  }
+
+  FileHeader header;
+  std::memcpy(&header, map->data_, sizeof(header));
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+      !(header.voxel_size > 0.0f) || header.num_azimuth == 0 || header.num_polar == 0)
+  {
+    ROS_WARN_STREAM(filename << " is not a reachability map.");
+    return ReachabilityMapPtr();
+  }
+
+  // The number of cells, checked against the size of the file without overflowing.
+  std::size_t num_cells = 1;
+  const std::size_t dims[5] = { header.size[0], header.size[1], header.size[2], header.num_azimuth, header.num_polar };
+  for (int i = 0; i < 5; i++)
+  {
+    if (dims[i] == 0 || num_cells > (map->size_ - sizeof(FileHeader)) / dims[i])
+    {
+      ROS_WARN_STREAM(filename << " is truncated.");
+      return ReachabilityMapPtr();
+    }
+    num_cells *= dims[i];
+  }
+
+  map->frame_id_.assign(header.frame_id, strnlen(header.frame_id, frame_id_size));
+  map->origin_ = Eigen::Vector3f(header.origin[0], header.origin[1], header.origin[2]) * 1000.0f; // M to MM
+  map->voxel_size_ = header.voxel_size * 1000.0f; // M to MM
+  for (int i = 0; i < 3; i++)
+    map->grid_size_[i] = header.size[i];
+  map->num_azimuth_ = header.num_azimuth;
+  map->num_polar_ = header.num_polar;
+  map->cells_ = static_cast<const boost::uint8_t*>(map->data_) + sizeof(FileHeader);
+
+  ROS_INFO_STREAM("Loaded the reachability map " << filename << " (" << header.size[0] << "x" << header.size[1] <<
+                  "x" << header.size[2] << " voxels of " << header.voxel_size << "m, " <<
+                  header.num_azimuth * header.num_polar << " directions) in frame " << map->frame_id_ << ".");
+  return map;
+}
+
+//-------------------------------------------------------------------------------
+
+const std::string &ReachabilityMap::getFrameId() const
+{
+  return frame_id_;
+}
+
+//-------------------------------------------------------------------------------
+
+bool ReachabilityMap::isReachable(const Eigen::Vector3f &position, const Eigen::Vector3f &approach_direction) const
+{
+  std::size_t index = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    const float voxel = std::floor((position(i) - origin_(i)) / voxel_size_);
+    if (!(voxel >= 0.0f && voxel < static_cast<float>(grid_size_[i])))
+      return false;
+    index = index * grid_size_[i] + static_cast<std::size_t>(voxel);
+  }
+
+  const float norm = approach_direction.norm();
+  if (!(norm > 0.0f))
+    return false;
+  const float azimuth = std::atan2(approach_direction.y(), approach_direction.x());
+  const float polar = std::acos(std::max(-1.0f, std::min(1.0f, approach_direction.z() / norm)));
+
+  boost::uint32_t a = static_cast<boost::uint32_t>((azimuth + M_PI) / (2.0 * M_PI) * num_azimuth_);
+  boost::uint32_t p = static_cast<boost::uint32_t>(polar / M_PI * num_polar_);
+  a = std::min(a, num_azimuth_ - 1);
+  p = std::min(p, num_polar_ - 1);
+
+  index = (index * num_polar_ + p) * num_azimuth_ + a;
+  return cells_[index] != 0;
+}
+
+//-------------------------------------------------------------------------------
+
+std::size_t ReachabilityMap::hashPose(const std::string &frame_id, const Eigen::Matrix4f &pose) const
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, frame_id);
+  for (int i = 0; i < 3; i++)
+    boost::hash_combine(seed, static_cast<long>(std::floor((pose(i, 3) - origin_(i)) / voxel_size_)));
+
+  // A rotation by an angle changes the quaternion by about half of it.
+  Eigen::Quaternionf q(Eigen::Matrix3f(pose.block<3, 3>(0, 0)));
+  if (q.w() < 0.0f)
+    q.coeffs() *= -1.0f;
+  const float step = static_cast<float>(M_PI) / num_azimuth_;
+  for (int i = 0; i < 4; i++)
+    boost::hash_combine(seed, static_cast<long>(std::floor(q.coeffs()(i) / step + 0.5f)));
+  return seed;
+}
+
+//-------------------------------------------------------------------------------
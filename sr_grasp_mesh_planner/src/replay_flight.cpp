@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   replay_flight.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Send the goal of a bundle saved by the flight recorder to the planner again.
+ **/
+
+#include <sr_robot_msgs/PlanGraspAction.h>
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <actionlib/client/simple_action_client.h>
+#include <dynamic_reconfigure/Reconfigure.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+/*!
+ * Set the dynamic reconfigure settings of the planner for the replay (none to only read them),
+ * as dynparam set does. Returns all its settings as they are then.
+ */
+bool reconfigure(const std::string &planner, dynamic_reconfigure::Config &config)
+{
+  dynamic_reconfigure::Reconfigure srv;
+  srv.request.config = config;
+  if (!ros::service::call(planner + "/set_parameters", srv))
+  {
+    ROS_ERROR_STREAM("Could not reconfigure " << planner << ".");
+    return false;
+  }
+  config = srv.response.config;
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+dynamic_reconfigure::Config replaySettings(bool use_cache, const std::string &approach_prior)
+{
+  dynamic_reconfigure::Config config;
+  dynamic_reconfigure::BoolParameter cache;
+  cache.name = "use_cache";
+  cache.value = use_cache;
+  config.bools.push_back(cache);
+  dynamic_reconfigure::StrParameter prior;
+  prior.name = "replay_approach_prior";
+  prior.value = approach_prior;
+  config.strs.push_back(prior);
+  return config;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "replay_flight");
+  if (argc < 2)
+  {
+    ROS_FATAL("Usage: rosrun sr_grasp_mesh_planner replay_flight <bundle directory>");
+    return EXIT_FAILURE;
+  }
+  const std::string bundle(argv[1]);
+
+  std::string action("sr_grasp_mesh_planner/plan_grasp");
+  ros::NodeHandle("~").param("action", action, action);
+  std::string planner("sr_grasp_mesh_planner");
+  ros::NodeHandle("~").param("planner", planner, planner);
+
+  std::ifstream goal_file((bundle + "/goal.bin").c_str(), std::ios::binary);
+  if (!goal_file)
+  {
+    ROS_FATAL_STREAM("No goal in " << bundle);
+    return EXIT_FAILURE;
+  }
+  std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(goal_file)), std::istreambuf_iterator<char>());
+
+  sr_robot_msgs::PlanGraspGoal goal;
+  try
+  {
+    ros::serialization::IStream stream(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    ros::serialization::deserialize(stream, goal);
+  }
+  catch (ros::Exception &e)
+  {
+    ROS_FATAL_STREAM("Could not read the goal of " << bundle << ": " << e.what());
+    return EXIT_FAILURE;
+  }
+
+  actionlib::SimpleActionClient<sr_robot_msgs::PlanGraspAction> ac(action, true);
+  ROS_INFO_STREAM("Waiting for " << action << ".");
+  ac.waitForServer();
+
+  // The goal is planned again from scratch, with the approach prior it was planned with if it
+  // had one. The settings of the planner are set back once it is done.
+  dynamic_reconfigure::Config previous;
+  if (!reconfigure(planner, previous))
+    return EXIT_FAILURE;
+  bool previous_cache = true;
+  std::string previous_prior;
+  for (size_t i = 0; i < previous.bools.size(); i++)
+    if (previous.bools[i].name == "use_cache")
+      previous_cache = previous.bools[i].value;
+  for (size_t i = 0; i < previous.strs.size(); i++)
+    if (previous.strs[i].name == "replay_approach_prior")
+      previous_prior = previous.strs[i].value;
+
+  // Read by the planner, from its own working directory.
+  std::string approach_prior;
+  const boost::filesystem::path prior_file = boost::filesystem::absolute(bundle + "/approach_prior.bin");
+  if (boost::filesystem::exists(prior_file))
+    approach_prior = prior_file.string();
+  dynamic_reconfigure::Config replay = replaySettings(false, approach_prior);
+  if (!reconfigure(planner, replay))
+    return EXIT_FAILURE;
+
+  ROS_INFO_STREAM("Sending the goal of " << bundle << " (" << goal.object.bounding_mesh.triangles.size() <<
+                  " triangles).");
+  const ros::WallTime start = ros::WallTime::now();
+  ac.sendGoal(goal);
+  ac.waitForResult();
+
+  dynamic_reconfigure::Config restored = replaySettings(previous_cache, previous_prior);
+  reconfigure(planner, restored);
+
+  ROS_INFO_STREAM("Finished in state " << ac.getState().toString() << " in " <<
+                  (ros::WallTime::now() - start).toSec() * 1000.0 << " ms, " <<
+                  (ac.getResult() ? ac.getResult()->grasps.size() : 0) << " grasp(s).");
+  return EXIT_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   retraction_engine.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Move the hand of an approach movement generator back until it is out of the object.
+ **/
+
+#include "sr_grasp_mesh_planner/retraction_engine.hpp"
+
+#include <VirtualRobot/EndEffector/EndEffector.h>
+#include <VirtualRobot/CollisionDetection/CollisionChecker.h>
+#include <VirtualRobot/CollisionDetection/CollisionModel.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+RetractionEngine::RetractionEngine(const Settings &settings)
+  : settings_(settings)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+void RetractionEngine::setSettings(const Settings &settings)
+{
+  settings_ = settings;
+}
+
+//-------------------------------------------------------------------------------
+
+const RetractionEngine::Settings &RetractionEngine::getSettings() const
+{
+  return settings_;
+}
+
+//-------------------------------------------------------------------------------
+
+const RetractionEngine::Stats &RetractionEngine::getStats() const
+{
+  return stats_;
+}
+
+//-------------------------------------------------------------------------------
+
+bool RetractionEngine::retract(GraspStudio::ApproachMovementGenerator &generator,
+                               const Eigen::Vector3f &direction)
+{
+  const Eigen::Matrix4f start_pose = generator.getEEFPose();
+  VirtualRobot::SceneObjectSetPtr hand = generator.getEEF()->createSceneObjectSet();
+  VirtualRobot::SceneObjectPtr object = generator.getObject();
+  if (!hand || !object || !object->getCollisionModel())
+    return false;
+
+  // Beyond the boxes, the hand is free: no need to check further.
+  float free_distance = -1.0f;
+  std::vector<VirtualRobot::CollisionModelPtr> models = hand->getCollisionModels();
+  if (settings_.mode == adaptive && !models.empty())
+  {
+    Eigen::Vector3f hand_min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f hand_max = -hand_min;
+    for (size_t i = 0; i < models.size(); i++)
+    {
+      const VirtualRobot::BoundingBox box = models[i]->getBoundingBox(true);
+      hand_min = hand_min.cwiseMin(box.getMin());
+      hand_max = hand_max.cwiseMax(box.getMax());
+    }
+    const VirtualRobot::BoundingBox object_box = object->getCollisionModel()->getBoundingBox(true);
+    // 1 mm of margin, for the rounding of the boxes.
+    free_distance = RetractionEngine::separatingDistance(direction, hand_min, hand_max,
+                                                         object_box.getMin(), object_box.getMax()) + 1.0f;
+  }
+
+  float distance = this->search(boost::bind(&RetractionEngine::collides_, this, &generator, hand,
+                                            boost::cref(start_pose), boost::cref(direction), _1),
+                                free_distance);
+
+  stats_.retractions++;
+  const bool found = (distance >= 0.0f);
+  if (!found)
+  {
+    stats_.failures++;
+    distance = settings_.max_distance;
+  }
+  stats_.distance += distance;
+
+  Eigen::Matrix4f pose = start_pose;
+  pose.block<3, 1>(0, 3) += distance * direction;
+  generator.setEEFPose(pose);
+  return found;
+}
+
+//-------------------------------------------------------------------------------
+
+float RetractionEngine::search(const CollisionQuery &collides, float free_distance)
+{
+  const float step = std::max(settings_.step, 0.01f);
+  // In steps, as moveEEFAway: max_steps is the last one checked.
+  const int max_steps = static_cast<int>(settings_.max_distance / step);
+
+  if (settings_.mode == fixed_steps)
+  {
+    for (int steps = 0; steps <= max_steps; steps++)
+    {
+      if (!collides(steps * step))
+        return steps * step;
+    }
+    return -1.0f;
+  }
+
+  if (!collides(0.0f))
+    return 0.0f;
+
+  const int free_steps = (free_distance >= 0.0f) ? static_cast<int>(std::ceil(free_distance / step)) : -1;
+
+  // Double the steps until the hand is free: lo collides and hi does not.
+  int lo = 0;
+  int hi = -1;
+  for (int steps = 1; hi < 0; steps *= 2)
+  {
+    if (free_steps > lo && free_steps <= max_steps && steps >= free_steps)
+    {
+      hi = free_steps;
+    }
+    else if (steps >= max_steps)
+    {
+      if (collides(max_steps * step))
+        return -1.0f;
+      hi = max_steps;
+    }
+    else if (collides(steps * step))
+    {
+      lo = steps;
+    }
+    else
+    {
+      hi = steps;
+    }
+  }
+
+  // Then bisect back to the first free step after lo.
+  while (hi - lo > 1)
+  {
+    const int middle = lo + (hi - lo) / 2;
+    if (collides(middle * step))
+      lo = middle;
+    else
+      hi = middle;
+  }
+  return hi * step;
+}
+
+//-------------------------------------------------------------------------------
+
+float RetractionEngine::separatingDistance(const Eigen::Vector3f &direction,
+                                           const Eigen::Vector3f &hand_min,
+                                           const Eigen::Vector3f &hand_max,
+                                           const Eigen::Vector3f &object_min,
+                                           const Eigen::Vector3f &object_max)
+{
+  // The hand moves along the direction: its lowest point along it must pass the highest of the object.
+  float hand_low = 0.0f;
+  float object_high = 0.0f;
+  for (int i = 0; i < 3; i++)
+  {
+    hand_low += direction(i) * (direction(i) > 0.0f ? hand_min(i) : hand_max(i));
+    object_high += direction(i) * (direction(i) > 0.0f ? object_max(i) : object_min(i));
+  }
+  return std::max(object_high - hand_low, 0.0f);
+}
+
+//-------------------------------------------------------------------------------
+
+bool RetractionEngine::collides_(GraspStudio::ApproachMovementGenerator *generator,
+                                 VirtualRobot::SceneObjectSetPtr hand,
+                                 const Eigen::Matrix4f &start_pose,
+                                 const Eigen::Vector3f &direction,
+                                 float distance)
+{
+  stats_.checks++;
+  Eigen::Matrix4f pose = start_pose;
+  pose.block<3, 1>(0, 3) += distance * direction;
+  generator->setEEFPose(pose);
+  return generator->getEEF()->getCollisionChecker()->checkCollision(generator->getObject()->getCollisionModel(), hand);
+}
+
+//-------------------------------------------------------------------------------
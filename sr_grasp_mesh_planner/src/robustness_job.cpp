@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   robustness_job.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Score accepted grasps by their quality under perturbations of the pose of the object.
+ **/
+
+#include "sr_grasp_mesh_planner/robustness_job.hpp"
+#include "sr_grasp_mesh_planner/approach_clearance.hpp"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/Nodes/RobotNode.h>
+
+#include <Eigen/Geometry>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/uniform_on_sphere.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+RobustnessJob::RobustnessJob(PreparedObjectPtr prepared,
+                             const std::vector<VirtualRobot::EndEffectorPtr> &eefs,
+                             const std::vector<int> &hands,
+                             int num_workers,
+                             const std::vector<VirtualRobot::GraspPtr> &grasps,
+                             bool force_closure,
+                             const Settings &settings,
+                             unsigned int seed)
+  : prepared_(prepared),
+    eefs_(eefs),
+    hands_(hands),
+    force_closure_(force_closure),
+    grasps_(grasps),
+    num_total_(static_cast<int>(grasps.size()) * std::max(settings.num_samples, 0)),
+    has_deadline_(settings.budget > 0.0f),
+    next_(0),
+    num_finished_(0),
+    counts_(grasps.size(), 0),
+    sums_(grasps.size(), 0.0),
+    squares_(grasps.size(), 0.0),
+    finished_(false)
+{
+  boost::mt19937 generator(static_cast<boost::uint32_t>(seed));
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<float> >
+    normal(generator, boost::normal_distribution<float>(0.0f, 1.0f));
+  boost::variate_generator<boost::mt19937&, boost::uniform_on_sphere<float> >
+    sphere(generator, boost::uniform_on_sphere<float>(3));
+
+  // About the center of the vertices: the origin of the mesh can be far from the object.
+  const Eigen::Vector3f &center = prepared_->shape_frame.center;
+  const float position_noise = settings.position_noise * 1000.0f; // M to MM
+  for (int k = 0; k < settings.num_samples; k++)
+  {
+    Eigen::Vector3f translation;
+    for (int i = 0; i < 3; i++)
+      translation(i) = normal() * position_noise;
+    const std::vector<float> axis = sphere();
+    const float angle = normal() * settings.rotation_noise;
+    const Eigen::Matrix3f rotation =
+      Eigen::AngleAxisf(angle, Eigen::Vector3f(axis[0], axis[1], axis[2])).toRotationMatrix();
+
+    Eigen::Matrix4f perturbation = Eigen::Matrix4f::Identity();
+    perturbation.block<3, 3>(0, 0) = rotation;
+    perturbation.block<3, 1>(0, 3) = center - rotation * center + translation;
+    perturbations_.push_back(perturbation);
+  }
+
+  if (has_deadline_)
+    deadline_ = boost::posix_time::microsec_clock::universal_time() +
+      boost::posix_time::microseconds(static_cast<long>(settings.budget * 1.0e6f));
+
+  for (size_t g = 0; g < hands_.size(); g++)
+    GraspSampleJob::reserveContexts(prepared_, hands_[g], num_workers);
+}
+
+//-------------------------------------------------------------------------------
+
+RobustnessJob::~RobustnessJob()
+{
+}
+
+//-------------------------------------------------------------------------------
+
+void RobustnessJob::run_sample(int worker_id)
+{
+  int sample;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (this->done_())
+      return;
+    sample = next_++;
+  }
+
+  const int g = sample % static_cast<int>(grasps_.size());
+  const int k = sample / static_cast<int>(grasps_.size());
+  SampleContext &context = GraspSampleJob::getContext(prepared_, hands_[g], eefs_[hands_[g]], worker_id);
+  const float quality = this->evaluate_(context, grasps_[g], perturbations_[k]);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  // The grasps have already been scored.
+  if (finished_)
+    return;
+  counts_[g]++;
+  sums_[g] += quality;
+  squares_[g] += static_cast<double>(quality) * quality;
+  if (++num_finished_ >= num_total_)
+    cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+float RobustnessJob::evaluate_(SampleContext &context,
+                               const VirtualRobot::GraspPtr &grasp,
+                               const Eigen::Matrix4f &perturbation) const
+{
+  VirtualRobot::EndEffectorPtr eef = context.approach->getEEF();
+  VirtualRobot::SceneObjectPtr object = prepared_->object;
+
+  // The object is at the origin: the TCP of the grasp is at the inverse of the pose of the object
+  // in the TCP, and moving the object by the perturbation moves the TCP by its inverse.
+  const Eigen::Matrix4f tcp_pose = perturbation.inverse() * grasp->getTransformation().inverse();
+  context.approach->openHand();
+  eef->getRobot()->setGlobalPoseForRobotNode(eef->getTcp(), tcp_pose);
+
+  // The open hand may now be in the object: it comes back along its approach direction first.
+  ApproachGraspPtr approach_grasp = boost::dynamic_pointer_cast<ApproachGrasp>(grasp);
+  Eigen::Vector3f approach_dir = context.approach->getApproachDirGlobal();
+  if (approach_grasp)
+    approach_dir = tcp_pose.block<3, 3>(0, 0) * approach_grasp->getApproachDirection();
+  if (context.retraction)
+    context.retraction->retract(*context.approach, approach_dir.normalized());
+
+  VirtualRobot::EndEffector::ContactInfoVector contacts = context.closing->closeActors(object, prepared_->bvh);
+  eef->addStaticPartContacts(object, contacts, approach_dir);
+  if (contacts.size() < 2)
+    return 0.0f;
+
+  context.quality_measure->setContactPoints(contacts);
+  const float quality = context.quality_measure->getGraspQuality();
+  if (force_closure_ && !context.quality_measure->isGraspForceClosure())
+    return 0.0f;
+  return quality;
+}
+
+//-------------------------------------------------------------------------------
+
+bool RobustnessJob::done() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return this->done_();
+}
+
+//-------------------------------------------------------------------------------
+
+bool RobustnessJob::done_() const
+{
+  if (finished_ || next_ >= num_total_)
+    return true;
+  return has_deadline_ && boost::posix_time::microsec_clock::universal_time() >= deadline_;
+}
+
+//-------------------------------------------------------------------------------
+
+int RobustnessJob::wait()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while (num_finished_ < num_total_ &&
+         !(has_deadline_ && boost::posix_time::microsec_clock::universal_time() >= deadline_))
+  {
+    if (has_deadline_)
+      cond_.timed_wait(lock, deadline_);
+    else
+      cond_.wait(lock);
+  }
+  // The samples still running are dropped.
+  finished_ = true;
+
+  for (size_t g = 0; g < grasps_.size(); g++)
+  {
+    ApproachGraspPtr grasp = boost::dynamic_pointer_cast<ApproachGrasp>(grasps_[g]);
+    const int n = counts_[g];
+    if (!grasp || n == 0)
+      continue;
+    const double mean = sums_[g] / n;
+    const double variance = (n > 1) ? std::max((squares_[g] - n * mean * mean) / (n - 1), 0.0) : 0.0;
+    grasp->setRobustness(static_cast<float>(mean), static_cast<float>(variance), n);
+  }
+  return num_finished_;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   seed_approach.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Analytic approach poses from the principal axes of an object, tried before the random ones.
+ **/
+
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+
+#include <Eigen/Geometry>
+
+//-------------------------------------------------------------------------------
+
+namespace sr_grasp_mesh_planner
+{
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+// The approach from the face of the box of the principal axes along axis, on both sides,
+// with the x axis of the grasp center point along each of the two other axes.
+void addFaceApproaches(const ShapeFrame &frame, int axis, SeedApproaches &seeds)
+{
+  const int others[2] = {(axis + 1) % 3, (axis + 2) % 3};
+  for (int side = 1; side >= -1; side -= 2)
+  {
+    for (int roll = 0; roll < 2; roll++)
+    {
+      SeedApproach seed;
+      seed.direction = side * frame.axes.col(axis);
+      seed.position = frame.center + frame.half_extents(axis) * seed.direction;
+      seed.x_axis = frame.axes.col(others[roll]);
+      seeds.push_back(seed);
+    }
+  }
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+SeedApproaches computeSeedApproaches(const ShapeFrame &frame)
+{
+  SeedApproaches seeds;
+  // The axes are sorted longest first: enclose the object around the longest one, palm on
+  // the largest face first, then pinch it from its ends.
+  addFaceApproaches(frame, 2, seeds);
+  addFaceApproaches(frame, 1, seeds);
+  addFaceApproaches(frame, 0, seeds);
+  return seeds;
+}
+
+//-------------------------------------------------------------------------------
+
+void setEEFToSeedApproach(GraspStudio::ApproachMovementSurfaceNormal &approach,
+                          RetractionEngine &retraction,
+                          const SeedApproach &seed)
+{
+  approach.openHand();
+  setEEFPoseWithRoll(approach, seed.position, seed.direction, seed.x_axis);
+  retraction.retract(approach, seed.direction.normalized());
+}
+
+//-------------------------------------------------------------------------------
+
+void setEEFPoseWithRoll(GraspStudio::ApproachMovementSurfaceNormal &approach,
+                        const Eigen::Vector3f &position,
+                        const Eigen::Vector3f &direction,
+                        const Eigen::Vector3f &x_axis)
+{
+  // As GraspStudio does for a random approach: the z axis of the grasp center point goes
+  // into the object, but the roll is the given one.
+  const Eigen::Vector3f z = -direction.normalized();
+  Eigen::Vector3f y = z.cross(x_axis);
+  y = (y.norm() > 1e-6f) ? Eigen::Vector3f(y.normalized()) : Eigen::Vector3f(z.unitOrthogonal());
+  const Eigen::Vector3f x = y.cross(z);
+
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  pose.block<3, 1>(0, 0) = x;
+  pose.block<3, 1>(0, 1) = y;
+  pose.block<3, 1>(0, 2) = z;
+  pose.block<3, 1>(0, 3) = position;
+  approach.setEEFPose(pose);
+}
+
+//-------------------------------------------------------------------------------
+
+} // end of namespace sr_grasp_mesh_planner
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   speculative_planner.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Plan grasps for recognized objects before they are requested.
+ **/
+
+#include "sr_grasp_mesh_planner/speculative_planner.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <string>
+#include <boost/bind.hpp>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+const std::size_t SpeculativePlanner::max_pending_ = 16;
+
+//-------------------------------------------------------------------------------
+
+SpeculativePlanner::SpeculativePlanner(ros::NodeHandle &nh,
+                                       MeshGraspPlannerPtr grasp_planner,
+                                       boost::shared_ptr<GraspCache> grasp_cache)
+  : grasp_planner_(grasp_planner),
+    grasp_cache_(grasp_cache),
+    enabled_(false),
+    paused_(0),
+    shutdown_(false),
+    max_grasps_(1),
+    timeout_one_grasp_(5.0f),
+    min_quality_(0.0f),
+    force_closure_(true),
+    approach_movement_(0)
+{
+  std::string topic;
+  nh.param<std::string>("recognized_objects_topic", topic, "recognized_object_array");
+  objects_sub_ = nh.subscribe(topic, 1, &SpeculativePlanner::objects_cb_, this);
+
+  thread_.reset(new boost::thread(boost::bind(&SpeculativePlanner::run_, this)));
+}
+
+//-------------------------------------------------------------------------------
+
+SpeculativePlanner::~SpeculativePlanner()
+{
+  objects_sub_.shutdown();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    shutdown_ = true;
+  }
+  cond_.notify_all();
+  thread_->join();
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::set_config(bool enabled,
+                                    int max_grasps,
+                                    float timeout_one_grasp,
+                                    float min_quality,
+                                    bool force_closure,
+                                    int approach_movement)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    enabled_           = enabled;
+    max_grasps_        = max_grasps;
+    timeout_one_grasp_ = timeout_one_grasp;
+    min_quality_       = min_quality;
+    force_closure_     = force_closure;
+    approach_movement_ = approach_movement;
+    if (!enabled_)
+      pending_.clear();
+  }
+  cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::pause()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  paused_++;
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::resume()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (paused_ > 0)
+      paused_--;
+  }
+  cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::objects_cb_(const object_recognition_msgs::RecognizedObjectArrayConstPtr &msg)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!enabled_)
+      return;
+
+    for (size_t i = 0; i < msg->objects.size(); i++)
+    {
+      const object_recognition_msgs::RecognizedObject &object = msg->objects[i];
+      if (object.bounding_mesh.triangles.empty())
+        continue;
+
+      const std::size_t key = grasp_planner_->getGraspKey(MeshObstacle::hash_mesh(object.bounding_mesh), object.pose);
+      if (this->is_pending_(key))
+        continue;
+      if (grasp_cache_->count(key, force_closure_, min_quality_) >= static_cast<std::size_t>(max_grasps_))
+        continue;
+
+      // The newest objects are the most likely to be picked next, drop the oldest.
+      if (pending_.size() >= max_pending_)
+        pending_.pop_front();
+
+      PendingObject pending;
+      pending.key = key;
+      pending.object = object;
+      pending_.push_back(pending);
+      ROS_DEBUG_STREAM("Speculative planning queued object " << key << ".");
+    }
+  }
+  cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+bool SpeculativePlanner::is_pending_(std::size_t key) const
+{
+  for (size_t i = 0; i < pending_.size(); i++)
+  {
+    if (pending_[i].key == key)
+      return true;
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::run_()
+{
+  // Only use the CPU when nothing else wants it.
+  if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19) != 0)
+    ROS_WARN_STREAM("Failed to lower the priority of the speculative planning thread.");
+
+  boost::mutex::scoped_lock lock(mutex_);
+  while (!shutdown_)
+  {
+    while (!shutdown_ && (!enabled_ || paused_ > 0 || pending_.empty()))
+      cond_.wait(lock);
+    if (shutdown_)
+      break;
+
+    // Work on the newest object first.
+    PendingObject pending = pending_.back();
+    pending_.pop_back();
+
+    lock.unlock();
+    this->speculate_(pending);
+    lock.lock();
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void SpeculativePlanner::speculate_(const PendingObject &pending)
+{
+  int max_grasps;
+  float timeout_one_grasp;
+  float min_quality;
+  bool force_closure;
+  int approach_movement;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    max_grasps        = max_grasps_;
+    timeout_one_grasp = timeout_one_grasp_;
+    min_quality       = min_quality_;
+    force_closure     = force_closure_;
+    approach_movement = approach_movement_;
+  }
+
+  const int num_cached = static_cast<int>(grasp_cache_->count(pending.key, force_closure, min_quality));
+  if (num_cached >= max_grasps)
+    return;
+  const int num_missing = max_grasps - num_cached;
+
+  PreparedObjectPtr prepared = grasp_planner_->prepareObject(pending.object, approach_movement);
+
+  // Idle workers only: goals are never slowed down by more than the samples already running.
+  // Speculative runs are not replayed, any seed will do.
+  const double idle_weight = 0.0;
+  const unsigned int seed = static_cast<unsigned int>(ros::WallTime::now().toNSec());
+  std::vector<VirtualRobot::GraspPtr> planned = grasp_planner_->planGrasps(prepared,
+                                                                           num_missing,
+                                                                           force_closure,
+                                                                           timeout_one_grasp * num_missing,
+                                                                           min_quality,
+                                                                           seed,
+                                                                           idle_weight);
+  if (planned.empty())
+  {
+    ROS_INFO_STREAM("Speculative planning gave up object " << pending.key << ".");
+    return;
+  }
+
+  std::vector<moveit_msgs::Grasp> grasps;
+  for (size_t i = 0; i < planned.size(); i++)
+    grasps.push_back(grasp_planner_->createGraspMsg(planned[i]));
+
+  grasp_cache_->insert(pending.key, force_closure, grasps);
+  ROS_DEBUG_STREAM("Speculative planning cached " << grasps.size() <<
+                   " grasp(s) for object " << pending.key << ".");
+}
+
+//-------------------------------------------------------------------------------
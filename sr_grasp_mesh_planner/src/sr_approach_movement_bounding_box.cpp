@@ -22,8 +22,15 @@
 #include <VirtualRobot/SceneObjectSet.h>
 #include <VirtualRobot/CollisionDetection/CollisionChecker.h>
 
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/uniform_on_sphere.hpp>
+#include <boost/random/variate_generator.hpp>
+
 #include <cstdio>
 #include <cstring>
+#include <vector>
 #include <iostream>
 #include <ros/ros.h>
 
@@ -34,7 +41,9 @@ SrApproachMovementBoundingBox::SrApproachMovementBoundingBox(VirtualRobot::Scene
                                                              VirtualRobot::EndEffectorPtr eef,
                                                              const std::string &graspPreshape,
                                                              float maxRandDist)
-  : ApproachMovementSurfaceNormal(object, eef, graspPreshape, maxRandDist)
+  : ApproachMovementSurfaceNormal(object, eef, graspPreshape, maxRandDist),
+    sampled_position_(Eigen::Vector3f::Zero()),
+    sampled_approach_dir_(Eigen::Vector3f::Zero())
 {
   name = "SrApproachMovementBoundingBox";
 
@@ -95,12 +104,17 @@ Eigen::Matrix4f SrApproachMovementBoundingBox::createNewApproachPose()
     ROS_ERROR_STREAM("no position on object?!");
     return pose;
   }
+  sampled_position_ = position;
+  sampled_approach_dir_ = -approachDir;
 
-  // set new pose
-  this->setEEFToApproachPose(position, approachDir);
+  // set new pose, with a random roll drawn from random_ (GraspStudio draws it from rand())
+  boost::variate_generator<boost::mt19937&, boost::uniform_on_sphere<float> >
+    roll(random_, boost::uniform_on_sphere<float>(3));
+  const std::vector<float> x_axis = roll();
+  setEEFPoseWithRoll(*this, position, approachDir, Eigen::Vector3f(x_axis[0], x_axis[1], x_axis[2]));
 
   // move away until valid
-  this->moveEEFAway(approachDir,3.0f);
+  retraction_.retract(*this, approachDir);
 
   Eigen::Matrix4f poseB = this->getEEFPose();
 
@@ -116,18 +130,66 @@ bool SrApproachMovementBoundingBox::getPositionOnObjectWithFocalPoint(Eigen::Vec
   if (bb_object_.faces.size() == 0)
     return false;
 
-  int nRandFace = rand() % bb_object_.faces.size();
-  int nVert1 = (bb_object_.faces[nRandFace]).id1;
-  int nVert2 = (bb_object_.faces[nRandFace]).id2;
-  int nVert3 = (bb_object_.faces[nRandFace]).id3;
+  // Candidates are kept with the probability given by the prior, the last one is kept anyway.
+  for (int draw = 1; ; draw++)
+  {
+    boost::variate_generator<boost::mt19937&, boost::uniform_int<int> >
+      face(random_, boost::uniform_int<int>(0, static_cast<int>(bb_object_.faces.size()) - 1));
+    int nRandFace = face();
+    int nVert1 = (bb_object_.faces[nRandFace]).id1;
+    int nVert2 = (bb_object_.faces[nRandFace]).id2;
+    int nVert3 = (bb_object_.faces[nRandFace]).id3;
+
+    storePos = randomPointInTriangle(bb_object_.vertices[nVert1],
+                                     bb_object_.vertices[nVert2],
+                                     bb_object_.vertices[nVert3],
+                                     random_);
+
+    storeApproachDir = (bb_object_.faces[nRandFace]).normal;
+
+    // The hand approaches against the normal.
+    if (!prior_ || draw >= ApproachPrior::max_draws ||
+        prior_->keep(shape_frame_, storePos, -storeApproachDir, random_))
+      break;
+  }
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------
 
-  storePos = VirtualRobot::MathTools::randomPointInTriangle(bb_object_.vertices[nVert1],
-                                                            bb_object_.vertices[nVert2],
-                                                            bb_object_.vertices[nVert3]);
+void SrApproachMovementBoundingBox::setPrior(ApproachPriorPtr prior, const ShapeFrame &shape_frame)
+{
+  prior_ = prior;
+  shape_frame_ = shape_frame;
+}
 
-  storeApproachDir = (bb_object_.faces[nRandFace]).normal;
+//-------------------------------------------------------------------------------
 
-  return true;
+RetractionEngine &SrApproachMovementBoundingBox::getRetraction()
+{
+  return retraction_;
+}
+
+//-------------------------------------------------------------------------------
+
+boost::mt19937 &SrApproachMovementBoundingBox::getRandom()
+{
+  return random_;
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &SrApproachMovementBoundingBox::getSampledPosition() const
+{
+  return sampled_position_;
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &SrApproachMovementBoundingBox::getSampledApproachDir() const
+{
+  return sampled_approach_dir_;
 }
 
 } // end of namespace sr_grasp_mesh_planner
@@ -22,8 +22,15 @@
 #include <VirtualRobot/Visualization/TriMeshModel.h>
 #include <VirtualRobot/CollisionDetection/CollisionChecker.h>
 
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/uniform_on_sphere.hpp>
+#include <boost/random/variate_generator.hpp>
+
 #include <cstdio>
 #include <cstring>
+#include <vector>
 #include <iostream>
 #include <ros/ros.h>
 
@@ -35,7 +42,9 @@ SrApproachMovementSurfaceNormal::SrApproachMovementSurfaceNormal(VirtualRobot::S
                                                                  VirtualRobot::EndEffectorPtr eef,
                                                                  const std::string &graspPreshape,
                                                                  float maxRandDist)
-  : ApproachMovementSurfaceNormal(object, eef, graspPreshape, maxRandDist)
+  : ApproachMovementSurfaceNormal(object, eef, graspPreshape, maxRandDist),
+    sampled_position_(Eigen::Vector3f::Zero()),
+    sampled_approach_dir_(Eigen::Vector3f::Zero())
 {
   name = "SrApproachMovementSurfaceNormal";
 }
@@ -60,12 +69,17 @@ Eigen::Matrix4f SrApproachMovementSurfaceNormal::createNewApproachPose()
     ROS_ERROR_STREAM("no position on object?!");
     return pose;
   }
+  sampled_position_ = position;
+  sampled_approach_dir_ = -approachDir;
 
-  // set new pose
-  this->setEEFToApproachPose(position,approachDir);
+  // set new pose, with a random roll drawn from random_ (GraspStudio draws it from rand())
+  boost::variate_generator<boost::mt19937&, boost::uniform_on_sphere<float> >
+    roll(random_, boost::uniform_on_sphere<float>(3));
+  const std::vector<float> x_axis = roll();
+  setEEFPoseWithRoll(*this, position, approachDir, Eigen::Vector3f(x_axis[0], x_axis[1], x_axis[2]));
 
   // move away until valid
-  this->moveEEFAway(approachDir,3.0f);
+  retraction_.retract(*this, approachDir);
 
   Eigen::Matrix4f poseB = this->getEEFPose();
 
@@ -97,18 +111,66 @@ bool SrApproachMovementSurfaceNormal::getPositionOnObjectWithFocalPoint(Eigen::V
   if (!object || objectModel->faces.size()==0)
     return false;
 
-  int nRandFace = rand() % objectModel->faces.size();
-  int nVert1 = (objectModel->faces[nRandFace]).id1;
-  int nVert2 = (objectModel->faces[nRandFace]).id2;
-  int nVert3 = (objectModel->faces[nRandFace]).id3;
+  // Candidates are kept with the probability given by the prior, the last one is kept anyway.
+  for (int draw = 1; ; draw++)
+  {
+    boost::variate_generator<boost::mt19937&, boost::uniform_int<int> >
+      face(random_, boost::uniform_int<int>(0, static_cast<int>(objectModel->faces.size()) - 1));
+    int nRandFace = face();
+    int nVert1 = (objectModel->faces[nRandFace]).id1;
+    int nVert2 = (objectModel->faces[nRandFace]).id2;
+    int nVert3 = (objectModel->faces[nRandFace]).id3;
+
+    storePos = randomPointInTriangle(objectModel->vertices[nVert1],
+                                     objectModel->vertices[nVert2],
+                                     objectModel->vertices[nVert3],
+                                     random_);
+
+    storeApproachDir = (objectModel->faces[nRandFace]).normal;
+
+    // The hand approaches against the normal.
+    if (!prior_ || draw >= ApproachPrior::max_draws ||
+        prior_->keep(shape_frame_, storePos, -storeApproachDir, random_))
+      break;
+  }
 
-  storePos = VirtualRobot::MathTools::randomPointInTriangle(objectModel->vertices[nVert1],
-                                                            objectModel->vertices[nVert2],
-                                                            objectModel->vertices[nVert3]);
+  return true;
+}
 
-  storeApproachDir = (objectModel->faces[nRandFace]).normal;
+//-------------------------------------------------------------------------------
 
-  return true;
+void SrApproachMovementSurfaceNormal::setPrior(ApproachPriorPtr prior, const ShapeFrame &shape_frame)
+{
+  prior_ = prior;
+  shape_frame_ = shape_frame;
+}
+
+//-------------------------------------------------------------------------------
+
+RetractionEngine &SrApproachMovementSurfaceNormal::getRetraction()
+{
+  return retraction_;
+}
+
+//-------------------------------------------------------------------------------
+
+boost::mt19937 &SrApproachMovementSurfaceNormal::getRandom()
+{
+  return random_;
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &SrApproachMovementSurfaceNormal::getSampledPosition() const
+{
+  return sampled_position_;
+}
+
+//-------------------------------------------------------------------------------
+
+const Eigen::Vector3f &SrApproachMovementSurfaceNormal::getSampledApproachDir() const
+{
+  return sampled_approach_dir_;
 }
 
 } // end of namespace sr_grasp_mesh_planner
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   time_to_first_grasp.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  Measure the time to the first grasp on the bundled meshes, with and without the seed approaches.
+ **/
+
+#include "sr_grasp_mesh_planner/grasp_sample_job.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/read_ply.hpp"
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+#include "sr_grasp_mesh_planner/PlannerConfig.h"
+
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/XML/RobotIO.h>
+
+#include <Inventor/SoDB.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+using namespace VirtualRobot;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+// As MeshGraspPlanner::prepareObject, without the caches: the mesh is in m.
+PreparedObjectPtr prepareMesh(const std::string &filename, EndEffectorPtr eef, int approach_movement)
+{
+  ReadPLY reader;
+  if (reader.load(filename.c_str()) != 0)
+    return PreparedObjectPtr();
+
+  shape_msgs::Mesh mesh;
+  mesh.triangles.resize(reader.total_triangles_);
+  for (int i = 0; i < reader.total_triangles_; i++)
+  {
+    mesh.triangles[i].vertex_indices[0] = reader.triangles_[i].n1;
+    mesh.triangles[i].vertex_indices[1] = reader.triangles_[i].n2;
+    mesh.triangles[i].vertex_indices[2] = reader.triangles_[i].n3;
+  }
+  mesh.vertices.resize(reader.total_vertices_);
+  for (int i = 0; i < reader.total_vertices_; i++)
+  {
+    mesh.vertices[i].x = reader.vertices_[i].x;
+    mesh.vertices[i].y = reader.vertices_[i].y;
+    mesh.vertices[i].z = reader.vertices_[i].z;
+  }
+
+  TriMeshModelPtr model = MeshObstacle::create_tri_mesh(mesh);
+  for (size_t i = 0; i < model->vertices.size(); i++)
+    model->vertices[i] *= 1000.0f; // M to MM
+
+  PreparedObjectPtr prepared(new PreparedObject);
+  prepared->approach_movement = approach_movement;
+  prepared->bvh = MeshBvh::build(model);
+  prepared->shape_frame = ShapeFrame::compute(model);
+  prepared->object = MeshObstacle::create_mesh_obstacle(model);
+  prepared->approach = createApproachMovement(approach_movement, prepared->object, eef,
+                                              ApproachPriorPtr(), prepared->shape_frame);
+  return prepared;
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "time_to_first_grasp");
+  ros::NodeHandle nh("~");
+
+  SoDB::init();
+
+  const std::string package_path = ros::package::getPath("sr_grasp_mesh_planner");
+  std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  std::string eef_name("SHADOWHAND");
+  std::string meshes;
+  int runs;
+  int num_threads;
+  int approach_movement;
+  double timeout;
+  double min_quality;
+  bool force_closure;
+  nh.param<std::string>("robot", robot_file, robot_file);
+  nh.param<std::string>("endeffector", eef_name, eef_name);
+  nh.param<std::string>("meshes", meshes, "");
+  nh.param("runs", runs, 10);
+  nh.param("num_threads", num_threads, 0);
+  nh.param("approach_movement", approach_movement, static_cast<int>(Planner_surface_normal));
+  nh.param("timeout", timeout, 30.0);
+  nh.param("min_quality", min_quality, 0.2);
+  nh.param("force_closure", force_closure, true);
+
+  // The meshes in m bundled with the planner, unless given (separated by commas).
+  std::vector<std::string> filenames;
+  if (meshes.empty())
+  {
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator it(package_path + "/meshes"); it != end; ++it)
+    {
+      const std::string name = it->path().filename().string();
+      if (name.size() > 6 && name.compare(name.size() - 6, 6, "_M.ply") == 0)
+        filenames.push_back(it->path().string());
+    }
+    std::sort(filenames.begin(), filenames.end());
+  }
+  else
+  {
+    std::stringstream ss(meshes);
+    std::string filename;
+    while (std::getline(ss, filename, ','))
+      filenames.push_back(filename);
+  }
+
+  RobotPtr robot = RobotIO::loadRobot(robot_file);
+  if (!robot)
+  {
+    ROS_FATAL_STREAM("No robot at " << robot_file);
+    return EXIT_FAILURE;
+  }
+  EndEffectorPtr eef = robot->getEndEffector(eef_name);
+  if (!eef)
+  {
+    ROS_FATAL_STREAM("No end-effector " << eef_name << " in " << robot_file);
+    return EXIT_FAILURE;
+  }
+
+  WorkStealingSchedulerPtr scheduler(new WorkStealingScheduler(num_threads));
+
+  for (size_t m = 0; m < filenames.size(); m++)
+  {
+    PreparedObjectPtr prepared = prepareMesh(filenames[m], eef, approach_movement);
+    if (!prepared)
+    {
+      ROS_ERROR_STREAM("Could not read " << filenames[m]);
+      continue;
+    }
+    const SeedApproaches seeds = computeSeedApproaches(prepared->shape_frame);
+
+    ROS_INFO_STREAM(filenames[m] << " (shape class " << prepared->shape_frame.shape_class << "), " << runs <<
+                    " runs on " << scheduler->num_workers() << " workers:");
+    const char *mode_names[] = {"Random:", "Seeded:"};
+    for (int mode = 0; mode < 2; mode++)
+    {
+      std::vector<double> times;
+      int num_seed_grasps = 0;
+      for (int run = 0; run < runs; run++)
+      {
+        // The seeds are only tried once per hand on an object.
+        prepared->seeds = (mode == 1) ? seeds : SeedApproaches();
+        prepared->next_seed.clear();
+
+        GraspSampleJobPtr job(new GraspSampleJob(prepared, eef, 0, scheduler->num_workers(), 1,
+                                                 force_closure, min_quality, timeout, run + 1));
+        scheduler->add_job(job);
+        job->wait();
+        job->cancel();
+        if (job->getTimeToFirstGrasp() >= 0.0)
+          times.push_back(job->getTimeToFirstGrasp() * 1000.0);
+        num_seed_grasps += job->getNumSeedGrasps();
+      }
+
+      if (times.empty())
+      {
+        ROS_INFO_STREAM("  " << mode_names[mode] << " no grasp in " << timeout << " s");
+        continue;
+      }
+      std::sort(times.begin(), times.end());
+      double mean = 0.0;
+      for (size_t i = 0; i < times.size(); i++)
+        mean += times[i] / times.size();
+      ROS_INFO_STREAM("  " << mode_names[mode] << " " << times.size() << " first grasp(s), median " <<
+                      times[times.size() / 2] << " ms, mean " << mean << " ms, max " << times.back() << " ms, " <<
+                      num_seed_grasps << " from the seeds");
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 Shadow Robot Company Ltd.
+ *  All rights reserved.
+ *
+ * This code is proprietary and may not be used, copied, distributed without
+ *  prior authorisation and agreement from Shadow Robot Company Ltd.
+ */
+
+/**
+ * @file   work_stealing_scheduler.cpp
+ * @author Shadow Robot's software team <software@shadowrobot.com>
+ * @brief  A pool of worker threads evaluating grasp samples of several jobs.
+ **/
+
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <boost/bind.hpp>
+#include <ros/ros.h>
+
+//-------------------------------------------------------------------------------
+
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+const std::size_t WorkStealingScheduler::chunk_size_ = 4;
+
+//-------------------------------------------------------------------------------
+
+WorkStealingScheduler::WorkStealingScheduler(int num_workers)
+  : global_pass_(0.0),
+    shutdown_(false)
+{
+  if (num_workers <= 0)
+    num_workers = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+
+  for (int i = 0; i < num_workers; i++)
+    workers_.push_back(boost::shared_ptr<Worker>(new Worker));
+
+  for (int i = 0; i < num_workers; i++)
+    threads_.create_thread(boost::bind(&WorkStealingScheduler::worker_loop_, this, i));
+
+  ROS_INFO_STREAM("Grasp sampling uses " << num_workers << " worker thread(s).");
+}
+
+//-------------------------------------------------------------------------------
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+  {
+    boost::mutex::scoped_lock lock(jobs_mutex_);
+    shutdown_ = true;
+  }
+  jobs_cond_.notify_all();
+  threads_.join_all();
+}
+
+//-------------------------------------------------------------------------------
+
+int WorkStealingScheduler::num_workers() const
+{
+  return static_cast<int>(workers_.size());
+}
+
+//-------------------------------------------------------------------------------
+
+void WorkStealingScheduler::add_job(SampleJobPtr job, double weight)
+{
+  {
+    boost::mutex::scoped_lock lock(jobs_mutex_);
+    JobEntry entry;
+    entry.job = job;
+    entry.weight = weight;
+    // Start at the current virtual time, so a new job neither starves nor is starved.
+    entry.pass = global_pass_;
+    jobs_.push_back(entry);
+  }
+  jobs_cond_.notify_all();
+}
+
+//-------------------------------------------------------------------------------
+
+void WorkStealingScheduler::worker_loop_(int worker_id)
+{
+  while (true)
+  {
+    SampleJobPtr job;
+    if (!this->pop_local_(worker_id, job) &&
+        !this->steal_(worker_id, job) &&
+        !this->refill_(worker_id, job))
+    {
+      boost::mutex::scoped_lock lock(jobs_mutex_);
+      if (shutdown_)
+        break;
+      if (jobs_.empty())
+        jobs_cond_.wait(lock);
+      continue;
+    }
+
+    // Samples of a finished job may still sit in the deques, they are just dropped.
+    if (job->done())
+      continue;
+
+    try
+    {
+      job->run_sample(worker_id);
+    }
+    catch (std::exception &e)
+    {
+      ROS_ERROR_STREAM("Worker " << worker_id << " failed to evaluate a sample: " << e.what());
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+bool WorkStealingScheduler::pop_local_(int worker_id, SampleJobPtr &job)
+{
+  Worker &worker = *workers_[worker_id];
+  boost::mutex::scoped_lock lock(worker.mutex);
+  if (worker.samples.empty())
+    return false;
+  job = worker.samples.back();
+  worker.samples.pop_back();
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+bool WorkStealingScheduler::refill_(int worker_id, SampleJobPtr &job)
+{
+  boost::mutex::scoped_lock lock(jobs_mutex_);
+
+  std::list<JobEntry>::iterator best = jobs_.end();
+  std::list<JobEntry>::iterator best_idle = jobs_.end();
+  std::list<JobEntry>::iterator it = jobs_.begin();
+  while (it != jobs_.end())
+  {
+    if (it->job->done())
+    {
+      it = jobs_.erase(it);
+      continue;
+    }
+    if (it->weight > 0.0)
+    {
+      if (best == jobs_.end() || it->pass < best->pass)
+        best = it;
+    }
+    else if (best_idle == jobs_.end())
+    {
+      best_idle = it;
+    }
+    ++it;
+  }
+
+  std::size_t n = chunk_size_;
+  if (best == jobs_.end())
+  {
+    if (best_idle == jobs_.end())
+      return false;
+    // One sample at a time, so that a weighted job gets the worker back quickly.
+    best = best_idle;
+    n = 1;
+    // Rotate the idle jobs.
+    jobs_.splice(jobs_.end(), jobs_, best);
+  }
+  else
+  {
+    best->pass += static_cast<double>(n) / best->weight;
+    global_pass_ = best->pass;
+    for (it = jobs_.begin(); it != jobs_.end(); ++it)
+    {
+      if (it->weight > 0.0)
+        global_pass_ = std::min(global_pass_, it->pass);
+    }
+  }
+
+  job = best->job;
+
+  Worker &worker = *workers_[worker_id];
+  boost::mutex::scoped_lock worker_lock(worker.mutex);
+  for (std::size_t i = 1; i < n; i++)
+    worker.samples.push_back(job);
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+bool WorkStealingScheduler::steal_(int worker_id, SampleJobPtr &job)
+{
+  const int n = static_cast<int>(workers_.size());
+  for (int i = 1; i < n; i++)
+  {
+    Worker &victim = *workers_[(worker_id + i) % n];
+    boost::mutex::scoped_lock lock(victim.mutex);
+    if (!victim.samples.empty())
+    {
+      job = victim.samples.front();
+      victim.samples.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
@@ -1,4 +1,22 @@
+#include "sr_grasp_mesh_planner/batch_forward_kinematics.hpp"
+#include "sr_grasp_mesh_planner/adaptive_quality_threshold.hpp"
+#include "sr_grasp_mesh_planner/approach_clearance.hpp"
+#include "sr_grasp_mesh_planner/approach_prior.hpp"
+#include "sr_grasp_mesh_planner/dynamic_aabb_tree.hpp"
+#include "sr_grasp_mesh_planner/flight_recorder.hpp"
+#include "sr_grasp_mesh_planner/grasp_cache.hpp"
+#include "sr_grasp_mesh_planner/hand_closing.hpp"
+#include "sr_grasp_mesh_planner/mesh_bvh.hpp"
+#include "sr_grasp_mesh_planner/mesh_obstacle.hpp"
+#include "sr_grasp_mesh_planner/model_registry.hpp"
+#include "sr_grasp_mesh_planner/prepared_object.hpp"
+#include "sr_grasp_mesh_planner/reachability_map.hpp"
 #include "sr_grasp_mesh_planner/read_ply.hpp"
+#include "sr_grasp_mesh_planner/retraction_engine.hpp"
+#include "sr_grasp_mesh_planner/robustness_job.hpp"
+#include "sr_grasp_mesh_planner/seed_approach.hpp"
+#include "sr_grasp_mesh_planner/work_stealing_scheduler.hpp"
+#include "sr_grasp_mesh_planner/PlannerConfig.h"
 #include <sr_robot_msgs/PlanGraspAction.h>
 #include <geometry_msgs/Point.h>
 #include <shape_msgs/MeshTriangle.h>
@@ -6,14 +24,986 @@
 
 #include <ros/ros.h>
 #include <ros/package.h>
+#include <ros/serialization.h>
 #include <actionlib/client/simple_action_client.h>
 #include <actionlib/client/terminal_state.h>
 
+#include <VirtualRobot/Robot.h>
+#include <VirtualRobot/XML/RobotIO.h>
+#include <VirtualRobot/CollisionDetection/CollisionModel.h>
+#include <VirtualRobot/EndEffector/EndEffectorActor.h>
+
+#include <Inventor/SoDB.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/thread_time.hpp>
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
 #include <gtest/gtest.h>
 
 //-------------------------------------------------------------------------------
 
-using sr_grasp_mesh_planner::ReadPLY;
+using namespace sr_grasp_mesh_planner;
+
+//-------------------------------------------------------------------------------
+
+namespace
+{
+
+typedef boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > UniformGenerator;
+
+Eigen::Vector3f randomPoint(UniformGenerator &uniform)
+{
+  const float x = uniform();
+  const float y = uniform();
+  const float z = uniform();
+  return Eigen::Vector3f(x, y, z);
+}
+
+moveit_msgs::Grasp makeGrasp(float quality)
+{
+  moveit_msgs::Grasp grasp;
+  grasp.grasp_quality = quality;
+  return grasp;
+}
+
+// Counts its samples until it has num_samples of them, or until canceled.
+class CountingJob : public SampleJob
+{
+public:
+  CountingJob(int num_samples, int num_workers)
+    : num_samples_(num_samples),
+      num_workers_(num_workers),
+      count_(0),
+      count_after_cancel_(0),
+      bad_worker_(false),
+      canceled_(false)
+  {
+  }
+
+  virtual void run_sample(int worker_id)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (worker_id < 0 || worker_id >= num_workers_)
+      bad_worker_ = true;
+    if (canceled_)
+      count_after_cancel_++;
+    else
+      count_++;
+    if (count_ >= num_samples_)
+      cond_.notify_all();
+  }
+
+  virtual bool done() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return canceled_ || count_ >= num_samples_;
+  }
+
+  // False on timeout (s).
+  bool wait(double timeout)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    const boost::system_time deadline = boost::get_system_time() +
+      boost::posix_time::milliseconds(static_cast<long>(timeout * 1000.0));
+    while (count_ < num_samples_)
+    {
+      if (!cond_.timed_wait(lock, deadline))
+        return false;
+    }
+    return true;
+  }
+
+  void cancel()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    canceled_ = true;
+  }
+
+  int getCount() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return count_;
+  }
+
+  int getCountAfterCancel() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return count_after_cancel_;
+  }
+
+  bool hasBadWorker() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return bad_worker_;
+  }
+
+private:
+  const int num_samples_;
+  const int num_workers_;
+  mutable boost::mutex mutex_;
+  boost::condition_variable cond_;
+  int count_;
+  int count_after_cancel_;
+  bool bad_worker_;
+  bool canceled_;
+};
+
+// Wait until the scheduler has dropped all its references to the job, false on timeout (s).
+bool waitReleased(const boost::shared_ptr<CountingJob> &job, double timeout)
+{
+  for (int i = 0; i < static_cast<int>(timeout * 100.0); i++)
+  {
+    if (job.use_count() == 1)
+      return true;
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  return job.use_count() == 1;
+}
+
+// The hand collides before depth mm, and inside the gap [gap_begin, gap_end) mm.
+class RetractionQuery
+{
+public:
+  RetractionQuery(float depth, float gap_begin = -1.0f, float gap_end = -1.0f)
+    : depth_(depth), gap_begin_(gap_begin), gap_end_(gap_end), checks_(0)
+  {
+  }
+
+  bool operator()(float distance)
+  {
+    checks_++;
+    return distance < depth_ || (distance >= gap_begin_ && distance < gap_end_);
+  }
+
+  int getChecks() const
+  {
+    return checks_;
+  }
+
+private:
+  float depth_;
+  float gap_begin_;
+  float gap_end_;
+  int checks_;
+};
+
+// A mesh of the package (in m), as a goal sends it. Empty if it cannot be read.
+shape_msgs::Mesh readMesh(const std::string &name)
+{
+  shape_msgs::Mesh mesh;
+  ReadPLY reader;
+  if (reader.load((ros::package::getPath("sr_grasp_mesh_planner") + "/meshes/" + name).c_str()) != 0)
+    return mesh;
+
+  mesh.triangles.resize(reader.total_triangles_);
+  for (int i = 0; i < reader.total_triangles_; i++)
+  {
+    mesh.triangles[i].vertex_indices[0] = reader.triangles_[i].n1;
+    mesh.triangles[i].vertex_indices[1] = reader.triangles_[i].n2;
+    mesh.triangles[i].vertex_indices[2] = reader.triangles_[i].n3;
+  }
+  mesh.vertices.resize(reader.total_vertices_);
+  for (int i = 0; i < reader.total_vertices_; i++)
+  {
+    mesh.vertices[i].x = reader.vertices_[i].x;
+    mesh.vertices[i].y = reader.vertices_[i].y;
+    mesh.vertices[i].z = reader.vertices_[i].z;
+  }
+  return mesh;
+}
+
+// A mesh of the package (in m), prepared in mm as the planner does, without the caches.
+PreparedObjectPtr prepareMesh(const std::string &name, VirtualRobot::EndEffectorPtr eef)
+{
+  const shape_msgs::Mesh mesh = readMesh(name);
+  if (mesh.triangles.empty())
+    return PreparedObjectPtr();
+
+  VirtualRobot::TriMeshModelPtr model = MeshObstacle::create_tri_mesh(mesh);
+  for (size_t i = 0; i < model->vertices.size(); i++)
+    model->vertices[i] *= 1000.0f; // M to MM
+
+  PreparedObjectPtr prepared(new PreparedObject);
+  prepared->approach_movement = Planner_surface_normal;
+  prepared->bvh = MeshBvh::build(model);
+  prepared->shape_frame = ShapeFrame::compute(model);
+  prepared->object = MeshObstacle::create_mesh_obstacle(model);
+  prepared->approach = createApproachMovement(prepared->approach_movement, prepared->object, eef,
+                                              ApproachPriorPtr(), prepared->shape_frame);
+  return prepared;
+}
+
+// A grasp of the hand with the TCP at the given pose in the frame of the object (mm).
+VirtualRobot::GraspPtr makeApproachGrasp(VirtualRobot::EndEffectorPtr eef, const Eigen::Matrix4f &tcp_pose)
+{
+  return VirtualRobot::GraspPtr(new ApproachGrasp("test", eef->getRobot()->getType(), eef->getName(),
+                                                  tcp_pose.inverse(), "test", 0.0f,
+                                                  Eigen::Vector3f::UnitZ(), 0.0f, 0.0f));
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
+TEST(TestGraspCache, testEviction)
+{
+  GraspCache cache(2);
+  cache.insert(1, true, std::vector<moveit_msgs::Grasp>(2, makeGrasp(0.5f)));
+  cache.insert(2, false, std::vector<moveit_msgs::Grasp>(1, makeGrasp(0.1f)));
+  EXPECT_EQ(2u, cache.count(1, true, 0.0f));
+  EXPECT_EQ(1u, cache.count(2, false, 0.0f));
+
+  // Grasps without force closure do not satisfy a goal with it, low quality grasps a higher minimum.
+  EXPECT_EQ(0u, cache.count(2, true, 0.0f));
+  EXPECT_EQ(0u, cache.count(1, true, 0.6f));
+
+  // More grasps for a cached object do not evict anything, nor make it younger.
+  cache.insert(1, false, std::vector<moveit_msgs::Grasp>(1, makeGrasp(0.3f)));
+  EXPECT_EQ(3u, cache.count(1, false, 0.0f));
+  EXPECT_EQ(1u, cache.count(2, false, 0.0f));
+
+  // A third object evicts the oldest one.
+  cache.insert(3, true, std::vector<moveit_msgs::Grasp>(1, makeGrasp(0.9f)));
+  EXPECT_EQ(0u, cache.count(1, false, 0.0f));
+  EXPECT_EQ(1u, cache.count(2, false, 0.0f));
+  EXPECT_EQ(1u, cache.count(3, true, 0.0f));
+
+  // No grasps, no object.
+  cache.insert(4, true, std::vector<moveit_msgs::Grasp>());
+  EXPECT_EQ(1u, cache.count(2, false, 0.0f));
+
+  std::vector<moveit_msgs::Grasp> grasps;
+  EXPECT_EQ(1u, cache.lookup(3, true, 0.5f, 10, grasps));
+  EXPECT_EQ(0u, cache.lookup(2, false, 0.0f, 0, grasps));
+  EXPECT_EQ(1u, grasps.size());
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.count(3, false, 0.0f));
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestMeshBvh, testBruteForce)
+{
+  boost::mt19937 random(1);
+  UniformGenerator uniform(random, boost::uniform_real<float>(-50.0f, 50.0f));
+  UniformGenerator offset(random, boost::uniform_real<float>(-5.0f, 5.0f));
+
+  // Small random triangles in a cube, and each of them on its own.
+  const int num_triangles = 200;
+  VirtualRobot::TriMeshModelPtr model(new VirtualRobot::TriMeshModel());
+  std::vector<MeshBvhPtr> singles;
+  for (int t = 0; t < num_triangles; t++)
+  {
+    Eigen::Vector3f a = randomPoint(uniform);
+    Eigen::Vector3f b = a + randomPoint(offset);
+    Eigen::Vector3f c = a + randomPoint(offset);
+    model->addTriangleWithFace(a, b, c);
+
+    VirtualRobot::TriMeshModelPtr single(new VirtualRobot::TriMeshModel());
+    single->addTriangleWithFace(a, b, c);
+    singles.push_back(MeshBvh::build(single));
+  }
+
+  MeshBvhPtr bvh = MeshBvh::build(model);
+  ASSERT_TRUE(bvh);
+  EXPECT_EQ(static_cast<std::size_t>(num_triangles), bvh->getNumTriangles());
+
+  int num_intersecting = 0;
+  for (int i = 0; i < 200; i++)
+  {
+    const Eigen::Vector3f min = randomPoint(uniform);
+    const Eigen::Vector3f max = min + randomPoint(offset).cwiseAbs();
+    bool expected = false;
+    for (int t = 0; t < num_triangles && !expected; t++)
+      expected = singles[t]->intersectsBox(min, max);
+    EXPECT_EQ(expected, bvh->intersectsBox(min, max)) << "box " << i;
+    num_intersecting += expected ? 1 : 0;
+  }
+  // Both outcomes are tested.
+  EXPECT_GT(num_intersecting, 0);
+  EXPECT_LT(num_intersecting, 200);
+
+  int num_hits = 0;
+  const float max_distance = 1000.0f;
+  for (int i = 0; i < 200; i++)
+  {
+    const Eigen::Vector3f origin = randomPoint(uniform);
+    const Eigen::Vector3f direction = randomPoint(uniform).normalized();
+    float expected = max_distance;
+    for (int t = 0; t < num_triangles; t++)
+      expected = std::min(expected, singles[t]->raycast(origin, direction, max_distance));
+    EXPECT_NEAR(expected, bvh->raycast(origin, direction, max_distance), 1.0e-3f) << "ray " << i;
+    num_hits += (expected < max_distance) ? 1 : 0;
+  }
+  EXPECT_GT(num_hits, 0);
+  EXPECT_LT(num_hits, 200);
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestDynamicAabbTree, testBruteForce)
+{
+  boost::mt19937 random(2);
+  UniformGenerator uniform(random, boost::uniform_real<float>(-100.0f, 100.0f));
+  UniformGenerator size(random, boost::uniform_real<float>(1.0f, 20.0f));
+  UniformGenerator move(random, boost::uniform_real<float>(-1.0f, 1.0f));
+
+  DynamicAabbTree tree(2.0f);
+  const int num_leaves = 100;
+  for (int l = 0; l < num_leaves; l++)
+  {
+    const Eigen::Vector3f min = randomPoint(uniform);
+    EXPECT_EQ(l, tree.addLeaf(min, min + randomPoint(size)));
+  }
+  EXPECT_EQ(num_leaves, tree.getNumLeaves());
+
+  // Small moves stay in the enlarged boxes, large ones refit the tree.
+  for (int l = 0; l < num_leaves; l += 2)
+  {
+    const Eigen::Vector3f delta = (l % 4 == 0) ? randomPoint(move) : randomPoint(uniform);
+    tree.updateLeaf(l, tree.getMin(l) + delta, tree.getMax(l) + delta);
+  }
+
+  for (int i = 0; i < 100; i++)
+  {
+    const Eigen::Vector3f min = randomPoint(uniform);
+    const Eigen::Vector3f max = min + 2.0f * randomPoint(size);
+    std::vector<int> expected;
+    for (int l = 0; l < num_leaves; l++)
+    {
+      if ((tree.getMin(l).array() <= max.array()).all() && (min.array() <= tree.getMax(l).array()).all())
+        expected.push_back(l);
+    }
+    std::vector<int> leaves;
+    tree.query(min, max, leaves);
+    std::sort(leaves.begin(), leaves.end());
+    EXPECT_EQ(expected, leaves) << "box " << i;
+  }
+
+  for (int a = 0; a < num_leaves; a++)
+  {
+    for (int b = 0; b < num_leaves; b++)
+    {
+      const bool expected = (tree.getMin(a).array() <= tree.getMax(b).array()).all() &&
+        (tree.getMin(b).array() <= tree.getMax(a).array()).all();
+      EXPECT_EQ(expected, tree.overlaps(a, b));
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestWorkStealingScheduler, testCompletion)
+{
+  const int num_workers = 4;
+  WorkStealingScheduler scheduler(num_workers);
+  EXPECT_EQ(num_workers, scheduler.num_workers());
+
+  boost::shared_ptr<CountingJob> weighted(new CountingJob(1000, num_workers));
+  boost::shared_ptr<CountingJob> light(new CountingJob(100, num_workers));
+  boost::shared_ptr<CountingJob> idle(new CountingJob(50, num_workers));
+  scheduler.add_job(weighted, 1.0);
+  scheduler.add_job(light, 0.25);
+  scheduler.add_job(idle, 0.0);
+
+  EXPECT_TRUE(weighted->wait(10.0));
+  EXPECT_TRUE(light->wait(10.0));
+  // The job without a weight only runs on idle workers, but it runs once the others are done.
+  EXPECT_TRUE(idle->wait(10.0));
+
+  EXPECT_FALSE(weighted->hasBadWorker());
+  EXPECT_FALSE(light->hasBadWorker());
+  EXPECT_FALSE(idle->hasBadWorker());
+
+  // Samples of a done job still in the deques are dropped, and the job is released.
+  EXPECT_TRUE(waitReleased(weighted, 5.0));
+  EXPECT_TRUE(waitReleased(light, 5.0));
+  EXPECT_TRUE(waitReleased(idle, 5.0));
+  EXPECT_LE(weighted->getCount(), 1000 + num_workers);
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestWorkStealingScheduler, testCancel)
+{
+  const int num_workers = 4;
+  WorkStealingScheduler scheduler(num_workers);
+
+  // Never done unless canceled.
+  boost::shared_ptr<CountingJob> endless(new CountingJob(std::numeric_limits<int>::max(), num_workers));
+  scheduler.add_job(endless, 1.0);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  EXPECT_GT(endless->getCount(), 0);
+
+  endless->cancel();
+  EXPECT_TRUE(waitReleased(endless, 5.0));
+  // At most the samples that had checked done() before the cancel.
+  EXPECT_LE(endless->getCountAfterCancel(), num_workers);
+
+  // The workers are free for the next job.
+  boost::shared_ptr<CountingJob> next(new CountingJob(100, num_workers));
+  scheduler.add_job(next, 1.0);
+  EXPECT_TRUE(next->wait(10.0));
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestHandClosing, testGeneratedForwardKinematics)
+{
+  SoDB::init();
+  const std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  VirtualRobot::RobotPtr robot = VirtualRobot::RobotIO::loadRobot(robot_file);
+  ASSERT_TRUE(robot);
+  VirtualRobot::EndEffectorPtr eef = robot->getEndEffector("SHADOWHAND");
+  ASSERT_TRUE(eef);
+
+  HandClosing closing(eef);
+  if (!closing.isGenerated())
+  {
+    ROS_WARN("The planner was built without the generated forward kinematics (see GENERATE_HAND_FK), not tested.");
+    return;
+  }
+
+  std::vector<VirtualRobot::RobotNodePtr> joints;
+  for (size_t i = 0; i < closing.getJointNames().size(); i++)
+  {
+    joints.push_back(robot->getRobotNode(closing.getJointNames()[i]));
+    ASSERT_TRUE(joints.back()) << closing.getJointNames()[i];
+  }
+  std::vector<VirtualRobot::CollisionModelPtr> links;
+  for (size_t i = 0; i < closing.getLinkNames().size(); i++)
+    links.push_back(robot->getRobotNode(closing.getLinkNames()[i])->getCollisionModel());
+
+  boost::mt19937 random(3);
+  UniformGenerator uniform(random, boost::uniform_real<float>(0.0f, 1.0f));
+  HandClosing::PoseVector poses;
+  for (int c = 0; c < 50; c++)
+  {
+    // Random configurations within the joint limits.
+    std::vector<float> values;
+    for (size_t i = 0; i < joints.size(); i++)
+    {
+      const float lo = joints[i]->getJointLimitLo();
+      const float hi = joints[i]->getJointLimitHi();
+      values.push_back(lo + (hi - lo) * uniform());
+    }
+    robot->setJointValues(joints, values);
+    closing.computeLinkPoses(std::vector<double>(values.begin(), values.end()), poses);
+    ASSERT_EQ(links.size(), poses.size());
+
+    for (size_t l = 0; l < links.size(); l++)
+    {
+      if (!links[l])
+        continue;
+      const Eigen::Matrix4f expected = links[l]->getGlobalPose();
+      EXPECT_LT((expected.block<3, 1>(0, 3) - poses[l].block<3, 1>(0, 3)).norm(), 1.0e-2f) <<
+        closing.getLinkNames()[l] << ", configuration " << c;
+      EXPECT_LT((expected.block<3, 3>(0, 0) - poses[l].block<3, 3>(0, 0)).norm(), 1.0e-4f) <<
+        closing.getLinkNames()[l] << ", configuration " << c;
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestBatchForwardKinematics, testSimox)
+{
+  SoDB::init();
+  const std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  VirtualRobot::RobotPtr robot = VirtualRobot::RobotIO::loadRobot(robot_file);
+  ASSERT_TRUE(robot);
+  VirtualRobot::EndEffectorPtr eef = robot->getEndEffector("SHADOWHAND");
+  ASSERT_TRUE(eef);
+
+  // The whole end-effector, then each actor alone.
+  std::vector<std::string> actor_names(1, "");
+  std::vector<VirtualRobot::EndEffectorActorPtr> actors;
+  eef->getActors(actors);
+  for (size_t i = 0; i < actors.size(); i++)
+    actor_names.push_back(actors[i]->getName());
+
+  boost::mt19937 random(5);
+  UniformGenerator uniform(random, boost::uniform_real<float>(0.0f, 1.0f));
+  const Eigen::Matrix4f robot_pose = robot->getGlobalPose();
+  const int num_configurations = 20;
+  for (size_t a = 0; a < actor_names.size(); a++)
+  {
+    BatchForwardKinematics batch(eef, actor_names[a]);
+    ASSERT_GT(batch.getNumLinks(), 0) << "actor " << actor_names[a];
+
+    std::vector<VirtualRobot::RobotNodePtr> joints;
+    for (int j = 0; j < batch.getNumJoints(); j++)
+    {
+      joints.push_back(robot->getRobotNode(batch.getJointNames()[j]));
+      ASSERT_TRUE(joints.back()) << batch.getJointNames()[j];
+    }
+
+    // Random configurations within the joint limits, joint by joint.
+    std::vector<float> batch_values(joints.size() * num_configurations);
+    for (size_t j = 0; j < joints.size(); j++)
+    {
+      const float lo = joints[j]->getJointLimitLo();
+      const float hi = joints[j]->getJointLimitHi();
+      for (int c = 0; c < num_configurations; c++)
+        batch_values[j * num_configurations + c] = lo + (hi - lo) * uniform();
+    }
+    std::vector<float> batch_poses;
+    batch.compute(batch_values, num_configurations, batch_poses);
+    ASSERT_EQ(static_cast<size_t>(batch.getNumLinks() * 12 * num_configurations), batch_poses.size());
+
+    std::vector<float> values(joints.size());
+    for (int c = 0; c < num_configurations; c++)
+    {
+      for (size_t j = 0; j < joints.size(); j++)
+        values[j] = batch_values[j * num_configurations + c];
+      robot->setJointValues(joints, values);
+      for (int l = 0; l < batch.getNumLinks(); l++)
+      {
+        const Eigen::Matrix4f expected = robot->getRobotNode(batch.getLinkNames()[l])->getGlobalPose();
+        const Eigen::Matrix4f pose = robot_pose * BatchForwardKinematics::getPose(batch_poses, num_configurations, l, c);
+        EXPECT_LT((expected.block<3, 1>(0, 3) - pose.block<3, 1>(0, 3)).norm(), 1.0e-2f) <<
+          batch.getLinkNames()[l] << ", configuration " << c;
+        EXPECT_LT((expected.block<3, 3>(0, 0) - pose.block<3, 3>(0, 0)).norm(), 1.0e-4f) <<
+          batch.getLinkNames()[l] << ", configuration " << c;
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestSeedApproach, testGeometry)
+{
+  ShapeFrame frame;
+  frame.center = Eigen::Vector3f(10.0f, -20.0f, 30.0f);
+  frame.axes = Eigen::AngleAxisf(0.3f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()).toRotationMatrix();
+  frame.half_extents = Eigen::Vector3f(80.0f, 30.0f, 10.0f);
+
+  const SeedApproaches seeds = computeSeedApproaches(frame);
+  // Both sides of each face, with two rolls.
+  ASSERT_EQ(12u, seeds.size());
+
+  // Enclosing the object along the shortest axis first, then along the middle one, then from its ends.
+  const int axes[3] = {2, 1, 0};
+  for (size_t i = 0; i < seeds.size(); i++)
+  {
+    const int axis = axes[i / 4];
+    const float side = (i % 4 < 2) ? 1.0f : -1.0f;
+    const SeedApproach &seed = seeds[i];
+
+    // From the object outward, along the axis.
+    EXPECT_NEAR(1.0f, seed.direction.norm(), 1.0e-5f);
+    EXPECT_NEAR(side, seed.direction.dot(frame.axes.col(axis)), 1.0e-5f) << "seed " << i;
+
+    // On the center of the face.
+    const Eigen::Vector3f expected = frame.center + side * frame.half_extents(axis) * frame.axes.col(axis);
+    EXPECT_LT((seed.position - expected).norm(), 1.0e-3f) << "seed " << i;
+
+    // The roll is along one of the other axes, a different one for each of the two seeds of a face.
+    EXPECT_NEAR(0.0f, seed.x_axis.dot(seed.direction), 1.0e-5f) << "seed " << i;
+    const int other = (i % 2 == 0) ? (axis + 1) % 3 : (axis + 2) % 3;
+    EXPECT_NEAR(1.0f, std::fabs(seed.x_axis.dot(frame.axes.col(other))), 1.0e-5f) << "seed " << i;
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestAdaptiveQualityThreshold, testThreshold)
+{
+  // Qualities in 10 bins of 0.1, after 20 samples.
+  AdaptiveQualityThreshold threshold(0.1f, 1.0f, 10, 20);
+  threshold.start(2, 3600.0);
+  EXPECT_GT(threshold.getRemainingTime(), 3500.0);
+
+  // Only the best grasps until enough samples are seen.
+  for (int i = 0; i < 19; i++)
+    threshold.addSample(0.05f * i);
+  EXPECT_FLOAT_EQ(1.0f, threshold.getThreshold());
+
+  // With an hour to find two grasps, only the best bin seen so far passes (above the maximum
+  // quality, a sample is in the last bin).
+  threshold.addSample(5.0f);
+  EXPECT_FLOAT_EQ(0.9f, threshold.getThreshold());
+
+  // Once all the grasps are found, it does not move any more.
+  threshold.addAccepted();
+  threshold.addAccepted();
+  for (int i = 0; i < 20; i++)
+    threshold.addSample(0.0f);
+  EXPECT_FLOAT_EQ(0.9f, threshold.getThreshold());
+
+  // A new goal starts from the maximum quality again, and once its budget is spent, any
+  // grasp above the floor passes.
+  threshold.start(2, 0.001);
+  EXPECT_FLOAT_EQ(1.0f, threshold.getThreshold());
+  boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+  EXPECT_DOUBLE_EQ(0.0, threshold.getRemainingTime());
+  for (int i = 0; i < 20; i++)
+    threshold.addSample(0.95f);
+  EXPECT_FLOAT_EQ(0.1f, threshold.getThreshold());
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestReachabilityMap, testCells)
+{
+  // 2x2x2 voxels of 10 cm from (-0.1, -0.1, -0.1), 4 azimuth and 2 polar bins.
+  const char magic[8] = { 'S', 'R', 'R', 'E', 'A', 'C', 'H', '1' };
+  char frame_id[64] = "base_link";
+  const float origin[3] = { -0.1f, -0.1f, -0.1f };
+  const float voxel_size = 0.1f;
+  const boost::uint32_t size[3] = { 2, 2, 2 };
+  const boost::uint32_t num_azimuth = 4;
+  const boost::uint32_t num_polar = 2;
+  // Only reachable in voxel (1, 0, 1), from above along x: polar bin 1, azimuth bin 2.
+  std::vector<boost::uint8_t> cells(2 * 2 * 2 * num_polar * num_azimuth, 0);
+  cells[((((1 * 2) + 0) * 2 + 1) * num_polar + 1) * num_azimuth + 2] = 1;
+
+  const std::string filename = "/tmp/test_grasp_mesh_planner_reachability.bin";
+  FILE *file = std::fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(file != NULL);
+  std::fwrite(magic, sizeof(magic), 1, file);
+  std::fwrite(frame_id, sizeof(frame_id), 1, file);
+  std::fwrite(origin, sizeof(origin), 1, file);
+  std::fwrite(&voxel_size, sizeof(voxel_size), 1, file);
+  std::fwrite(size, sizeof(size), 1, file);
+  std::fwrite(&num_azimuth, sizeof(num_azimuth), 1, file);
+  std::fwrite(&num_polar, sizeof(num_polar), 1, file);
+  // Without the last cell first: the file is too short for its grid.
+  std::fwrite(&cells[0], cells.size() - 1, 1, file);
+  std::fflush(file);
+  EXPECT_FALSE(ReachabilityMap::load(filename));
+  std::fwrite(&cells.back(), 1, 1, file);
+  std::fclose(file);
+
+  ReachabilityMapPtr map = ReachabilityMap::load(filename);
+  std::remove(filename.c_str());
+  ASSERT_TRUE(map);
+  EXPECT_EQ("base_link", map->getFrameId());
+
+  // Positions in mm.
+  const Eigen::Vector3f reachable(50.0f, -50.0f, 50.0f);
+  EXPECT_TRUE(map->isReachable(reachable, Eigen::Vector3f(1.0f, 0.0f, -1.0f)));
+  EXPECT_FALSE(map->isReachable(reachable, Eigen::Vector3f(1.0f, 0.0f, 1.0f)));
+  EXPECT_FALSE(map->isReachable(reachable, Eigen::Vector3f(-1.0f, 0.0f, -1.0f)));
+  EXPECT_FALSE(map->isReachable(Eigen::Vector3f(-50.0f, -50.0f, 50.0f), Eigen::Vector3f(1.0f, 0.0f, -1.0f)));
+  EXPECT_FALSE(map->isReachable(Eigen::Vector3f(150.0f, -50.0f, 50.0f), Eigen::Vector3f(1.0f, 0.0f, -1.0f)));
+  EXPECT_FALSE(map->isReachable(reachable, Eigen::Vector3f::Zero()));
+
+  // Poses in the same voxel, a few degrees apart, share their key.
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  pose.block<3, 1>(0, 3) = Eigen::Vector3f(10.0f, 10.0f, 10.0f);
+  Eigen::Matrix4f close = Eigen::Matrix4f::Identity();
+  close.block<3, 3>(0, 0) = Eigen::AngleAxisf(0.05f, Eigen::Vector3f::UnitZ()).toRotationMatrix();
+  close.block<3, 1>(0, 3) = Eigen::Vector3f(40.0f, 40.0f, 40.0f);
+  EXPECT_EQ(map->hashPose("base_link", pose), map->hashPose("base_link", close));
+  Eigen::Matrix4f moved = pose;
+  moved(0, 3) = 110.0f;
+  EXPECT_NE(map->hashPose("base_link", pose), map->hashPose("base_link", moved));
+  Eigen::Matrix4f turned = pose;
+  turned.block<3, 3>(0, 0) = Eigen::AngleAxisf(1.5f, Eigen::Vector3f::UnitZ()).toRotationMatrix();
+  EXPECT_NE(map->hashPose("base_link", pose), map->hashPose("base_link", turned));
+  EXPECT_NE(map->hashPose("base_link", pose), map->hashPose("world", pose));
+
+  EXPECT_FALSE(ReachabilityMap::load("/tmp/test_grasp_mesh_planner_no_such_map.bin"));
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestApproachPrior, testCells)
+{
+  // A box twice as long as wide, four times as wide as high: elongated and flat.
+  VirtualRobot::TriMeshModelPtr model(new VirtualRobot::TriMeshModel());
+  const Eigen::Vector3f half(80.0f, 40.0f, 10.0f);
+  for (int i = 0; i < 8; i++)
+    model->vertices.push_back(Eigen::Vector3f((i & 1) ? half.x() : -half.x(),
+                                              (i & 2) ? half.y() : -half.y(),
+                                              (i & 4) ? half.z() : -half.z()));
+  // Heavier on the +x end, so that the frame does not flip.
+  model->vertices.push_back(Eigen::Vector3f(half.x(), 0.0f, 0.0f));
+  const ShapeFrame frame = ShapeFrame::compute(model);
+  EXPECT_EQ(ShapeFrame::elongated_flat, frame.shape_class);
+  EXPECT_NEAR(1.0f, std::fabs(frame.axes.col(0).x()), 1.0e-4f);
+  EXPECT_NEAR(1.0f, std::fabs(frame.axes.col(2).z()), 1.0e-4f);
+
+  ApproachPrior prior;
+  const Eigen::Vector3f end(70.0f, 0.0f, 10.0f);
+  const Eigen::Vector3f down(0.0f, 0.0f, -1.0f);
+  const Eigen::Vector3f other_end(-70.0f, 0.0f, 10.0f);
+  // Nothing learnt: every candidate is kept.
+  EXPECT_FLOAT_EQ(1.0f, prior.getWeight(frame, end, down));
+
+  // The grasps are counted where the generators ask about candidates.
+  for (int i = 0; i < 9; i++)
+    prior.addGrasp(frame, end, down);
+  EXPECT_EQ(9u, prior.getNumGrasps());
+  EXPECT_FLOAT_EQ(1.0f, prior.getWeight(frame, end, down));
+  // Another cell along the longest axis, or from below, is only explored.
+  EXPECT_NEAR(0.2f + 0.8f * 0.1f, prior.getWeight(frame, other_end, down), 1.0e-5f);
+  EXPECT_NEAR(0.2f + 0.8f * 0.1f, prior.getWeight(frame, end, -down), 1.0e-5f);
+  // Another shape class learnt nothing.
+  ShapeFrame compact = frame;
+  compact.shape_class = ShapeFrame::compact;
+  EXPECT_FLOAT_EQ(1.0f, prior.getWeight(compact, other_end, down));
+
+  // keep() draws with that weight.
+  boost::mt19937 random(11);
+  int kept = 0;
+  const int draws = 10000;
+  for (int i = 0; i < draws; i++)
+    kept += prior.keep(frame, other_end, down, random) ? 1 : 0;
+  EXPECT_NEAR(0.28, static_cast<double>(kept) / draws, 0.02);
+
+  // Saved and loaded as it was.
+  const std::string filename = "/tmp/test_grasp_mesh_planner_prior.bin";
+  ASSERT_TRUE(prior.save(filename));
+  ApproachPriorPtr loaded = ApproachPrior::load(filename);
+  std::remove(filename.c_str());
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(9u, loaded->getNumGrasps());
+  EXPECT_FLOAT_EQ(prior.getWeight(frame, other_end, down), loaded->getWeight(frame, other_end, down));
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestRetractionEngine, testSearch)
+{
+  RetractionEngine::Settings settings;
+  settings.mode = RetractionEngine::fixed_steps;
+  RetractionEngine fixed(settings);
+  settings.mode = RetractionEngine::adaptive;
+  RetractionEngine adaptive(settings);
+
+  // The same step as the fixed steps, from the surface to deep inside.
+  for (float depth = 0.0f; depth < 1000.0f; depth = 1.7f * depth + 0.9f)
+  {
+    RetractionQuery fixed_query(depth);
+    RetractionQuery adaptive_query(depth);
+    const float expected = fixed.search(boost::ref(fixed_query));
+    EXPECT_GE(expected, depth);
+    EXPECT_LT(expected, depth + settings.step);
+    EXPECT_FLOAT_EQ(expected, adaptive.search(boost::ref(adaptive_query))) << "depth " << depth;
+    // Twice the logarithm of the steps, at most.
+    EXPECT_LE(adaptive_query.getChecks(), 2 * static_cast<int>(std::ceil(std::log(depth / settings.step + 2.0f) / std::log(2.0f))) + 2)
+      << "depth " << depth;
+  }
+
+  // Beyond the distance known to be free, nothing is checked.
+  {
+    RetractionQuery query(100.0f);
+    EXPECT_FLOAT_EQ(102.0f, adaptive.search(boost::ref(query), 100.5f));
+    RetractionQuery checked(100.0f);
+    adaptive.search(boost::ref(checked));
+    EXPECT_LT(query.getChecks(), checked.getChecks());
+  }
+
+  // Still colliding at max_distance.
+  {
+    RetractionQuery fixed_query(2.0f * settings.max_distance);
+    RetractionQuery adaptive_query(2.0f * settings.max_distance);
+    EXPECT_LT(fixed.search(boost::ref(fixed_query)), 0.0f);
+    EXPECT_LT(adaptive.search(boost::ref(adaptive_query)), 0.0f);
+  }
+
+  // A free gap between 30 and 60 mm, before the hand is free for good at 300 mm: the doubling
+  // lands in it at 48 mm, then the bisection goes back to its beginning.
+  {
+    RetractionQuery fixed_query(30.0f, 60.0f, 300.0f);
+    RetractionQuery adaptive_query(30.0f, 60.0f, 300.0f);
+    EXPECT_FLOAT_EQ(30.0f, fixed.search(boost::ref(fixed_query)));
+    EXPECT_FLOAT_EQ(30.0f, adaptive.search(boost::ref(adaptive_query)));
+  }
+  // A gap the doubling steps over (20 to 22 mm free, between its checks at 12 and 24 mm) is missed, but the distance is free.
+  {
+    RetractionQuery query(20.0f, 22.0f, 300.0f);
+    const float distance = adaptive.search(boost::ref(query));
+    EXPECT_FLOAT_EQ(300.0f, distance);
+    RetractionQuery check(20.0f, 22.0f, 300.0f);
+    EXPECT_FALSE(check(distance));
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestRobustnessJob, testScores)
+{
+  SoDB::init();
+  const std::string robot_file = ros::package::getPath("sr_grasp_description") + "/simox/shadowhand.xml";
+  VirtualRobot::RobotPtr robot = VirtualRobot::RobotIO::loadRobot(robot_file);
+  ASSERT_TRUE(robot);
+  VirtualRobot::EndEffectorPtr eef = robot->getEndEffector("SHADOWHAND");
+  ASSERT_TRUE(eef);
+  PreparedObjectPtr prepared = prepareMesh("WhiteCup_800_M.ply", eef);
+  ASSERT_TRUE(prepared);
+
+  // The TCP at the center of the cup, the same grasp for a second hand (the same model), and
+  // the TCP a meter away, where the hand closes on nothing.
+  Eigen::Matrix4f center = Eigen::Matrix4f::Identity();
+  center.block<3, 1>(0, 3) = prepared->shape_frame.center;
+  Eigen::Matrix4f away = center;
+  away(2, 3) += 1000.0f;
+  std::vector<VirtualRobot::EndEffectorPtr> eefs(2, eef);
+  const int hand_list[3] = {0, 1, 0};
+  const std::vector<int> hands(hand_list, hand_list + 3);
+
+  RobustnessJob::Settings settings;
+  settings.num_samples = 8;
+  settings.budget = 0.0f;
+  const unsigned int seed = 7;
+  const int num_workers = 2;
+  WorkStealingScheduler scheduler(num_workers);
+
+  // Twice on the same seed: the same perturbations, so the same scores.
+  std::vector<VirtualRobot::GraspPtr> runs[2];
+  for (int r = 0; r < 2; r++)
+  {
+    runs[r].push_back(makeApproachGrasp(eef, center));
+    runs[r].push_back(makeApproachGrasp(eef, center));
+    runs[r].push_back(makeApproachGrasp(eef, away));
+    RobustnessJobPtr job(new RobustnessJob(prepared, eefs, hands, num_workers, runs[r], false, settings, seed));
+    scheduler.add_job(job, 1.0);
+    EXPECT_EQ(3 * settings.num_samples, job->wait());
+  }
+
+  for (size_t g = 0; g < runs[0].size(); g++)
+  {
+    ApproachGraspPtr grasp = boost::dynamic_pointer_cast<ApproachGrasp>(runs[0][g]);
+    ApproachGraspPtr again = boost::dynamic_pointer_cast<ApproachGrasp>(runs[1][g]);
+    EXPECT_EQ(settings.num_samples, grasp->getNumRobustnessSamples()) << "grasp " << g;
+    EXPECT_GE(grasp->getRobustness(), 0.0f) << "grasp " << g;
+    EXPECT_FLOAT_EQ(grasp->getRobustness(), again->getRobustness()) << "grasp " << g;
+  }
+  // Each grasp on the context of its own hand, on the same perturbations.
+  EXPECT_FLOAT_EQ(boost::dynamic_pointer_cast<ApproachGrasp>(runs[0][0])->getRobustness(),
+                  boost::dynamic_pointer_cast<ApproachGrasp>(runs[0][1])->getRobustness());
+  // Without contacts, every perturbation counts as zero.
+  EXPECT_FLOAT_EQ(0.0f, boost::dynamic_pointer_cast<ApproachGrasp>(runs[0][2])->getRobustness());
+  EXPECT_FLOAT_EQ(0.0f, boost::dynamic_pointer_cast<ApproachGrasp>(runs[0][2])->getRobustnessVariance());
+
+  // Without noise, every perturbation is the pose of the object: no variance.
+  settings.position_noise = 0.0f;
+  settings.rotation_noise = 0.0f;
+  std::vector<VirtualRobot::GraspPtr> exact(1, makeApproachGrasp(eef, center));
+  RobustnessJobPtr job(new RobustnessJob(prepared, eefs, std::vector<int>(1, 0), num_workers, exact, false,
+                                         settings, seed));
+  scheduler.add_job(job, 1.0);
+  EXPECT_EQ(settings.num_samples, job->wait());
+  EXPECT_NEAR(0.0f, boost::dynamic_pointer_cast<ApproachGrasp>(exact[0])->getRobustnessVariance(), 1.0e-6f);
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestFlightRecorder, testBundles)
+{
+  const boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("test_grasp_mesh_planner_%%%%-%%%%");
+  // Two goals in memory, and none is slow enough to be saved for its latency.
+  FlightRecorder recorder(2, 3600.0, directory.string());
+  sr_robot_msgs::PlanGraspGoalPtr goal(new sr_robot_msgs::PlanGraspGoal);
+  goal->object.type.key = "box";
+
+  // A goal that succeeds in time is not saved.
+  const unsigned int fast = recorder.begin("fast", goal, 1, "seed: 1\n");
+  EXPECT_EQ("", recorder.end(fast, true, "succeeded", 2));
+  EXPECT_FALSE(boost::filesystem::exists(directory));
+
+  // A failed goal is saved, with the approach prior as it was when it started planning.
+  const ShapeFrame frame;
+  const Eigen::Vector3f position(0.5f, 0.0f, 0.0f);
+  const Eigen::Vector3f down(0.0f, 0.0f, -1.0f);
+  ApproachPrior prior;
+  prior.addGrasp(frame, position, down);
+  const unsigned int failed = recorder.begin("failed", goal, 42, "seed: 42\n");
+  recorder.setApproachPrior(failed, prior.clone());
+  prior.addGrasp(frame, position, down);
+  {
+    FlightRecorder::ScopedSpan span(&recorder, failed, "plan grasp");
+  }
+  const std::string bundle = recorder.end(failed, false, "canceled", 0);
+  ASSERT_NE("", bundle);
+  EXPECT_TRUE(boost::filesystem::exists(bundle + "/trace.json"));
+  EXPECT_TRUE(boost::filesystem::exists(bundle + "/summary.txt"));
+
+  std::ifstream goal_file((bundle + "/goal.bin").c_str(), std::ios::binary);
+  std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(goal_file)), std::istreambuf_iterator<char>());
+  ASSERT_FALSE(buffer.empty());
+  sr_robot_msgs::PlanGraspGoal saved_goal;
+  ros::serialization::IStream stream(&buffer[0], buffer.size());
+  ros::serialization::deserialize(stream, saved_goal);
+  EXPECT_EQ("box", saved_goal.object.type.key);
+
+  std::ifstream config_file((bundle + "/config.yaml").c_str());
+  std::string config;
+  std::getline(config_file, config);
+  EXPECT_EQ("seed: 42", config);
+
+  ApproachPriorPtr saved_prior = ApproachPrior::load(bundle + "/approach_prior.bin");
+  ASSERT_TRUE(saved_prior);
+  EXPECT_EQ(1u, saved_prior->getNumGrasps());
+
+  // The records are reused in turn: the failed goal is forgotten two goals later.
+  const unsigned int third = recorder.begin("third", goal, 3, "");
+  recorder.begin("fourth", goal, 4, "");
+  EXPECT_EQ("", recorder.end(failed, false, "canceled", 0));
+  EXPECT_NE("", recorder.end(third, false, "canceled", 0));
+
+  boost::filesystem::remove_all(directory);
+}
+
+//-------------------------------------------------------------------------------
+
+TEST(TestModelRegistry, testLoad)
+{
+  const boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("test_grasp_mesh_planner_%%%%-%%%%");
+  boost::filesystem::create_directories(directory);
+  boost::filesystem::copy_file(ros::package::getPath("sr_grasp_mesh_planner") + "/meshes/WhiteCup_800_M.ply",
+                               directory / "cup.ply");
+  std::ofstream notes((directory / "notes.txt").string().c_str());
+  notes << "Not a model." << std::endl;
+  notes.close();
+
+  ModelRegistry registry;
+  EXPECT_EQ(0, registry.load((directory / "missing").string()));
+  EXPECT_EQ(1, registry.load(directory.string()));
+  const std::vector<std::string> keys = registry.getKeys();
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ("cup", keys[0]);
+  EXPECT_FALSE(registry.find("notes"));
+
+  // The same mesh sent in a goal has the same key, so both share the grasp cache.
+  ModelRegistry::ModelConstPtr model = registry.find("cup");
+  ASSERT_TRUE(model);
+  EXPECT_FALSE(model->mesh.triangles.empty());
+  EXPECT_EQ(MeshObstacle::hash_mesh(readMesh("WhiteCup_800_M.ply")), model->mesh_key);
+
+  // The object prepared for a model is kept for its approach movement, until the model is loaded again.
+  PreparedObjectPtr prepared(new PreparedObject);
+  prepared->approach_movement = Planner_surface_normal;
+  EXPECT_FALSE(registry.getPrepared("cup", Planner_surface_normal));
+  registry.setPrepared("cup", prepared);
+  EXPECT_EQ(prepared, registry.getPrepared("cup", Planner_surface_normal));
+  EXPECT_FALSE(registry.getPrepared("cup", Planner_bounding_box));
+  EXPECT_EQ(1, registry.load(directory.string()));
+  EXPECT_FALSE(registry.getPrepared("cup", Planner_surface_normal));
+
+  boost::filesystem::remove_all(directory);
+}
 
 //-------------------------------------------------------------------------------
 
@@ -14,15 +14,24 @@
 
 #pragma once
 
+#include <map>
+#include <ostream>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <boost/foreach.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 
-#include <Inventor/Qt/SoQt.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInteraction.h>
+#include <Inventor/nodekits/SoNodeKit.h>
 #include <Inventor/nodes/SoCube.h>
 #include <Inventor/nodes/SoCylinder.h>
 #include <Inventor/nodes/SoSphere.h>
@@ -30,6 +39,8 @@
 #include <Inventor/nodes/SoSeparator.h>
 #include <Inventor/nodes/SoTranslation.h>
 #include <Inventor/nodes/SoUnits.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
 #include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/actions/SoToVRML2Action.h>
 #include <Inventor/VRMLnodes/SoVRMLTransform.h>
@@ -39,6 +50,31 @@
 namespace gsc
 {
 
+/**
+ * The options of a conversion besides its files, with the defaults of urdf_to_simox_xml:
+ * J1 of each finger of the Shadow hand follows its J2, and the collision filter is computed
+ * (see UrdfToSimoxXml::set_coupled_joints and UrdfToSimoxXml::set_collision_filter).
+ * The planner converts the hands given as URDF with the same defaults.
+ **/
+struct ConversionOptions
+{
+  ConversionOptions();
+
+  std::vector<std::string> coupled_joints;
+  int collision_intervals;
+  double workspace_radius; // m
+  double collision_margin; // m
+  bool binary_models;
+};
+
+/**
+ * Several converters can run at the same time in one process (see --manifest in main.cpp).
+ * Inventor is initialized once for all of them, and only one of them uses it at a time.
+ * The meshes are converted once per process: a mesh used by several hands (with the same
+ * scale) is copied from the first conversion.
+ * Errors (a URDF that cannot be parsed, a mesh that cannot be converted) throw a
+ * std::runtime_error, as the converter also runs inside the planner (see loadRobotModel).
+ **/
 class UrdfToSimoxXml
 {
 public:
@@ -48,13 +84,70 @@ public:
                  double scale);
   ~UrdfToSimoxXml();
 
+  /*!
+   * Couple joints, e.g., "FFJ1:FFJ2:1.0" for the value of FFJ1 to be the value of FFJ2 times 1.0
+   * (to be called before write_xml). Joints with a mimic tag in the URDF are coupled too.
+   * A coupled joint follows its joint in Simox (PropagateJointValue) and is not moved by the actors.
+   */
+  void set_coupled_joints(const std::vector<std::string>& couplings);
+
+  /*!
+   * Sweep the bounding boxes of the links, padded by margin (m), over the joint limits split in
+   * num_intervals intervals (to be called before write_xml), to find the pairs of links that can
+   * collide and the links that can reach the workspace, a sphere of workspace_radius (m) around
+   * the GCP. The swept boxes hold the links in any configuration, so a pair is only filtered out
+   * if it can never collide. write_xml then sets the tightest considerCollisions of the actor
+   * nodes, and write_fk_header writes the masks. With 0 intervals, considerCollisions is None,
+   * as a template. More intervals give tighter boxes.
+   */
+  void set_collision_filter(int num_intervals,
+                            double workspace_radius,
+                            double margin);
+
+  /*!
+   * Write the models of the links as binary Inventor files (.iv) instead of ASCII VRML (.wrl),
+   * to be called before write_xml. They are smaller and parsed faster when the hand is loaded.
+   * The size and parse time of both formats are logged for each mesh.
+   */
+  void set_binary_models(bool binary_models);
+
+  /*! Set all the options above at once (to be called before write_xml). */
+  void set_options(const ConversionOptions& options);
+
   void write_xml(const std::string& output_dir,
                  const std::string& simox_xml_filename);
 
+  /*!
+   * The Simox XML that write_xml would write for the hand (e.g., shadowhand), as a string.
+   * The models of the links are still written to the model directory of output_dir, so give
+   * output_dir as the base path of the models when creating the robot from this string, e.g.,
+   * VirtualRobot::RobotIO::createRobotFromString(xml, output_dir).
+   */
+  std::string get_xml(const std::string& hand_name);
+
+  /*! The name of the robot in the URDF. */
+  std::string get_robot_name(void) const;
+
+  /*!
+   * Write a C++ header with the forward kinematics of each actor, unrolled and
+   * specialized with the joint axes and offsets written by write_xml (to be called first).
+   */
+  void write_fk_header(const std::string& output_dir,
+                       const std::string& fk_header_filename);
+
+  /*!
+   * Initialize Inventor, once per process (also done by the constructor). Call it from the
+   * main thread before converters are created on other threads. No window is opened.
+   */
+  static bool init_inventor(void);
+
   static bool compareUrdfJoint(boost::shared_ptr<urdf::Joint> j1,
                                boost::shared_ptr<urdf::Joint> j2);
 
 private:
+  void build_xml_(const std::string& hand_name,
+                  boost::property_tree::ptree& pt);
+
   void add_hand_base_node_(boost::property_tree::ptree & hand_node,
                            const std::string & hand_base,
                            const std::string & hand_tcp,
@@ -67,6 +160,9 @@ private:
   void add_hand_gcp_node_(boost::property_tree::ptree & hand_node,
                           const std::string & hand_gcp);
 
+  void get_hand_gcp_(double translation[3],
+                     double rollpitchyaw[3]);
+
   void add_link_node_(boost::property_tree::ptree & hand_node,
                       boost::shared_ptr<const urdf::Link> link);
 
@@ -125,6 +221,8 @@ private:
   std::string convert_sphere_(const std::string & link_name,
                               const double & radius);
   std::string convert_mesh_(const std::string & urdf_filename);
+  std::string convert_scaled_mesh_(const std::string & urdf_filename,
+                                   const urdf::Vector3 & mesh_scale);
 
   std::string  write_to_iv_file_(const std::string & file_name,
                                  SoSeparator *scene_with_shape);
@@ -134,12 +232,57 @@ private:
                         const double & scale_y,
                         const double & scale_z);
 
+  std::string write_binary_iv_(const std::string & wrl_filename);
+
+  static double parse_time_(const std::string & filename);
+
   std::string to_string_(double x);
 
   void set_base_link_(void);
 
   void read_dae_file_(const std::string & dae_filename);
 
+private:
+  void write_fk_link_(std::ostream & out,
+                      boost::shared_ptr<const urdf::Link> link,
+                      const std::string & frame,
+                      const double offset[12],
+                      const std::set<std::string> & output_links,
+                      int & num_frames);
+
+  bool fk_subtree_has_(boost::shared_ptr<const urdf::Link> link,
+                       const std::set<std::string> & output_links);
+
+  void get_fk_transform_(const urdf::Pose & pose,
+                         double transform[12]);
+
+  static void fk_multiply_(const double a[12],
+                           const double b[12],
+                           double c[12]);
+
+  static std::string fk_array_(const double transform[12]);
+
+  static void fk_rotate_(const double a[12],
+                         const double axis[3],
+                         double q,
+                         double c[12]);
+
+  static SbBox3f transform_box_(const double transform[12],
+                                const SbBox3f & box);
+
+  SbBox3f sweep_box_(boost::shared_ptr<const urdf::Link> link,
+                     const SbBox3f & box);
+
+  void compute_collision_filter_(void);
+
+  SbBox3f get_bounding_box_(const std::string & filename);
+
+  std::string get_consider_collisions_(boost::shared_ptr<const urdf::Link> link);
+
+  int get_link_actor_(boost::shared_ptr<const urdf::Link> link);
+
+  double round_(double x);
+
 private:
   boost::scoped_ptr<urdf::Model> urdf_model_;
 
@@ -161,7 +304,52 @@ private:
   std::vector< boost::shared_ptr<const urdf::Link> > simox_links_;
   std::vector< boost::shared_ptr<const urdf::Joint> > simox_joints_;
 
-  QWidget *window_;
+  // Coupled joint -> (the joint it follows, factor).
+  typedef std::map< std::string, std::pair<std::string, double> > name2coupling;
+  name2coupling coupled_joints_;
+
+  // Set by write_xml, e.g., SHADOWHAND.
+  std::string hand_type_;
+
+  // Index in the generated forward kinematics of the revolute joints and of the links.
+  std::map<std::string, int> fk_joint_index_;
+  std::map<std::string, int> fk_link_index_;
+
+  // See set_collision_filter.
+  int collision_intervals_;
+  double workspace_radius_;
+  double collision_margin_;
+
+  // See set_binary_models. Sizes (bytes) and parse times (s) of the converted meshes.
+  bool binary_models_;
+  double ascii_bytes_;
+  double binary_bytes_;
+  double ascii_parse_time_;
+  double binary_parse_time_;
+
+  // The collision model of each converted link.
+  std::map<std::string, std::string> simox_colli_files_;
+
+  // Indexed as simox_links_, set by compute_collision_filter_ (empty without intervals).
+  std::vector< std::vector<bool> > can_collide_;
+  std::vector<bool> reaches_workspace_;
+
+  static void init_inventor_(void);
+  static boost::once_flag inventor_once_;
+  // Inventor is not thread safe.
+  static boost::recursive_mutex inventor_mutex_;
+
+  // A mesh converted and scaled for one of the converters, by URDF filename and scales.
+  struct ConvertedMesh
+  {
+    boost::mutex mutex;
+    std::string filename;
+    // scale_ after the conversion (see read_dae_file_).
+    double scale;
+  };
+  typedef std::map< std::string, boost::shared_ptr<ConvertedMesh> > name2converted;
+  static name2converted converted_meshes_;
+  static boost::mutex converted_meshes_mutex_;
 
   static const std::string model_dir_name_;
 
@@ -17,11 +17,18 @@
 
 #include "urdf_to_simox_xml/urdf_to_simox_xml.hpp"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/program_options.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <ros/ros.h>
 #include <ros/package.h>
 
@@ -31,6 +38,113 @@ namespace po = boost::program_options;
 
 //-------------------------------------------------------------------------------
 
+namespace
+{
+
+// One hand to convert: a line of the manifest, or the command line.
+struct Conversion
+{
+  std::string urdf_filename;
+  std::string simox_xml_filename;
+  std::string fk_header_filename;
+};
+
+// The options shared by all the conversions.
+struct Options
+{
+  bool urdf_init_param;
+  std::string output_dir;
+  double scale;
+  gsc::ConversionOptions conversion;
+};
+
+void convert(const Conversion &conversion, const Options &options)
+{
+  gsc::UrdfToSimoxXml urdf2xml(options.urdf_init_param, conversion.urdf_filename, options.output_dir, options.scale);
+
+  urdf2xml.set_options(options.conversion);
+
+  urdf2xml.write_xml(options.output_dir, conversion.simox_xml_filename);
+
+  if (!conversion.fk_header_filename.empty())
+    urdf2xml.write_fk_header(options.output_dir, conversion.fk_header_filename);
+}
+
+/*
+ * Each line is "urdf_file xml_file [fk_header_file]", separated by spaces.
+ * Empty lines and lines starting with # are ignored.
+ */
+bool read_manifest(const std::string &manifest_filename, std::vector<Conversion> &conversions)
+{
+  std::ifstream manifest(manifest_filename.c_str());
+  if (!manifest)
+  {
+    ROS_ERROR_STREAM("Failed to open the manifest " << manifest_filename << ".");
+    return false;
+  }
+
+  std::string line;
+  int line_number = 0;
+  while (std::getline(manifest, line))
+  {
+    line_number++;
+    boost::trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of(" \t"), boost::token_compress_on);
+    if (fields.size() < 2 || fields.size() > 3)
+    {
+      ROS_ERROR_STREAM(manifest_filename << ":" << line_number << ": expected urdf_file xml_file [fk_header_file].");
+      return false;
+    }
+
+    Conversion conversion;
+    conversion.urdf_filename = fields[0];
+    conversion.simox_xml_filename = fields[1];
+    if (fields.size() > 2)
+      conversion.fk_header_filename = fields[2];
+    conversions.push_back(conversion);
+  }
+  return true;
+}
+
+// The conversions not started yet are taken in order by the worker threads.
+boost::mutex next_conversion_mutex;
+std::size_t next_conversion = 0;
+std::size_t failed_conversions = 0;
+
+void convert_worker(const std::vector<Conversion> *conversions, const Options *options)
+{
+  while (true)
+  {
+    std::size_t i;
+    {
+      boost::mutex::scoped_lock lock(next_conversion_mutex);
+      if (next_conversion >= conversions->size())
+        return;
+      i = next_conversion++;
+    }
+    ROS_INFO_STREAM("Converting " << (*conversions)[i].urdf_filename << " to " <<
+                    (*conversions)[i].simox_xml_filename << ".");
+    try
+    {
+      convert((*conversions)[i], *options);
+    }
+    catch (std::exception &e)
+    {
+      ROS_ERROR_STREAM("Failed to convert " << (*conversions)[i].urdf_filename << ": " << e.what());
+      boost::mutex::scoped_lock lock(next_conversion_mutex);
+      failed_conversions++;
+    }
+  }
+}
+
+} // end of anonymous namespace
+
+//-------------------------------------------------------------------------------
+
 int main(int argc, char** argv)
 {
   ros::init(argc, argv, "urdf_to_simox_xml");
@@ -51,7 +165,17 @@ int main(int argc, char** argv)
   std::string urdf_filename;
   std::string output_dir;
   std::string simox_xml_filename;
+  std::string fk_header_filename;
+  std::string coupled_joints;
+  std::string manifest_filename;
+  int jobs;
+  int collision_intervals;
+  double workspace_radius;
+  double collision_margin;
   double scale;
+  bool binary_iv;
+
+  const gsc::ConversionOptions defaults;
 
   try {
     po::options_description desc("Allowed options");
@@ -69,6 +193,26 @@ int main(int argc, char** argv)
       ("scale", po::value<double>(&scale)->default_value(1.0),
        "set the default scale (used when converting to WRL files)\n"
        "note that the units in VRML (i.e., .WRL files) are assumed to be meters.")
+      ("binary_iv", po::value<bool>(&binary_iv)->default_value(defaults.binary_models),
+       "write the models of the links as binary Inventor files (.iv) instead of VRML (.wrl)\n"
+       "they are smaller and faster to load, the sizes and parse times of both are logged.")
+      ("fk_header", po::value<std::string>(&fk_header_filename)->default_value(""),
+       "also write the forward kinematics of the actors to this C++ header (e.g., shadowhand_fk.hpp)")
+      ("coupled_joints", po::value<std::string>(&coupled_joints)->default_value(boost::join(defaults.coupled_joints, ",")),
+       "set the coupled joints, as joint:followed_joint:factor separated by commas\n"
+       "the default is the coupling of J1 and J2 of the fingers of the Shadow hand (joints that are not in the URDF are ignored).")
+      ("collision_intervals", po::value<int>(&collision_intervals)->default_value(defaults.collision_intervals),
+       "set the number of intervals each joint range is split in to sweep the links and find the ones that can collide\n"
+       "and set considerCollisions (0 leaves it to None, to be set manually)")
+      ("workspace_radius", po::value<double>(&workspace_radius)->default_value(defaults.workspace_radius),
+       "set the radius of the workspace of the object around the GCP (m)")
+      ("collision_margin", po::value<double>(&collision_margin)->default_value(defaults.collision_margin),
+       "set the margin added to the bounding boxes of the links (m)")
+      ("manifest", po::value<std::string>(&manifest_filename)->default_value(""),
+       "convert all the hands of this file instead, one per line: urdf_file xml_file [fk_header_file]\n"
+       "(the other options apply to all of them, --robot_description, --urdf, --xml and --fk_header are ignored)")
+      ("jobs", po::value<int>(&jobs)->default_value(0),
+       "set the number of hands converted at the same time with --manifest (0 for one per hardware thread)")
       ;
 
     po::variables_map vm;
@@ -82,11 +226,18 @@ int main(int argc, char** argv)
       exit (EXIT_SUCCESS);
     }
 
-    if (urdf_init_param)
-      std::cout << "Load from the robot_description parameter : " << urdf_init_param << std::endl;
+    if (!manifest_filename.empty())
+    {
+      std::cout << "Manifest:                                   " << manifest_filename << std::endl;
+    }
     else
-      std::cout << "Path to the URDF file:                      " << urdf_filename << std::endl;
-    std::cout << "Name of the output file (Simox XML):        " << simox_xml_filename << std::endl;
+    {
+      if (urdf_init_param)
+        std::cout << "Load from the robot_description parameter : " << urdf_init_param << std::endl;
+      else
+        std::cout << "Path to the URDF file:                      " << urdf_filename << std::endl;
+      std::cout << "Name of the output file (Simox XML):        " << simox_xml_filename << std::endl;
+    }
   }
   catch (std::exception& e)
   {
@@ -97,9 +248,63 @@ int main(int argc, char** argv)
   if (!boost::filesystem::exists(output_dir))
     boost::filesystem::create_directories(output_dir);
 
-  gsc::UrdfToSimoxXml urdf2xml(urdf_init_param, urdf_filename, output_dir, scale);
+  Options options;
+  options.urdf_init_param = urdf_init_param;
+  options.output_dir = output_dir;
+  options.scale = scale;
+  options.conversion.coupled_joints.clear();
+  if (!coupled_joints.empty())
+    boost::split(options.conversion.coupled_joints, coupled_joints, boost::is_any_of(","));
+  options.conversion.collision_intervals = collision_intervals;
+  options.conversion.workspace_radius = workspace_radius;
+  options.conversion.collision_margin = collision_margin;
+  options.conversion.binary_models = binary_iv;
 
-  urdf2xml.write_xml(output_dir, simox_xml_filename);
+  if (manifest_filename.empty())
+  {
+    Conversion conversion;
+    conversion.urdf_filename = urdf_filename;
+    conversion.simox_xml_filename = simox_xml_filename;
+    conversion.fk_header_filename = fk_header_filename;
+    try
+    {
+      convert(conversion, options);
+    }
+    catch (std::exception &e)
+    {
+      ROS_ERROR_STREAM(e.what());
+      exit (EXIT_FAILURE);
+    }
+    return 0;
+  }
+
+  // All the hands of the manifest (from their URDF files), several at the same time.
+  std::vector<Conversion> conversions;
+  if (!read_manifest(manifest_filename, conversions))
+    return -1;
+  options.urdf_init_param = false;
+  if (!gsc::UrdfToSimoxXml::init_inventor())
+  {
+    ROS_ERROR_STREAM("Failed to init Inventor.");
+    return -1;
+  }
+
+  if (jobs <= 0)
+    jobs = std::max(1u, boost::thread::hardware_concurrency());
+  jobs = std::min(jobs, static_cast<int>(conversions.size()));
+
+  boost::thread_group workers;
+  for (int i = 0; i < jobs; i++)
+    workers.create_thread(boost::bind(&convert_worker, &conversions, &options));
+  workers.join_all();
+
+  if (failed_conversions > 0)
+  {
+    ROS_ERROR_STREAM("Failed to convert " << failed_conversions << " of the " << conversions.size() <<
+                     " hand(s) from " << manifest_filename << ".");
+    exit (EXIT_FAILURE);
+  }
+  ROS_INFO_STREAM("Converted " << conversions.size() << " hand(s) from " << manifest_filename << ".");
 
   return 0;
 }
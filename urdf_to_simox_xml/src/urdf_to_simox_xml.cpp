@@ -16,12 +16,16 @@
 
 #include "urdf_to_simox_xml/urdf_to_simox_xml.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <exception>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <set>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/iter_find.hpp>
@@ -30,6 +34,7 @@
 #include <boost/lexical_cast.hpp>
 #include <ros/console.h>
 #include <ros/package.h>
+#include <ros/time.h>
 
 //-------------------------------------------------------------------------------
 
@@ -48,6 +53,26 @@ const std::string UrdfToSimoxXml::robot_name_in_dms_urdf_ = std::string("four_do
 // Will be used later when checking which hand model we are actually parsing.
 const std::string UrdfToSimoxXml::robot_name_in_shadowhand_urdf_ = std::string("shadowhand");
 
+boost::once_flag UrdfToSimoxXml::inventor_once_ = BOOST_ONCE_INIT;
+boost::recursive_mutex UrdfToSimoxXml::inventor_mutex_;
+
+UrdfToSimoxXml::name2converted UrdfToSimoxXml::converted_meshes_;
+boost::mutex UrdfToSimoxXml::converted_meshes_mutex_;
+
+//-------------------------------------------------------------------------------
+
+ConversionOptions::ConversionOptions()
+  : collision_intervals(32),
+    workspace_radius(0.1),
+    collision_margin(0.005),
+    binary_models(false)
+{
+  coupled_joints.push_back("FFJ1:FFJ2:1.0");
+  coupled_joints.push_back("LFJ1:LFJ2:1.0");
+  coupled_joints.push_back("MFJ1:MFJ2:1.0");
+  coupled_joints.push_back("RFJ1:RFJ2:1.0");
+}
+
 //-------------------------------------------------------------------------------
 
 UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
@@ -56,15 +81,20 @@ UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
                                const double scale)
   : urdf_model_(new urdf::Model()),
     output_dir_(output_dir),
-    scale_(scale)
+    scale_(scale),
+    collision_intervals_(0),
+    workspace_radius_(0.0),
+    collision_margin_(0.0),
+    binary_models_(false),
+    ascii_bytes_(0.0),
+    binary_bytes_(0.0),
+    ascii_parse_time_(0.0),
+    binary_parse_time_(0.0)
 {
-  // Init Inventor.
-  const char input[] = "UrdfToSimoxXml";
-  window_ = SoQt::init(input);
-  if (window_ == NULL)
+  // Init Inventor, once for all the converters.
+  if (!UrdfToSimoxXml::init_inventor())
   {
-    ROS_ERROR_STREAM("Failed to init Inventor.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("Failed to init Inventor.");
   }
 
   if (urdf_init_param)
@@ -73,8 +103,7 @@ UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
     const std::string rd_param("robot_description");
     if (!urdf_model_->initParam(rd_param))
     {
-      ROS_ERROR_STREAM("Failed to parse param " << rd_param << ".");
-      exit (EXIT_FAILURE);
+      throw std::runtime_error("Failed to parse param " + rd_param + ".");
     }
   }
   else
@@ -82,8 +111,7 @@ UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
     // Parse the URDF file and then construct the model.
     if (!urdf_model_->initFile(urdf_file))
     {
-      ROS_ERROR_STREAM("Failed to parse urdf file " << urdf_file << ".");
-      exit (EXIT_FAILURE);
+      throw std::runtime_error("Failed to parse urdf file " + urdf_file + ".");
     }
   }
 
@@ -95,8 +123,7 @@ UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
   urdf_model_->getLinks(links_);
   if (links_.empty())
   {
-    ROS_ERROR_STREAM("There are no links in " << urdf_file << ".");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("There are no links in " + urdf_file + ".");
   }
 
   // Set the base link.
@@ -116,6 +143,52 @@ UrdfToSimoxXml::UrdfToSimoxXml(const bool urdf_init_param,
 
   // Sort the joints by their names.
   std::sort(joints_.begin(), joints_.end(), UrdfToSimoxXml::compareUrdfJoint);
+
+  // Joints that mimic another joint are coupled to it.
+  BOOST_FOREACH(boost::shared_ptr<urdf::Joint> joint, joints_)
+  {
+    if (!joint->mimic)
+      continue;
+    if (joint->mimic->offset != 0.0)
+      ROS_WARN_STREAM("Simox does not support the offset of the mimic tag of " << joint->name << ". It is ignored.");
+    coupled_joints_[joint->name] = std::make_pair(joint->mimic->joint_name, joint->mimic->multiplier);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::set_coupled_joints(const std::vector<std::string>& couplings)
+{
+  BOOST_FOREACH(const std::string& coupling, couplings)
+  {
+    std::vector<std::string> fields;
+    boost::split(fields, coupling, boost::is_any_of(":"));
+    double factor = 0.0;
+    try
+    {
+      if (fields.size() != 3)
+        throw boost::bad_lexical_cast();
+      factor = boost::lexical_cast<double>(fields[2]);
+    }
+    catch (boost::bad_lexical_cast &)
+    {
+      throw std::runtime_error("Coupling " + coupling + " should be something like FFJ1:FFJ2:1.0.");
+    }
+
+    boost::shared_ptr<const urdf::Joint> joint = urdf_model_->getJoint(fields[0]);
+    boost::shared_ptr<const urdf::Joint> leader = urdf_model_->getJoint(fields[1]);
+    if (!joint || !leader)
+    {
+      ROS_WARN_STREAM("Coupling " << coupling << " is ignored, the joints are not in the URDF.");
+      continue;
+    }
+    if (joint->type != urdf::Joint::REVOLUTE || leader->type != urdf::Joint::REVOLUTE)
+    {
+      ROS_WARN_STREAM("Coupling " << coupling << " is ignored, only revolute joints can be coupled.");
+      continue;
+    }
+    coupled_joints_[fields[0]] = std::make_pair(fields[1], factor);
+  }
 }
 
 //-------------------------------------------------------------------------------
@@ -125,29 +198,105 @@ UrdfToSimoxXml::~UrdfToSimoxXml()
 }
 
 //-------------------------------------------------------------------------------
+
+bool UrdfToSimoxXml::init_inventor(void)
+{
+  boost::call_once(&UrdfToSimoxXml::init_inventor_, inventor_once_);
+  return SoDB::isInitialized();
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::init_inventor_(void)
+{
+  // The conversion only reads and writes files: it needs neither a window nor a display (e.g., when
+  // run at build time). Nothing is done again if the application already did it (e.g., SoQt::init).
+  SoDB::init();
+  SoNodeKit::init();
+  SoInteraction::init();
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::set_collision_filter(int num_intervals,
+                                          double workspace_radius,
+                                          double margin)
+{
+  collision_intervals_ = num_intervals;
+  workspace_radius_ = workspace_radius;
+  collision_margin_ = margin;
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::set_binary_models(bool binary_models)
+{
+  binary_models_ = binary_models;
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::set_options(const ConversionOptions& options)
+{
+  this->set_coupled_joints(options.coupled_joints);
+  this->set_collision_filter(options.collision_intervals, options.workspace_radius, options.collision_margin);
+  this->set_binary_models(options.binary_models);
+}
+
 //-------------------------------------------------------------------------------
 
 void UrdfToSimoxXml::write_xml(const std::string& output_dir,
                                const std::string& simox_xml_filename)
 {
-  // No link has been converted to Simox.
-  simox_links_.clear();
-
   // Obtain the name of the hand from simox_xml_filename.
   std::list<std::string> stringList;
   boost::iter_split(stringList, simox_xml_filename, boost::first_finder("."));
   if (stringList.size() != 2)
   {
-    ROS_ERROR_STREAM(simox_xml_filename << " should be something like dms.xml or shadowhand.xml.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error(simox_xml_filename + " should be something like dms.xml or shadowhand.xml.");
   }
 
-  std::string hand_name(stringList.front());
-  std::string hand_name_upper_case = boost::to_upper_copy(hand_name);
-  std::string hand_name_lower_case = boost::to_lower_copy(hand_name);
+  ptree pt;
+  this->build_xml_(stringList.front(), pt);
 
-  // Create empty property tree object
+  // Write property tree to XML file
+  // http://stackoverflow.com/questions/6572550/boostproperty-tree-xml-pretty-printing
+  std::string simox_xml_file = output_dir + "/" + simox_xml_filename;
+  boost::property_tree::xml_writer_settings<char> settings('\t', 1);
+  boost::property_tree::write_xml(simox_xml_file, pt, std::locale(), settings);
+}
+
+//-------------------------------------------------------------------------------
+
+std::string UrdfToSimoxXml::get_xml(const std::string& hand_name)
+{
   ptree pt;
+  this->build_xml_(hand_name, pt);
+
+  std::ostringstream xml;
+  boost::property_tree::write_xml(xml, pt);
+  return xml.str();
+}
+
+//-------------------------------------------------------------------------------
+
+std::string UrdfToSimoxXml::get_robot_name(void) const
+{
+  return urdf_model_->getName();
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::build_xml_(const std::string& hand_name,
+                                boost::property_tree::ptree& pt)
+{
+  // No link and no joint has been converted to Simox.
+  simox_links_.clear();
+  simox_joints_.clear();
+
+  std::string hand_name_upper_case = boost::to_upper_copy(hand_name);
+  std::string hand_name_lower_case = boost::to_lower_copy(hand_name);
+  hand_type_ = hand_name_upper_case;
 
   // TCP = Tool Center Point
   //   TCP is the point in relation to which all robot positioning is defined.
@@ -179,6 +328,9 @@ void UrdfToSimoxXml::write_xml(const std::string& output_dir,
   // Add RobotNode for the base link.
   this->add_link_node_(hand_node, base_link_);
 
+  // Find the links that can collide, now that all of them are converted.
+  this->compute_collision_filter_();
+
   // Add Endeffector name="${hand_name_upper_case}" base="${hand_name_lower_case}_hand_base"
   // tcp="${hand_name_lower_case}_hand_tcp" gcp="${hand_name_lower_case}_hand_gcp".
   this->add_endeffector_node_(hand_node,
@@ -194,11 +346,12 @@ void UrdfToSimoxXml::write_xml(const std::string& output_dir,
   // Add the ${hand_name_upper_case} to the tree.
   pt.add_child("Robot", hand_node);
 
-  // Write property tree to XML file
-  // http://stackoverflow.com/questions/6572550/boostproperty-tree-xml-pretty-printing
-  std::string simox_xml_file = output_dir + "/" + simox_xml_filename;
-  boost::property_tree::xml_writer_settings<char> settings('\t', 1);
-  boost::property_tree::write_xml(simox_xml_file, pt, std::locale(), settings);
+  if (binary_models_ && ascii_bytes_ > 0.0)
+  {
+    ROS_INFO_STREAM("Binary models of " << hand_name << ": " << binary_bytes_ / 1024.0 << " kB instead of " <<
+                    ascii_bytes_ / 1024.0 << " kB, parsed in " << binary_parse_time_ * 1000.0 << " ms instead of " <<
+                    ascii_parse_time_ * 1000.0 << " ms.");
+  }
 }
 
 //-------------------------------------------------------------------------------
@@ -267,31 +420,50 @@ void UrdfToSimoxXml::add_hand_gcp_node_(boost::property_tree::ptree & hand_node,
   hand_gcp_node.put("<xmlattr>.name", hand_gcp);
   hand_gcp_node.put("<xmlcomment>", "Translation and rollpitchyaw values were set manually!");
 
+  double translation[3];
+  double rollpitchyaw[3];
+  this->get_hand_gcp_(translation, rollpitchyaw);
+
   boost::property_tree::ptree Translation_node;
+  this->set_translation_node_(Translation_node, translation[0], translation[1], translation[2]);
   boost::property_tree::ptree rollpitchyaw_node;
+  this->set_rollpitchyaw_node_(rollpitchyaw_node, rollpitchyaw[0], rollpitchyaw[1], rollpitchyaw[2]);
 
+  boost::property_tree::ptree Transform_node;
+  Transform_node.add_child("Translation", Translation_node);
+  Transform_node.add_child("rollpitchyaw", rollpitchyaw_node);
+  hand_gcp_node.add_child("Transform", Transform_node);
+  hand_node.add_child("RobotNode", hand_gcp_node);
+}
+
+//-------------------------------------------------------------------------------
+
+// The GCP relative to the hand base (m and radian), set manually.
+void UrdfToSimoxXml::get_hand_gcp_(double translation[3],
+                                   double rollpitchyaw[3])
+{
   const std::string model_name = urdf_model_->getName();
   if (model_name.compare(robot_name_in_dms_urdf_) == 0) // DMS Hand
   {
-    this->set_translation_node_(Translation_node, -0.01, -0.035, 0.07);
-    this->set_rollpitchyaw_node_(rollpitchyaw_node, 1.0, 0.0, 0.0);
+    const double t[3] = { -0.01, -0.035, 0.07 };
+    const double r[3] = { 1.0, 0.0, 0.0 };
+    std::copy(t, t + 3, translation);
+    std::copy(r, r + 3, rollpitchyaw);
   }
   else if (model_name.compare(robot_name_in_shadowhand_urdf_) == 0) // Shadow Hand
   {
-    this->set_translation_node_(Translation_node, 0.0, -0.05, 0.30);
-    this->set_rollpitchyaw_node_(rollpitchyaw_node, 0.75, 0.0, 0.0);
+    const double t[3] = { 0.0, -0.05, 0.30 };
+    const double r[3] = { 0.75, 0.0, 0.0 };
+    std::copy(t, t + 3, translation);
+    std::copy(r, r + 3, rollpitchyaw);
   }
   else // Other Hand
   {
-    this->set_translation_node_(Translation_node, 0.0, 0.0, 0.0);
-    this->set_rollpitchyaw_node_(rollpitchyaw_node, 1.0, 0.0, 0.0);
+    const double t[3] = { 0.0, 0.0, 0.0 };
+    const double r[3] = { 1.0, 0.0, 0.0 };
+    std::copy(t, t + 3, translation);
+    std::copy(r, r + 3, rollpitchyaw);
   }
-
-  boost::property_tree::ptree Transform_node;
-  Transform_node.add_child("Translation", Translation_node);
-  Transform_node.add_child("rollpitchyaw", rollpitchyaw_node);
-  hand_gcp_node.add_child("Transform", Transform_node);
-  hand_node.add_child("RobotNode", hand_gcp_node);
 }
 
 //-------------------------------------------------------------------------------
@@ -306,14 +478,7 @@ std::string UrdfToSimoxXml::parse_geometry(boost::shared_ptr<const urdf::Link> l
     boost::shared_ptr<urdf::Mesh> mesh = boost::dynamic_pointer_cast<urdf::Mesh>(geometry);
 
     // Note that variable scale_ may be reset inside method convert_mesh_.
-    simox_filename = this->convert_mesh_(mesh->filename);
-
-    // <mesh filename="package://sr_grasp_description/meshes/TH3_z.dae" scale="0.1 0.1 0.1" />
-    const double scale_x = mesh->scale.x * scale_;
-    const double scale_y = mesh->scale.y * scale_;
-    const double scale_z = mesh->scale.z * scale_;
-    if (scale_x != 1.0 || scale_y != 1.0 || scale_z != 1.0)
-      this->scale_wrl_scene_(simox_filename, scale_x, scale_y, scale_z);
+    simox_filename = this->convert_scaled_mesh_(mesh->filename, mesh->scale);
   }
   else if (geometry->type == urdf::Geometry::SPHERE)
   {
@@ -336,8 +501,7 @@ std::string UrdfToSimoxXml::parse_geometry(boost::shared_ptr<const urdf::Link> l
   }
   else
   {
-    ROS_ERROR_STREAM("SPHERE, BOX, CYLINDER, MESH are the 4 supported urdf::Geometry types.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("SPHERE, BOX, CYLINDER, MESH are the 4 supported urdf::Geometry types.");
   }
 
   return simox_filename;
@@ -374,6 +538,7 @@ void UrdfToSimoxXml::add_visual_node(boost::shared_ptr<urdf::Visual> visual,
   {
     simox_visua_filename = this->parse_geometry(link, geometry);
     simox_colli_filename = simox_visua_filename;
+    simox_colli_files_[link->name] = simox_colli_filename;
   }
 
   // Add the visualization node.
@@ -471,6 +636,17 @@ void UrdfToSimoxXml::add_joint_node_(boost::property_tree::ptree & hand_node,
     Joint_node.put("<xmlattr>.type", "revolute");
     Joint_node.add_child("Axis", Axis_node);
     Joint_node.add_child("Limits", Limits_node);
+
+    // Add PropagateJointValue for the joints coupled to this one.
+    for (name2coupling::const_iterator iter = coupled_joints_.begin(); iter != coupled_joints_.end(); ++iter)
+    {
+      if (iter->second.first != child_joint->name)
+        continue;
+      boost::property_tree::ptree Propagate_node;
+      Propagate_node.put("<xmlattr>.name", iter->first);
+      Propagate_node.put("<xmlattr>.factor", this->to_string_(iter->second.second));
+      Joint_node.add_child("PropagateJointValue", Propagate_node);
+    }
     child_joint_node.add_child("Joint", Joint_node);
   }
   else if (child_joint->type == urdf::Joint::FIXED)
@@ -481,8 +657,7 @@ void UrdfToSimoxXml::add_joint_node_(boost::property_tree::ptree & hand_node,
   }
   else
   {
-    ROS_ERROR_STREAM("Only revolute and fixed joints are support at moment.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("Only revolute and fixed joints are support at moment.");
   }
 
   boost::property_tree::ptree Child_node;
@@ -561,13 +736,17 @@ void UrdfToSimoxXml::add_endeffector_node_(boost::property_tree::ptree & hand_no
       {
         boost::property_tree::ptree Node_node;
         Node_node.put("<xmlattr>.name", link->name);
-        Node_node.put("<xmlattr>.considerCollisions", "None");
+        Node_node.put("<xmlattr>.considerCollisions", this->get_consider_collisions_(link));
         Actor_node.add_child("Node", Node_node);
       }
     }
 
     BOOST_FOREACH(boost::shared_ptr<const urdf::Joint> joint, simox_joints_)
     {
+      // Coupled joints follow their joint, the actor does not move them.
+      if (coupled_joints_.find(joint->name) != coupled_joints_.end())
+        continue;
+
       const char& first_char = joint->name.at(0);
       if (actor_name == toupper(first_char))
       {
@@ -617,6 +796,666 @@ void UrdfToSimoxXml::get_actors(std::map<int, bool>& actors)
 }
 
 //-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::write_fk_header(const std::string& output_dir,
+                                     const std::string& fk_header_filename)
+{
+  if (simox_links_.empty())
+  {
+    throw std::runtime_error("UrdfToSimoxXml::write_xml must be called before UrdfToSimoxXml::write_fk_header.");
+  }
+
+  // The joint values are given for the revolute joints only, in the order of the Simox XML file.
+  fk_joint_index_.clear();
+  std::vector<std::string> joint_names;
+  BOOST_FOREACH(boost::shared_ptr<const urdf::Joint> joint, simox_joints_)
+  {
+    if (joint->type == urdf::Joint::REVOLUTE)
+    {
+      fk_joint_index_[joint->name] = joint_names.size();
+      joint_names.push_back(joint->name);
+    }
+  }
+
+  fk_link_index_.clear();
+  for (size_t i = 0; i < simox_links_.size(); i++)
+    fk_link_index_[simox_links_[i]->name] = i;
+
+  std::map<int, bool> actors;
+  this->get_actors(actors);
+
+  std::string fk_header_file = output_dir + "/" + fk_header_filename;
+  std::ofstream out(fk_header_file.c_str());
+  if (!out)
+  {
+    throw std::runtime_error("Failed to open " + fk_header_file + " for writing.");
+  }
+  out << std::setprecision(17);
+
+  out << "/**\n";
+  out << " * @file   " << fk_header_filename << "\n";
+  out << " * @brief  Forward kinematics of " << hand_type_ << ", generated by urdf_to_simox_xml from "
+      << urdf_model_->getName() << ".\n";
+  out << " *         Do not edit, run urdf_to_simox_xml with --fk_header instead.\n";
+  out << " *\n";
+  out << " * The joint axes and offsets are the ones of the Simox XML file. Poses are row-major\n";
+  out << " * 3x4 matrices (rotation, then translation in mm), in the frame of the root node.\n";
+  out << " **/\n\n";
+  out << "#pragma once\n\n";
+  out << "#include <cmath>\n\n";
+  out << "namespace generated_hand_fk\n{\n\n";
+
+  out << "static const char *const hand_type = \"" << hand_type_ << "\";\n\n";
+
+  out << "static const int num_joints = " << joint_names.size() << ";\n";
+  out << "static const char *const joint_names[num_joints] = {\n";
+  for (size_t i = 0; i < joint_names.size(); i++)
+    out << "  \"" << joint_names[i] << "\"" << (i + 1 < joint_names.size() ? "," : "") << "\n";
+  out << "};\n\n";
+
+  out << "static const int num_links = " << simox_links_.size() << ";\n";
+  out << "static const char *const link_names[num_links] = {\n";
+  for (size_t i = 0; i < simox_links_.size(); i++)
+    out << "  \"" << simox_links_[i]->name << "\"" << (i + 1 < simox_links_.size() ? "," : "") << "\n";
+  out << "};\n\n";
+
+  out << "static const int num_actors = " << actors.size() << ";\n";
+  out << "static const char actor_names[num_actors] = {";
+  for (std::map<int, bool>::iterator iter = actors.begin(); iter != actors.end(); ++iter)
+    out << (iter == actors.begin() ? " " : ", ") << "'" << static_cast<char>(iter->first) << "'";
+  out << " };\n\n";
+
+  // The coupled joints, which follow their joint while closing the hand (as PropagateJointValue in Simox).
+  std::vector<std::string> couplings;
+  for (name2coupling::const_iterator iter = coupled_joints_.begin(); iter != coupled_joints_.end(); ++iter)
+  {
+    if (fk_joint_index_.find(iter->first) == fk_joint_index_.end() ||
+        fk_joint_index_.find(iter->second.first) == fk_joint_index_.end())
+      continue;
+    std::ostringstream ss;
+    ss << std::setprecision(17) << "  { " << fk_joint_index_[iter->first] << ", "
+       << fk_joint_index_[iter->second.first] << ", " << iter->second.second << " }";
+    couplings.push_back(ss.str());
+  }
+  // An array cannot be empty.
+  const size_t num_couplings = couplings.size();
+  if (couplings.empty())
+    couplings.push_back("  { -1, -1, 0.0 }");
+
+  out << "// q[joint] = q[leader] * factor, for each coupled joint.\n";
+  out << "struct Coupling\n{\n  int joint;\n  int leader;\n  double factor;\n};\n\n";
+  out << "static const int num_couplings = " << num_couplings << ";\n";
+  out << "static const Coupling couplings[" << couplings.size() << "] = {\n";
+  for (size_t i = 0; i < couplings.size(); i++)
+    out << couplings[i] << (i + 1 < couplings.size() ? "," : "") << "\n";
+  out << "};\n\n";
+
+  // The collision filter (all true if the links were not swept).
+  const bool filtered = !can_collide_.empty();
+  out << "// Pairs of links that can collide, and links that can reach the workspace around the GCP,\n";
+  out << "// found by sweeping the links over the joint limits (all true if they were not swept).\n";
+  out << "static const bool collision_filter = " << (filtered ? "true" : "false") << ";\n";
+  out << "static const bool can_collide[num_links][num_links] = {\n";
+  for (size_t i = 0; i < simox_links_.size(); i++)
+  {
+    out << "  {";
+    for (size_t j = 0; j < simox_links_.size(); j++)
+      out << (j == 0 ? " " : ", ") << ((!filtered || can_collide_[i][j]) ? 1 : 0);
+    out << " }" << (i + 1 < simox_links_.size() ? "," : "") << "\n";
+  }
+  out << "};\n";
+  out << "static const bool reaches_workspace[num_links] = {";
+  for (size_t i = 0; i < simox_links_.size(); i++)
+    out << (i == 0 ? " " : ", ") << ((!filtered || reaches_workspace_[i]) ? 1 : 0);
+  out << " };\n\n";
+
+  out << "inline void copy_(const double a[12], double b[12])\n{\n";
+  out << "  for (int i = 0; i < 12; i++)\n    b[i] = a[i];\n}\n\n";
+
+  out << "// c = a * b\n";
+  out << "inline void multiply_(const double a[12], const double b[12], double c[12])\n{\n";
+  for (int r = 0; r < 3; r++)
+  {
+    for (int col = 0; col < 4; col++)
+    {
+      out << "  c[" << 4 * r + col << "] = a[" << 4 * r << "] * b[" << col << "] + a[" << 4 * r + 1
+          << "] * b[" << 4 + col << "] + a[" << 4 * r + 2 << "] * b[" << 8 + col << "]";
+      if (col == 3)
+        out << " + a[" << 4 * r + 3 << "]";
+      out << ";\n";
+    }
+  }
+  out << "}\n\n";
+
+  out << "// c = a * rotation of q around the axis (x, y, z)\n";
+  out << "inline void rotate_(const double a[12], double x, double y, double z, double q, double c[12])\n{\n";
+  out << "  const double s = std::sin(q);\n";
+  out << "  const double co = std::cos(q);\n";
+  out << "  const double t = 1.0 - co;\n";
+  out << "  const double r[12] = { t * x * x + co,     t * x * y - s * z, t * x * z + s * y, 0.0,\n";
+  out << "                         t * x * y + s * z, t * y * y + co,     t * y * z - s * x, 0.0,\n";
+  out << "                         t * x * z - s * y, t * y * z + s * x, t * z * z + co,     0.0 };\n";
+  out << "  multiply_(a, r, c);\n}\n\n";
+
+  const double identity[12] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+
+  // One function per actor, which only computes the poses of the links of the actor.
+  for (std::map<int, bool>::iterator iter = actors.begin(); iter != actors.end(); ++iter)
+  {
+    char actor_name = static_cast<char>(iter->first);
+
+    std::set<std::string> output_links;
+    BOOST_FOREACH(boost::shared_ptr<const urdf::Link> link, simox_links_)
+    {
+      if (actor_name == toupper(link->name.at(0)))
+        output_links.insert(link->name);
+    }
+
+    out << "// Links of actor " << actor_name << ":";
+    BOOST_FOREACH(const std::string &name, output_links)
+      out << " " << name;
+    out << "\n";
+    out << "inline void actor_" << actor_name << "(const double q[num_joints], double poses[num_links][12])\n{\n";
+    int num_frames = 0;
+    this->write_fk_link_(out, base_link_, "", identity, output_links, num_frames);
+    out << "}\n\n";
+  }
+
+  out << "typedef void (*ActorFunction)(const double q[num_joints], double poses[num_links][12]);\n\n";
+  out << "static const ActorFunction actor_functions[num_actors] = {";
+  for (std::map<int, bool>::iterator iter = actors.begin(); iter != actors.end(); ++iter)
+    out << (iter == actors.begin() ? " " : ", ") << "&actor_" << static_cast<char>(iter->first);
+  out << " };\n\n";
+
+  // And one for all the links.
+  {
+    std::set<std::string> output_links;
+    BOOST_FOREACH(boost::shared_ptr<const urdf::Link> link, simox_links_)
+      output_links.insert(link->name);
+
+    out << "inline void all_links(const double q[num_joints], double poses[num_links][12])\n{\n";
+    int num_frames = 0;
+    this->write_fk_link_(out, base_link_, "", identity, output_links, num_frames);
+    out << "}\n\n";
+  }
+
+  out << "} // end of namespace generated_hand_fk\n";
+  out.close();
+
+  ROS_INFO_STREAM("Forward kinematics written to " << fk_header_file << ".");
+}
+
+//-------------------------------------------------------------------------------
+
+/*
+ * Follows add_link_node_ and add_joint_node_: the pose of a link node is the pose
+ * of its joint node times the origin of its visual, and the pose of a joint node is
+ * the pose of its parent link node times its origin, then rotated by the joint value.
+ * frame is the variable holding the pose of the last revolute joint (the root node if empty),
+ * offset the constant transform from that frame to the link.
+ */
+void UrdfToSimoxXml::write_fk_link_(std::ostream & out,
+                                    boost::shared_ptr<const urdf::Link> link,
+                                    const std::string & frame,
+                                    const double offset[12],
+                                    const std::set<std::string> & output_links,
+                                    int & num_frames)
+{
+  double visual_origin[12] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+  if (link->visual)
+    this->get_fk_transform_(link->visual->origin, visual_origin);
+
+  double link_offset[12];
+  UrdfToSimoxXml::fk_multiply_(offset, visual_origin, link_offset);
+
+  if (output_links.find(link->name) != output_links.end())
+  {
+    const int link_index = fk_link_index_[link->name];
+    out << "  {\n";
+    out << "    // " << link->name << "\n";
+    out << "    static const double c[12] = " << UrdfToSimoxXml::fk_array_(link_offset) << ";\n";
+    if (frame.empty())
+      out << "    copy_(c, poses[" << link_index << "]);\n";
+    else
+      out << "    multiply_(" << frame << ", c, poses[" << link_index << "]);\n";
+    out << "  }\n";
+  }
+
+  std::vector< boost::shared_ptr<urdf::Joint> > child_joints;
+  child_joints = link->child_joints;
+  BOOST_FOREACH(boost::shared_ptr<const urdf::Joint> child_joint, child_joints)
+  {
+    // Only the links with a visual node are converted to Simox.
+    boost::shared_ptr<const urdf::Link> child_link = urdf_model_->getLink(child_joint->child_link_name);
+    if (!child_link->visual || !this->fk_subtree_has_(child_link, output_links))
+      continue;
+
+    double joint_origin[12];
+    this->get_fk_transform_(child_joint->parent_to_joint_origin_transform, joint_origin);
+    double joint_offset[12];
+    UrdfToSimoxXml::fk_multiply_(link_offset, joint_origin, joint_offset);
+
+    if (child_joint->type == urdf::Joint::REVOLUTE)
+    {
+      // Simox normalizes the axis.
+      double x = this->round_(child_joint->axis.x);
+      double y = this->round_(child_joint->axis.y);
+      double z = this->round_(child_joint->axis.z);
+      const double norm = std::sqrt(x * x + y * y + z * z);
+      x /= norm;
+      y /= norm;
+      z /= norm;
+
+      std::string child_frame = "f" + boost::lexical_cast<std::string>(num_frames++);
+      out << "  double " << child_frame << "[12];\n";
+      out << "  {\n";
+      out << "    // " << child_joint->name << "\n";
+      out << "    static const double c[12] = " << UrdfToSimoxXml::fk_array_(joint_offset) << ";\n";
+      if (frame.empty())
+      {
+        out << "    rotate_(c, " << x << ", " << y << ", " << z << ", q["
+            << fk_joint_index_[child_joint->name] << "], " << child_frame << ");\n";
+      }
+      else
+      {
+        out << "    double t[12];\n";
+        out << "    multiply_(" << frame << ", c, t);\n";
+        out << "    rotate_(t, " << x << ", " << y << ", " << z << ", q["
+            << fk_joint_index_[child_joint->name] << "], " << child_frame << ");\n";
+      }
+      out << "  }\n";
+
+      const double identity[12] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+      this->write_fk_link_(out, child_link, child_frame, identity, output_links, num_frames);
+    }
+    else
+    {
+      // Fixed joints are folded into the constant offset.
+      this->write_fk_link_(out, child_link, frame, joint_offset, output_links, num_frames);
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+bool UrdfToSimoxXml::fk_subtree_has_(boost::shared_ptr<const urdf::Link> link,
+                                     const std::set<std::string> & output_links)
+{
+  if (output_links.find(link->name) != output_links.end())
+    return true;
+
+  std::vector< boost::shared_ptr<urdf::Joint> > child_joints;
+  child_joints = link->child_joints;
+  BOOST_FOREACH(boost::shared_ptr<const urdf::Joint> child_joint, child_joints)
+  {
+    boost::shared_ptr<const urdf::Link> child_link = urdf_model_->getLink(child_joint->child_link_name);
+    if (child_link->visual && this->fk_subtree_has_(child_link, output_links))
+      return true;
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------------
+
+// Same values as in the Simox XML file (see to_string_), translation in mm.
+void UrdfToSimoxXml::get_fk_transform_(const urdf::Pose & pose,
+                                       double transform[12])
+{
+  double roll, pitch, yaw;
+  pose.rotation.getRPY(roll, pitch, yaw);
+  roll  = this->round_(roll);
+  pitch = this->round_(pitch);
+  yaw   = this->round_(yaw);
+
+  // R = Rz(yaw) * Ry(pitch) * Rx(roll), as in Simox.
+  const double cr = std::cos(roll),  sr = std::sin(roll);
+  const double cp = std::cos(pitch), sp = std::sin(pitch);
+  const double cy = std::cos(yaw),   sy = std::sin(yaw);
+
+  transform[0]  = cy * cp;
+  transform[1]  = cy * sp * sr - sy * cr;
+  transform[2]  = cy * sp * cr + sy * sr;
+  transform[3]  = this->round_(pose.position.x) * 1000.0; // M to MM
+  transform[4]  = sy * cp;
+  transform[5]  = sy * sp * sr + cy * cr;
+  transform[6]  = sy * sp * cr - cy * sr;
+  transform[7]  = this->round_(pose.position.y) * 1000.0; // M to MM
+  transform[8]  = -sp;
+  transform[9]  = cp * sr;
+  transform[10] = cp * cr;
+  transform[11] = this->round_(pose.position.z) * 1000.0; // M to MM
+}
+
+//-------------------------------------------------------------------------------
+
+void UrdfToSimoxXml::fk_multiply_(const double a[12],
+                                  const double b[12],
+                                  double c[12])
+{
+  for (int r = 0; r < 3; r++)
+  {
+    for (int col = 0; col < 4; col++)
+    {
+      c[4 * r + col] = (a[4 * r] * b[col] +
+                        a[4 * r + 1] * b[4 + col] +
+                        a[4 * r + 2] * b[8 + col] +
+                        (col == 3 ? a[4 * r + 3] : 0.0));
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+std::string UrdfToSimoxXml::fk_array_(const double transform[12])
+{
+  std::ostringstream ss;
+  ss << std::setprecision(17);
+  ss << "{ ";
+  for (int i = 0; i < 12; i++)
+    ss << transform[i] << (i < 11 ? ", " : " }");
+  return ss.str();
+}
+
+//-------------------------------------------------------------------------------
+
+// Round as the values written to the Simox XML file.
+double UrdfToSimoxXml::round_(double x)
+{
+  return boost::lexical_cast<double>(this->to_string_(x));
+}
+
+//-------------------------------------------------------------------------------
+
+// c = a * rotation of q around the (unit) axis, as rotate_ in the generated header.
+void UrdfToSimoxXml::fk_rotate_(const double a[12],
+                                const double axis[3],
+                                double q,
+                                double c[12])
+{
+  const double x = axis[0], y = axis[1], z = axis[2];
+  const double s = std::sin(q);
+  const double co = std::cos(q);
+  const double t = 1.0 - co;
+  const double r[12] = { t * x * x + co,     t * x * y - s * z, t * x * z + s * y, 0.0,
+                         t * x * y + s * z, t * y * y + co,     t * y * z - s * x, 0.0,
+                         t * x * z - s * y, t * y * z + s * x, t * z * z + co,     0.0 };
+  UrdfToSimoxXml::fk_multiply_(a, r, c);
+}
+
+//-------------------------------------------------------------------------------
+
+// The axis-aligned box of the corners of the box, transformed.
+SbBox3f UrdfToSimoxXml::transform_box_(const double transform[12],
+                                       const SbBox3f & box)
+{
+  SbBox3f transformed;
+  if (box.isEmpty())
+    return transformed;
+
+  const double *p = transform;
+  for (int corner = 0; corner < 8; corner++)
+  {
+    const SbVec3f v((corner & 1) ? box.getMax()[0] : box.getMin()[0],
+                    (corner & 2) ? box.getMax()[1] : box.getMin()[1],
+                    (corner & 4) ? box.getMax()[2] : box.getMin()[2]);
+    transformed.extendBy(SbVec3f(p[0] * v[0] + p[1] * v[1] + p[2] * v[2] + p[3],
+                                 p[4] * v[0] + p[5] * v[1] + p[6] * v[2] + p[7],
+                                 p[8] * v[0] + p[9] * v[1] + p[10] * v[2] + p[11]));
+  }
+  return transformed;
+}
+
+//-------------------------------------------------------------------------------
+
+/*
+ * The box of the link (in its frame) swept by the joint of the link over its limits, in the
+ * frame of the parent link. The frames are composed as in
+ * write_fk_link_. The limits of a revolute joint are split in collision_intervals_ intervals:
+ * within an interval of half-width d around q, a point at a distance r from the origin of the
+ * joint is at most r * d from where it is at q, so the box at q padded by r * d holds the box
+ * over the interval, and the union of those holds the box over the limits.
+ */
+SbBox3f UrdfToSimoxXml::sweep_box_(boost::shared_ptr<const urdf::Link> link,
+                                   const SbBox3f & box)
+{
+  double visual_origin[12] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+  if (link->visual)
+    this->get_fk_transform_(link->visual->origin, visual_origin);
+  const SbBox3f joint_box = UrdfToSimoxXml::transform_box_(visual_origin, box);
+
+  boost::shared_ptr<const urdf::Joint> joint = link->parent_joint;
+  double joint_origin[12];
+  this->get_fk_transform_(joint->parent_to_joint_origin_transform, joint_origin);
+  if (joint->type != urdf::Joint::REVOLUTE || joint_box.isEmpty())
+    return UrdfToSimoxXml::transform_box_(joint_origin, joint_box);
+
+  double axis[3] = { this->round_(joint->axis.x),
+                     this->round_(joint->axis.y),
+                     this->round_(joint->axis.z) };
+  const double norm = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  for (int i = 0; i < 3; i++)
+    axis[i] /= norm;
+
+  // The farthest point of the box from the origin of the joint is one of its corners.
+  double radius = 0.0;
+  for (int corner = 0; corner < 8; corner++)
+  {
+    const SbVec3f v((corner & 1) ? joint_box.getMax()[0] : joint_box.getMin()[0],
+                    (corner & 2) ? joint_box.getMax()[1] : joint_box.getMin()[1],
+                    (corner & 4) ? joint_box.getMax()[2] : joint_box.getMin()[2]);
+    radius = std::max(radius, static_cast<double>(v.length()));
+  }
+
+  const double lower = this->round_(joint->limits->lower);
+  const double upper = this->round_(joint->limits->upper);
+  const double half_width = (upper - lower) / (2.0 * collision_intervals_);
+  const float padding = static_cast<float>(radius * half_width);
+
+  SbBox3f swept;
+  for (int i = 0; i < collision_intervals_; i++)
+  {
+    double rotated[12];
+    UrdfToSimoxXml::fk_rotate_(joint_origin, axis, lower + (2 * i + 1) * half_width, rotated);
+    const SbBox3f interval_box = UrdfToSimoxXml::transform_box_(rotated, joint_box);
+    swept.extendBy(SbBox3f(interval_box.getMin() - SbVec3f(padding, padding, padding),
+                           interval_box.getMax() + SbVec3f(padding, padding, padding)));
+  }
+  return swept;
+}
+
+//-------------------------------------------------------------------------------
+
+SbBox3f UrdfToSimoxXml::get_bounding_box_(const std::string & filename)
+{
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
+  SoInput scene;
+  if (!scene.openFile(filename.c_str()))
+  {
+    throw std::runtime_error("Could not open " + filename + " for reading");
+  }
+  SoSeparator *root = SoDB::readAll(&scene);
+  scene.closeFile();
+  if (root == NULL)
+  {
+    throw std::runtime_error("Problem reading file " + filename);
+  }
+
+  root->ref();
+  SoGetBoundingBoxAction bbox_action((SbViewportRegion()));
+  bbox_action.apply(root);
+  SbBox3f box = bbox_action.getBoundingBox();
+  root->unref();
+  return box;
+}
+
+//-------------------------------------------------------------------------------
+
+/*
+ * Two links can collide if their bounding boxes (padded by the margin) swept over the joint
+ * limits, in the frame of their closest common ancestor, overlap (see sweep_box_). The joints
+ * between the ancestor and each link are independent, coupled joints included, which are
+ * swept over their own limits. A link can reach the workspace if its box swept over all the
+ * joints, in the frame of the base, is within the workspace radius of the GCP. The boxes only
+ * grow when swept, so the filter is conservative: a pair that is filtered out never collides,
+ * but some pairs that are kept may not collide either.
+ */
+void UrdfToSimoxXml::compute_collision_filter_(void)
+{
+  can_collide_.clear();
+  reaches_workspace_.clear();
+  if (collision_intervals_ <= 0)
+    return;
+
+  const size_t num_links = simox_links_.size();
+
+  // Bounding boxes of the collision models, in the frame of their link node (mm).
+  const float margin = static_cast<float>(collision_margin_ * 1000.0);
+  std::vector<SbBox3f> boxes(num_links);
+  for (size_t i = 0; i < num_links; i++)
+  {
+    std::map<std::string, std::string>::const_iterator file = simox_colli_files_.find(simox_links_[i]->name);
+    if (file == simox_colli_files_.end())
+      continue;
+    SbBox3f box = this->get_bounding_box_(file->second);
+    if (box.isEmpty())
+      continue;
+    boxes[i].setBounds(box.getMin() * 1000.0f - SbVec3f(margin, margin, margin),
+                       box.getMax() * 1000.0f + SbVec3f(margin, margin, margin));
+  }
+
+  // The box of each link swept in the frame of each of its ancestors (and its own), by name,
+  // and in the frame of the base (as the GCP).
+  std::vector< std::map<std::string, SbBox3f> > swept(num_links);
+  std::vector<SbBox3f> base_boxes(num_links);
+  double base_origin[12] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+  if (base_link_->visual)
+    this->get_fk_transform_(base_link_->visual->origin, base_origin);
+  for (size_t i = 0; i < num_links; i++)
+  {
+    if (boxes[i].isEmpty())
+      continue;
+    boost::shared_ptr<const urdf::Link> link = simox_links_[i];
+    SbBox3f box = boxes[i];
+    swept[i][link->name] = box;
+    while (link != base_link_ && link->parent_joint)
+    {
+      box = this->sweep_box_(link, box);
+      link = urdf_model_->getLink(link->parent_joint->parent_link_name);
+      swept[i][link->name] = box;
+    }
+    base_boxes[i] = UrdfToSimoxXml::transform_box_(base_origin, box);
+  }
+
+  double gcp_translation[3];
+  double gcp_rollpitchyaw[3];
+  this->get_hand_gcp_(gcp_translation, gcp_rollpitchyaw);
+  const SbVec3f gcp(this->round_(gcp_translation[0]) * 1000.0,
+                    this->round_(gcp_translation[1]) * 1000.0,
+                    this->round_(gcp_translation[2]) * 1000.0);
+  const float radius = static_cast<float>(workspace_radius_ * 1000.0);
+
+  can_collide_.assign(num_links, std::vector<bool>(num_links, false));
+  reaches_workspace_.assign(num_links, false);
+
+  for (size_t i = 0; i < num_links; i++)
+  {
+    if (swept[i].empty())
+      continue;
+
+    // Distance from the GCP to the box.
+    SbVec3f closest;
+    for (int k = 0; k < 3; k++)
+      closest[k] = std::max(base_boxes[i].getMin()[k], std::min(base_boxes[i].getMax()[k], gcp[k]));
+    if ((closest - gcp).length() <= radius)
+      reaches_workspace_[i] = true;
+
+    for (size_t j = i + 1; j < num_links; j++)
+    {
+      if (swept[j].empty())
+        continue;
+
+      // The closest ancestor of j (or j itself) that is also an ancestor of i.
+      boost::shared_ptr<const urdf::Link> ancestor = simox_links_[j];
+      std::map<std::string, SbBox3f>::const_iterator box_i = swept[i].find(ancestor->name);
+      while (box_i == swept[i].end() && ancestor->parent_joint)
+      {
+        ancestor = urdf_model_->getLink(ancestor->parent_joint->parent_link_name);
+        box_i = swept[i].find(ancestor->name);
+      }
+      if (box_i == swept[i].end())
+        continue;
+
+      if (box_i->second.intersect(swept[j][ancestor->name]))
+        can_collide_[i][j] = can_collide_[j][i] = true;
+    }
+  }
+
+  size_t num_pairs = 0;
+  size_t num_reaching = 0;
+  for (size_t i = 0; i < num_links; i++)
+  {
+    for (size_t j = i + 1; j < num_links; j++)
+      num_pairs += can_collide_[i][j] ? 1 : 0;
+    num_reaching += reaches_workspace_[i] ? 1 : 0;
+  }
+  ROS_INFO_STREAM(num_pairs << " of " << num_links * (num_links - 1) / 2 << " pairs of links can collide, " <<
+                  num_reaching << " of " << num_links << " links can reach the workspace (" <<
+                  collision_intervals_ << " intervals per joint).");
+}
+
+//-------------------------------------------------------------------------------
+
+// The actor of the link (see add_endeffector_node_), -1 for the static part.
+int UrdfToSimoxXml::get_link_actor_(boost::shared_ptr<const urdf::Link> link)
+{
+  if (link == base_link_)
+    return -1;
+
+  std::map<int, bool> actors;
+  this->get_actors(actors);
+  const int first_int = toupper(static_cast<int>(link->name.at(0)));
+  return (actors.find(first_int) != actors.end()) ? first_int : -1;
+}
+
+//-------------------------------------------------------------------------------
+
+/*
+ * Simox checks a node of an actor against the other actors with Actors, against the
+ * static part with Static, against both with All, and against the object with any of them.
+ */
+std::string UrdfToSimoxXml::get_consider_collisions_(boost::shared_ptr<const urdf::Link> link)
+{
+  if (can_collide_.empty())
+    return "None";
+
+  size_t index = 0;
+  while (simox_links_[index] != link)
+    index++;
+
+  const int actor = this->get_link_actor_(link);
+  bool actors = false;
+  bool statics = false;
+  for (size_t j = 0; j < simox_links_.size(); j++)
+  {
+    if (!can_collide_[index][j])
+      continue;
+    const int other_actor = this->get_link_actor_(simox_links_[j]);
+    if (other_actor < 0)
+      statics = true;
+    else if (other_actor != actor)
+      actors = true;
+  }
+
+  if (actors && statics)
+    return "All";
+  if (statics)
+    return "Static";
+  if (actors || reaches_workspace_[index])
+    return "Actors";
+  return "None";
+}
+
 //-------------------------------------------------------------------------------
 
 void UrdfToSimoxXml::set_joint_limits_node_(boost::property_tree::ptree & Limits_node,
@@ -700,6 +1539,8 @@ void UrdfToSimoxXml::set_rollpitchyaw_node_(boost::property_tree::ptree & Transl
 std::string UrdfToSimoxXml::write_to_iv_file_(const std::string & file_name,
                                        SoSeparator *scene_with_shape)
 {
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
   std::string simox_filename;
   std::string model_dir = output_dir_ + UrdfToSimoxXml::model_dir_name_;
   if (!boost::filesystem::exists(model_dir))
@@ -708,7 +1549,7 @@ std::string UrdfToSimoxXml::write_to_iv_file_(const std::string & file_name,
 
   SoWriteAction writeAction;
   writeAction.getOutput()->openFile(simox_filename.c_str());
-  writeAction.getOutput()->setBinary(FALSE);
+  writeAction.getOutput()->setBinary(binary_models_ ? TRUE : FALSE);
   writeAction.apply(scene_with_shape);
   writeAction.getOutput()->closeFile();
 
@@ -722,6 +1563,8 @@ std::string UrdfToSimoxXml::convert_cube_(const std::string & link_name,
                                           const double & height,
                                           const double & depth)
 {
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
   // Make a scene containing a cube.
   SoSeparator *cube_scene = new SoSeparator;
   SoUnits *cube_units = new SoUnits;
@@ -754,6 +1597,8 @@ std::string UrdfToSimoxXml::convert_cylinder_(const std::string & link_name,
                                               const double & height,
                                               const double & radius)
 {
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
   // Make a scene containing a cylinder.
   SoSeparator *cylinder_scene = new SoSeparator;
   SoUnits *cylinder_units = new SoUnits;
@@ -784,6 +1629,8 @@ std::string UrdfToSimoxXml::convert_cylinder_(const std::string & link_name,
 std::string UrdfToSimoxXml::convert_sphere_(const std::string & link_name,
                                             const double & radius)
 {
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
   // Make a scene containing a sphere.
   SoSeparator *sphere_scene = new SoSeparator;
   SoUnits *sphere_units = new SoUnits;
@@ -823,16 +1670,14 @@ std::string UrdfToSimoxXml::convert_mesh_(const std::string & urdf_filename)
   }
   else
   {
-    ROS_ERROR_STREAM("The prefix of " << urdf_filename << " is NOT package://.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("The prefix of " + urdf_filename + " is NOT package://.");
   }
 
   std::list<std::string> stringList;
   boost::iter_split(stringList, urdf_filename_copy, boost::first_finder("/"));
   if (stringList.size() < 2)
   {
-    ROS_ERROR_STREAM(urdf_filename << " is either empty or too short.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error(urdf_filename + " is either empty or too short.");
   }
 
   std::string package_name = stringList.front();
@@ -886,9 +1731,9 @@ std::string UrdfToSimoxXml::convert_mesh_(const std::string & urdf_filename)
     std::size_t found = str.find("loaded has 0 vn");
     if (found!=std::string::npos)
     {
-      ROS_ERROR_STREAM("The following system call failed. Check URDF data.");
-      ROS_ERROR_STREAM(stream.str());
-      exit (EXIT_FAILURE);
+      free(line);
+      pclose(fp);
+      throw std::runtime_error("The following system call failed. Check URDF data.\n" + stream.str());
     }
   }
   if (line)
@@ -901,35 +1746,87 @@ std::string UrdfToSimoxXml::convert_mesh_(const std::string & urdf_filename)
 
 //-------------------------------------------------------------------------------
 
+// <mesh filename="package://sr_grasp_description/meshes/TH3_z.dae" scale="0.1 0.1 0.1" />
+std::string UrdfToSimoxXml::convert_scaled_mesh_(const std::string & urdf_filename,
+                                                 const urdf::Vector3 & mesh_scale)
+{
+  std::stringstream key;
+  key << urdf_filename << " " << mesh_scale.x << " " << mesh_scale.y << " " << mesh_scale.z << " " << scale_ <<
+      (binary_models_ ? " binary" : "");
+
+  boost::shared_ptr<ConvertedMesh> converted;
+  {
+    boost::mutex::scoped_lock lock(converted_meshes_mutex_);
+    boost::shared_ptr<ConvertedMesh> &entry = converted_meshes_[key.str()];
+    if (!entry)
+      entry.reset(new ConvertedMesh);
+    converted = entry;
+  }
+
+  // The first converter to get the mesh converts it, the others wait for it.
+  boost::mutex::scoped_lock lock(converted->mutex);
+  if (converted->filename.empty())
+  {
+    std::string simox_filename = this->convert_mesh_(urdf_filename);
+    const double scale_x = mesh_scale.x * scale_;
+    const double scale_y = mesh_scale.y * scale_;
+    const double scale_z = mesh_scale.z * scale_;
+    if (scale_x != 1.0 || scale_y != 1.0 || scale_z != 1.0)
+      this->scale_wrl_scene_(simox_filename, scale_x, scale_y, scale_z);
+    if (binary_models_)
+      simox_filename = this->write_binary_iv_(simox_filename);
+
+    converted->filename = simox_filename;
+    converted->scale = scale_;
+    return simox_filename;
+  }
+
+  scale_ = converted->scale;
+
+  // Converted for another output directory.
+  std::string model_dir = output_dir_ + UrdfToSimoxXml::model_dir_name_;
+  std::string simox_filename = model_dir + "/" + boost::filesystem::path(converted->filename).filename().string();
+  if (simox_filename != converted->filename)
+  {
+    if (!boost::filesystem::exists(model_dir))
+      boost::filesystem::create_directories(model_dir);
+    boost::filesystem::copy_file(converted->filename, simox_filename,
+                                 boost::filesystem::copy_option::overwrite_if_exists);
+  }
+  ROS_INFO_STREAM(urdf_filename << " was already converted to " << converted->filename << ".");
+  return simox_filename;
+}
+
+//-------------------------------------------------------------------------------
+
 void UrdfToSimoxXml::scale_wrl_scene_(const std::string & filename,
                                       const double & scale_x,
                                       const double & scale_y,
                                       const double & scale_z)
 {
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
   SoSeparator *root = new SoSeparator;
   SoInput scene;
 
   // Try to open the file.
   if (!scene.openFile(filename.c_str()))
   {
-    ROS_ERROR("Could not open %s for reading\n", filename.c_str());
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("Could not open " + filename + " for reading");
   }
 
   // Check if the file is valid.
   if (!scene.isValidFile())
   {
-    ROS_ERROR("File %s is not a valid Inventor file\n", filename.c_str());
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("File " + filename + " is not a valid Inventor file");
   }
 
   // Try to read the file.
   root = SoDB::readAll(&scene);
   if (root == NULL)
   {
-    ROS_ERROR("Problem reading file %s\n", filename.c_str());
     scene.closeFile();
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("Problem reading file " + filename);
   }
 
   // Close the file.
@@ -967,8 +1864,82 @@ void UrdfToSimoxXml::scale_wrl_scene_(const std::string & filename,
     }
   }
 
-  ROS_ERROR_STREAM("UrdfToSimoxXml::scale_wrl_scene_ failed. Should not reach here.");
-  exit (EXIT_FAILURE);
+  root->unref();
+  throw std::runtime_error("UrdfToSimoxXml::scale_wrl_scene_ failed. Should not reach here.");
+}
+
+//-------------------------------------------------------------------------------
+
+// Convert a .wrl file written by meshlabserver to a binary .iv file next to it.
+std::string UrdfToSimoxXml::write_binary_iv_(const std::string & wrl_filename)
+{
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
+  SoInput scene;
+  if (!scene.openFile(wrl_filename.c_str()))
+  {
+    throw std::runtime_error("Could not open " + wrl_filename + " for reading");
+  }
+  SoSeparator *root = SoDB::readAll(&scene);
+  scene.closeFile();
+  if (root == NULL)
+  {
+    throw std::runtime_error("Problem reading file " + wrl_filename);
+  }
+  root->ref();
+
+  boost::filesystem::path iv_path(wrl_filename);
+  iv_path.replace_extension(".iv");
+  const std::string iv_filename = iv_path.string();
+
+  SoOutput out;
+  if (!out.openFile(iv_filename.c_str()))
+  {
+    root->unref();
+    throw std::runtime_error("Could not open " + iv_filename + " for writing");
+  }
+  out.setBinary(TRUE);
+  SoWriteAction wra(&out);
+  wra.apply(root);
+  out.closeFile();
+  root->unref();
+
+  // Compare both formats, as the planner would load them.
+  const double ascii_bytes = static_cast<double>(boost::filesystem::file_size(wrl_filename));
+  const double binary_bytes = static_cast<double>(boost::filesystem::file_size(iv_filename));
+  const double ascii_parse_time = UrdfToSimoxXml::parse_time_(wrl_filename);
+  const double binary_parse_time = UrdfToSimoxXml::parse_time_(iv_filename);
+  ascii_bytes_ += ascii_bytes;
+  binary_bytes_ += binary_bytes;
+  ascii_parse_time_ += ascii_parse_time;
+  binary_parse_time_ += binary_parse_time;
+  ROS_INFO_STREAM(iv_path.filename().string() << ": " << binary_bytes / 1024.0 << " kB (" <<
+                  ascii_bytes / 1024.0 << " kB as VRML), parsed in " << binary_parse_time * 1000.0 << " ms (" <<
+                  ascii_parse_time * 1000.0 << " ms as VRML).");
+
+  boost::filesystem::remove(wrl_filename);
+  return iv_filename;
+}
+
+//-------------------------------------------------------------------------------
+
+double UrdfToSimoxXml::parse_time_(const std::string & filename)
+{
+  boost::recursive_mutex::scoped_lock lock(inventor_mutex_);
+
+  const ros::WallTime start = ros::WallTime::now();
+  SoInput scene;
+  if (!scene.openFile(filename.c_str()))
+    return 0.0;
+  SoSeparator *root = SoDB::readAll(&scene);
+  scene.closeFile();
+  const double parse_time = (ros::WallTime::now() - start).toSec();
+  if (root != NULL)
+  {
+    root->ref();
+    root->unref();
+  }
+  return parse_time;
 }
 
 //-------------------------------------------------------------------------------
@@ -988,13 +1959,11 @@ void UrdfToSimoxXml::set_base_link_(void)
   }
   if (n == 0)
   {
-    ROS_ERROR_STREAM("Failed to set the base link.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("Failed to set the base link.");
   }
   if (n > 1)
   {
-    ROS_ERROR_STREAM("There are multiple base links.");
-    exit (EXIT_FAILURE);
+    throw std::runtime_error("There are multiple base links.");
   }
 }
 